@@ -1,8 +1,11 @@
+#include "absl/strings/str_cat.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/matrix.h"
+#include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/formats/tensor.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/gpu/gl_calculator_helper.h"
-#include "mediapipe/util/resource_util.h"
 
 #define HAVE_GPU_BUFFER
 #ifdef __APPLE__
@@ -11,39 +14,148 @@
 
 
 #include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_engine.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_execution_context.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_host_copy.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_image.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_latency_governor.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_packed_image.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_trace_recorder.h"
 #include <lluvia/core.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <map>
 #include <memory>
-#include <tuple>
+#include <mutex>
+#include <set>
+#include <vector>
 
 namespace mediapipe {
 
+namespace {
 
-struct PortHandler {
-    // the staging buffer used to transfer data from ImageFrame or GPUBuffer to Lluvia/Vulkan memory space
-    std::shared_ptr<ll::Buffer> stagingBuffer;
-    
-    // the pointer to the staging buffer mapped to the host memory space.
-    std::unique_ptr<uint8_t [], ll::Buffer::BufferMapDeleter> stagingBufferMappedPtr;
+// Copies the region of src at (x, y) with the size of dst. The region can
+// extend past the borders of src, pixels outside replicate the nearest border pixel.
+void copyTileWithHalo(const ImageFrame& src, const int x, const int y, ImageFrame& dst) {
 
-    // the image in device memory
-    std::shared_ptr<ll::Image> image;
+    const auto pixelBytes = static_cast<size_t>(src.NumberOfChannels() * src.ByteDepth());
 
-    // the image vide to feed to the container node
-    std::shared_ptr<ll::ImageView> imageView;
+    // columns of dst inside src
+    const auto begin = std::clamp(-x, 0, dst.Width());
+    const auto end = std::clamp(src.Width() - x, begin, dst.Width());
 
-    // port name in the Lluvia's container node
-    std::string lluviaPortName;
+    for (auto row = 0; row < dst.Height(); ++row) {
 
-    // mediapipe tag used to bind port
-    std::string mediapipeTag;
+        const auto* srcRow = src.PixelData() + std::clamp(y + row, 0, src.Height() - 1) * src.WidthStep();
+        auto* dstRow = dst.MutablePixelData() + row * dst.WidthStep();
 
-    // type of mediapipe packet expected to be received in this port.
-    lluvia::MediapipePacketType mediapipePacketType;
-};
+        std::memcpy(dstRow + begin * pixelBytes, srcRow + (x + begin) * pixelBytes, (end - begin) * pixelBytes);
+
+        for (auto col = 0; col < begin; ++col) {
+            std::memcpy(dstRow + col * pixelBytes, srcRow, pixelBytes);
+        }
+
+        for (auto col = end; col < dst.Width(); ++col) {
+            std::memcpy(dstRow + col * pixelBytes, srcRow + (src.Width() - 1) * pixelBytes, pixelBytes);
+        }
+    }
+}
+
+int getScaledSize(const int size, const float scale) {
+    return std::max(1, static_cast<int>(std::lround(size * scale)));
+}
+
+// Options of the engine running a degradation level of the latency governor.
+lluvia::LluviaCalculatorOptions makeLevelOptions(const lluvia::LluviaCalculatorOptions& options, const lluvia::DegradationLevel& level) {
+
+    auto levelOptions = options;
+
+    // the calculator applies the governor, an engine runs a single level
+    levelOptions.clear_latency_governor();
+
+    for (const auto& parameter : level.parameter()) {
+
+        auto& parameters = *levelOptions.mutable_parameter();
+        auto it = std::find_if(parameters.begin(), parameters.end(), [&parameter](const lluvia::ContainerParameter& p) {
+            return p.name() == parameter.name();
+        });
+
+        if (it != parameters.end()) {
+            *it = parameter;
+        } else {
+            *levelOptions.add_parameter() = parameter;
+        }
+    }
+
+    // the snapshot holds the container node initialized with the parameters of level 0
+    levelOptions.clear_snapshot_path();
+
+    for (auto& portBinding : *levelOptions.mutable_input_port_binding()) {
+        if (portBinding.width() > 0 && portBinding.height() > 0) {
+            portBinding.set_width(getScaledSize(portBinding.width(), level.input_scale()));
+            portBinding.set_height(getScaledSize(portBinding.height(), level.input_scale()));
+        }
+    }
+
+    return levelOptions;
+}
 
-// Calculator to pass a CPU image through. It prints in the logs the
-// image attributes such as resolution and format.
+// Nearest neighbour resize of image to the size of resized, sampling the
+// source pixel at the center of each destination pixel.
+void resizeImageFrame(const ImageFrame& image, ImageFrame& resized) {
+
+    const auto pixelBytes = image.NumberOfChannels() * image.ByteDepth();
+
+    for (auto y = 0; y < resized.Height(); ++y) {
+
+        const auto* srcRow = image.PixelData() + static_cast<int64_t>(2 * y + 1) * image.Height() / (2 * resized.Height()) * image.WidthStep();
+        auto* dstRow = resized.MutablePixelData() + y * resized.WidthStep();
+
+        for (auto x = 0; x < resized.Width(); ++x) {
+            const auto srcX = static_cast<int64_t>(2 * x + 1) * image.Width() / (2 * resized.Width());
+            std::copy_n(srcRow + srcX * pixelBytes, pixelBytes, dstRow + x * pixelBytes);
+        }
+    }
+}
+
+std::mutex pinnedDevicesMutex;
+
+// number of temporal calculators pinned to each device index
+std::map<int, int> pinnedDevices;
+
+// Returns the device with the fewest temporal calculators pinned to it, the
+// first listed on ties, and pins one more calculator to it.
+int pinTemporalDevice(const std::vector<int>& deviceIndices) {
+
+    auto guard = std::lock_guard {pinnedDevicesMutex};
+
+    auto selected = deviceIndices[0];
+    for (const auto deviceIndex : deviceIndices) {
+        if (pinnedDevices[deviceIndex] < pinnedDevices[selected]) {
+            selected = deviceIndex;
+        }
+    }
+
+    ++pinnedDevices[selected];
+    return selected;
+}
+
+void unpinTemporalDevice(const int deviceIndex) {
+
+    auto guard = std::lock_guard {pinnedDevicesMutex};
+    --pinnedDevices[deviceIndex];
+}
+
+} // namespace
+
+// Calculator running a Lluvia container node on its input packets. Frames
+// run on a single device, or are distributed across several devices in
+// multi device mode.
 class LluviaCalculator : public CalculatorBase {
 public:
     static ::mediapipe::Status GetContract(CalculatorContract* cc);
@@ -51,49 +163,190 @@ public:
     ::mediapipe::Status Process(CalculatorContext* cc) override;
     ::mediapipe::Status Close(CalculatorContext* cc) override;
 
-    
-
 private:
-    ::mediapipe::Status InitNode(CalculatorContext* cc);
+    ::mediapipe::Status OpenMultiDevice(const std::vector<ll::DeviceDescriptor>& availableDevices);
+    ::mediapipe::Status OpenTiled(const ll::DeviceDescriptor& device);
 
-    std::tuple<bool, ll::ChannelCount, ll::ChannelType> getLluviaImageFormat(const mediapipe::ImageFormat_Format format);
-    std::tuple<bool, mediapipe::ImageFormat_Format> getMediapipeImageFormat(const ll::ChannelCount channelCount, const ll::ChannelType channelType);
+    // initializes the context and runs the warm-up frames if the input
+    // shapes are declared. Positive width and height replace the declared sizes.
+    ::mediapipe::Status InitEagerly(LluviaExecutionContext& context, const int width, const int height);
+    size_t RouteFrame();
 
-    ::mediapipe::Status InitInputPortAsImageFrame(const lluvia::PortBinding& portBinding, CalculatorContext* cc);
-    ::mediapipe::Status InitInputPortAsGpuBuffer(const lluvia::PortBinding& portBinding, CalculatorContext* cc);
+    // reads the input packets of the current timestamp into the frame
+    void ReadFrame(CalculatorContext* cc, LluviaFrame& frame) const;
+
+    // runs the tiles of the frame and emits the stitched outputs
+    ::mediapipe::Status ProcessTiled(CalculatorContext* cc, const LluviaFrame& frame);
+
+    // runs m_frame at the level of the latency governor and reports its times
+    ::mediapipe::Status ProcessGoverned(CalculatorContext* cc);
+
+    // engine of a latency governor level, m_engine for level 0
+    LluviaEngine& getLevelEngine(const int level);
+    ::mediapipe::Status ValidateLatencyGovernor() const;
+
+    // resizes the IMAGE_FRAME outputs of m_frame, run at input scale, to
+    // their size at full resolution
+    void UpscaleOutputs(const float scale);
+
+    // emits the finished frames in timestamp order, waiting for the oldest
+    // ones while more than maxPendingFrames are in flight
+    ::mediapipe::Status EmitFrames(CalculatorContext* cc, const size_t maxPendingFrames);
 
     lluvia::LluviaCalculatorOptions m_options;
+    std::string m_nodeName {};
+
+    // null if trace_path is not set
+    std::shared_ptr<LluviaTraceRecorder> m_trace {};
+
+    // tags of the input streams, read once as GetTags() returns a new set
+    std::vector<std::string> m_inputTags {};
+
+    // single device mode, frames run on the executor thread through
+    // LluviaEngine::ProcessFrame(). The frame is reused so that steady state
+    // Process() calls do not allocate besides the output packets
+    std::unique_ptr<LluviaEngine> m_engine {};
+    LluviaFrame m_frame {};
+
+    // latency governor, single device mode only. The engines of levels 1
+    // and above are created in Open() next to m_engine.
+    std::unique_ptr<LluviaLatencyGovernor> m_governor {};
+    std::vector<std::unique_ptr<LluviaEngine>> m_levelEngines {};
+
+    // tags of the IMAGE_FRAME outputs, and their size on the frames run at
+    // full resolution, which outputs of reduced input scales are resized to
+    std::set<std::string> m_imageOutputTags {};
+    std::map<std::string, std::pair<int, int>> m_fullOutputSizes {};
+
+    // levels that processed a frame, whose times no longer include the initialization
+    std::vector<bool> m_levelsInitialized {};
+
+    // resized input images by tag, reused while the level and input size do not change
+    std::map<std::string, std::unique_ptr<ImageFrame>> m_resizedInputs {};
+    bool m_levelReported {false};
+
+    // multi device mode, one worker per execution context
+    struct PendingFrame {
+        std::shared_ptr<LluviaFrame> frame;
+        std::shared_future<::mediapipe::Status> status;
+    };
+
+    std::vector<std::unique_ptr<LluviaDeviceWorker>> m_workers {};
+    std::deque<PendingFrame> m_pendingFrames {};
+    size_t m_nextWorker {0};
 
-    std::shared_ptr<ll::Session> m_session {};
-    std::shared_ptr<ll::Memory> m_hostMemory {};
-    std::shared_ptr<ll::Memory> m_deviceMemory {};
+    // device index a temporal container node is pinned to, -1 if not pinned
+    int m_pinnedDevice {-1};
 
-    std::unique_ptr<ll::CommandBuffer> m_cmdBuffer {};
-    std::unique_ptr<ll::Duration> m_duration {};
+    // tiled mode, a tile is copied to one slot while the other runs
+    struct TileSlot {
+        std::shared_ptr<LluviaFrame> frame;
 
-    // the container node
-    std::shared_ptr<ll::ContainerNode> m_containerNode {};
+        // tile input images by tag, referenced by the frame
+        std::map<std::string, std::unique_ptr<ImageFrame>> inputs;
 
-    std::vector<mediapipe::PortHandler> m_inputHandlers;
-    std::vector<mediapipe::PortHandler> m_outputHandlers;
+        // position of the tile in the output images, without halo
+        int x {0};
+        int y {0};
+
+        // invalid if no tile is in flight
+        std::shared_future<::mediapipe::Status> status;
+
+        // destroyed first as it can still read the inputs
+        std::unique_ptr<LluviaDeviceWorker> worker;
+    };
+
+    std::array<TileSlot, 2> m_tileSlots {};
+    bool m_tiled {false};
 
 #if !MEDIAPIPE_GPU_BUFFER_USE_CV_PIXEL_BUFFER
     GlCalculatorHelper m_glHelper;
 #endif  // MEDIAPIPE_GPU_BUFFER_USE_CV_PIXEL_BUFFER
-
-    std::once_flag m_configureNode {};
 };
 
 ::mediapipe::Status LluviaCalculator::GetContract(CalculatorContract* cc) {
 
     LOG(INFO) << "LLUVIA: GetContract()";
 
+    const auto& options = cc->Options<lluvia::LluviaCalculatorOptions>();
+    const auto outputPortBindings = getOutputPortBindings(options);
+
+    // region of interest streams can be declared by both input and output bindings
+    auto lluviaImageTags = std::set<std::string> {};
+    for (const auto& portBinding : options.input_port_binding()) {
+        if (portBinding.packet_type() == lluvia::LLUVIA_IMAGE) lluviaImageTags.insert(portBinding.mediapipe_tag());
+    }
+
+    for (const auto& portBinding : outputPortBindings) {
+        if (portBinding.packet_type() == lluvia::LLUVIA_IMAGE) lluviaImageTags.insert(portBinding.mediapipe_tag());
+    }
+
+    // FLOAT_VECTOR and MATRIX ports, inputs and outputs
+    auto vectorTags = std::map<std::string, lluvia::MediapipePacketType> {};
+    for (const auto& portBinding : options.input_port_binding()) {
+        if (isVectorPacketType(portBinding.packet_type())) vectorTags[portBinding.mediapipe_tag()] = portBinding.packet_type();
+    }
+
+    for (const auto& portBinding : outputPortBindings) {
+        if (isVectorPacketType(portBinding.packet_type())) vectorTags[portBinding.mediapipe_tag()] = portBinding.packet_type();
+    }
+
+    auto roiTags = std::set<std::string> {};
+    for (const auto& portBinding : options.input_port_binding()) {
+        if (!portBinding.roi_tag().empty()) roiTags.insert(portBinding.roi_tag());
+    }
+
+    for (const auto& portBinding : outputPortBindings) {
+        if (!portBinding.roi_tag().empty()) roiTags.insert(portBinding.roi_tag());
+    }
+
+    auto triggerTags = std::set<std::string> {};
+    for (const auto& portBinding : outputPortBindings) {
+        if (!portBinding.readback().trigger_tag().empty()) triggerTags.insert(portBinding.readback().trigger_tag());
+    }
+
     for (const auto& tag : cc->Inputs().GetTags()) {
-        cc->Inputs().Tag(tag).SetOneOf<ImageFrame, GpuBuffer>();
+        if (triggerTags.count(tag) > 0) {
+            cc->Inputs().Tag(tag).Set<bool>();
+        } else if (roiTags.count(tag) > 0) {
+            cc->Inputs().Tag(tag).SetOneOf<NormalizedRect, Rect>();
+        } else if (lluviaImageTags.count(tag) > 0) {
+            cc->Inputs().Tag(tag).Set<LluviaImage>();
+        } else if (vectorTags.count(tag) > 0) {
+            if (vectorTags[tag] == lluvia::MATRIX) cc->Inputs().Tag(tag).Set<Matrix>();
+            else cc->Inputs().Tag(tag).Set<std::vector<float>>();
+        } else {
+            cc->Inputs().Tag(tag).SetOneOf<ImageFrame, GpuBuffer>();
+        }
+    }
+
+    auto packedTags = std::set<std::string> {};
+    for (const auto& portBinding : outputPortBindings) {
+        if (portBinding.packing().encoding() != lluvia::OutputPacking::NONE) packedTags.insert(portBinding.mediapipe_tag());
     }
 
+    auto tensorTags = std::set<std::string> {};
+    for (const auto& portBinding : outputPortBindings) {
+        if (portBinding.packet_type() == lluvia::TENSOR) tensorTags.insert(portBinding.mediapipe_tag());
+    }
+
+    const auto& levelTag = options.latency_governor().level_tag();
+
     for (const auto& tag : cc->Outputs().GetTags()) {
-        cc->Outputs().Tag(tag).SetOneOf<ImageFrame, GpuBuffer>();
+        if (!levelTag.empty() && tag == levelTag) {
+            cc->Outputs().Tag(tag).Set<int>();
+        } else if (tensorTags.count(tag) > 0) {
+            cc->Outputs().Tag(tag).Set<std::vector<Tensor>>();
+        } else if (packedTags.count(tag) > 0) {
+            cc->Outputs().Tag(tag).Set<LluviaPackedImage>();
+        } else if (lluviaImageTags.count(tag) > 0) {
+            cc->Outputs().Tag(tag).Set<LluviaImage>();
+        } else if (vectorTags.count(tag) > 0) {
+            if (vectorTags[tag] == lluvia::MATRIX) cc->Outputs().Tag(tag).Set<Matrix>();
+            else cc->Outputs().Tag(tag).Set<std::vector<float>>();
+        } else {
+            cc->Outputs().Tag(tag).SetOneOf<ImageFrame, GpuBuffer>();
+        }
     }
 
     // Note: we call this method even on platforms where we don't use the helper,
@@ -108,455 +361,565 @@ private:
 
     LOG(INFO) << "Open()";
 
-    // Inform the framework that we always output at the same timestamp
-    // as we receive a packet at.
-    cc->SetOffset(TimestampDiff(0));
-
 // #if !MEDIAPIPE_GPU_BUFFER_USE_CV_PIXEL_BUFFER
 //     MP_RETURN_IF_ERROR(m_glHelper.Open(cc));
 // #endif  // MEDIAPIPE_GPU_BUFFER_USE_CV_PIXEL_BUFFER
 
     m_options = cc->Options<lluvia::LluviaCalculatorOptions>();
+    m_nodeName = cc->NodeName();
 
-    // try to find a DISCRETE_GPU device
-    auto availableDevices = ll::Session::getAvailableDevices();
-    auto selectedDevice = availableDevices[0];
+    const auto inputTags = cc->Inputs().GetTags();
+    m_inputTags.assign(inputTags.begin(), inputTags.end());
 
-    for (const auto& desc : availableDevices) {
-        if (desc.deviceType == ll::DeviceType::DiscreteGPU) {
-            selectedDevice = desc;
+    // outputs of all the container nodes share the output streams of the calculator
+    auto outputTags = std::set<std::string> {};
+    for (const auto& portBinding : getOutputPortBindings(m_options)) {
+        if (!outputTags.insert(portBinding.mediapipe_tag()).second) {
+            return absl::InvalidArgumentError(absl::StrCat("output tag ", portBinding.mediapipe_tag(), " is bound more than once"));
         }
     }
 
-    LOG(INFO) << "using device: " << selectedDevice.name;
+    if (!m_options.trace_path().empty()) {
+        m_trace = LluviaTraceRecorder::getOrCreate(m_options.trace_path(), m_options.trace_max_events());
+    }
 
-    // TODO: options for creating the session
-    // - device type
-    auto sessionDescriptor = ll::SessionDescriptor()
-        .setDeviceDescriptor(selectedDevice)
-        .enableDebug(m_options.enable_debug());
+    auto openScope = LluviaTraceScope {m_trace.get(), m_nodeName, "Open"};
 
-    m_session = ll::Session::create(sessionDescriptor);
+    auto availableDevices = ll::Session::getAvailableDevices();
+    if (availableDevices.empty()) {
+        return absl::UnavailableError("no Vulkan device available");
+    }
 
-    // print available memory flags
-    for (const auto& memFlags : m_session->getSupportedMemoryFlags()) {
-        auto flags = std::string {};
-        for (const auto& f : ll::memoryPropertyFlagsToVectorString(memFlags)) {
-            flags = flags + f +  ", ";
-        }
-        LOG(INFO) << "memory flags: " << flags;
+    m_governor = absl::make_unique<LluviaLatencyGovernor>(m_options.latency_governor());
+    if (m_governor->isEnabled()) {
+        MP_RETURN_IF_ERROR(ValidateLatencyGovernor());
     }
-    
-    auto deviceMemoryProperties = ll::MemoryPropertyFlagBits::DeviceLocal;
-    m_deviceMemory = m_session->createMemory(deviceMemoryProperties, 32 * 1024 * 1024, false);
 
-    #ifdef __ANDROID__
-        auto hostMemoryProperties = ll::MemoryPropertyFlagBits::DeviceLocal | ll::MemoryPropertyFlagBits::HostCoherent | ll::MemoryPropertyFlagBits::HostVisible;
-        m_hostMemory = m_session->createMemory(hostMemoryProperties, 0, true);
-    #else
-        m_hostMemory = m_session->getHostMemory();
-    #endif
+    if (m_options.multi_device().device_index_size() > 0) {
+        if (m_options.tiling().tile_width() > 0 && m_options.tiling().tile_height() > 0) {
+            return absl::InvalidArgumentError("tiling is not supported in multi device mode");
+        }
 
+        // outputs of a frame are emitted once the frames before it finished,
+        // possibly on a later call to Process()
+        return OpenMultiDevice(availableDevices);
+    }
 
-    
+    const auto& tiling = m_options.tiling();
+    m_tiled = tiling.tile_width() > 0 && tiling.tile_height() > 0;
 
-    // load all supplied libraries to the session
-    for (auto i = 0; i < m_options.library_path_size(); ++i) {
-        
-        auto libraryPath = std::string {};
+    // Inform the framework that we always output at the same timestamp
+    // as we receive a packet at.
+    cc->SetOffset(TimestampDiff(0));
 
-        #ifdef __ANDROID__
-            ASSIGN_OR_RETURN(libraryPath, mediapipe::PathToResourceAsFile(m_options.library_path(i)));
-        #else
-            libraryPath = m_options.library_path(i);
-        #endif
+    const auto selectedDevice = selectDefaultDevice(availableDevices);
 
-        LOG(INFO) << "library path: " << libraryPath;
-        m_session->loadLibrary(libraryPath);
+    LOG(INFO) << "using device: " << selectedDevice.name;
+
+    if (m_tiled) {
+        return OpenTiled(selectedDevice);
     }
 
-    // execute all the scripts in the session
-    for (auto i = 0; i < m_options.script_path_size(); ++i) {
-        
-        auto scriptPath = std::string {};
-        
-        #ifdef __ANDROID__
-            ASSIGN_OR_RETURN(scriptPath, mediapipe::PathToResourceAsFile(m_options.script_path(i)));
-        #else
-            scriptPath = m_options.script_path(i);
-        #endif
-        
-        LOG(INFO) << "script path: " << scriptPath;
-        m_session->scriptFile(scriptPath);
+    // the calculator applies the latency governor, the engine runs level 0
+    auto engineOptions = m_options;
+    engineOptions.clear_latency_governor();
+
+    ASSIGN_OR_RETURN(m_engine, LluviaEngine::Create(engineOptions, selectedDevice, m_trace, 1, m_nodeName));
+
+    // the level engines are initialized and warmed up now if the input
+    // shapes are declared, so that stepping down does not stall a frame
+    for (auto level = 0; level < m_options.latency_governor().level_size(); ++level) {
+
+        const auto levelOptions = makeLevelOptions(m_options, m_options.latency_governor().level(level));
+
+        auto engine = std::unique_ptr<LluviaEngine> {};
+        ASSIGN_OR_RETURN(engine, LluviaEngine::Create(levelOptions, selectedDevice, m_trace, 1, m_nodeName));
+        m_levelEngines.push_back(std::move(engine));
     }
 
-    // LOG(INFO) << "libraries and scripts loaded, enumerating available nodes";
-    // for (const auto& desc : m_session->getNodeBuilderDescriptors()) {
-    //     LOG(INFO) << "" << desc.name;
-    // }
+    m_levelsInitialized.assign(m_levelEngines.size() + 1, false);
+
+    for (const auto& portBinding : getOutputPortBindings(m_options)) {
+        if (portBinding.packet_type() == lluvia::IMAGE_FRAME) {
+            m_imageOutputTags.insert(portBinding.mediapipe_tag());
+        }
+    }
 
-    LOG(INFO) << "Open(): finish";
     return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status LluviaCalculator::InitNode(CalculatorContext* cc) {
+::mediapipe::Status LluviaCalculator::ValidateLatencyGovernor() const {
 
-    LOG(INFO) << "InitNode(): start";
+    if (m_options.multi_device().device_index_size() > 0 || (m_options.tiling().tile_width() > 0 && m_options.tiling().tile_height() > 0)) {
+        return absl::InvalidArgumentError("the latency governor is only supported in single device mode without tiling");
+    }
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Container node
-    LOG(INFO) << "InitNode(): creating container node";
-    m_containerNode = m_session->createContainerNode(m_options.container_node());
+    for (const auto& level : m_options.latency_governor().level()) {
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Input bindings
-    LOG(INFO) << "InitNode(): creating input port bindings";
-    for (auto i = 0; i < m_options.input_port_binding_size(); ++i) {
-        
-        const auto& portBinding = m_options.input_port_binding(i);
+        if (level.input_scale() <= 0.0f || level.input_scale() > 1.0f) {
+            return absl::InvalidArgumentError(absl::StrCat("latency governor input_scale must be in (0, 1], got ", level.input_scale()));
+        }
 
-        if (portBinding.packet_type() == lluvia::IMAGE_FRAME) {
-            InitInputPortAsImageFrame(portBinding, cc);
+        if (level.input_scale() == 1.0f) {
+            continue;
         }
-        else if (portBinding.packet_type() == lluvia::GPU_BUFFER) {
-            InitInputPortAsGpuBuffer(portBinding, cc);
+
+        // the outputs are resized back to the full resolution, which packed
+        // images, tensors and device images are not
+        for (const auto& portBinding : getOutputPortBindings(m_options)) {
+
+            const auto resizable = (portBinding.packet_type() == lluvia::IMAGE_FRAME && !portBinding.has_packing())
+                || isVectorPacketType(portBinding.packet_type());
+
+            if (!resizable) {
+                return absl::InvalidArgumentError(absl::StrCat("port ", portBinding.mediapipe_tag(),
+                    ": input_scale only supports IMAGE_FRAME outputs without packing, FLOAT_VECTOR and MATRIX outputs"));
+            }
+
+            if (!portBinding.roi_tag().empty()) {
+                return absl::InvalidArgumentError(absl::StrCat("port ", portBinding.mediapipe_tag(), ": input_scale does not support roi_tag"));
+            }
         }
-        else {
-            return absl::UnknownError("Unknown port type");
-        } 
 
+        // regions are given in pixels of the full resolution frames
+        for (const auto& portBinding : m_options.input_port_binding()) {
+
+            // only image frames are resized on the host, other inputs would
+            // not match the sizes declared to the level context
+            if (portBinding.packet_type() != lluvia::IMAGE_FRAME) {
+                return absl::InvalidArgumentError(absl::StrCat("port ", portBinding.mediapipe_tag(), ": input_scale only supports IMAGE_FRAME inputs"));
+            }
+
+            if (!portBinding.roi_tag().empty()) {
+                return absl::InvalidArgumentError(absl::StrCat("port ", portBinding.mediapipe_tag(), ": input_scale does not support roi_tag"));
+            }
+        }
     }
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Parameters
-    // TODO
+    return ::mediapipe::OkStatus();
+}
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Node init
-    LOG(INFO) << "InitNode(): init container node";
-    m_containerNode->init();
+LluviaEngine& LluviaCalculator::getLevelEngine(const int level) {
+    return level == 0 ? *m_engine : *m_levelEngines[level - 1];
+}
+
+void LluviaCalculator::UpscaleOutputs(const float scale) {
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Outputs
-    LOG(INFO) << "InitNode(): creating output port bindings";
-    for (auto i = 0; i < m_options.output_port_binding_size(); ++i) {
+    for (auto& [tag, packet] : m_frame.outputs) {
 
-        const auto& portBinding = m_options.output_port_binding(i);
+        if (m_imageOutputTags.count(*tag) == 0) {
+            continue;
+        }
 
-        // initialize the port handler for with the protobuffer attributes
-        auto portHandler = PortHandler {};
-        portHandler.mediapipePacketType = portBinding.packet_type();
-        portHandler.mediapipeTag = portBinding.mediapipe_tag();
-        portHandler.lluviaPortName = portBinding.lluvia_port();
+        const auto& image = packet.Get<ImageFrame>();
 
-        // initialize lluvia objects
-        try {
-            // getting unexisting port name throws exception
-            portHandler.imageView = std::static_pointer_cast<ll::ImageView>(m_containerNode->getPort(portHandler.lluviaPortName));
-        } catch(std::system_error& e) {
-            return absl::UnknownError(e.what());
+        if (scale == 1.0f) {
+            m_fullOutputSizes.try_emplace(*tag, image.Width(), image.Height());
+            continue;
         }
-        
-        portHandler.image = portHandler.imageView->getImage();
-        portHandler.stagingBuffer = m_hostMemory->createBuffer(portHandler.image->getMinimumSize());
-        portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
 
-        // finally, add the handler to the list of output handlers
-        m_outputHandlers.push_back(std::move(portHandler));
+        // outputs read back before any full resolution frame are scaled by the inverse factor
+        const auto it = m_fullOutputSizes.find(*tag);
+        const auto width = it != m_fullOutputSizes.end() ? it->second.first : getScaledSize(image.Width(), 1.0f / scale);
+        const auto height = it != m_fullOutputSizes.end() ? it->second.second : getScaledSize(image.Height(), 1.0f / scale);
+
+        auto upscaled = absl::make_unique<ImageFrame>(image.Format(), width, height, ImageFrame::kDefaultAlignmentBoundary);
+        resizeImageFrame(image, *upscaled);
+        packet = Adopt(upscaled.release()).At(packet.Timestamp());
+    }
+}
+
+::mediapipe::Status LluviaCalculator::InitEagerly(LluviaExecutionContext& context, const int width, const int height) {
+
+    auto frame = std::shared_ptr<LluviaFrame> {};
+    ASSIGN_OR_RETURN(frame, makeDeclaredFrame(m_options, width, height));
+
+    if (frame == nullptr) {
+        return ::mediapipe::OkStatus();
     }
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Duration
-    m_duration = m_session->createDuration();
+    auto scope = LluviaTraceScope {m_trace.get(), m_nodeName, "Open/warmup"};
+    return context.Warmup(*frame, std::max(0, m_options.warmup_runs()));
+}
+
+::mediapipe::Status LluviaCalculator::OpenMultiDevice(const std::vector<ll::DeviceDescriptor>& availableDevices) {
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Command buffer
-    LOG(INFO) << "InitNode(): creating command buffer";
-    m_cmdBuffer = m_session->createCommandBuffer();
-    m_cmdBuffer->begin();
-    m_cmdBuffer->durationStart(*m_duration);
+    const auto& multiDevice = m_options.multi_device();
 
-    // Copy all staging buffers to their corresponding port handler image.
-    for (auto& inputHandler : m_inputHandlers) {
-        m_cmdBuffer->changeImageLayout(*inputHandler.image, ll::ImageLayout::TransferDstOptimal);
-        m_cmdBuffer->memoryBarrier();
-        m_cmdBuffer->copyBufferToImage(*inputHandler.stagingBuffer, *inputHandler.image);
-        m_cmdBuffer->memoryBarrier(); // TODO: needed?
-        m_cmdBuffer->changeImageLayout(*inputHandler.image, ll::ImageLayout::General);
-        m_cmdBuffer->memoryBarrier();
+    for (const auto deviceIndex : multiDevice.device_index()) {
+        if (deviceIndex < 0 || deviceIndex >= static_cast<int>(availableDevices.size())) {
+            return absl::InvalidArgumentError(absl::StrCat("device_index ", deviceIndex, " out of range, ", availableDevices.size(), " devices available"));
+        }
     }
-    
-    // Compute
-    m_cmdBuffer->run(*m_containerNode);
-    m_cmdBuffer->memoryBarrier();
 
-    // Copy all output images to their corresponding staging buffers
-    for (auto& outputHandler : m_outputHandlers) {
-        
-        m_cmdBuffer->changeImageLayout(*outputHandler.image, ll::ImageLayout::TransferSrcOptimal);
-        m_cmdBuffer->memoryBarrier();
-        m_cmdBuffer->copyImageToBuffer(*outputHandler.image, *outputHandler.stagingBuffer);
-        m_cmdBuffer->memoryBarrier();
-        m_cmdBuffer->changeImageLayout(*outputHandler.image, ll::ImageLayout::General);
-        m_cmdBuffer->memoryBarrier();
+    // frames of different devices cannot exchange objects
+    if (!m_options.session_name().empty()) {
+        return absl::InvalidArgumentError("session_name is not supported in multi device mode");
     }
 
-    
-    m_cmdBuffer->durationEnd(*m_duration);
-    m_cmdBuffer->end();
+    const auto outputPortBindings = getOutputPortBindings(m_options);
 
-    LOG(INFO) << "InitNode() finish";
+    for (const auto* portBindings : {&m_options.input_port_binding(), &outputPortBindings}) {
+        for (const auto& portBinding : *portBindings) {
+            if (portBinding.packet_type() == lluvia::LLUVIA_IMAGE) {
+                return absl::InvalidArgumentError("LLUVIA_IMAGE ports are not supported in multi device mode");
+            }
+        }
+    }
+
+    auto contextIndices = std::vector<int> {};
+
+    if (multiDevice.temporal()) {
+        // the container node keeps state between frames, so every frame runs on
+        // one context. Temporal calculators of the process spread across the devices.
+        m_pinnedDevice = pinTemporalDevice({multiDevice.device_index().begin(), multiDevice.device_index().end()});
+
+        for (auto i = 0; i < multiDevice.device_index_size(); ++i) {
+            if (multiDevice.device_index(i) == m_pinnedDevice) {
+                contextIndices.push_back(i);
+                break;
+            }
+        }
+    } else {
+        for (auto i = 0; i < multiDevice.device_index_size(); ++i) {
+            contextIndices.push_back(i);
+        }
+    }
+
+    for (const auto i : contextIndices) {
+
+        const auto& device = availableDevices[multiDevice.device_index(i)];
+        LOG(INFO) << "using device " << multiDevice.device_index(i) << ": " << device.name;
+
+        auto context = absl::make_unique<LluviaExecutionContext>(m_options, m_nodeName, m_trace);
+
+        // every context gets its own session, even if a device is listed more than once
+        MP_RETURN_IF_ERROR(context->Open(device, "", absl::StrCat("GPU queue ", m_nodeName, " context ", i)));
+        MP_RETURN_IF_ERROR(InitEagerly(*context, 0, 0));
+
+        // frames_in_flight is bounded by EmitFrames()
+        m_workers.push_back(absl::make_unique<LluviaDeviceWorker>(std::move(context), 0));
+    }
 
     return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status LluviaCalculator::Process(CalculatorContext* cc) {
+::mediapipe::Status LluviaCalculator::OpenTiled(const ll::DeviceDescriptor& device) {
 
-    ///////////////////////////////////////////////////////////////////////////
-    // init the internals on the first call to Process
-    std::call_once(m_configureNode, &LluviaCalculator::InitNode, this, cc);
+    RET_CHECK_GE(m_options.tiling().halo(), 0);
 
-    ///////////////////////////////////////////////////////////////////////////
-    // copy input packets to input handlers
-    for (auto& inputHandler : m_inputHandlers) {
+    if (m_options.input_port_binding_size() == 0) {
+        return absl::InvalidArgumentError("tiling requires at least one input port");
+    }
 
-        if (inputHandler.mediapipePacketType == lluvia::IMAGE_FRAME) {
-            auto& inputImage = cc->Inputs().Tag(inputHandler.mediapipeTag).Get<ImageFrame>();
-            inputImage.CopyToBuffer(&inputHandler.stagingBufferMappedPtr[0], inputHandler.stagingBuffer->getSize());
+    const auto outputPortBindings = getOutputPortBindings(m_options);
+
+    // tiles are ImageFrames whose outputs are stitched with the resolution of the inputs
+    for (const auto* portBindings : {&m_options.input_port_binding(), &outputPortBindings}) {
+        for (const auto& portBinding : *portBindings) {
+            if (portBinding.packet_type() != lluvia::IMAGE_FRAME || !portBinding.roi_tag().empty()) {
+                return absl::InvalidArgumentError(absl::StrCat("port ", portBinding.mediapipe_tag(), ": tiling only supports IMAGE_FRAME ports without roi_tag"));
+            }
         }
     }
 
-    ///////////////////////////////////////////////////////////////////////////
-    // run the container node
-    m_session->run(*m_cmdBuffer);
+    // readback policies count tiles instead of frames
+    for (const auto& portBinding : outputPortBindings) {
+        if (portBinding.packing().encoding() != lluvia::OutputPacking::NONE || portBinding.has_readback()) {
+            return absl::InvalidArgumentError(absl::StrCat("port ", portBinding.mediapipe_tag(), ": tiling does not support packing encodings or readback policies"));
+        }
+    }
 
-    auto ns = m_duration->getDuration();
-    LOG(INFO) << "elapsed time: " << static_cast<float>(ns.count()) / 1e6 << " ms";
+    for (auto i = 0; i < static_cast<int>(m_tileSlots.size()); ++i) {
 
-    ///////////////////////////////////////////////////////////////////////////
-    // produce output packets
-    for (auto& outputHandler : m_outputHandlers) {
+        auto context = absl::make_unique<LluviaExecutionContext>(m_options, m_nodeName, m_trace);
+        MP_RETURN_IF_ERROR(context->Open(device, m_options.session_name(), absl::StrCat("GPU queue ", m_nodeName, " tile slot ", i)));
 
-        if (outputHandler.mediapipePacketType == lluvia::IMAGE_FRAME) {
+        const auto& tiling = m_options.tiling();
+        MP_RETURN_IF_ERROR(InitEagerly(*context, tiling.tile_width() + 2 * tiling.halo(), tiling.tile_height() + 2 * tiling.halo()));
 
-            ::mediapipe::ImageFormat_Format outputImageFormat = ::mediapipe::ImageFormat_Format_UNKNOWN;
-            bool imageFormatFound = false;
+        auto& slot = m_tileSlots[i];
+        slot.frame = std::make_shared<LluviaFrame>();
+        slot.worker = absl::make_unique<LluviaDeviceWorker>(std::move(context), 1);
+    }
 
-            std::tie(imageFormatFound, outputImageFormat) =  getMediapipeImageFormat(outputHandler.image->getChannelCount(),
-                                                                                     outputHandler.image->getChannelType());
-            
-            if (!imageFormatFound) {
-                return ::mediapipe::UnknownError("unable to find compatible output image format");
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaCalculator::ProcessTiled(CalculatorContext* cc, const LluviaFrame& frame) {
+
+    const auto& tiling = m_options.tiling();
+    const auto halo = tiling.halo();
+    const auto tileWidth = tiling.tile_width();
+    const auto tileHeight = tiling.tile_height();
+
+    const auto& firstImage = frame.input(m_options.input_port_binding(0).mediapipe_tag()).Get<ImageFrame>();
+    const auto width = firstImage.Width();
+    const auto height = firstImage.Height();
+
+    for (const auto& portBinding : m_options.input_port_binding()) {
+        const auto& inputImage = frame.input(portBinding.mediapipe_tag()).Get<ImageFrame>();
+        RET_CHECK(inputImage.Width() == width && inputImage.Height() == height)
+            << "tiled input images must have the same size, port: " << portBinding.mediapipe_tag();
+    }
+
+    auto outputImages = std::map<std::string, std::unique_ptr<ImageFrame>> {};
+
+    // waits for the tile of the slot and copies its outputs without the halo
+    const auto stitchTile = [&](TileSlot& slot) -> ::mediapipe::Status {
+
+        const auto status = slot.status.get();
+        slot.status = {};
+        MP_RETURN_IF_ERROR(status);
+
+        for (const auto& output : slot.frame->outputs) {
+
+            const auto& tileImage = output.second.Get<ImageFrame>();
+            RET_CHECK(tileImage.Width() == tileWidth + 2 * halo && tileImage.Height() == tileHeight + 2 * halo)
+                << "tiled container nodes must keep the resolution of their inputs, port: " << *output.first;
+
+            auto& outputImage = outputImages[*output.first];
+            if (!outputImage) {
+                outputImage = absl::make_unique<ImageFrame>(tileImage.Format(), width, height);
             }
 
-            std::unique_ptr<ImageFrame> outputImage = absl::make_unique<ImageFrame>(outputImageFormat,
-                                                                                    outputHandler.image->getWidth(),
-                                                                                    outputHandler.image->getHeight());
+            const auto pixelBytes = static_cast<size_t>(tileImage.NumberOfChannels() * tileImage.ByteDepth());
+            copyRows(tileImage.PixelData() + halo * tileImage.WidthStep() + halo * pixelBytes, tileImage.WidthStep(),
+                     outputImage->MutablePixelData() + slot.y * outputImage->WidthStep() + slot.x * pixelBytes, outputImage->WidthStep(),
+                     std::min(tileWidth, width - slot.x) * pixelBytes, std::min(tileHeight, height - slot.y), false);
+        }
+
+        slot.frame->outputs.clear();
+        return ::mediapipe::OkStatus();
+    };
 
-            // copy staging buffer to output ImageFrame
-            std::memcpy(outputImage->MutablePixelData(), &outputHandler.stagingBufferMappedPtr[0], outputHandler.stagingBuffer->getSize());
+    auto tileIndex = size_t {0};
+    for (auto y = 0; y < height; y += tileHeight) {
+        for (auto x = 0; x < width; x += tileWidth) {
 
-            LOG_EVERY_N(INFO, 300) << "LluviaCalculator: shape [h:"
-                                    << std::to_string(outputImage->Height()) << ", w:" << std::to_string(outputImage->Width()) << "], format: "
-                                    << std::to_string(static_cast<int>(outputImage->Format())) << ", channel size: "
-                                    << std::to_string(outputImage->ChannelSize());
+            // the slot is free once its previous tile is stitched
+            auto& slot = m_tileSlots[tileIndex++ % m_tileSlots.size()];
+            if (slot.status.valid()) {
+                MP_RETURN_IF_ERROR(stitchTile(slot));
+            }
 
-            // TODO: timestamps
-            cc->Outputs().Tag(outputHandler.mediapipeTag).Add(outputImage.release(), cc->InputTimestamp());
+            slot.x = x;
+            slot.y = y;
+            slot.frame->timestamp = frame.timestamp;
+
+            for (const auto& portBinding : m_options.input_port_binding()) {
+
+                const auto& tag = portBinding.mediapipe_tag();
+                const auto& inputImage = frame.input(tag).Get<ImageFrame>();
+
+                auto& tileImage = slot.inputs[tag];
+                if (!tileImage || tileImage->Format() != inputImage.Format()) {
+                    tileImage = absl::make_unique<ImageFrame>(inputImage.Format(), tileWidth + 2 * halo, tileHeight + 2 * halo);
+                }
+
+                copyTileWithHalo(inputImage, x - halo, y - halo, *tileImage);
+                slot.frame->inputs[tag] = PointToForeign(tileImage.get());
+            }
+
+            slot.status = slot.worker->submit(slot.frame);
         }
     }
 
+    // the last tiles, oldest first
+    for (auto i = size_t {0}; i < m_tileSlots.size(); ++i) {
+        auto& slot = m_tileSlots[(tileIndex + i) % m_tileSlots.size()];
+        if (slot.status.valid()) {
+            MP_RETURN_IF_ERROR(stitchTile(slot));
+        }
+    }
+
+    for (auto& outputImage : outputImages) {
+        cc->Outputs().Tag(outputImage.first).Add(outputImage.second.release(), frame.timestamp);
+    }
+
     return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status LluviaCalculator::Close(CalculatorContext* cc) {
-    return ::mediapipe::OkStatus();
+size_t LluviaCalculator::RouteFrame() {
+
+    if (m_options.multi_device().routing() == lluvia::MultiDeviceOptions::LEAST_LOADED) {
+
+        const auto it = std::min_element(m_workers.begin(), m_workers.end(), [](const auto& a, const auto& b) {
+            return a->getQueuedFrames() < b->getQueuedFrames();
+        });
+
+        return static_cast<size_t>(std::distance(m_workers.begin(), it));
+    }
+
+    return m_nextWorker++ % m_workers.size();
 }
 
-std::tuple<bool, ll::ChannelCount, ll::ChannelType> LluviaCalculator::getLluviaImageFormat(const mediapipe::ImageFormat_Format format) {
-
-    switch(format) {
-
-        case ImageFormat_Format_SRGB:
-            return std::make_tuple(true, ll::ChannelCount::C3, ll::ChannelType::Uint8);
-        
-        case ImageFormat_Format_SRGBA:
-            return std::make_tuple(true, ll::ChannelCount::C4, ll::ChannelType::Uint8);
-        
-        case ImageFormat_Format_SBGRA:
-            return std::make_tuple(true, ll::ChannelCount::C4, ll::ChannelType::Uint8);
-        
-        case ImageFormat_Format_GRAY8:
-            return std::make_tuple(true, ll::ChannelCount::C1, ll::ChannelType::Uint8);
-        
-        case ImageFormat_Format_GRAY16:
-            return std::make_tuple(true, ll::ChannelCount::C1, ll::ChannelType::Uint16);
-        
-        case ImageFormat_Format_SRGBA64:
-            return std::make_tuple(true, ll::ChannelCount::C4, ll::ChannelType::Uint64);
-        
-        case ImageFormat_Format_VEC32F1:
-            return std::make_tuple(true, ll::ChannelCount::C1, ll::ChannelType::Float32);
-        
-        case ImageFormat_Format_VEC32F2:
-            return std::make_tuple(true, ll::ChannelCount::C2, ll::ChannelType::Float32);
-        
-        default:
-            return std::make_tuple(false, ll::ChannelCount::C1, ll::ChannelType::Uint8);
+void LluviaCalculator::ReadFrame(CalculatorContext* cc, LluviaFrame& frame) const {
+
+    frame.timestamp = cc->InputTimestamp();
+    frame.outputs.clear();
+
+    // the map keeps its nodes once every tag was seen
+    for (const auto& tag : m_inputTags) {
+        const auto& stream = cc->Inputs().Tag(tag);
+        frame.inputs[tag] = stream.IsEmpty() ? Packet {} : stream.Value();
     }
 }
 
-std::tuple<bool, mediapipe::ImageFormat_Format> LluviaCalculator::getMediapipeImageFormat(const ll::ChannelCount channelCount, const ll::ChannelType channelType) {
+::mediapipe::Status LluviaCalculator::Process(CalculatorContext* cc) {
 
-    switch(channelCount) {
+    // timestamps with only ROI or trigger packets have no frame to run
+    for (const auto& portBinding : m_options.input_port_binding()) {
+        if (cc->Inputs().Tag(portBinding.mediapipe_tag()).IsEmpty()) {
+            return ::mediapipe::OkStatus();
+        }
+    }
 
-        case ll::ChannelCount::C1:
-            switch (channelType) {
-            case ll::ChannelType::Uint8:
-                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_GRAY8);
-            case ll::ChannelType::Uint16:
-                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_GRAY16);
-            case ll::ChannelType::Float32:
-                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_VEC32F1);
-            default:
-                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
-            }
+    if (m_engine) {
+        ReadFrame(cc, m_frame);
 
-        case ll::ChannelCount::C2:
-            switch (channelType) {
-            case ll::ChannelType::Float32:
-                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_VEC32F2);
-            default:
-                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
-            }
+        if (m_governor->isEnabled()) {
+            return ProcessGoverned(cc);
+        }
 
-        case ll::ChannelCount::C3:
-            switch (channelType) {
-            case ll::ChannelType::Uint8:
-                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_SRGB);
-            default:
-                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
-            }
+        MP_RETURN_IF_ERROR(m_engine->ProcessFrame(m_frame));
 
-        case ll::ChannelCount::C4:
-            switch (channelType) {
-            case ll::ChannelType::Uint8:
-                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_SRGBA);
-            case ll::ChannelType::Uint64:
-                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_SRGBA64);
-            default:
-                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
-            }
+        for (auto& output : m_frame.outputs) {
+            cc->Outputs().Tag(*output.first).AddPacket(std::move(output.second));
+        }
+
+        return ::mediapipe::OkStatus();
+    }
+
+    auto frame = std::make_shared<LluviaFrame>();
+    ReadFrame(cc, *frame);
+
+    if (m_tiled) {
+        return ProcessTiled(cc, *frame);
     }
+
+    const auto worker = RouteFrame();
+    m_pendingFrames.push_back(PendingFrame {frame, m_workers[worker]->submit(frame)});
+
+    const auto framesInFlight = static_cast<size_t>(std::max(1, m_options.multi_device().frames_in_flight()));
+    return EmitFrames(cc, framesInFlight * m_workers.size());
 }
 
-::mediapipe::Status LluviaCalculator::InitInputPortAsImageFrame(const lluvia::PortBinding& portBinding, CalculatorContext* cc) {
+::mediapipe::Status LluviaCalculator::ProcessGoverned(CalculatorContext* cc) {
 
-    // initialize the port handler for with the protobuffer attributes
-    auto portHandler = PortHandler {};
-    portHandler.mediapipePacketType = portBinding.packet_type();
-    portHandler.mediapipeTag = portBinding.mediapipe_tag();
-    portHandler.lluviaPortName = portBinding.lluvia_port();
+    if (!m_governor->shouldProcess()) {
+        return ::mediapipe::OkStatus();
+    }
 
-    auto& inputImage = cc->Inputs().Tag(portBinding.mediapipe_tag()).Get<ImageFrame>();
-    const auto width = inputImage.Width();
-    const auto height = inputImage.Height();
+    const auto start = std::chrono::steady_clock::now();
+    const auto level = m_governor->getLevel();
+    const auto scale = m_governor->getDegradationLevel().input_scale();
 
-    // TODO: usage flags
-    portHandler.stagingBuffer = m_hostMemory->createBuffer(static_cast<uint64_t>(inputImage.PixelDataSizeStoredContiguously()));
-    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+    if (scale != 1.0f) {
+        for (const auto& portBinding : m_options.input_port_binding()) {
 
-    const ll::ImageUsageFlags imgUsageFlags = { ll::ImageUsageFlagBits::Storage
-                                                | ll::ImageUsageFlagBits::Sampled
-                                                | ll::ImageUsageFlagBits::TransferDst
-                                                | ll::ImageUsageFlagBits::TransferSrc};
+            auto& packet = m_frame.inputs[portBinding.mediapipe_tag()];
+            if (portBinding.packet_type() != lluvia::IMAGE_FRAME || packet.IsEmpty()) {
+                continue;
+            }
 
-    auto imageFormatSupported = false;
-    auto channelCount = ll::ChannelCount::C1;
-    auto channelType = ll::ChannelType::Uint8;
+            const auto& image = packet.Get<ImageFrame>();
+            const auto width = getScaledSize(image.Width(), scale);
+            const auto height = getScaledSize(image.Height(), scale);
 
-    std::tie(imageFormatSupported, channelCount, channelType) = getLluviaImageFormat(inputImage.Format());
+            auto& resized = m_resizedInputs[portBinding.mediapipe_tag()];
+            if (!resized || resized->Format() != image.Format() || resized->Width() != width || resized->Height() != height) {
+                resized = absl::make_unique<ImageFrame>(image.Format(), width, height, ImageFrame::kDefaultAlignmentBoundary);
+            }
 
-    if (!imageFormatSupported) {
-        return ::mediapipe::UnknownError("image format not supported");
+            // the context copies the inputs before ProcessFrame() returns
+            resizeImageFrame(image, *resized);
+            packet = PointToForeign(resized.get()).At(packet.Timestamp());
+        }
     }
 
-    const auto imgDesc = ll::ImageDescriptor{1, static_cast<uint32_t >(height), static_cast<uint32_t>(width),
-                                                channelCount, channelType}
-                .setUsageFlags(imgUsageFlags);
+    auto& engine = getLevelEngine(level);
+    MP_RETURN_IF_ERROR(engine.ProcessFrame(m_frame));
+    UpscaleOutputs(scale);
 
-    portHandler.image = m_deviceMemory->createImage(imgDesc);
-    portHandler.imageView = portHandler.image->createImageView(ll::ImageViewDescriptor{ll::ImageAddressMode::ClampToBorder,
-                                                                                ll::ImageFilterMode::Nearest,
-                                                                                false,
-                                                                                false});
+    for (auto& output : m_frame.outputs) {
+        cc->Outputs().Tag(*output.first).AddPacket(std::move(output.second));
+    }
 
-    portHandler.image->changeImageLayout(ll::ImageLayout::General);
+    // the first frame of a level includes the initialization of its engine
+    auto changed = false;
+    if (m_levelsInitialized[level]) {
+        changed = m_governor->update(engine.getGpuDuration(), std::chrono::steady_clock::now() - start);
+    }
+    m_levelsInitialized[level] = true;
 
-    // bind to the container node
-    m_containerNode->bind(portHandler.lluviaPortName, portHandler.imageView);
+    if (changed) {
+        LOG(INFO) << "latency governor: level " << level << " -> " << m_governor->getLevel();
+        cc->GetCounter(absl::StrCat(m_nodeName, ": latency governor level changes"))->Increment();
+    }
+
+    if (changed || !m_levelReported) {
 
-    // finally, add the handler to the list of input handlers
-    m_inputHandlers.push_back(std::move(portHandler));
+        if (m_trace) {
+            m_trace->addCounterEvent(m_nodeName, "latency governor level", LluviaTraceRecorder::now(), m_governor->getLevel());
+        }
+
+        const auto& levelTag = m_options.latency_governor().level_tag();
+        if (!levelTag.empty()) {
+            cc->Outputs().Tag(levelTag).AddPacket(MakePacket<int>(m_governor->getLevel()).At(cc->InputTimestamp()));
+        }
+
+        m_levelReported = true;
+    }
 
     return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status LluviaCalculator::InitInputPortAsGpuBuffer(const lluvia::PortBinding& portBinding, CalculatorContext* cc) {
+::mediapipe::Status LluviaCalculator::EmitFrames(CalculatorContext* cc, const size_t maxPendingFrames) {
 
-    // initialize the port handler for with the protobuffer attributes
-    auto portHandler = PortHandler {};
-    portHandler.mediapipePacketType = portBinding.packet_type();
-    portHandler.mediapipeTag = portBinding.mediapipe_tag();
-    portHandler.lluviaPortName = portBinding.lluvia_port();
+    while (!m_pendingFrames.empty()) {
 
-    auto& gpuBuffer = cc->Inputs().Tag(portBinding.mediapipe_tag()).Get<GpuBuffer>();
+        auto& pendingFrame = m_pendingFrames.front();
 
-    // Create a read view to get all attributes of the gpu buffer through an ImageFrame.
-    // TODO: Need to check whether nputImage->PixelDataSize() is equal to this other method
-    //       std::unique_ptr<ImageFrame> inputFrame = absl::make_unique<ImageFrame>(
-    //                 ImageFormatForGpuBufferFormat(inputImage->format()), width,
-    //                 height, ImageFrame::kGlDefaultAlignmentBoundary);
-    auto inputImage = gpuBuffer.GetReadView<ImageFrame>();
-    const auto width = inputImage->Width();
-    const auto height = inputImage->Height();
+        const auto finished = pendingFrame.status.wait_for(std::chrono::seconds {0}) == std::future_status::ready;
+        if (!finished && m_pendingFrames.size() <= maxPendingFrames) {
+            break;
+        }
 
-    // TODO: usage flags
-    portHandler.stagingBuffer = m_hostMemory->createBuffer(static_cast<uint64_t>(inputImage->PixelDataSizeStoredContiguously()));
-    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+        // waits for the frame if not finished
+        MP_RETURN_IF_ERROR(pendingFrame.status.get());
 
-    const ll::ImageUsageFlags imgUsageFlags = { ll::ImageUsageFlagBits::Storage
-                                                | ll::ImageUsageFlagBits::Sampled
-                                                | ll::ImageUsageFlagBits::TransferDst
-                                                | ll::ImageUsageFlagBits::TransferSrc};
+        for (auto& output : pendingFrame.frame->outputs) {
+            cc->Outputs().Tag(*output.first).AddPacket(std::move(output.second));
+        }
 
-    auto imageFormatSupported = false;
-    auto channelCount = ll::ChannelCount::C1;
-    auto channelType = ll::ChannelType::Uint8;
+        m_pendingFrames.pop_front();
+    }
 
-    std::tie(imageFormatSupported, channelCount, channelType) = getLluviaImageFormat(inputImage->Format());
+    return ::mediapipe::OkStatus();
+}
 
-    if (!imageFormatSupported) {
-        return ::mediapipe::UnknownError("image format not supported");
-    }
+::mediapipe::Status LluviaCalculator::Close(CalculatorContext* cc) {
 
-    const auto imgDesc = ll::ImageDescriptor{1, static_cast<uint32_t >(height), static_cast<uint32_t>(width),
-                                                channelCount, channelType}
-                .setUsageFlags(imgUsageFlags);
+    // emit every frame still in flight
+    auto status = EmitFrames(cc, 0);
 
-    portHandler.image = m_deviceMemory->createImage(imgDesc);
-    portHandler.imageView = portHandler.image->createImageView(ll::ImageViewDescriptor{ll::ImageAddressMode::ClampToBorder,
-                                                                                ll::ImageFilterMode::Nearest,
-                                                                                false,
-                                                                                false});
+    m_workers.clear();
+    for (auto& slot : m_tileSlots) {
+        slot.worker.reset();
+    }
 
-    portHandler.image->changeImageLayout(ll::ImageLayout::General);
+    if (m_pinnedDevice >= 0) {
+        unpinTemporalDevice(m_pinnedDevice);
+    }
 
-    // bind to the container node
-    m_containerNode->bind(portHandler.lluviaPortName, portHandler.imageView);
+    MP_RETURN_IF_ERROR(status);
 
-    // finally, add the handler to the list of input handlers
-    m_inputHandlers.push_back(std::move(portHandler));
+    if (m_trace) {
+        // the recorder also writes the file when released, writing here makes
+        // the trace available as soon as the graph is done
+        MP_RETURN_IF_ERROR(m_trace->write());
+    }
 
     return ::mediapipe::OkStatus();
 }
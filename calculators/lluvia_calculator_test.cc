@@ -2,24 +2,132 @@
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/matrix.h"
+#include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/formats/tensor.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/sink.h"
 #include "mediapipe/gpu/gl_calculator_helper.h"
 
 #include "tools/cpp/runfiles/runfiles.h"
 using bazel::tools::cpp::runfiles::Runfiles;
 
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_container_snapshot.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_host_copy.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_image.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_packed_image.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_submission_queue.h"
+
 #include "lluvia/core.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <memory>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// heap allocations counted while countAllocations is set, see TestSteadyStateAllocations
+std::atomic<bool> countAllocations {false};
+std::atomic<int64_t> allocationCount {0};
+
+} // namespace
+
+void* operator new(std::size_t size) {
+
+    if (countAllocations.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
 
 namespace mediapipe {
 
 namespace {
 
+// streams of the IN_0 and OUT_0 ports of GetPassthroughOptions() and GetGrayscaleOptions()
+constexpr auto kPassthroughStreams = R"pb(
+    input_stream: "IN_0:input_image_0"
+    output_stream: "OUT_0:output_image_0"
+)pb";
+
+// Passthrough container node from the IMAGE_FRAME IN_0 port to OUT_0.
+lluvia::LluviaCalculatorOptions GetPassthroughOptions() {
+
+    auto runfiles = std::unique_ptr<Runfiles> {Runfiles::CreateForTest(nullptr)};
+
+    auto libraryPath = runfiles->Rlocation("lluvia/lluvia/nodes/lluvia_node_library.zip");
+    auto lluviaMediapipeLibraryPath = runfiles->Rlocation("mediapipe/mediapipe/lluvia-mediapipe/calculators/lluvia_mediapipe_library.zip");
+    auto calculatorScriptPath = runfiles->Rlocation("mediapipe/mediapipe/lluvia-mediapipe/calculators/test_data/PassthroughContainerNode.lua");
+
+    return ParseTextProtoOrDie<lluvia::LluviaCalculatorOptions>(absl::Substitute(R"pb(
+        container_node: "mediapipe/test/PassthroughContainerNode"
+        library_path: "$0"
+        library_path: "$1"
+        script_path: "$2"
+
+        input_port_binding:  {
+            mediapipe_tag: "IN_0"
+            lluvia_port: "in_image_0"
+            packet_type: IMAGE_FRAME
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "OUT_0"
+            lluvia_port: "out_image_0"
+            packet_type: IMAGE_FRAME
+        }
+    )pb", libraryPath, lluviaMediapipeLibraryPath, calculatorScriptPath));
+}
+
+// RGBA2Gray container node of lluvia_mediapipe_library from the IMAGE_FRAME IN_0 port to OUT_0.
+lluvia::LluviaCalculatorOptions GetGrayscaleOptions() {
+
+    auto options = GetPassthroughOptions();
+    options.set_container_node("lluvia/mediapipe/LluviaCalculator");
+    options.clear_script_path();
+    options.mutable_input_port_binding(0)->set_lluvia_port("in_image");
+    options.mutable_output_port_binding(0)->set_lluvia_port("out_image");
+    return options;
+}
+
+// options with the fields of a test merged in, repeated fields are appended
+lluvia::LluviaCalculatorOptions MergeOptions(lluvia::LluviaCalculatorOptions options, const std::string& fields) {
+
+    options.MergeFrom(ParseTextProtoOrDie<lluvia::LluviaCalculatorOptions>(fields));
+    return options;
+}
+
+// LluviaCalculator node with the streams of a test
+CalculatorGraphConfig::Node MakeCalculatorNode(const std::string& streams, const lluvia::LluviaCalculatorOptions& options) {
+
+    auto node = ParseTextProtoOrDie<CalculatorGraphConfig::Node>(absl::StrCat("calculator: \"LluviaCalculator\"\n", streams));
+    node.add_node_options()->PackFrom(options);
+    return node;
+}
+
 TEST(LluviaCalculatorTest, TestLoadNodeLibrary) {
 
     auto runfiles = Runfiles::CreateForTest(nullptr);
@@ -375,5 +483,1268 @@ TEST(LluviaCalculatorTest, TestInputGPUBuffer) {
     }
 }
 
+TEST(LluviaCalculatorTest, TestRegionOfInterest) {
+
+    auto options = GetPassthroughOptions();
+    options.set_enable_debug(true);
+    options.mutable_input_port_binding(0)->set_roi_tag("ROI_IN");
+    options.mutable_output_port_binding(0)->set_roi_tag("ROI_OUT");
+
+    CalculatorRunner runner(MakeCalculatorNode(absl::StrCat(kPassthroughStreams, R"pb(
+        input_stream: "ROI_IN:input_roi"
+        input_stream: "ROI_OUT:output_roi"
+    )pb"), options));
+
+    // input image with a constant pattern inside the ROI
+    auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, 1920, 1080);
+    inputImage->SetToZero();
+    for (auto y = 500; y < 580; ++y) {
+        std::memset(inputImage->MutablePixelData() + y * inputImage->WidthStep() + 900, 7, 120);
+    }
+
+    auto inputRoi = Rect {};
+    inputRoi.set_x_center(960);
+    inputRoi.set_y_center(540);
+    inputRoi.set_width(200);
+    inputRoi.set_height(100);
+
+    auto outputRoi = NormalizedRect {};
+    outputRoi.set_x_center(0.5f);
+    outputRoi.set_y_center(0.5f);
+    outputRoi.set_width(60.0f / 1920.0f);
+    outputRoi.set_height(40.0f / 1080.0f);
+
+    runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(0)));
+    runner.MutableInputs()->Tag("ROI_IN").packets.push_back(MakePacket<Rect>(inputRoi).At(Timestamp(0)));
+    runner.MutableInputs()->Tag("ROI_OUT").packets.push_back(MakePacket<NormalizedRect>(outputRoi).At(Timestamp(0)));
+
+    MP_ASSERT_OK(runner.Run());
+
+    ASSERT_EQ(runner.Outputs().Tag("OUT_0").packets.size(), 1);
+
+    auto& outImage = runner.Outputs().Tag("OUT_0").packets[0].Get<ImageFrame>();
+    ASSERT_EQ(outImage.Format(), ImageFormat::GRAY8);
+    ASSERT_EQ(outImage.Width(), 60);
+    ASSERT_EQ(outImage.Height(), 40);
+
+    // the output ROI is fully contained in the uploaded input ROI
+    for (auto y = 0; y < outImage.Height(); ++y) {
+        for (auto x = 0; x < outImage.Width(); ++x) {
+            ASSERT_EQ(outImage.PixelData()[y * outImage.WidthStep() + x], 7);
+        }
+    }
+}
+
+TEST(LluviaCalculatorTest, TestRegionOfInterestWithoutImage) {
+
+    auto options = GetPassthroughOptions();
+    options.mutable_input_port_binding(0)->set_roi_tag("ROI_IN");
+
+    CalculatorRunner runner(MakeCalculatorNode(absl::StrCat(kPassthroughStreams, R"pb(
+        input_stream: "ROI_IN:input_roi"
+    )pb"), options));
+
+    auto inputRoi = Rect {};
+    inputRoi.set_x_center(32);
+    inputRoi.set_y_center(24);
+    inputRoi.set_width(16);
+    inputRoi.set_height(8);
+
+    // images at timestamps 0 and 2, an ROI at every timestamp
+    for (auto t = 0; t < 3; ++t) {
+        if (t != 1) {
+            auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, 64, 48);
+            std::memset(inputImage->MutablePixelData(), t + 1, inputImage->PixelDataSize());
+            runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+        }
+
+        runner.MutableInputs()->Tag("ROI_IN").packets.push_back(MakePacket<Rect>(inputRoi).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    const auto& packets = runner.Outputs().Tag("OUT_0").packets;
+    ASSERT_EQ(packets.size(), 2);
+    EXPECT_EQ(packets[0].Timestamp(), Timestamp(0));
+    EXPECT_EQ(packets[1].Timestamp(), Timestamp(2));
+
+    // the pixels of the ROI are uploaded from the image of the same timestamp
+    const auto& outImage = packets[1].Get<ImageFrame>();
+    EXPECT_EQ(outImage.PixelData()[24 * outImage.WidthStep() + 32], 3);
+}
+
+TEST(LluviaCalculatorTest, TestOutputPacking) {
+
+    auto options = MergeOptions(GetPassthroughOptions(), R"pb(
+        enable_debug: true
+
+        input_port_binding:  {
+            mediapipe_tag: "IN_1"
+            lluvia_port: "in_image_1"
+            packet_type: IMAGE_FRAME
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "OUT_1"
+            lluvia_port: "out_image_1"
+            packet_type: IMAGE_FRAME
+            packing: { swizzle: "rg" encoding: INT16 scale: 100 }
+        }
+    )pb");
+    options.mutable_output_port_binding(0)->mutable_packing()->set_swizzle("bgr");
+
+    CalculatorRunner runner(MakeCalculatorNode(absl::StrCat(kPassthroughStreams, R"pb(
+        input_stream: "IN_1:input_image_1"
+        output_stream: "OUT_1:output_image_1"
+    )pb"), options));
+
+    // every RGBA pixel is (1, 2, 3, 4)
+    auto rgbaImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 641, 480);
+    for (auto y = 0; y < rgbaImage->Height(); ++y) {
+        auto row = rgbaImage->MutablePixelData() + y * rgbaImage->WidthStep();
+        for (auto x = 0; x < rgbaImage->Width(); ++x) {
+            row[4 * x + 0] = 1;
+            row[4 * x + 1] = 2;
+            row[4 * x + 2] = 3;
+            row[4 * x + 3] = 4;
+        }
+    }
+
+    // every flow vector is (1.5, -2.25)
+    auto flowImage = absl::make_unique<ImageFrame>(ImageFormat::VEC32F2, 320, 240);
+    for (auto y = 0; y < flowImage->Height(); ++y) {
+        auto row = reinterpret_cast<float*>(flowImage->MutablePixelData() + y * flowImage->WidthStep());
+        for (auto x = 0; x < flowImage->Width(); ++x) {
+            row[2 * x + 0] = 1.5f;
+            row[2 * x + 1] = -2.25f;
+        }
+    }
+
+    runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(rgbaImage.release()).At(Timestamp(0)));
+    runner.MutableInputs()->Tag("IN_1").packets.push_back(Adopt(flowImage.release()).At(Timestamp(0)));
+
+    MP_ASSERT_OK(runner.Run());
+
+    ASSERT_EQ(runner.Outputs().Tag("OUT_0").packets.size(), 1);
+    ASSERT_EQ(runner.Outputs().Tag("OUT_1").packets.size(), 1);
+
+    auto& outRGB = runner.Outputs().Tag("OUT_0").packets[0].Get<ImageFrame>();
+    ASSERT_EQ(outRGB.Format(), ImageFormat::SRGB);
+    ASSERT_EQ(outRGB.Width(), 641);
+    ASSERT_EQ(outRGB.Height(), 480);
+
+    for (auto y = 0; y < outRGB.Height(); ++y) {
+        const auto row = outRGB.PixelData() + y * outRGB.WidthStep();
+        for (auto x = 0; x < outRGB.Width(); ++x) {
+            ASSERT_EQ(row[3 * x + 0], 3);
+            ASSERT_EQ(row[3 * x + 1], 2);
+            ASSERT_EQ(row[3 * x + 2], 1);
+        }
+    }
+
+    auto& outFlow = runner.Outputs().Tag("OUT_1").packets[0].Get<LluviaPackedImage>();
+    ASSERT_EQ(outFlow.width, 320);
+    ASSERT_EQ(outFlow.height, 240);
+    ASSERT_EQ(outFlow.channels, 2);
+    ASSERT_EQ(outFlow.encoding, lluvia::OutputPacking::INT16);
+    ASSERT_EQ(outFlow.data.size(), 320 * 240 * 2 * sizeof(int16_t));
+
+    const auto flowValues = reinterpret_cast<const int16_t*>(outFlow.data.data());
+    for (auto i = 0; i < 320 * 240; ++i) {
+        ASSERT_EQ(flowValues[2 * i + 0], 150);
+        ASSERT_EQ(flowValues[2 * i + 1], -225);
+    }
+}
+
+TEST(LluviaCalculatorTest, TestChainedLluviaImage) {
+
+    auto producerOptions = GetPassthroughOptions();
+    producerOptions.set_session_name("chained");
+    producerOptions.mutable_output_port_binding(0)->set_packet_type(lluvia::LLUVIA_IMAGE);
+
+    auto consumerOptions = GetPassthroughOptions();
+    consumerOptions.set_session_name("chained");
+    consumerOptions.mutable_input_port_binding(0)->set_packet_type(lluvia::LLUVIA_IMAGE);
+
+    // two passthrough calculators exchanging the image in device memory
+    auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(input_stream: "input_image")pb");
+
+    *graphConfig.add_node() = MakeCalculatorNode(R"pb(
+        input_stream: "IN_0:input_image"
+        output_stream: "OUT_0:device_image"
+    )pb", producerOptions);
+
+    *graphConfig.add_node() = MakeCalculatorNode(R"pb(
+        input_stream: "IN_0:device_image"
+        output_stream: "OUT_0:output_image"
+    )pb", consumerOptions);
+
+    auto outputPackets = std::vector<Packet> {};
+    tool::AddVectorSink("output_image", &graphConfig, &outputPackets);
+
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(graphConfig));
+    MP_ASSERT_OK(graph.StartRun({}));
+
+    constexpr auto frameCount = 8;
+    for (auto t = 0; t < frameCount; ++t) {
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, 640, 480);
+        for (auto y = 0; y < inputImage->Height(); ++y) {
+            std::memset(inputImage->MutablePixelData() + y * inputImage->WidthStep(), (y + t) % 256, inputImage->Width());
+        }
+
+        MP_ASSERT_OK(graph.AddPacketToInputStream("input_image", Adopt(inputImage.release()).At(Timestamp(t))));
+    }
+
+    MP_ASSERT_OK(graph.CloseAllInputStreams());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+
+    ASSERT_EQ(outputPackets.size(), frameCount);
+
+    for (auto t = 0; t < frameCount; ++t) {
+        auto& outImage = outputPackets[t].Get<ImageFrame>();
+        ASSERT_EQ(outImage.Width(), 640);
+        ASSERT_EQ(outImage.Height(), 480);
+
+        for (auto y = 0; y < outImage.Height(); ++y) {
+            ASSERT_EQ(outImage.PixelData()[y * outImage.WidthStep()], (y + t) % 256);
+        }
+    }
+}
+
+TEST(LluviaCalculatorTest, TestContainerSnapshot) {
+
+    auto snapshotPath = absl::StrCat(std::getenv("TEST_TMPDIR"), "/LluviaCalculator.snapshot");
+
+    auto options = GetGrayscaleOptions();
+    options.set_snapshot_path(snapshotPath);
+
+    const auto node_config = MakeCalculatorNode(kPassthroughStreams, options);
+
+    auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 640, 480);
+    for (auto y = 0; y < inputImage->Height(); ++y) {
+        auto* row = inputImage->MutablePixelData() + y * inputImage->WidthStep();
+        for (auto x = 0; x < inputImage->Width() * 4; ++x) {
+            row[x] = static_cast<uint8>((x + 3 * y) % 256);
+        }
+    }
+
+    const auto inputPacket = Adopt(inputImage.release()).At(Timestamp(0));
+
+    // the first run initializes the container node through Lua and writes the snapshot,
+    // the second one instantiates it from the snapshot
+    auto outputPackets = std::vector<Packet> {};
+    for (auto run = 0; run < 2; ++run) {
+
+        CalculatorRunner runner(node_config);
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(inputPacket);
+
+        MP_ASSERT_OK(runner.Run());
+        ASSERT_EQ(runner.Outputs().Tag("OUT_0").packets.size(), 1);
+        outputPackets.push_back(runner.Outputs().Tag("OUT_0").packets[0]);
+
+        if (run == 0) {
+            ASSERT_OK_AND_ASSIGN(auto snapshot, ReadContainerSnapshot(snapshotPath));
+            EXPECT_EQ(snapshot.container_node(), "lluvia/mediapipe/LluviaCalculator");
+            ASSERT_EQ(snapshot.compute_nodes_size(), 1);
+            EXPECT_EQ(snapshot.compute_nodes(0).builder_name(), "lluvia/color/RGBA2Gray");
+        }
+    }
+
+    auto& expected = outputPackets[0].Get<ImageFrame>();
+    auto& fromSnapshot = outputPackets[1].Get<ImageFrame>();
+
+    ASSERT_EQ(expected.Format(), fromSnapshot.Format());
+    ASSERT_EQ(expected.Width(), fromSnapshot.Width());
+    ASSERT_EQ(expected.Height(), fromSnapshot.Height());
+
+    for (auto y = 0; y < expected.Height(); ++y) {
+        ASSERT_EQ(std::memcmp(expected.PixelData() + y * expected.WidthStep(),
+                              fromSnapshot.PixelData() + y * fromSnapshot.WidthStep(),
+                              expected.Width() * expected.NumberOfChannels() * expected.ByteDepth()), 0);
+    }
+}
+
+TEST(LluviaCalculatorTest, TestTensorOutput) {
+
+    auto options = GetPassthroughOptions();
+
+    auto* outputBinding = options.mutable_output_port_binding(0);
+    outputBinding->set_mediapipe_tag("TENSORS");
+    outputBinding->set_packet_type(lluvia::TENSOR);
+    *outputBinding->mutable_tensor() = ParseTextProtoOrDie<lluvia::TensorOptions>(R"pb(
+        element_type: FLOAT32
+        swizzle: "bgr"
+        mean: 127.5
+        std: 127.5
+    )pb");
+
+    CalculatorRunner runner(MakeCalculatorNode(R"pb(
+        input_stream: "IN_0:input_image_0"
+        output_stream: "TENSORS:output_tensors"
+    )pb", options));
+
+    // every RGBA pixel is (0, 51, 255, 7)
+    auto rgbaImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 224, 160);
+    for (auto y = 0; y < rgbaImage->Height(); ++y) {
+        auto row = rgbaImage->MutablePixelData() + y * rgbaImage->WidthStep();
+        for (auto x = 0; x < rgbaImage->Width(); ++x) {
+            row[4 * x + 0] = 0;
+            row[4 * x + 1] = 51;
+            row[4 * x + 2] = 255;
+            row[4 * x + 3] = 7;
+        }
+    }
+
+    runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(rgbaImage.release()).At(Timestamp(0)));
+
+    MP_ASSERT_OK(runner.Run());
+
+    const auto& outputPackets = runner.Outputs().Tag("TENSORS").packets;
+    ASSERT_EQ(outputPackets.size(), 1);
+
+    const auto& tensors = outputPackets[0].Get<std::vector<Tensor>>();
+    ASSERT_EQ(tensors.size(), 1);
+
+    const auto& tensor = tensors[0];
+    ASSERT_EQ(tensor.element_type(), Tensor::ElementType::kFloat32);
+    ASSERT_EQ(tensor.shape().dims, (std::vector<int> {1, 160, 224, 3}));
+
+    const auto view = tensor.GetCpuReadView();
+    const auto* values = view.buffer<float>();
+
+    // channels in bgr order, normalized to [-1, 1]
+    const auto expected = std::array<float, 3> {1.0f, (51.0f - 127.5f) / 127.5f, -1.0f};
+    for (auto i = 0; i < 160 * 224; i += 97) {
+        for (auto c = 0; c < 3; ++c) {
+            ASSERT_NEAR(values[3 * i + c], expected[c], 1e-5f);
+        }
+    }
+}
+
+TEST(LluviaCalculatorTest, TestReductionOutputs) {
+
+    auto options = GetPassthroughOptions();
+    options.clear_output_port_binding();
+
+    options = MergeOptions(options, R"pb(
+        output_port_binding:  {
+            mediapipe_tag: "SUM"
+            lluvia_port: "out_image_0"
+            packet_type: FLOAT_VECTOR
+            reduction: { type: SUM }
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "MIN_MAX"
+            lluvia_port: "out_image_0"
+            packet_type: MATRIX
+            reduction: { type: MIN_MAX }
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "HISTOGRAM"
+            lluvia_port: "out_image_0"
+            packet_type: FLOAT_VECTOR
+            reduction: { type: HISTOGRAM channel: 0 bins: 8 min_value: 0 max_value: 8 }
+        }
+    )pb");
+
+    CalculatorRunner runner(MakeCalculatorNode(R"pb(
+        input_stream: "IN_0:input_image_0"
+        output_stream: "SUM:output_sum"
+        output_stream: "MIN_MAX:output_min_max"
+        output_stream: "HISTOGRAM:output_histogram"
+    )pb", options));
+
+    // every RGBA pixel is (x % 8, 5, y, 255). 3000 pixels, not a multiple of
+    // the pixels reduced per invocation.
+    constexpr auto width = 100;
+    constexpr auto height = 30;
+    constexpr auto frameCount = 2;
+
+    for (auto t = 0; t < frameCount; ++t) {
+
+        auto rgbaImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, width, height);
+        for (auto y = 0; y < rgbaImage->Height(); ++y) {
+            auto row = rgbaImage->MutablePixelData() + y * rgbaImage->WidthStep();
+            for (auto x = 0; x < rgbaImage->Width(); ++x) {
+                row[4 * x + 0] = x % 8;
+                row[4 * x + 1] = 5;
+                row[4 * x + 2] = y;
+                row[4 * x + 3] = 255;
+            }
+        }
+
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(rgbaImage.release()).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    ASSERT_EQ(runner.Outputs().Tag("SUM").packets.size(), frameCount);
+    ASSERT_EQ(runner.Outputs().Tag("MIN_MAX").packets.size(), frameCount);
+    ASSERT_EQ(runner.Outputs().Tag("HISTOGRAM").packets.size(), frameCount);
+
+    for (auto t = 0; t < frameCount; ++t) {
+
+        // sum of x % 8 over a row is 342, sum of y over a column is 435
+        const auto& sum = runner.Outputs().Tag("SUM").packets[t].Get<std::vector<float>>();
+        EXPECT_EQ(sum, (std::vector<float> {342.0f * height, 5.0f * width * height, 435.0f * width, 255.0f * width * height}));
+
+        const auto& minMax = runner.Outputs().Tag("MIN_MAX").packets[t].Get<Matrix>();
+        ASSERT_EQ(minMax.rows(), 2);
+        ASSERT_EQ(minMax.cols(), 4);
+
+        const auto expectedMin = std::array<float, 4> {0.0f, 5.0f, 0.0f, 255.0f};
+        const auto expectedMax = std::array<float, 4> {7.0f, 5.0f, height - 1.0f, 255.0f};
+        for (auto c = 0; c < 4; ++c) {
+            EXPECT_EQ(minMax(0, c), expectedMin[c]);
+            EXPECT_EQ(minMax(1, c), expectedMax[c]);
+        }
+
+        // counts do not accumulate across frames
+        const auto& histogram = runner.Outputs().Tag("HISTOGRAM").packets[t].Get<std::vector<float>>();
+        EXPECT_EQ(histogram, (std::vector<float> {390, 390, 390, 390, 360, 360, 360, 360}));
+    }
+}
+
+TEST(LluviaCalculatorTest, TestReadbackPolicy) {
+
+    auto options = GetPassthroughOptions();
+    options.clear_output_port_binding();
+
+    options = MergeOptions(options, R"pb(
+        output_port_binding:  {
+            mediapipe_tag: "DECIMATED"
+            lluvia_port: "out_image_0"
+            packet_type: IMAGE_FRAME
+            readback: { every_n_frames: 3 }
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "TRIGGERED"
+            lluvia_port: "out_image_0"
+            packet_type: IMAGE_FRAME
+            readback: { trigger_tag: "TRIGGER" }
+        }
+    )pb");
+
+    CalculatorRunner runner(MakeCalculatorNode(R"pb(
+        input_stream: "IN_0:input_image_0"
+        input_stream: "TRIGGER:trigger"
+        output_stream: "DECIMATED:output_decimated"
+        output_stream: "TRIGGERED:output_triggered"
+    )pb", options));
+
+    constexpr auto frameCount = 7;
+    for (auto t = 0; t < frameCount; ++t) {
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, 64, 48);
+        std::memset(inputImage->MutablePixelData(), t, inputImage->PixelDataSize());
+
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+        runner.MutableInputs()->Tag("TRIGGER").packets.push_back(MakePacket<bool>(t == 1 || t == 4).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    // every frame is the output of its own timestamp, whichever variant of the command buffer ran before
+    const auto checkOutputs = [&runner](const std::string& tag, const std::vector<int>& expectedFrames) {
+        const auto& packets = runner.Outputs().Tag(tag).packets;
+        ASSERT_EQ(packets.size(), expectedFrames.size());
+
+        for (auto i = size_t {0}; i < packets.size(); ++i) {
+            EXPECT_EQ(packets[i].Timestamp(), Timestamp(expectedFrames[i]));
+
+            const auto& outputImage = packets[i].Get<ImageFrame>();
+            EXPECT_EQ(outputImage.PixelData()[0], expectedFrames[i]);
+            EXPECT_EQ(outputImage.PixelData()[outputImage.PixelDataSize() - 1], expectedFrames[i]);
+        }
+    };
+
+    checkOutputs("DECIMATED", {0, 3, 6});
+    checkOutputs("TRIGGERED", {1, 4});
+}
+
+TEST(LluviaCalculatorTest, TestTriggerWithoutImage) {
+
+    auto options = GetPassthroughOptions();
+    options.mutable_output_port_binding(0)->mutable_readback()->set_trigger_tag("TRIGGER");
+
+    CalculatorRunner runner(MakeCalculatorNode(absl::StrCat(kPassthroughStreams, R"pb(
+        input_stream: "TRIGGER:trigger"
+    )pb"), options));
+
+    // images at timestamps 0 and 2, a trigger at every timestamp
+    for (auto t = 0; t < 3; ++t) {
+        if (t != 1) {
+            auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, 64, 48);
+            std::memset(inputImage->MutablePixelData(), t + 1, inputImage->PixelDataSize());
+            runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+        }
+
+        runner.MutableInputs()->Tag("TRIGGER").packets.push_back(MakePacket<bool>(true).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    const auto& packets = runner.Outputs().Tag("OUT_0").packets;
+    ASSERT_EQ(packets.size(), 2);
+    EXPECT_EQ(packets[0].Timestamp(), Timestamp(0));
+    EXPECT_EQ(packets[1].Timestamp(), Timestamp(2));
+    EXPECT_EQ(packets[1].Get<ImageFrame>().PixelData()[0], 3);
+}
+
+TEST(LluviaCalculatorTest, TestTraceOutput) {
+
+    auto tracePath = absl::StrCat(std::getenv("TEST_TMPDIR"), "/LluviaCalculator.trace.json");
+
+    auto options = GetGrayscaleOptions();
+    options.set_trace_path(tracePath);
+
+    CalculatorRunner runner(MakeCalculatorNode(kPassthroughStreams, options));
+
+    constexpr auto frameCount = 3;
+    for (auto t = 0; t < frameCount; ++t) {
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 320, 240);
+        std::memset(inputImage->MutablePixelData(), 0, inputImage->PixelDataSize());
+
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    // the trace is written on Close()
+    auto file = std::ifstream {tracePath};
+    ASSERT_TRUE(file.good());
+
+    auto stream = std::stringstream {};
+    stream << file.rdbuf();
+    const auto trace = stream.str();
+
+    EXPECT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0);
+
+    for (const auto* name : {"\"Open\"", "\"Open/create_session\"", "\"InitNode/container_node\"",
+                             "\"Process/inputs\"", "\"Process/run\"", "\"Process/outputs\"", "\"command buffer\""}) {
+        EXPECT_NE(trace.find(name), std::string::npos) << name;
+    }
+
+    // GPU spans are on their own named track
+    EXPECT_NE(trace.find("\"thread_name\""), std::string::npos);
+}
+
+TEST(LluviaCalculatorTest, TestUnifiedMemoryOutput) {
+
+    auto options = GetPassthroughOptions();
+    options.set_memory_mode(lluvia::LluviaCalculatorOptions::UNIFIED);
+    options.set_image_pool_size(1);
+
+    CalculatorRunner runner(MakeCalculatorNode(kPassthroughStreams, options));
+
+    constexpr auto frameCount = 3;
+    for (auto t = 0; t < frameCount; ++t) {
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 101, 67);
+        std::memset(inputImage->MutablePixelData(), 10 * (t + 1), inputImage->PixelDataSize());
+
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+    }
+
+    const auto status = runner.Run();
+    if (status.code() == absl::StatusCode::kFailedPrecondition) {
+        GTEST_SKIP() << status.message();
+    }
+    MP_ASSERT_OK(status);
+
+    // the runner keeps every output, so each frame adopts its own staging buffer
+    // and earlier frames are not overwritten
+    const auto& packets = runner.Outputs().Tag("OUT_0").packets;
+    ASSERT_EQ(packets.size(), frameCount);
+
+    for (auto t = 0; t < frameCount; ++t) {
+        const auto& outputImage = packets[t].Get<ImageFrame>();
+        ASSERT_EQ(outputImage.Format(), ImageFormat::SRGBA);
+        ASSERT_EQ(outputImage.Width(), 101);
+        ASSERT_EQ(outputImage.Height(), 67);
+
+        for (auto y = 0; y < outputImage.Height(); ++y) {
+            const auto* row = outputImage.PixelData() + y * outputImage.WidthStep();
+            for (auto x = 0; x < outputImage.Width() * 4; ++x) {
+                ASSERT_EQ(row[x], 10 * (t + 1));
+            }
+        }
+    }
+}
+
+TEST(LluviaCalculatorTest, TestMultiDevice) {
+
+    // the same device twice gives two execution contexts on a single GPU
+    for (const auto& multiDevice : {"device_index: 0 device_index: 0 routing: ROUND_ROBIN",
+                                    "device_index: 0 device_index: 0 routing: LEAST_LOADED frames_in_flight: 3",
+                                    "device_index: 0 device_index: 0 temporal: true"}) {
+
+        auto options = GetPassthroughOptions();
+        *options.mutable_multi_device() = ParseTextProtoOrDie<lluvia::MultiDeviceOptions>(multiDevice);
+
+        CalculatorRunner runner(MakeCalculatorNode(kPassthroughStreams, options));
+
+        constexpr auto frameCount = 9;
+        for (auto t = 0; t < frameCount; ++t) {
+            auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 64, 48);
+            std::memset(inputImage->MutablePixelData(), 20 * (t + 1), inputImage->PixelDataSize());
+
+            runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+        }
+
+        MP_ASSERT_OK(runner.Run()) << multiDevice;
+
+        // every frame is emitted, in timestamp order, with its own content
+        const auto& packets = runner.Outputs().Tag("OUT_0").packets;
+        ASSERT_EQ(packets.size(), frameCount) << multiDevice;
+
+        for (auto t = 0; t < frameCount; ++t) {
+            EXPECT_EQ(packets[t].Timestamp(), Timestamp(t)) << multiDevice;
+
+            const auto& outputImage = packets[t].Get<ImageFrame>();
+            ASSERT_EQ(outputImage.Width(), 64);
+            ASSERT_EQ(outputImage.Height(), 48);
+
+            for (auto y = 0; y < outputImage.Height(); ++y) {
+                const auto* row = outputImage.PixelData() + y * outputImage.WidthStep();
+                for (auto x = 0; x < outputImage.Width() * 4; ++x) {
+                    ASSERT_EQ(row[x], 20 * (t + 1)) << multiDevice;
+                }
+            }
+        }
+    }
+}
+
+TEST(LluviaCalculatorTest, TestTiledOutput) {
+
+    // 4 x 3 tiles, the last column and row partially covered
+    auto options = GetPassthroughOptions();
+    options.mutable_tiling()->set_tile_width(32);
+    options.mutable_tiling()->set_tile_height(32);
+    options.mutable_tiling()->set_halo(5);
+
+    CalculatorRunner runner(MakeCalculatorNode(kPassthroughStreams, options));
+
+    constexpr auto frameCount = 2;
+    constexpr auto width = 117;
+    constexpr auto height = 70;
+
+    const auto pixelValue = [](const int t, const int x, const int y, const int c) {
+        return static_cast<uint8>((x * 3 + y * 7 + c * 11 + t * 13) % 256);
+    };
+
+    for (auto t = 0; t < frameCount; ++t) {
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, width, height);
+
+        for (auto y = 0; y < height; ++y) {
+            auto* row = inputImage->MutablePixelData() + y * inputImage->WidthStep();
+            for (auto x = 0; x < width; ++x) {
+                for (auto c = 0; c < 4; ++c) {
+                    row[4 * x + c] = pixelValue(t, x, y, c);
+                }
+            }
+        }
+
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    const auto& packets = runner.Outputs().Tag("OUT_0").packets;
+    ASSERT_EQ(packets.size(), frameCount);
+
+    for (auto t = 0; t < frameCount; ++t) {
+        EXPECT_EQ(packets[t].Timestamp(), Timestamp(t));
+
+        const auto& outputImage = packets[t].Get<ImageFrame>();
+        ASSERT_EQ(outputImage.Format(), ImageFormat::SRGBA);
+        ASSERT_EQ(outputImage.Width(), width);
+        ASSERT_EQ(outputImage.Height(), height);
+
+        for (auto y = 0; y < height; ++y) {
+            const auto* row = outputImage.PixelData() + y * outputImage.WidthStep();
+            for (auto x = 0; x < width; ++x) {
+                for (auto c = 0; c < 4; ++c) {
+                    ASSERT_EQ(row[4 * x + c], pixelValue(t, x, y, c)) << "x: " << x << " y: " << y;
+                }
+            }
+        }
+    }
+}
+
+TEST(LluviaCalculatorTest, TestEagerInitFirstFrameLatency) {
+
+    constexpr auto width = 640;
+    constexpr auto height = 480;
+
+    // time between sending the first frame to an opened graph and receiving its output
+    const auto measureFirstFrameLatency = [&](const bool declareShape) {
+
+        auto options = GetPassthroughOptions();
+        if (declareShape) {
+            auto* inputBinding = options.mutable_input_port_binding(0);
+            inputBinding->set_width(width);
+            inputBinding->set_height(height);
+            inputBinding->set_format(ImageFormat::SRGBA);
+        }
+
+        auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+            input_stream: "input_image"
+            output_stream: "output_image"
+        )pb");
+
+        *graphConfig.add_node() = MakeCalculatorNode(R"pb(
+            input_stream: "IN_0:input_image"
+            output_stream: "OUT_0:output_image"
+        )pb", options);
+
+        auto outputPackets = std::vector<Packet> {};
+        tool::AddVectorSink("output_image", &graphConfig, &outputPackets);
+
+        CalculatorGraph graph;
+        MP_EXPECT_OK(graph.Initialize(graphConfig));
+        MP_EXPECT_OK(graph.StartRun({}));
+
+        // Open() runs before the graph is idle
+        MP_EXPECT_OK(graph.WaitUntilIdle());
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, width, height);
+        std::memset(inputImage->MutablePixelData(), 42, inputImage->PixelDataSize());
+
+        const auto start = std::chrono::steady_clock::now();
+        MP_EXPECT_OK(graph.AddPacketToInputStream("input_image", Adopt(inputImage.release()).At(Timestamp(0))));
+        MP_EXPECT_OK(graph.WaitUntilIdle());
+        const auto latency = std::chrono::steady_clock::now() - start;
+
+        MP_EXPECT_OK(graph.CloseAllInputStreams());
+        MP_EXPECT_OK(graph.WaitUntilDone());
+
+        EXPECT_EQ(outputPackets.size(), 1);
+        if (!outputPackets.empty()) {
+            EXPECT_EQ(outputPackets[0].Get<ImageFrame>().PixelData()[0], 42);
+        }
+
+        return latency;
+    };
+
+    const auto lazyLatency = measureFirstFrameLatency(false);
+    const auto eagerLatency = measureFirstFrameLatency(true);
+
+    LOG(INFO) << "first frame latency, lazy: " << std::chrono::duration<double, std::milli>(lazyLatency).count()
+              << " ms, eager: " << std::chrono::duration<double, std::milli>(eagerLatency).count() << " ms";
+
+    // the eager first frame skips port allocation, container node creation
+    // and command buffer recording
+    EXPECT_LT(eagerLatency, lazyLatency);
+}
+
+TEST(LluviaCalculatorTest, TestDeclaredShapeMismatch) {
+
+    auto options = GetPassthroughOptions();
+    options.set_warmup_runs(1);
+    options.mutable_input_port_binding(0)->set_width(64);
+    options.mutable_input_port_binding(0)->set_height(48);
+
+    CalculatorRunner runner(MakeCalculatorNode(kPassthroughStreams, options));
+
+    auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 32, 48);
+    runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(0)));
+
+    EXPECT_FALSE(runner.Run().ok());
+}
+
+TEST(LluviaCalculatorTest, TestWorkgroupTuning) {
+
+    auto cachePath = absl::StrCat(std::getenv("TEST_TMPDIR"), "/LluviaCalculator.workgroups");
+    std::remove(cachePath.c_str());
+
+    const auto readFile = [](const std::string& path) {
+        auto file = std::ifstream {path};
+        auto content = std::stringstream {};
+        content << file.rdbuf();
+        return content.str();
+    };
+
+    const auto makeNodeConfig = [&](const bool tuned) {
+
+        auto options = GetGrayscaleOptions();
+        options.mutable_workgroup_tuning()->set_enabled(tuned);
+        options.mutable_workgroup_tuning()->set_cache_path(cachePath);
+        options.mutable_workgroup_tuning()->set_iterations(2);
+
+        return MakeCalculatorNode(kPassthroughStreams, options);
+    };
+
+    auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 320, 240);
+    for (auto y = 0; y < inputImage->Height(); ++y) {
+        auto* row = inputImage->MutablePixelData() + y * inputImage->WidthStep();
+        for (auto x = 0; x < inputImage->Width() * 4; ++x) {
+            row[x] = static_cast<uint8>((x + 5 * y) % 256);
+        }
+    }
+
+    const auto inputPacket = Adopt(inputImage.release()).At(Timestamp(0));
+
+    // builder shapes, tuning and writing the cache, then reading the cache
+    auto outputPackets = std::vector<Packet> {};
+    auto cacheContents = std::vector<std::string> {};
+    for (const auto tuned : {false, true, true}) {
+
+        CalculatorRunner runner(makeNodeConfig(tuned));
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(inputPacket);
+
+        MP_ASSERT_OK(runner.Run());
+        ASSERT_EQ(runner.Outputs().Tag("OUT_0").packets.size(), 1);
+        outputPackets.push_back(runner.Outputs().Tag("OUT_0").packets[0]);
+
+        if (tuned) {
+            cacheContents.push_back(readFile(cachePath));
+        }
+    }
+
+    // one line for the RGBA2Gray node, not benchmarked again once cached
+    EXPECT_NE(cacheContents[0].find("\tlluvia/color/RGBA2Gray\t"), std::string::npos) << cacheContents[0];
+    EXPECT_EQ(std::count(cacheContents[0].begin(), cacheContents[0].end(), '\n'), 1);
+    EXPECT_EQ(cacheContents[0], cacheContents[1]);
+
+    // the grid of the tuned shape covers at least the image
+    auto& expected = outputPackets[0].Get<ImageFrame>();
+    for (auto i = 1; i < static_cast<int>(outputPackets.size()); ++i) {
+
+        auto& tuned = outputPackets[i].Get<ImageFrame>();
+        ASSERT_EQ(expected.Width(), tuned.Width());
+        ASSERT_EQ(expected.Height(), tuned.Height());
+
+        for (auto y = 0; y < expected.Height(); ++y) {
+            ASSERT_EQ(std::memcmp(expected.PixelData() + y * expected.WidthStep(),
+                                  tuned.PixelData() + y * tuned.WidthStep(),
+                                  expected.Width() * expected.NumberOfChannels() * expected.ByteDepth()), 0);
+        }
+    }
+}
+
+TEST(LluviaCalculatorTest, TestAdditionalContainerNodes) {
+
+    // the passthrough and grayscale container nodes share the uploaded input
+    const auto options = MergeOptions(GetPassthroughOptions(), R"pb(
+        additional_container {
+            container_node: "lluvia/mediapipe/LluviaCalculator"
+
+            input_port { key: "IN_0" value: "in_image" }
+
+            output_port_binding:  {
+                mediapipe_tag: "GRAY"
+                lluvia_port: "out_image"
+                packet_type: IMAGE_FRAME
+            }
+        }
+    )pb");
+
+    CalculatorRunner runner(MakeCalculatorNode(absl::StrCat(kPassthroughStreams, R"pb(
+        output_stream: "GRAY:gray_image"
+    )pb"), options));
+
+    constexpr auto frameCount = 3;
+    for (auto t = 0; t < frameCount; ++t) {
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 320, 240);
+        std::memset(inputImage->MutablePixelData(), 40 * (t + 1), inputImage->PixelDataSize());
+
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    ASSERT_EQ(runner.Outputs().Tag("OUT_0").packets.size(), frameCount);
+    ASSERT_EQ(runner.Outputs().Tag("GRAY").packets.size(), frameCount);
+
+    for (auto t = 0; t < frameCount; ++t) {
+
+        const auto& outImage = runner.Outputs().Tag("OUT_0").packets[t].Get<ImageFrame>();
+        EXPECT_EQ(outImage.Format(), ImageFormat::SRGBA);
+        EXPECT_EQ(outImage.PixelData()[0], 40 * (t + 1));
+
+        // gray pixels of an image with equal channels keep their value
+        const auto& grayImage = runner.Outputs().Tag("GRAY").packets[t].Get<ImageFrame>();
+        EXPECT_EQ(grayImage.Format(), ImageFormat::GRAY8);
+        EXPECT_EQ(grayImage.Width(), 320);
+        EXPECT_EQ(grayImage.Height(), 240);
+        EXPECT_NEAR(grayImage.PixelData()[0], 40 * (t + 1), 1);
+    }
+}
+
+TEST(LluviaCalculatorTest, TestLatencyGovernor) {
+
+    // no frame meets the deadline, so the governor steps down after each
+    // frame not including the initialization of its level
+    const auto options = MergeOptions(GetPassthroughOptions(), R"pb(
+        latency_governor {
+            deadline_ms: 0.001
+            step_down_frames: 1
+            level_tag: "LEVEL"
+            level { input_scale: 0.5 }
+            level { input_scale: 0.5 frame_interval: 2 }
+        }
+    )pb");
+
+    CalculatorRunner runner(MakeCalculatorNode(absl::StrCat(kPassthroughStreams, R"pb(
+        output_stream: "LEVEL:level"
+    )pb"), options));
+
+    constexpr auto frameCount = 8;
+    for (auto t = 0; t < frameCount; ++t) {
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 320, 240);
+        std::memset(inputImage->MutablePixelData(), t, inputImage->PixelDataSize());
+
+        runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(t)));
+    }
+
+    MP_ASSERT_OK(runner.Run());
+
+    // level 0 on frames 0 and 1, level 1 on frames 2 and 3, then level 2 on every other frame
+    const auto& levelPackets = runner.Outputs().Tag("LEVEL").packets;
+    ASSERT_EQ(levelPackets.size(), 3);
+    for (auto i = 0; i < 3; ++i) {
+        EXPECT_EQ(levelPackets[i].Get<int>(), i);
+    }
+
+    EXPECT_EQ(levelPackets[1].Timestamp(), Timestamp(1));
+    EXPECT_EQ(levelPackets[2].Timestamp(), Timestamp(3));
+
+    const auto expectedFrames = std::vector<int> {0, 1, 2, 3, 4, 6};
+    const auto& outputPackets = runner.Outputs().Tag("OUT_0").packets;
+    ASSERT_EQ(outputPackets.size(), expectedFrames.size());
+
+    for (auto i = size_t {0}; i < expectedFrames.size(); ++i) {
+
+        const auto t = expectedFrames[i];
+        const auto& outImage = outputPackets[i].Get<ImageFrame>();
+
+        // outputs of the reduced levels are resized to the full resolution
+        EXPECT_EQ(outputPackets[i].Timestamp(), Timestamp(t));
+        EXPECT_EQ(outImage.Width(), 320);
+        EXPECT_EQ(outImage.Height(), 240);
+        EXPECT_EQ(outImage.PixelData()[0], t);
+        EXPECT_EQ(outImage.PixelData()[239 * outImage.WidthStep() + 319 * 4], t);
+    }
+}
+
+TEST(LluviaCalculatorTest, TestLatencyGovernorPackedOutput) {
+
+    // packed images cannot be resized back to the full resolution
+    auto options = MergeOptions(GetPassthroughOptions(), R"pb(
+        latency_governor {
+            deadline_ms: 10
+            level { input_scale: 0.5 }
+        }
+    )pb");
+    options.mutable_output_port_binding(0)->mutable_packing()->set_swizzle("r");
+
+    CalculatorRunner runner(MakeCalculatorNode(kPassthroughStreams, options));
+
+    auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 320, 240);
+    runner.MutableInputs()->Tag("IN_0").packets.push_back(Adopt(inputImage.release()).At(Timestamp(0)));
+
+    EXPECT_FALSE(runner.Run().ok());
+}
+
+TEST(LluviaCalculatorTest, TestSubmissionQueue) {
+
+    auto session = std::shared_ptr<ll::Session> {ll::Session::create(ll::SessionDescriptor().enableDebug(true))};
+    auto queue = LluviaSubmissionQueue {session, std::make_shared<std::mutex>()};
+
+    constexpr auto threadCount = 8;
+    constexpr auto submitsPerThread = 50;
+
+    auto failures = std::atomic<int> {0};
+    auto threads = std::vector<std::thread> {};
+
+    for (auto i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&]() {
+
+            auto cmdBuffer = session->createCommandBuffer();
+            cmdBuffer->begin();
+            cmdBuffer->memoryBarrier();
+            cmdBuffer->end();
+
+            for (auto n = 0; n < submitsPerThread; ++n) {
+                if (!queue.run(*cmdBuffer).ok()) {
+                    ++failures;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_EQ(queue.getSubmissionCount(), threadCount * submitsPerThread);
+
+    // concurrent submitters share wake-ups of the thread
+    EXPECT_GT(queue.getWakeupCount(), 0);
+    EXPECT_LE(queue.getWakeupCount(), queue.getSubmissionCount());
+    LOG(INFO) << "submissions per wake-up: " << static_cast<double>(queue.getSubmissionCount()) / queue.getWakeupCount();
+
+    auto cmdBuffer = session->createCommandBuffer();
+    cmdBuffer->begin();
+    cmdBuffer->end();
+
+    auto status = queue.submitAsync(*cmdBuffer);
+    MP_EXPECT_OK(status.get());
+
+    EXPECT_FALSE(session->hasReceivedVulkanWarningMessages());
+}
+
+TEST(LluviaCalculatorTest, TestHostCopy) {
+
+    auto engine = LluviaHostCopyEngine::getShared(4);
+    EXPECT_EQ(engine, LluviaHostCopyEngine::getShared(4));
+
+    // 4K RGB rows padded to 64 bytes, copied without padding to an unaligned destination
+    constexpr auto width = 3840;
+    constexpr auto height = 2160;
+    constexpr auto rowBytes = size_t {width * 3};
+    constexpr auto srcStride = (rowBytes + 63) / 64 * 64;
+
+    auto src = std::vector<uint8_t>(srcStride * height);
+    for (auto i = size_t {0}; i < src.size(); ++i) {
+        src[i] = static_cast<uint8_t>(i * 7 + i / 4096);
+    }
+
+    constexpr auto threadCount = 3;
+    auto failures = std::atomic<int> {0};
+    auto threads = std::vector<std::thread> {};
+
+    for (auto i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&, i]() {
+
+            auto dst = std::vector<uint8_t>(rowBytes * height + 1);
+            engine->copy(src.data(), srcStride, dst.data() + 1, rowBytes, rowBytes, height, i % 2 == 0);
+
+            for (auto y = 0; y < height; ++y) {
+                if (std::memcmp(dst.data() + 1 + y * rowBytes, src.data() + y * srcStride, rowBytes) != 0) {
+                    ++failures;
+                    return;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(failures.load(), 0);
+}
+
+TEST(LluviaCalculatorTest, TestSubmissionThread) {
+
+    auto options = GetPassthroughOptions();
+    options.set_session_name("submission_thread");
+    options.set_submission_thread(true);
+
+    // parallel passthrough calculators submitting through the thread of their shared session
+    constexpr auto streamCount = 4;
+
+    auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(input_stream: "input_image")pb");
+    for (auto i = 0; i < streamCount; ++i) {
+        *graphConfig.add_node() = MakeCalculatorNode(absl::Substitute(R"pb(
+            input_stream: "IN_0:input_image"
+            output_stream: "OUT_0:output_image_$0"
+        )pb", i), options);
+    }
+
+    auto outputPackets = std::vector<std::vector<Packet>>(streamCount);
+    for (auto i = 0; i < streamCount; ++i) {
+        tool::AddVectorSink(absl::StrCat("output_image_", i), &graphConfig, &outputPackets[i]);
+    }
+
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(graphConfig));
+    MP_ASSERT_OK(graph.StartRun({}));
+
+    constexpr auto frameCount = 8;
+    for (auto t = 0; t < frameCount; ++t) {
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, 640, 480);
+        for (auto y = 0; y < inputImage->Height(); ++y) {
+            std::memset(inputImage->MutablePixelData() + y * inputImage->WidthStep(), (y + t) % 256, inputImage->Width());
+        }
+
+        MP_ASSERT_OK(graph.AddPacketToInputStream("input_image", Adopt(inputImage.release()).At(Timestamp(t))));
+    }
+
+    MP_ASSERT_OK(graph.CloseAllInputStreams());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+
+    for (auto i = 0; i < streamCount; ++i) {
+
+        ASSERT_EQ(outputPackets[i].size(), frameCount);
+
+        for (auto t = 0; t < frameCount; ++t) {
+            auto& outImage = outputPackets[i][t].Get<ImageFrame>();
+            ASSERT_EQ(outImage.Width(), 640);
+            ASSERT_EQ(outImage.Height(), 480);
+
+            for (auto y = 0; y < outImage.Height(); ++y) {
+                ASSERT_EQ(outImage.PixelData()[y * outImage.WidthStep()], (y + t) % 256);
+            }
+        }
+    }
+}
+
+// Runs a command buffer and emits its input packet on every output: the
+// allocations of the driver and of the framework per frame, without any of
+// the calculator itself.
+class AllocationReferenceCalculator : public CalculatorBase {
+public:
+    static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+        cc->Inputs().Tag("IN_0").Set<ImageFrame>();
+        for (const auto& tag : cc->Outputs().GetTags()) {
+            cc->Outputs().Tag(tag).SetAny();
+        }
+        return ::mediapipe::OkStatus();
+    }
+
+    ::mediapipe::Status Open(CalculatorContext* cc) override {
+        cc->SetOffset(TimestampDiff(0));
+
+        m_session = ll::Session::create(ll::SessionDescriptor {});
+        m_source = m_session->getHostMemory()->createBuffer(1024);
+        m_destination = m_session->getHostMemory()->createBuffer(1024);
+        m_duration = m_session->createDuration();
+
+        m_cmdBuffer = m_session->createCommandBuffer();
+        m_cmdBuffer->begin();
+        m_cmdBuffer->durationStart(*m_duration);
+        m_cmdBuffer->copyBuffer(*m_source, *m_destination);
+        m_cmdBuffer->memoryBarrier();
+        m_cmdBuffer->durationEnd(*m_duration);
+        m_cmdBuffer->end();
+
+        return ::mediapipe::OkStatus();
+    }
+
+    ::mediapipe::Status Process(CalculatorContext* cc) override {
+        m_session->run(*m_cmdBuffer);
+        m_duration->getDuration();
+
+        for (auto id = cc->Outputs().BeginId(); id < cc->Outputs().EndId(); ++id) {
+            cc->Outputs().Get(id).AddPacket(cc->Inputs().Tag("IN_0").Value());
+        }
+
+        return ::mediapipe::OkStatus();
+    }
+
+private:
+    std::shared_ptr<ll::Session> m_session;
+    std::shared_ptr<ll::Buffer> m_source;
+    std::shared_ptr<ll::Buffer> m_destination;
+    std::unique_ptr<ll::Duration> m_duration;
+    std::unique_ptr<ll::CommandBuffer> m_cmdBuffer;
+};
+REGISTER_CALCULATOR(AllocationReferenceCalculator);
+
+TEST(LluviaCalculatorTest, TestSteadyStateAllocations) {
+
+    constexpr auto warmupFrames = 50;
+    constexpr auto frameCount = 2000;
+
+    auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 64, 48);
+    std::memset(inputImage->MutablePixelData(), 7, inputImage->PixelDataSize());
+    const auto inputPacket = Adopt(inputImage.release());
+
+    // allocations of frameCount frames once warm. Outputs are released by the
+    // observer. CalculatorRunner keeps every output packet, so any output
+    // pool would grow on each of its frames.
+    const auto countFrameAllocations = [&](const CalculatorGraphConfig::Node& node) {
+
+        auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(input_stream: "input_image")pb");
+        *graphConfig.add_node() = node;
+
+        CalculatorGraph graph;
+        MP_EXPECT_OK(graph.Initialize(graphConfig));
+        MP_EXPECT_OK(graph.ObserveOutputStream("output_image", [](const Packet&) { return ::mediapipe::OkStatus(); }));
+        MP_EXPECT_OK(graph.StartRun({}));
+
+        for (auto t = 0; t < warmupFrames + frameCount; ++t) {
+
+            if (t == warmupFrames) {
+                allocationCount.store(0);
+                countAllocations.store(true);
+            }
+
+            MP_EXPECT_OK(graph.AddPacketToInputStream("input_image", inputPacket.At(Timestamp(t))));
+            MP_EXPECT_OK(graph.WaitUntilIdle());
+        }
+
+        countAllocations.store(false);
+        const auto count = allocationCount.load();
+
+        MP_EXPECT_OK(graph.CloseAllInputStreams());
+        MP_EXPECT_OK(graph.WaitUntilDone());
+
+        return count;
+    };
+
+    // Process() allocates nothing once warm: the allocations per frame are
+    // at most the ones of the driver and the framework in the reference
+    const auto expectNoProcessAllocations = [&](const std::string& streams, const lluvia::LluviaCalculatorOptions& options, const std::string& name) {
+
+        const auto referenceAllocations = countFrameAllocations(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(
+            absl::StrCat("calculator: \"AllocationReferenceCalculator\"\n", streams)));
+
+        const auto lluviaAllocations = countFrameAllocations(MakeCalculatorNode(streams, options));
+
+        LOG(INFO) << name << " allocations per frame, reference: " << static_cast<double>(referenceAllocations) / frameCount
+                  << ", LluviaCalculator: " << static_cast<double>(lluviaAllocations) / frameCount;
+
+        EXPECT_LE(lluviaAllocations, referenceAllocations) << name;
+    };
+
+    constexpr auto imageStreams = R"pb(
+        input_stream: "IN_0:input_image"
+        output_stream: "OUT_0:output_image"
+    )pb";
+
+    // AUTO emits staging buffers without copy on integrated GPUs and CPU devices with unified memory
+    for (const auto memoryMode : {lluvia::LluviaCalculatorOptions::STAGING, lluvia::LluviaCalculatorOptions::AUTO}) {
+
+        auto options = GetPassthroughOptions();
+        options.set_memory_mode(memoryMode);
+
+        expectNoProcessAllocations(imageStreams, options, lluvia::LluviaCalculatorOptions::MemoryMode_Name(memoryMode));
+    }
+
+    // vector outputs reuse their std::vector and Matrix
+    auto options = MergeOptions(GetPassthroughOptions(), R"pb(
+        output_port_binding:  {
+            mediapipe_tag: "SUM"
+            lluvia_port: "out_image_0"
+            packet_type: FLOAT_VECTOR
+            reduction: { type: SUM }
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "MIN_MAX"
+            lluvia_port: "out_image_0"
+            packet_type: MATRIX
+            reduction: { type: MIN_MAX }
+        }
+    )pb");
+
+    expectNoProcessAllocations(R"pb(
+        input_stream: "IN_0:input_image"
+        output_stream: "OUT_0:output_image"
+        output_stream: "SUM:output_sum"
+        output_stream: "MIN_MAX:output_min_max"
+    )pb", options, "vector outputs");
+}
+
 } // namespace
 } // namespace mediapipe
@@ -0,0 +1,696 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_container_snapshot.h"
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/port/file_helpers.h"
+
+#include <cstring>
+#include <set>
+#include <unordered_map>
+
+namespace mediapipe {
+
+namespace {
+
+// Command buffer logging the commands recorded by a container node into a snapshot.
+class SnapshotRecorder : public ll::CommandBuffer {
+public:
+    explicit SnapshotRecorder(lluvia::ContainerSnapshot* snapshot) : m_snapshot {snapshot} {}
+
+    void begin() override {}
+    void end() override {}
+
+    void run(const ll::ComputeNode& node) override {
+
+        auto op = m_snapshot->add_record_ops();
+        op->set_type(lluvia::RecordOp::RUN);
+        op->set_node(addComputeNode(node));
+    }
+
+    void run(const ll::ContainerNode& node) override {
+        node.record(*this);
+    }
+
+    void copyBuffer(const ll::Buffer& src, const ll::Buffer& dst) override {
+        addCopy(lluvia::RecordOp::COPY_BUFFER, addBuffer(src), addBuffer(dst));
+    }
+
+    void copyBufferToImage(const ll::Buffer& src, const ll::Image& dst) override {
+        addCopy(lluvia::RecordOp::COPY_BUFFER_TO_IMAGE, addBuffer(src), addImage(dst, nullptr));
+    }
+
+    void copyImageToBuffer(const ll::Image& src, const ll::Buffer& dst) override {
+        addCopy(lluvia::RecordOp::COPY_IMAGE_TO_BUFFER, addImage(src, nullptr), addBuffer(dst));
+    }
+
+    void copyImageToImage(const ll::Image& src, const ll::Image& dst) override {
+        addCopy(lluvia::RecordOp::COPY_IMAGE_TO_IMAGE, addImage(src, nullptr), addImage(dst, nullptr));
+    }
+
+    void changeImageLayout(ll::Image& image, const ll::ImageLayout newLayout) override {
+
+        auto op = m_snapshot->add_record_ops();
+        op->set_type(lluvia::RecordOp::CHANGE_IMAGE_LAYOUT);
+        op->set_destination(addImage(image, nullptr));
+        op->set_layout(static_cast<uint32_t>(newLayout));
+    }
+
+    void clearImage(ll::Image& image) override {
+
+        auto op = m_snapshot->add_record_ops();
+        op->set_type(lluvia::RecordOp::CLEAR_IMAGE);
+        op->set_destination(addImage(image, nullptr));
+    }
+
+    void memoryBarrier() override {
+        m_snapshot->add_record_ops()->set_type(lluvia::RecordOp::MEMORY_BARRIER);
+    }
+
+    void durationStart(ll::Duration& duration) override {
+        m_status = absl::UnimplementedError("durations recorded by container nodes are not supported in snapshots");
+    }
+
+    void durationEnd(ll::Duration& duration) override {
+        m_status = absl::UnimplementedError("durations recorded by container nodes are not supported in snapshots");
+    }
+
+    lluvia::ObjectRef addObject(const std::shared_ptr<ll::Object>& object) {
+
+        auto ref = lluvia::ObjectRef {};
+
+        switch (object->getType()) {
+            case ll::ObjectType::Buffer:
+                ref.set_type(lluvia::SNAPSHOT_BUFFER);
+                ref.set_index(addBuffer(*std::static_pointer_cast<ll::Buffer>(object), std::static_pointer_cast<ll::Buffer>(object)));
+                break;
+
+            case ll::ObjectType::Image:
+                ref.set_type(lluvia::SNAPSHOT_IMAGE);
+                ref.set_index(addImage(*std::static_pointer_cast<ll::Image>(object), std::static_pointer_cast<ll::Image>(object)));
+                break;
+
+            case ll::ObjectType::ImageView:
+                ref.set_type(lluvia::SNAPSHOT_IMAGE_VIEW);
+                ref.set_index(addImageView(std::static_pointer_cast<ll::ImageView>(object)));
+                break;
+        }
+
+        return ref;
+    }
+
+    int addImage(const ll::Image& image, std::shared_ptr<ll::Image> shared) {
+
+        auto it = m_imageIndices.find(&image);
+        if (it != m_imageIndices.end()) {
+            if (shared && !m_images[it->second]) m_images[it->second] = shared;
+            return it->second;
+        }
+
+        auto imageSnapshot = m_snapshot->add_images();
+        imageSnapshot->set_width(image.getWidth());
+        imageSnapshot->set_height(image.getHeight());
+        imageSnapshot->set_depth(image.getDepth());
+        imageSnapshot->set_channel_count(static_cast<uint32_t>(image.getChannelCount()));
+        imageSnapshot->set_channel_type(static_cast<uint32_t>(image.getChannelType()));
+        imageSnapshot->set_usage_flags(static_cast<uint32_t>(image.getUsageFlags()));
+
+        const auto index = m_snapshot->images_size() - 1;
+        m_imageIndices[&image] = index;
+        m_images.push_back(shared);
+
+        return index;
+    }
+
+    int addImageView(const std::shared_ptr<ll::ImageView>& imageView) {
+
+        auto it = m_imageViewIndices.find(imageView.get());
+        if (it != m_imageViewIndices.end()) {
+            return it->second;
+        }
+
+        const auto image = imageView->getImage();
+        const auto& desc = imageView->getDescriptor();
+
+        auto viewSnapshot = m_snapshot->add_image_views();
+        viewSnapshot->set_image(addImage(*image, image));
+        viewSnapshot->set_address_mode(static_cast<uint32_t>(desc.getAddressModeU()));
+        viewSnapshot->set_filter_mode(static_cast<uint32_t>(desc.getFilterMode()));
+        viewSnapshot->set_normalized_coordinates(desc.isNormalizedCoordinates());
+        viewSnapshot->set_is_sampled(desc.isSampled());
+
+        const auto index = m_snapshot->image_views_size() - 1;
+        m_imageViewIndices[imageView.get()] = index;
+
+        return index;
+    }
+
+    int addBuffer(const ll::Buffer& buffer, std::shared_ptr<ll::Buffer> shared = nullptr) {
+
+        auto it = m_bufferIndices.find(&buffer);
+        if (it != m_bufferIndices.end()) {
+            if (shared && !m_buffers[it->second]) m_buffers[it->second] = shared;
+            return it->second;
+        }
+
+        auto bufferSnapshot = m_snapshot->add_buffers();
+        bufferSnapshot->set_size(buffer.getSize());
+        bufferSnapshot->set_usage_flags(static_cast<uint32_t>(buffer.getUsageFlags()));
+        bufferSnapshot->set_host_visible(buffer.isMappable());
+
+        const auto index = m_snapshot->buffers_size() - 1;
+        m_bufferIndices[&buffer] = index;
+        m_buffers.push_back(shared);
+
+        return index;
+    }
+
+    int addComputeNode(const ll::ComputeNode& node) {
+
+        auto it = m_nodeIndices.find(&node);
+        if (it != m_nodeIndices.end()) {
+            return it->second;
+        }
+
+        const auto& desc = node.getDescriptor();
+
+        auto nodeSnapshot = m_snapshot->add_compute_nodes();
+        nodeSnapshot->set_builder_name(desc.getBuilderName());
+
+        // ll_node archives the program of each node with the builder name
+        nodeSnapshot->set_program(desc.getBuilderName() + ".comp");
+        nodeSnapshot->set_function_name(desc.getFunctionName());
+
+        const auto localShape = desc.getLocalShape();
+        nodeSnapshot->set_local_x(localShape.x);
+        nodeSnapshot->set_local_y(localShape.y);
+        nodeSnapshot->set_local_z(localShape.z);
+
+        const auto gridShape = desc.getGridShape();
+        nodeSnapshot->set_grid_x(gridShape.x);
+        nodeSnapshot->set_grid_y(gridShape.y);
+        nodeSnapshot->set_grid_z(gridShape.z);
+
+        const auto& pushConstants = desc.getPushConstants();
+        nodeSnapshot->set_push_constants(std::string {static_cast<const char*>(pushConstants.getPtr()), pushConstants.getSize()});
+
+        for (const auto& [name, portDesc] : desc.getPorts()) {
+
+            auto portSnapshot = nodeSnapshot->add_ports();
+            portSnapshot->set_name(name);
+            portSnapshot->set_binding(portDesc.getBinding());
+            portSnapshot->set_direction(static_cast<uint32_t>(portDesc.getDirection()));
+            portSnapshot->set_port_type(static_cast<uint32_t>(portDesc.getPortType()));
+            *portSnapshot->mutable_object() = addObject(node.getPort(name));
+        }
+
+        const auto index = m_snapshot->compute_nodes_size() - 1;
+        m_nodeIndices[&node] = index;
+
+        return index;
+    }
+
+    const ::mediapipe::Status& getStatus() const noexcept { return m_status; }
+
+    // objects seen through ports, null for objects only referenced by transfer commands
+    std::vector<std::shared_ptr<ll::Image>> m_images;
+    std::vector<std::shared_ptr<ll::Buffer>> m_buffers;
+
+private:
+    void addCopy(const lluvia::RecordOp::Type type, const int source, const int destination) {
+
+        auto op = m_snapshot->add_record_ops();
+        op->set_type(type);
+        op->set_source(source);
+        op->set_destination(destination);
+    }
+
+    lluvia::ContainerSnapshot* m_snapshot;
+    ::mediapipe::Status m_status;
+
+    std::unordered_map<const ll::Image*, int> m_imageIndices;
+    std::unordered_map<const ll::ImageView*, int> m_imageViewIndices;
+    std::unordered_map<const ll::Buffer*, int> m_bufferIndices;
+    std::unordered_map<const ll::ComputeNode*, int> m_nodeIndices;
+};
+
+// Image or buffer key of an object reference, image views resolve to their image.
+std::pair<lluvia::SnapshotObjectType, int> getStorageKey(const lluvia::ContainerSnapshot& snapshot, const lluvia::ObjectRef& ref) {
+
+    if (ref.type() == lluvia::SNAPSHOT_IMAGE_VIEW) {
+        return {lluvia::SNAPSHOT_IMAGE, snapshot.image_views(ref.index()).image()};
+    }
+
+    return {ref.type(), ref.index()};
+}
+
+// Objects whose first access in the record ops is a read.
+std::set<std::pair<lluvia::SnapshotObjectType, int>> getObjectsReadBeforeWritten(const lluvia::ContainerSnapshot& snapshot) {
+
+    auto written = std::set<std::pair<lluvia::SnapshotObjectType, int>> {};
+    auto readFirst = std::set<std::pair<lluvia::SnapshotObjectType, int>> {};
+
+    const auto read = [&](const std::pair<lluvia::SnapshotObjectType, int>& key) {
+        if (written.count(key) == 0) readFirst.insert(key);
+    };
+
+    for (const auto& op : snapshot.record_ops()) {
+        switch (op.type()) {
+            case lluvia::RecordOp::RUN:
+                // read all inputs before marking outputs, a node may read and write the same object
+                for (const auto& port : snapshot.compute_nodes(op.node()).ports()) {
+                    if (port.direction() == static_cast<uint32_t>(ll::PortDirection::In)) {
+                        read(getStorageKey(snapshot, port.object()));
+                    }
+                }
+                for (const auto& port : snapshot.compute_nodes(op.node()).ports()) {
+                    if (port.direction() == static_cast<uint32_t>(ll::PortDirection::Out)) {
+                        written.insert(getStorageKey(snapshot, port.object()));
+                    }
+                }
+                break;
+
+            case lluvia::RecordOp::COPY_BUFFER:
+                read({lluvia::SNAPSHOT_BUFFER, op.source()});
+                written.insert({lluvia::SNAPSHOT_BUFFER, op.destination()});
+                break;
+
+            case lluvia::RecordOp::COPY_BUFFER_TO_IMAGE:
+                read({lluvia::SNAPSHOT_BUFFER, op.source()});
+                written.insert({lluvia::SNAPSHOT_IMAGE, op.destination()});
+                break;
+
+            case lluvia::RecordOp::COPY_IMAGE_TO_BUFFER:
+                read({lluvia::SNAPSHOT_IMAGE, op.source()});
+                written.insert({lluvia::SNAPSHOT_BUFFER, op.destination()});
+                break;
+
+            case lluvia::RecordOp::COPY_IMAGE_TO_IMAGE:
+                read({lluvia::SNAPSHOT_IMAGE, op.source()});
+                written.insert({lluvia::SNAPSHOT_IMAGE, op.destination()});
+                break;
+
+            case lluvia::RecordOp::CLEAR_IMAGE:
+                written.insert({lluvia::SNAPSHOT_IMAGE, op.destination()});
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return readFirst;
+}
+
+// Copies the content of an image in device memory to host memory.
+std::string readImageContent(const std::shared_ptr<ll::Session>& session, const std::shared_ptr<ll::Image>& image) {
+
+    auto stagingBuffer = session->getHostMemory()->createBuffer(image->getMinimumSize());
+
+    auto cmdBuffer = session->createCommandBuffer();
+    cmdBuffer->begin();
+    cmdBuffer->changeImageLayout(*image, ll::ImageLayout::TransferSrcOptimal);
+    cmdBuffer->memoryBarrier();
+    cmdBuffer->copyImageToBuffer(*image, *stagingBuffer);
+    cmdBuffer->memoryBarrier();
+    cmdBuffer->changeImageLayout(*image, ll::ImageLayout::General);
+    cmdBuffer->end();
+
+    session->run(*cmdBuffer);
+
+    auto mappedPtr = stagingBuffer->map<uint8_t []>();
+    return std::string {reinterpret_cast<const char*>(mappedPtr.get()), stagingBuffer->getSize()};
+}
+
+std::string readBufferContent(const std::shared_ptr<ll::Session>& session, const std::shared_ptr<ll::Buffer>& buffer) {
+
+    auto stagingBuffer = buffer;
+
+    if (!buffer->isMappable()) {
+        stagingBuffer = session->getHostMemory()->createBuffer(buffer->getSize());
+
+        auto cmdBuffer = session->createCommandBuffer();
+        cmdBuffer->begin();
+        cmdBuffer->copyBuffer(*buffer, *stagingBuffer);
+        cmdBuffer->end();
+
+        session->run(*cmdBuffer);
+    }
+
+    auto mappedPtr = stagingBuffer->map<uint8_t []>();
+    return std::string {reinterpret_cast<const char*>(mappedPtr.get()), stagingBuffer->getSize()};
+}
+
+bool isSameShape(const lluvia::ImageSnapshot& imageSnapshot, const ll::Image& image) {
+
+    return imageSnapshot.width() == image.getWidth()
+        && imageSnapshot.height() == image.getHeight()
+        && imageSnapshot.depth() == image.getDepth()
+        && imageSnapshot.channel_count() == static_cast<uint32_t>(image.getChannelCount())
+        && imageSnapshot.channel_type() == static_cast<uint32_t>(image.getChannelType());
+}
+
+} // namespace
+
+::mediapipe::StatusOr<lluvia::ContainerSnapshot> CaptureContainerSnapshot(const std::shared_ptr<ll::Session>& session,
+                                                                         const ll::ContainerNode& containerNode,
+                                                                         const std::vector<std::string>& portNames) {
+
+    auto snapshot = lluvia::ContainerSnapshot {};
+    snapshot.set_container_node(containerNode.getDescriptor().getBuilderName());
+
+    auto recorder = SnapshotRecorder {&snapshot};
+
+    try {
+        auto portKeys = std::set<std::pair<lluvia::SnapshotObjectType, int>> {};
+        for (const auto& name : portNames) {
+
+            auto portSnapshot = snapshot.add_ports();
+            portSnapshot->set_name(name);
+            *portSnapshot->mutable_object() = recorder.addObject(containerNode.getPort(name));
+        }
+
+        containerNode.record(recorder);
+        MP_RETURN_IF_ERROR(recorder.getStatus());
+
+        for (const auto& port : snapshot.ports()) {
+            portKeys.insert(getStorageKey(snapshot, port.object()));
+        }
+
+        // objects initialized by onNodeInit, written by the calculator otherwise
+        for (const auto& key : getObjectsReadBeforeWritten(snapshot)) {
+
+            if (portKeys.count(key) > 0) {
+                continue;
+            }
+
+            if (key.first == lluvia::SNAPSHOT_IMAGE) {
+
+                const auto& image = recorder.m_images[key.second];
+                if (!image) {
+                    return absl::UnimplementedError("content of images only referenced by transfer commands cannot be captured");
+                }
+
+                snapshot.mutable_images(key.second)->set_content(readImageContent(session, image));
+
+            } else {
+
+                const auto& buffer = recorder.m_buffers[key.second];
+                if (!buffer) {
+                    return absl::UnimplementedError("content of buffers only referenced by transfer commands cannot be captured");
+                }
+
+                snapshot.mutable_buffers(key.second)->set_content(readBufferContent(session, buffer));
+            }
+        }
+
+    } catch (std::exception& e) {
+        return absl::InternalError(absl::StrCat("error capturing container node snapshot: ", e.what()));
+    }
+
+    return snapshot;
+}
+
+std::string ReadObjectContent(const std::shared_ptr<ll::Session>& session, const std::shared_ptr<ll::Object>& object) {
+
+    if (object->getType() == ll::ObjectType::ImageView) {
+        return readImageContent(session, std::static_pointer_cast<ll::ImageView>(object)->getImage());
+    }
+
+    return readBufferContent(session, std::static_pointer_cast<ll::Buffer>(object));
+}
+
+::mediapipe::StatusOr<lluvia::ContainerSnapshot> ReadContainerSnapshot(const std::string& path) {
+
+    auto content = std::string {};
+    MP_RETURN_IF_ERROR(file::GetContents(path, &content));
+
+    auto snapshot = lluvia::ContainerSnapshot {};
+    if (!snapshot.ParseFromString(content)) {
+        return absl::DataLossError(absl::StrCat("error parsing container node snapshot: ", path));
+    }
+
+    return snapshot;
+}
+
+::mediapipe::Status WriteContainerSnapshot(const std::string& path, const lluvia::ContainerSnapshot& snapshot) {
+
+    auto content = std::string {};
+    if (!snapshot.SerializeToString(&content)) {
+        return absl::InternalError("error serializing container node snapshot");
+    }
+
+    return file::SetContents(path, content);
+}
+
+::mediapipe::StatusOr<std::unique_ptr<LluviaContainerInstance>> LluviaContainerInstance::Create(
+    const std::shared_ptr<ll::Session>& session,
+    const std::shared_ptr<ll::Memory>& deviceMemory,
+    const std::shared_ptr<ll::Memory>& hostMemory,
+    const lluvia::ContainerSnapshot& snapshot,
+    const std::map<std::string, std::shared_ptr<ll::Object>>& boundPorts) {
+
+    auto instance = std::unique_ptr<LluviaContainerInstance> {new LluviaContainerInstance {}};
+    instance->m_snapshot = snapshot;
+
+    instance->m_images.resize(snapshot.images_size());
+    instance->m_imageViews.resize(snapshot.image_views_size());
+    instance->m_buffers.resize(snapshot.buffers_size());
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Bound ports
+    for (const auto& port : snapshot.ports()) {
+
+        auto it = boundPorts.find(port.name());
+        if (it == boundPorts.end()) {
+            continue;
+        }
+
+        const auto& object = it->second;
+        const auto& ref = port.object();
+
+        if (ref.type() == lluvia::SNAPSHOT_IMAGE_VIEW && object->getType() == ll::ObjectType::ImageView) {
+
+            auto imageView = std::static_pointer_cast<ll::ImageView>(object);
+            const auto imageIndex = snapshot.image_views(ref.index()).image();
+
+            if (!isSameShape(snapshot.images(imageIndex), *imageView->getImage())) {
+                return absl::FailedPreconditionError(absl::StrCat("port ", port.name(), " shape differs from the snapshot"));
+            }
+
+            instance->m_imageViews[ref.index()] = imageView;
+            instance->m_images[imageIndex] = imageView->getImage();
+
+        } else if (ref.type() == lluvia::SNAPSHOT_BUFFER && object->getType() == ll::ObjectType::Buffer) {
+
+            auto buffer = std::static_pointer_cast<ll::Buffer>(object);
+            if (buffer->getSize() != snapshot.buffers(ref.index()).size()) {
+                return absl::FailedPreconditionError(absl::StrCat("port ", port.name(), " size differs from the snapshot"));
+            }
+
+            instance->m_buffers[ref.index()] = buffer;
+
+        } else {
+            return absl::FailedPreconditionError(absl::StrCat("port ", port.name(), " type differs from the snapshot"));
+        }
+    }
+
+    try {
+        auto uploadCmdBuffer = session->createCommandBuffer();
+        uploadCmdBuffer->begin();
+
+        // staging buffers must outlive the upload command buffer
+        auto stagingBuffers = std::vector<std::shared_ptr<ll::Buffer>> {};
+
+        const auto createStagingBuffer = [&](const std::string& content) {
+            auto stagingBuffer = hostMemory->createBuffer(content.size());
+            auto mappedPtr = stagingBuffer->map<uint8_t []>();
+            std::memcpy(mappedPtr.get(), content.data(), content.size());
+
+            stagingBuffers.push_back(stagingBuffer);
+            return stagingBuffer;
+        };
+
+        ///////////////////////////////////////////////////////////////////////////
+        // Images
+        for (auto i = 0; i < snapshot.images_size(); ++i) {
+
+            if (instance->m_images[i]) {
+                continue;
+            }
+
+            const auto& imageSnapshot = snapshot.images(i);
+            const auto imgDesc = ll::ImageDescriptor {imageSnapshot.depth(), imageSnapshot.height(), imageSnapshot.width(),
+                                                      static_cast<ll::ChannelCount>(imageSnapshot.channel_count()),
+                                                      static_cast<ll::ChannelType>(imageSnapshot.channel_type())}
+                                     .setUsageFlags(ll::ImageUsageFlags {imageSnapshot.usage_flags()});
+
+            auto image = deviceMemory->createImage(imgDesc);
+
+            if (imageSnapshot.content().empty()) {
+                uploadCmdBuffer->changeImageLayout(*image, ll::ImageLayout::General);
+            } else {
+                auto stagingBuffer = createStagingBuffer(imageSnapshot.content());
+
+                uploadCmdBuffer->changeImageLayout(*image, ll::ImageLayout::TransferDstOptimal);
+                uploadCmdBuffer->memoryBarrier();
+                uploadCmdBuffer->copyBufferToImage(*stagingBuffer, *image);
+                uploadCmdBuffer->memoryBarrier();
+                uploadCmdBuffer->changeImageLayout(*image, ll::ImageLayout::General);
+            }
+
+            instance->m_images[i] = image;
+        }
+
+        for (auto i = 0; i < snapshot.image_views_size(); ++i) {
+
+            if (instance->m_imageViews[i]) {
+                continue;
+            }
+
+            const auto& viewSnapshot = snapshot.image_views(i);
+            instance->m_imageViews[i] = instance->m_images[viewSnapshot.image()]->createImageView(
+                ll::ImageViewDescriptor {static_cast<ll::ImageAddressMode>(viewSnapshot.address_mode()),
+                                         static_cast<ll::ImageFilterMode>(viewSnapshot.filter_mode()),
+                                         viewSnapshot.normalized_coordinates(),
+                                         viewSnapshot.is_sampled()});
+        }
+
+        ///////////////////////////////////////////////////////////////////////////
+        // Buffers
+        for (auto i = 0; i < snapshot.buffers_size(); ++i) {
+
+            if (instance->m_buffers[i]) {
+                continue;
+            }
+
+            const auto& bufferSnapshot = snapshot.buffers(i);
+            auto& memory = bufferSnapshot.host_visible() ? hostMemory : deviceMemory;
+
+            auto buffer = memory->createBuffer(bufferSnapshot.size(), ll::BufferUsageFlags {bufferSnapshot.usage_flags()});
+
+            if (!bufferSnapshot.content().empty()) {
+                if (buffer->isMappable()) {
+                    auto mappedPtr = buffer->map<uint8_t []>();
+                    std::memcpy(mappedPtr.get(), bufferSnapshot.content().data(), bufferSnapshot.content().size());
+                } else {
+                    uploadCmdBuffer->copyBuffer(*createStagingBuffer(bufferSnapshot.content()), *buffer);
+                }
+            }
+
+            instance->m_buffers[i] = buffer;
+        }
+
+        // also holds the layout transitions of the images without content
+        uploadCmdBuffer->end();
+        session->run(*uploadCmdBuffer);
+
+        ///////////////////////////////////////////////////////////////////////////
+        // Compute nodes
+        for (const auto& nodeSnapshot : snapshot.compute_nodes()) {
+
+            // an empty builder name skips the Lua onNodeInit of the node
+            auto desc = ll::ComputeNodeDescriptor {}
+                .setProgram(session->getProgram(nodeSnapshot.program()))
+                .setFunctionName(nodeSnapshot.function_name())
+                .setBuilderName("")
+                .setLocalShape(ll::vec3ui {nodeSnapshot.local_x(), nodeSnapshot.local_y(), nodeSnapshot.local_z()})
+                .setGridShape(ll::vec3ui {nodeSnapshot.grid_x(), nodeSnapshot.grid_y(), nodeSnapshot.grid_z()});
+
+            for (const auto& port : nodeSnapshot.ports()) {
+                desc.addPort(ll::PortDescriptor {port.binding(), port.name(),
+                                                 static_cast<ll::PortDirection>(port.direction()),
+                                                 static_cast<ll::PortType>(port.port_type())});
+            }
+
+            // builders only push 32 bit values
+            const auto& pushConstantBytes = nodeSnapshot.push_constants();
+            auto pushConstants = ll::PushConstants {};
+            for (auto offset = size_t {0}; offset + sizeof(int32_t) <= pushConstantBytes.size(); offset += sizeof(int32_t)) {
+                auto value = int32_t {0};
+                std::memcpy(&value, pushConstantBytes.data() + offset, sizeof(int32_t));
+                pushConstants.pushInt32(value);
+            }
+            desc.setPushConstants(pushConstants);
+
+            auto node = session->createComputeNode(desc);
+            for (const auto& port : nodeSnapshot.ports()) {
+                node->bind(port.name(), instance->getObject(port.object()));
+            }
+
+            node->init();
+            instance->m_computeNodes.push_back(node);
+        }
+
+    } catch (std::exception& e) {
+        return absl::InternalError(absl::StrCat("error instantiating container node snapshot: ", e.what()));
+    }
+
+    return instance;
+}
+
+std::shared_ptr<ll::Object> LluviaContainerInstance::getPort(const std::string& name) const {
+
+    for (const auto& port : m_snapshot.ports()) {
+        if (port.name() == name) {
+            return getObject(port.object());
+        }
+    }
+
+    // same behavior as ll::ContainerNode::getPort()
+    throw std::system_error(std::error_code(), "port " + name + " not found in container node snapshot");
+}
+
+void LluviaContainerInstance::record(ll::CommandBuffer& cmdBuffer) const {
+
+    for (const auto& op : m_snapshot.record_ops()) {
+
+        switch (op.type()) {
+            case lluvia::RecordOp::RUN:
+                cmdBuffer.run(*m_computeNodes[op.node()]);
+                break;
+
+            case lluvia::RecordOp::MEMORY_BARRIER:
+                cmdBuffer.memoryBarrier();
+                break;
+
+            case lluvia::RecordOp::CHANGE_IMAGE_LAYOUT:
+                cmdBuffer.changeImageLayout(*m_images[op.destination()], static_cast<ll::ImageLayout>(op.layout()));
+                break;
+
+            case lluvia::RecordOp::COPY_BUFFER:
+                cmdBuffer.copyBuffer(*m_buffers[op.source()], *m_buffers[op.destination()]);
+                break;
+
+            case lluvia::RecordOp::COPY_BUFFER_TO_IMAGE:
+                cmdBuffer.copyBufferToImage(*m_buffers[op.source()], *m_images[op.destination()]);
+                break;
+
+            case lluvia::RecordOp::COPY_IMAGE_TO_BUFFER:
+                cmdBuffer.copyImageToBuffer(*m_images[op.source()], *m_buffers[op.destination()]);
+                break;
+
+            case lluvia::RecordOp::COPY_IMAGE_TO_IMAGE:
+                cmdBuffer.copyImageToImage(*m_images[op.source()], *m_images[op.destination()]);
+                break;
+
+            case lluvia::RecordOp::CLEAR_IMAGE:
+                cmdBuffer.clearImage(*m_images[op.destination()]);
+                break;
+        }
+    }
+}
+
+std::shared_ptr<ll::Object> LluviaContainerInstance::getObject(const lluvia::ObjectRef& ref) const {
+
+    switch (ref.type()) {
+        case lluvia::SNAPSHOT_IMAGE:
+            return m_images[ref.index()];
+        case lluvia::SNAPSHOT_IMAGE_VIEW:
+            return m_imageViews[ref.index()];
+        case lluvia::SNAPSHOT_BUFFER:
+            return m_buffers[ref.index()];
+    }
+
+    return nullptr;
+}
+
+} // namespace mediapipe
@@ -0,0 +1,90 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_CONTAINER_SNAPSHOT_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_CONTAINER_SNAPSHOT_H_
+
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_snapshot.pb.h"
+
+#include <lluvia/core.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mediapipe {
+
+/**
+ * Captures an initialized container node into a snapshot.
+ *
+ * The container node is recorded into a command buffer that only logs the
+ * commands, which yields the compute nodes, the objects they bind and the
+ * record order. Objects read before being written, other than the ports
+ * in portNames, keep their content after init.
+ *
+ * Only compute nodes and transfer commands are supported. Containers
+ * recording durations or other commands return an Unimplemented error.
+ */
+::mediapipe::StatusOr<lluvia::ContainerSnapshot> CaptureContainerSnapshot(const std::shared_ptr<ll::Session>& session,
+                                                                         const ll::ContainerNode& containerNode,
+                                                                         const std::vector<std::string>& portNames);
+
+/**
+ * Copies the content of a buffer, or of the image of an image view, to host memory.
+ */
+std::string ReadObjectContent(const std::shared_ptr<ll::Session>& session, const std::shared_ptr<ll::Object>& object);
+
+::mediapipe::StatusOr<lluvia::ContainerSnapshot> ReadContainerSnapshot(const std::string& path);
+
+::mediapipe::Status WriteContainerSnapshot(const std::string& path, const lluvia::ContainerSnapshot& snapshot);
+
+/**
+ * Container node instantiated from a snapshot without running Lua.
+ *
+ * Compute nodes are created from descriptors with an empty builder name,
+ * so only their SPIR-V programs must be loaded in the session.
+ */
+class LluviaContainerInstance {
+public:
+    /**
+     * Creates the objects and compute nodes of the snapshot.
+     *
+     * boundPorts replaces the objects of the given container ports, usually
+     * the input images. Returns a FailedPrecondition error if their shape
+     * differs from the captured one, in which case the container node must
+     * be initialized through Lua.
+     *
+     * The images and buffers are initialized by a command buffer run on the
+     * session, callers hold the lock guarding the queue of the session.
+     */
+    static ::mediapipe::StatusOr<std::unique_ptr<LluviaContainerInstance>> Create(
+        const std::shared_ptr<ll::Session>& session,
+        const std::shared_ptr<ll::Memory>& deviceMemory,
+        const std::shared_ptr<ll::Memory>& hostMemory,
+        const lluvia::ContainerSnapshot& snapshot,
+        const std::map<std::string, std::shared_ptr<ll::Object>>& boundPorts);
+
+    std::shared_ptr<ll::Object> getPort(const std::string& name) const;
+
+    void record(ll::CommandBuffer& cmdBuffer) const;
+
+    const std::vector<std::shared_ptr<ll::ComputeNode>>& getComputeNodes() const noexcept { return m_computeNodes; }
+    const lluvia::ContainerSnapshot& getSnapshot() const noexcept { return m_snapshot; }
+
+private:
+    LluviaContainerInstance() = default;
+
+    std::shared_ptr<ll::Object> getObject(const lluvia::ObjectRef& ref) const;
+
+    lluvia::ContainerSnapshot m_snapshot;
+
+    std::vector<std::shared_ptr<ll::Image>> m_images;
+    std::vector<std::shared_ptr<ll::ImageView>> m_imageViews;
+    std::vector<std::shared_ptr<ll::Buffer>> m_buffers;
+
+    std::vector<std::shared_ptr<ll::ComputeNode>> m_computeNodes;
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_CONTAINER_SNAPSHOT_H_
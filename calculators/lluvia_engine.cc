@@ -0,0 +1,180 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_engine.h"
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_trace_recorder.h"
+
+#include <lluvia/core.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace mediapipe {
+
+namespace {
+
+std::future<::mediapipe::StatusOr<LluviaEngineOutputs>> makeReadyFuture(::mediapipe::StatusOr<LluviaEngineOutputs> outputs) {
+
+    auto promise = std::promise<::mediapipe::StatusOr<LluviaEngineOutputs>> {};
+    promise.set_value(std::move(outputs));
+    return promise.get_future();
+}
+
+} // namespace
+
+::mediapipe::StatusOr<std::unique_ptr<LluviaEngine>> LluviaEngine::Create(const lluvia::LluviaCalculatorOptions& options,
+                                                                         const int maxInFlightFrames,
+                                                                         const std::string& name) {
+
+    auto trace = std::shared_ptr<LluviaTraceRecorder> {};
+    if (!options.trace_path().empty()) {
+        trace = LluviaTraceRecorder::getOrCreate(options.trace_path(), options.trace_max_events());
+    }
+
+    auto availableDevices = ll::Session::getAvailableDevices();
+    if (availableDevices.empty()) {
+        return absl::UnavailableError("no Vulkan device available");
+    }
+
+    const auto device = selectDefaultDevice(availableDevices);
+    LOG(INFO) << name << ": using device: " << device.name;
+
+    return Create(options, device, trace, maxInFlightFrames, name);
+}
+
+::mediapipe::StatusOr<std::unique_ptr<LluviaEngine>> LluviaEngine::Create(const lluvia::LluviaCalculatorOptions& options,
+                                                                         const ll::DeviceDescriptor& device,
+                                                                         const std::shared_ptr<LluviaTraceRecorder>& trace,
+                                                                         const int maxInFlightFrames,
+                                                                         const std::string& name) {
+
+    if (maxInFlightFrames <= 0) {
+        return absl::InvalidArgumentError(absl::StrCat("maxInFlightFrames must be positive, got ", maxInFlightFrames));
+    }
+
+    if (options.multi_device().device_index_size() > 0
+        || (options.tiling().tile_width() > 0 && options.tiling().tile_height() > 0)
+        || options.latency_governor().level_size() > 0) {
+        return absl::InvalidArgumentError("multi device, tiling and latency governor options are not supported by LluviaEngine");
+    }
+
+    auto context = absl::make_unique<LluviaExecutionContext>(options, name, trace);
+
+    // engines sharing a session share its queue
+    const auto gpuTrack = absl::StrCat("GPU queue ", options.session_name().empty() ? name : options.session_name());
+    MP_RETURN_IF_ERROR(context->Open(device, options.session_name(), gpuTrack));
+
+    auto frame = std::shared_ptr<LluviaFrame> {};
+    ASSIGN_OR_RETURN(frame, makeDeclaredFrame(options, 0, 0));
+
+    if (frame != nullptr) {
+        auto scope = LluviaTraceScope {trace.get(), name, "Open/warmup"};
+        MP_RETURN_IF_ERROR(context->Warmup(*frame, std::max(0, options.warmup_runs())));
+    }
+
+    auto engine = absl::WrapUnique(new LluviaEngine {options});
+    engine->m_worker = absl::make_unique<LluviaDeviceWorker>(std::move(context), maxInFlightFrames);
+    return engine;
+}
+
+LluviaEngine::LluviaEngine(const lluvia::LluviaCalculatorOptions& options) :
+    m_options {options} {
+}
+
+LluviaEngine::~LluviaEngine() {
+
+    if (m_worker) {
+        m_worker->cancel();
+    }
+}
+
+std::future<::mediapipe::StatusOr<LluviaEngineOutputs>> LluviaEngine::submit(std::map<std::string, Packet> inputs) {
+
+    for (const auto& portBinding : m_options.input_port_binding()) {
+        const auto it = inputs.find(portBinding.mediapipe_tag());
+        if (it == inputs.end() || it->second.IsEmpty()) {
+            return makeReadyFuture(absl::InvalidArgumentError(absl::StrCat("no packet for input port ", portBinding.mediapipe_tag())));
+        }
+
+        if (portBinding.packet_type() == lluvia::IMAGE_FRAME && !it->second.ValidateAsType<ImageFrame>().ok()) {
+            return makeReadyFuture(absl::InvalidArgumentError(absl::StrCat("input port ", portBinding.mediapipe_tag(), " expects an ImageFrame")));
+        }
+    }
+
+    auto frame = std::make_shared<LluviaFrame>();
+    frame->inputs = std::move(inputs);
+    frame->timestamp = Timestamp(m_frameIndex++);
+
+    auto promise = std::make_shared<std::promise<::mediapipe::StatusOr<LluviaEngineOutputs>>>();
+    auto outputs = promise->get_future();
+
+    m_worker->submit(frame, [this, frame, promise](::mediapipe::Status status) {
+
+        // the pixels of input views can be reused once the future is ready
+        frame->inputs.clear();
+
+        if (!status.ok()) {
+            promise->set_value(std::move(status));
+            return;
+        }
+
+        UpdateFrameStatistics();
+
+        auto frameOutputs = LluviaEngineOutputs {};
+        for (auto& [tag, packet] : frame->outputs) {
+            frameOutputs[*tag] = std::move(packet);
+        }
+
+        promise->set_value(std::move(frameOutputs));
+    });
+
+    return outputs;
+}
+
+std::future<::mediapipe::StatusOr<LluviaEngineOutputs>> LluviaEngine::submit(const std::map<std::string, LluviaImageView>& images) {
+
+    auto inputs = std::map<std::string, Packet> {};
+
+    for (const auto& [tag, view] : images) {
+
+        const auto widthStep = view.widthStep > 0 ? view.widthStep
+                                                  : view.width * ImageFrame::NumberOfChannelsForFormat(view.format)
+                                                    * ImageFrame::ByteDepthForFormat(view.format);
+
+        // the caller owns the pixels, the engine only reads them
+        auto image = absl::make_unique<ImageFrame>(view.format, view.width, view.height, widthStep,
+                                                   const_cast<uint8_t*>(view.pixels), [](uint8_t*) {});
+
+        inputs[tag] = Adopt(image.release());
+    }
+
+    return submit(std::move(inputs));
+}
+
+::mediapipe::Status LluviaEngine::ProcessFrame(LluviaFrame& frame) {
+
+    // the worker thread uses the context while frames are queued
+    RET_CHECK(m_worker->getQueuedFrames() == 0) << "ProcessFrame() called with submitted frames in flight";
+    MP_RETURN_IF_ERROR(m_worker->getContext().ProcessFrame(frame));
+
+    UpdateFrameStatistics();
+    return ::mediapipe::OkStatus();
+}
+
+void LluviaEngine::UpdateFrameStatistics() {
+
+    const auto& context = m_worker->getContext();
+    m_gpuDuration.store(context.getGpuDuration().count());
+    m_transferBytes.store(context.getTransferBytes());
+}
+
+void LluviaEngine::cancel() {
+    m_worker->cancel();
+}
+
+} // namespace mediapipe
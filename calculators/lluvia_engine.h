@@ -0,0 +1,142 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_ENGINE_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_ENGINE_H_
+
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_execution_context.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_trace_recorder.h"
+
+#include <lluvia/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace mediapipe {
+
+/**
+ * Pixels of an input image owned by the caller, read without copy until the
+ * future of the frame is ready.
+ */
+struct LluviaImageView {
+    const uint8_t* pixels {nullptr};
+    int width {0};
+    int height {0};
+
+    // bytes between rows, 0 if the rows are not padded
+    int widthStep {0};
+
+    ImageFormat::Format format {ImageFormat::SRGBA};
+};
+
+// Output packets of a frame by the mediapipe_tag of their port binding.
+using LluviaEngineOutputs = std::map<std::string, Packet>;
+
+/**
+ * Runs the container node of a LluviaCalculatorOptions on one device, with
+ * the port bindings, staging buffers, command buffers and readbacks of
+ * LluviaCalculator, whose single device mode runs on an engine.
+ *
+ * Submitted frames are processed in submission order on the LluviaDeviceWorker
+ * of the engine. Inputs and outputs are keyed by the mediapipe_tag of their
+ * port bindings, with the packet types of the bindings, and region of
+ * interest packets by their roi_tag. Output ImageFrames use the pooled pixels
+ * of the calculator, reused once the caller releases them.
+ *
+ * Multi device, tiling and latency governor options are not supported, they
+ * run several engines or execution contexts, see LluviaCalculator.
+ */
+class LluviaEngine {
+public:
+    /**
+     * Opens the session on the default device and, if the input ports
+     * declare their shapes, initializes the container node and runs the
+     * warm-up frames. The trace is recorded to trace_path if set.
+     *
+     * maxInFlightFrames bounds the frames submitted and not finished yet.
+     * name identifies the engine in logs and traces.
+     */
+    static ::mediapipe::StatusOr<std::unique_ptr<LluviaEngine>> Create(const lluvia::LluviaCalculatorOptions& options,
+                                                                      const int maxInFlightFrames = 2,
+                                                                      const std::string& name = "LluviaEngine");
+
+    /**
+     * Create() on device, recording to trace, which can be null.
+     */
+    static ::mediapipe::StatusOr<std::unique_ptr<LluviaEngine>> Create(const lluvia::LluviaCalculatorOptions& options,
+                                                                      const ll::DeviceDescriptor& device,
+                                                                      const std::shared_ptr<LluviaTraceRecorder>& trace,
+                                                                      const int maxInFlightFrames,
+                                                                      const std::string& name);
+
+    // cancels the frames not started and waits for the running one
+    ~LluviaEngine();
+
+    LluviaEngine(const LluviaEngine&) = delete;
+    LluviaEngine& operator=(const LluviaEngine&) = delete;
+
+    /**
+     * Queues a frame, blocking while maxInFlightFrames frames are in flight.
+     *
+     * The future holds the outputs of the frame, an InvalidArgument error if
+     * an input port has no packet, or a Cancelled error if cancel() was
+     * called before the frame started.
+     */
+    std::future<::mediapipe::StatusOr<LluviaEngineOutputs>> submit(std::map<std::string, Packet> inputs);
+
+    // submit() with an IMAGE_FRAME input per tag wrapping the caller pixels
+    std::future<::mediapipe::StatusOr<LluviaEngineOutputs>> submit(const std::map<std::string, LluviaImageView>& images);
+
+    /**
+     * Runs frame on the calling thread and adds its outputs, for callers
+     * reusing their frames such as LluviaCalculator. Fails while submitted
+     * frames are in flight.
+     */
+    ::mediapipe::Status ProcessFrame(LluviaFrame& frame);
+
+    /**
+     * Cancels the frames queued and not started yet. The running frame
+     * finishes, and the engine accepts new frames afterwards.
+     */
+    void cancel();
+
+    // frames submitted and not finished yet
+    int getInFlightFrames() const noexcept { return m_worker->getQueuedFrames(); }
+
+    // GPU time of the last finished frame, see LluviaExecutionContext::getGpuDuration()
+    std::chrono::nanoseconds getGpuDuration() const noexcept { return std::chrono::nanoseconds {m_gpuDuration.load()}; }
+
+    // bytes copied on the device for the last finished frame, see LluviaExecutionContext::getTransferBytes()
+    uint64_t getTransferBytes() const noexcept { return m_transferBytes.load(); }
+
+private:
+    explicit LluviaEngine(const lluvia::LluviaCalculatorOptions& options);
+
+    // copies the statistics of the frame the context just finished, on the
+    // thread that ran it, as the context is not read while frames run
+    void UpdateFrameStatistics();
+
+    const lluvia::LluviaCalculatorOptions m_options;
+
+    // set by UpdateFrameStatistics(), before m_worker so that they outlive
+    // the frames it finishes while destroyed
+    std::atomic<int64_t> m_gpuDuration {0};
+    std::atomic<uint64_t> m_transferBytes {0};
+
+    std::unique_ptr<LluviaDeviceWorker> m_worker {};
+
+    // timestamps only order the output packets of the engine
+    std::atomic<int64_t> m_frameIndex {0};
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_ENGINE_H_
@@ -0,0 +1,235 @@
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+#include "tools/cpp/runfiles/runfiles.h"
+using bazel::tools::cpp::runfiles::Runfiles;
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_engine.h"
+
+#include <cstring>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace mediapipe {
+
+namespace {
+
+constexpr auto kWidth = 64;
+constexpr auto kHeight = 32;
+
+// Passthrough container node from a declared 64x32 GRAY8 input to an IMAGE_FRAME output.
+lluvia::LluviaCalculatorOptions GetPassthroughOptions() {
+
+    auto runfiles = std::unique_ptr<Runfiles> {Runfiles::CreateForTest(nullptr)};
+
+    auto libraryPath = runfiles->Rlocation("lluvia/lluvia/nodes/lluvia_node_library.zip");
+    auto calculatorScriptPath = runfiles->Rlocation("mediapipe/mediapipe/lluvia-mediapipe/calculators/test_data/PassthroughContainerNode.lua");
+
+    return ParseTextProtoOrDie<lluvia::LluviaCalculatorOptions>(absl::Substitute(R"pb(
+        enable_debug: true
+        container_node: "mediapipe/test/PassthroughContainerNode"
+        library_path: "$0"
+        script_path: "$1"
+
+        input_port_binding:  {
+            mediapipe_tag: "IN_0"
+            lluvia_port: "in_image_0"
+            packet_type: IMAGE_FRAME
+            width: $2
+            height: $3
+            format: GRAY8
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "OUT_0"
+            lluvia_port: "out_image_0"
+            packet_type: IMAGE_FRAME
+        }
+    )pb", libraryPath, calculatorScriptPath, kWidth, kHeight));
+}
+
+TEST(LluviaEngineTest, TestSubmit) {
+
+    ASSERT_OK_AND_ASSIGN(auto engine, LluviaEngine::Create(GetPassthroughOptions(), 3));
+
+    constexpr auto frameCount = 8;
+
+    // one buffer per frame, alive until its future is ready
+    auto pixels = std::vector<std::vector<uint8_t>> {};
+    auto futures = std::vector<std::future<::mediapipe::StatusOr<LluviaEngineOutputs>>> {};
+
+    for (auto t = 0; t < frameCount; ++t) {
+        pixels.emplace_back(kWidth * kHeight, static_cast<uint8_t>(t + 1));
+
+        futures.push_back(engine->submit(std::map<std::string, LluviaImageView> {
+            {"IN_0", LluviaImageView {pixels.back().data(), kWidth, kHeight, 0, ImageFormat::GRAY8}}}));
+
+        EXPECT_LE(engine->getInFlightFrames(), 3);
+    }
+
+    for (auto t = 0; t < frameCount; ++t) {
+
+        ASSERT_OK_AND_ASSIGN(auto outputs, futures[t].get());
+        ASSERT_EQ(outputs.count("OUT_0"), 1);
+
+        const auto& image = outputs["OUT_0"].Get<ImageFrame>();
+        ASSERT_EQ(image.Width(), kWidth);
+        ASSERT_EQ(image.Height(), kHeight);
+        EXPECT_EQ(image.PixelData()[0], t + 1);
+        EXPECT_EQ(image.PixelData()[(kHeight - 1) * image.WidthStep() + kWidth - 1], t + 1);
+    }
+
+    EXPECT_EQ(engine->getInFlightFrames(), 0);
+}
+
+TEST(LluviaEngineTest, TestCancel) {
+
+    ASSERT_OK_AND_ASSIGN(auto engine, LluviaEngine::Create(GetPassthroughOptions(), 16));
+
+    auto pixels = std::vector<uint8_t>(kWidth * kHeight, 7);
+    const auto inputs = std::map<std::string, LluviaImageView> {
+        {"IN_0", LluviaImageView {pixels.data(), kWidth, kHeight, 0, ImageFormat::GRAY8}}};
+
+    auto futures = std::vector<std::future<::mediapipe::StatusOr<LluviaEngineOutputs>>> {};
+    for (auto t = 0; t < 16; ++t) {
+        futures.push_back(engine->submit(inputs));
+    }
+
+    engine->cancel();
+
+    // every frame either ran or was cancelled before it started
+    for (auto& future : futures) {
+        const auto outputs = future.get();
+        if (!outputs.ok()) {
+            EXPECT_EQ(outputs.status().code(), absl::StatusCode::kCancelled);
+        }
+    }
+
+    EXPECT_EQ(engine->getInFlightFrames(), 0);
+
+    // the engine accepts frames after a cancellation
+    ASSERT_OK_AND_ASSIGN(auto outputs, engine->submit(inputs).get());
+    EXPECT_EQ(outputs["OUT_0"].Get<ImageFrame>().PixelData()[0], 7);
+}
+
+TEST(LluviaEngineTest, TestProcessFrame) {
+
+    ASSERT_OK_AND_ASSIGN(auto engine, LluviaEngine::Create(GetPassthroughOptions()));
+
+    // the frame is reused as LluviaCalculator does
+    auto frame = LluviaFrame {};
+
+    for (auto t = 0; t < 3; ++t) {
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, kWidth, kHeight);
+        std::memset(inputImage->MutablePixelData(), t + 1, inputImage->PixelDataSize());
+
+        frame.timestamp = Timestamp(t);
+        frame.inputs["IN_0"] = Adopt(inputImage.release());
+        frame.outputs.clear();
+
+        MP_ASSERT_OK(engine->ProcessFrame(frame));
+
+        ASSERT_EQ(frame.outputs.size(), 1);
+        EXPECT_EQ(*frame.outputs[0].first, "OUT_0");
+        EXPECT_EQ(frame.outputs[0].second.Timestamp(), Timestamp(t));
+        EXPECT_EQ(frame.outputs[0].second.Get<ImageFrame>().PixelData()[0], t + 1);
+    }
+}
+
+TEST(LluviaEngineTest, TestRegionOfInterestTransfer) {
+
+    constexpr auto width = 256;
+    constexpr auto height = 128;
+
+    auto runfiles = std::unique_ptr<Runfiles> {Runfiles::CreateForTest(nullptr)};
+
+    // the region nodes are in lluvia_mediapipe_library
+    auto options = GetPassthroughOptions();
+    options.add_library_path(runfiles->Rlocation("mediapipe/mediapipe/lluvia-mediapipe/calculators/lluvia_mediapipe_library.zip"));
+    options.mutable_input_port_binding(0)->set_width(width);
+    options.mutable_input_port_binding(0)->set_height(height);
+    options.mutable_input_port_binding(0)->set_roi_tag("ROI");
+    options.mutable_output_port_binding(0)->set_roi_tag("ROI");
+
+    ASSERT_OK_AND_ASSIGN(auto engine, LluviaEngine::Create(options));
+
+    // pixels [90, 110) x [45, 55), rounded out to [64, 128) x [32, 64)
+    auto roi = Rect {};
+    roi.set_x_center(100);
+    roi.set_y_center(50);
+    roi.set_width(20);
+    roi.set_height(10);
+
+    auto frame = LluviaFrame {};
+
+    // only the frame at timestamp 1 has a region
+    for (auto t = 0; t < 3; ++t) {
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, width, height);
+        std::memset(inputImage->MutablePixelData(), t + 1, inputImage->PixelDataSize());
+
+        frame.timestamp = Timestamp(t);
+        frame.inputs["IN_0"] = Adopt(inputImage.release());
+        frame.inputs.erase("ROI");
+        if (t == 1) {
+            frame.inputs["ROI"] = MakePacket<Rect>(roi);
+        }
+        frame.outputs.clear();
+
+        MP_ASSERT_OK(engine->ProcessFrame(frame));
+        ASSERT_EQ(frame.outputs.size(), 1);
+
+        const auto& outImage = frame.outputs[0].second.Get<ImageFrame>();
+
+        if (t != 1) {
+            // the input and output images are copied whole
+            EXPECT_EQ(engine->getTransferBytes(), static_cast<uint64_t>(2 * width * height));
+            ASSERT_EQ(outImage.Width(), width);
+            ASSERT_EQ(outImage.Height(), height);
+            continue;
+        }
+
+        // only the rounded regions of the input and output images are copied
+        EXPECT_EQ(engine->getTransferBytes(), static_cast<uint64_t>(2 * 64 * 32));
+        ASSERT_EQ(outImage.Width(), 20);
+        ASSERT_EQ(outImage.Height(), 10);
+
+        for (auto y = 0; y < outImage.Height(); ++y) {
+            for (auto x = 0; x < outImage.Width(); ++x) {
+                ASSERT_EQ(outImage.PixelData()[y * outImage.WidthStep() + x], 2);
+            }
+        }
+    }
+}
+
+TEST(LluviaEngineTest, TestMissingInput) {
+
+    ASSERT_OK_AND_ASSIGN(auto engine, LluviaEngine::Create(GetPassthroughOptions()));
+
+    const auto outputs = engine->submit(std::map<std::string, Packet> {}).get();
+    EXPECT_EQ(outputs.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+TEST(LluviaEngineTest, TestUnsupportedOptions) {
+
+    auto options = GetPassthroughOptions();
+    options.mutable_tiling()->set_tile_width(16);
+    options.mutable_tiling()->set_tile_height(16);
+
+    EXPECT_FALSE(LluviaEngine::Create(options).ok());
+    EXPECT_FALSE(LluviaEngine::Create(GetPassthroughOptions(), 0).ok());
+}
+
+} // namespace
+
+} // namespace mediapipe
@@ -0,0 +1,2056 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_execution_context.h"
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/formats/matrix.h"
+#include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/gpu/gpu_buffer.h"
+#include "mediapipe/util/resource_util.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_packed_image.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_session_registry.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_workgroup_tuner.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <set>
+
+namespace mediapipe {
+
+namespace {
+
+// Row stride of ImageFrames allocated by the calculator, aligned as ImageFrame does.
+int getAlignedWidthStep(const int width, const int pixelBytes) {
+    const auto alignment = static_cast<int>(ImageFrame::kDefaultAlignmentBoundary);
+    return (width * pixelBytes + alignment - 1) / alignment * alignment;
+}
+
+// True once every copy of packet emitted downstream is released, so that
+// its data can be written again.
+bool isReleased(const Packet& packet) {
+
+    if (packet_internal::GetHolderShared(packet).use_count() != 1) {
+        return false;
+    }
+
+    // the writes that follow happen after the reads of the released copies
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+// Source channel index of each swizzle letter, 8 bits per channel, the first letter in the lowest byte.
+::mediapipe::StatusOr<uint32_t> getSwizzleBits(const std::string& swizzle, const size_t channelCount) {
+
+    const auto channelNames = std::string {"rgba"};
+
+    if (swizzle.empty() || swizzle.size() > 4) {
+        return absl::InvalidArgumentError(absl::StrCat("swizzle must have 1 to 4 channels, got: ", swizzle));
+    }
+
+    auto swizzleBits = uint32_t {0};
+    for (auto i = size_t {0}; i < swizzle.size(); ++i) {
+
+        const auto channel = channelNames.find(swizzle[i]);
+        if (channel == std::string::npos || channel >= channelCount) {
+            return absl::InvalidArgumentError(absl::StrCat("invalid swizzle ", swizzle, " for image with ", channelCount, " channels"));
+        }
+
+        swizzleBits |= static_cast<uint32_t>(channel) << (8 * i);
+    }
+
+    return swizzleBits;
+}
+
+// pixels reduced by each invocation of the ReduceTile nodes
+constexpr int reducePixelsPerInvocation = 64;
+
+// Regions of interest are rounded out to multiples of regionAlignment pixels,
+// so that a region moving by a few pixels reuses its command buffers.
+constexpr int regionAlignment = 32;
+
+// region variants of the command buffers kept per image pool slot
+constexpr size_t maxRegionCommands = 8;
+
+// Bytes per channel of the images the region nodes copy, 0 for the others.
+// The nodes write without a format qualifier, 3 channel images are left out
+// as few devices support them as storage images.
+int getRegionChannelBytes(const ll::Image& image) {
+
+    if (image.getChannelCount() == ll::ChannelCount::C3) {
+        return 0;
+    }
+
+    switch (image.getChannelType()) {
+        case ll::ChannelType::Uint8: return 1;
+        case ll::ChannelType::Uint16: return 2;
+        case ll::ChannelType::Float32: return 4;
+        default: return 0;
+    }
+}
+
+PixelRect alignRegion(const PixelRect& rect, const int width, const int height) {
+
+    if (rect.width == 0 || rect.height == 0) {
+        return PixelRect {};
+    }
+
+    const auto x0 = rect.x / regionAlignment * regionAlignment;
+    const auto y0 = rect.y / regionAlignment * regionAlignment;
+    const auto x1 = std::min(width, (rect.x + rect.width + regionAlignment - 1) / regionAlignment * regionAlignment);
+    const auto y1 = std::min(height, (rect.y + rect.height + regionAlignment - 1) / regionAlignment * regionAlignment);
+
+    return PixelRect {x0, y0, x1 - x0, y1 - y0};
+}
+
+bool isWholeImage(const PixelRect& region, const ll::Image& image) {
+    return region == PixelRect {0, 0, static_cast<int>(image.getWidth()), static_cast<int>(image.getHeight())};
+}
+
+// region of handler recorded in command, null if the whole image is copied
+const PixelRect* getRecordedRegion(const RecordedCommand& command, const PortHandler& handler) {
+
+    if (handler.regionIndex < 0 || command.regions.empty()) {
+        return nullptr;
+    }
+
+    const auto& region = command.regions[handler.regionIndex];
+    return isWholeImage(region, *handler.image) ? nullptr : &region;
+}
+
+uint64_t getRegionBytes(const PortHandler& handler, const PixelRect* region) {
+
+    const auto width = region ? region->width : static_cast<int>(handler.image->getWidth());
+    const auto height = region ? region->height : static_cast<int>(handler.image->getHeight());
+    return static_cast<uint64_t>(width) * height * handler.pixelBytes;
+}
+
+// Deterministic values varying along rows, columns and channels, so that
+// workgroup tuning candidates skipping or repeating pixels change the
+// outputs. Float values stay finite and in [0, 1).
+void fillPattern(ImageFrame& image) {
+
+    const auto rowValues = image.Width() * image.NumberOfChannels();
+
+    for (auto y = 0; y < image.Height(); ++y) {
+
+        auto* row = image.MutablePixelData() + y * image.WidthStep();
+
+        for (auto i = 0; i < rowValues; ++i) {
+
+            const auto value = (i * 7 + y * 13) % 251;
+
+            switch (image.ByteDepth()) {
+                case 1: row[i] = static_cast<uint8_t>(value); break;
+                case 2: reinterpret_cast<uint16_t*>(row)[i] = static_cast<uint16_t>(value); break;
+                default: reinterpret_cast<float*>(row)[i] = static_cast<float>(value) / 251.0f; break;
+            }
+        }
+    }
+}
+
+} // namespace
+
+ll::DeviceDescriptor selectDefaultDevice(const std::vector<ll::DeviceDescriptor>& devices) {
+
+    auto selectedDevice = devices[0];
+
+    for (const auto& desc : devices) {
+        if (desc.deviceType == ll::DeviceType::DiscreteGPU) {
+            selectedDevice = desc;
+        }
+    }
+
+    return selectedDevice;
+}
+
+std::tuple<bool, ll::ChannelCount, ll::ChannelType> getLluviaImageFormat(const mediapipe::ImageFormat_Format format) {
+
+    switch(format) {
+
+        case ImageFormat_Format_SRGB:
+            return std::make_tuple(true, ll::ChannelCount::C3, ll::ChannelType::Uint8);
+
+        case ImageFormat_Format_SRGBA:
+            return std::make_tuple(true, ll::ChannelCount::C4, ll::ChannelType::Uint8);
+
+        case ImageFormat_Format_SBGRA:
+            return std::make_tuple(true, ll::ChannelCount::C4, ll::ChannelType::Uint8);
+
+        case ImageFormat_Format_GRAY8:
+            return std::make_tuple(true, ll::ChannelCount::C1, ll::ChannelType::Uint8);
+
+        case ImageFormat_Format_GRAY16:
+            return std::make_tuple(true, ll::ChannelCount::C1, ll::ChannelType::Uint16);
+
+        case ImageFormat_Format_SRGBA64:
+            return std::make_tuple(true, ll::ChannelCount::C4, ll::ChannelType::Uint64);
+
+        case ImageFormat_Format_VEC32F1:
+            return std::make_tuple(true, ll::ChannelCount::C1, ll::ChannelType::Float32);
+
+        case ImageFormat_Format_VEC32F2:
+            return std::make_tuple(true, ll::ChannelCount::C2, ll::ChannelType::Float32);
+
+        default:
+            return std::make_tuple(false, ll::ChannelCount::C1, ll::ChannelType::Uint8);
+    }
+}
+
+std::tuple<bool, mediapipe::ImageFormat_Format> getMediapipeImageFormat(const ll::ChannelCount channelCount, const ll::ChannelType channelType) {
+
+    switch(channelCount) {
+
+        case ll::ChannelCount::C1:
+            switch (channelType) {
+            case ll::ChannelType::Uint8:
+                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_GRAY8);
+            case ll::ChannelType::Uint16:
+                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_GRAY16);
+            case ll::ChannelType::Float32:
+                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_VEC32F1);
+            default:
+                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
+            }
+
+        case ll::ChannelCount::C2:
+            switch (channelType) {
+            case ll::ChannelType::Float32:
+                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_VEC32F2);
+            default:
+                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
+            }
+
+        case ll::ChannelCount::C3:
+            switch (channelType) {
+            case ll::ChannelType::Uint8:
+                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_SRGB);
+            default:
+                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
+            }
+
+        case ll::ChannelCount::C4:
+            switch (channelType) {
+            case ll::ChannelType::Uint8:
+                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_SRGBA);
+            case ll::ChannelType::Uint64:
+                return std::make_tuple(true, ::mediapipe::ImageFormat_Format_SRGBA64);
+            default:
+                return std::make_tuple(false, ::mediapipe::ImageFormat_Format_UNKNOWN);
+            }
+    }
+}
+
+bool isVectorPacketType(const lluvia::MediapipePacketType packetType) {
+    return packetType == lluvia::FLOAT_VECTOR || packetType == lluvia::MATRIX;
+}
+
+google::protobuf::RepeatedPtrField<lluvia::PortBinding> getOutputPortBindings(const lluvia::LluviaCalculatorOptions& options) {
+
+    auto portBindings = options.output_port_binding();
+    for (const auto& container : options.additional_container()) {
+        portBindings.MergeFrom(container.output_port_binding());
+    }
+
+    return portBindings;
+}
+
+::mediapipe::StatusOr<std::shared_ptr<LluviaFrame>> makeDeclaredFrame(const lluvia::LluviaCalculatorOptions& options, const int width, const int height) {
+
+    const auto& portBindings = options.input_port_binding();
+    const auto declared = std::any_of(portBindings.begin(), portBindings.end(), [](const auto& portBinding) {
+        return portBinding.width() > 0 || portBinding.height() > 0;
+    });
+
+    if (!declared) {
+        return std::shared_ptr<LluviaFrame> {};
+    }
+
+    auto frame = std::make_shared<LluviaFrame>();
+
+    for (const auto& portBinding : portBindings) {
+        if (portBinding.packet_type() != lluvia::IMAGE_FRAME || portBinding.width() <= 0 || portBinding.height() <= 0) {
+            return absl::InvalidArgumentError(absl::StrCat("port ", portBinding.mediapipe_tag(),
+                ": eager initialization requires every input port to be an IMAGE_FRAME with declared width and height"));
+        }
+
+        auto image = absl::make_unique<ImageFrame>(portBinding.format(),
+                                                   width > 0 ? width : portBinding.width(),
+                                                   height > 0 ? height : portBinding.height());
+        fillPattern(*image);
+
+        frame->inputs[portBinding.mediapipe_tag()] = Adopt(image.release());
+    }
+
+    return frame;
+}
+
+LluviaDeviceWorker::LluviaDeviceWorker(std::unique_ptr<LluviaExecutionContext> context, const int maxQueuedFrames) :
+    m_context {std::move(context)},
+    m_maxQueuedFrames {maxQueuedFrames},
+    m_thread {&LluviaDeviceWorker::run, this} {
+}
+
+LluviaDeviceWorker::~LluviaDeviceWorker() {
+
+    {
+        auto guard = std::lock_guard {m_mutex};
+        m_stop = true;
+    }
+
+    m_taskCondition.notify_one();
+    m_thread.join();
+}
+
+std::shared_future<::mediapipe::Status> LluviaDeviceWorker::submit(const std::shared_ptr<LluviaFrame>& frame) {
+
+    auto promise = std::make_shared<std::promise<::mediapipe::Status>>();
+    auto status = promise->get_future().share();
+
+    submit(frame, [promise](::mediapipe::Status frameStatus) {
+        promise->set_value(std::move(frameStatus));
+    });
+
+    return status;
+}
+
+void LluviaDeviceWorker::submit(const std::shared_ptr<LluviaFrame>& frame, DoneCallback done) {
+
+    {
+        auto lock = std::unique_lock {m_mutex};
+        m_slotCondition.wait(lock, [this]() { return m_maxQueuedFrames <= 0 || m_queuedFrames.load() < m_maxQueuedFrames; });
+
+        m_tasks.push_back(Task {frame, std::move(done)});
+        ++m_queuedFrames;
+    }
+
+    m_taskCondition.notify_one();
+}
+
+void LluviaDeviceWorker::cancel() {
+
+    auto cancelled = std::deque<Task> {};
+
+    {
+        auto guard = std::lock_guard {m_mutex};
+        cancelled.swap(m_tasks);
+        m_queuedFrames -= static_cast<int>(cancelled.size());
+    }
+
+    m_slotCondition.notify_all();
+
+    for (auto& task : cancelled) {
+        task.done(absl::CancelledError("frame cancelled before it started"));
+    }
+}
+
+void LluviaDeviceWorker::run() {
+
+    while (true) {
+
+        auto task = Task {};
+        {
+            auto lock = std::unique_lock {m_mutex};
+            m_taskCondition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+
+            // pending tasks are finished before stopping
+            if (m_tasks.empty()) {
+                return;
+            }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        auto status = m_context->ProcessFrame(*task.frame);
+
+        // the frame no longer counts once done runs, so done can submit the next one
+        {
+            auto guard = std::lock_guard {m_mutex};
+            --m_queuedFrames;
+        }
+
+        m_slotCondition.notify_one();
+        task.done(std::move(status));
+    }
+}
+
+LluviaExecutionContext::LluviaExecutionContext(const lluvia::LluviaCalculatorOptions& options, const std::string& nodeName, const std::shared_ptr<LluviaTraceRecorder>& trace) :
+    m_options {options},
+    m_trace {trace},
+    m_nodeName {nodeName} {
+}
+
+::mediapipe::Status LluviaExecutionContext::Open(const ll::DeviceDescriptor& device, const std::string& sessionName, const std::string& gpuTrack) {
+
+    if (m_options.workgroup_tuning().enabled() && m_options.workgroup_tuning().max_invocations() <= 0) {
+        return absl::InvalidArgumentError(absl::StrCat("workgroup_tuning.max_invocations must be positive, got ",
+                                                       m_options.workgroup_tuning().max_invocations()));
+    }
+
+    // TODO: options for creating the session
+    // - device type
+    auto sessionDescriptor = ll::SessionDescriptor()
+        .setDeviceDescriptor(device)
+        .enableDebug(m_options.enable_debug());
+
+    {
+        auto scope = LluviaTraceScope {m_trace.get(), m_nodeName, "Open/create_session"};
+
+        auto sessionHandle = LluviaSessionRegistry::getOrCreate(sessionName, m_options.submission_thread(), [&sessionDescriptor]() {
+            return ll::Session::create(sessionDescriptor);
+        });
+
+        m_session = sessionHandle.session;
+        m_runMutex = sessionHandle.runMutex;
+        m_submissionQueue = sessionHandle.submissionQueue;
+    }
+
+    m_hostCopy = LluviaHostCopyEngine::getShared(std::max(1, m_options.host_copy_threads()));
+
+    m_device = device;
+    m_gpuTrack = gpuTrack;
+
+    const ll::MemoryPropertyFlags unifiedMemoryProperties = ll::MemoryPropertyFlagBits::DeviceLocal
+                                                            | ll::MemoryPropertyFlagBits::HostCoherent
+                                                            | ll::MemoryPropertyFlagBits::HostVisible;
+    auto unifiedMemorySupported = false;
+
+    // print available memory flags
+    for (const auto& memFlags : m_session->getSupportedMemoryFlags()) {
+        auto flags = std::string {};
+        for (const auto& f : ll::memoryPropertyFlagsToVectorString(memFlags)) {
+            flags = flags + f +  ", ";
+        }
+        LOG(INFO) << "memory flags: " << flags;
+
+        unifiedMemorySupported = unifiedMemorySupported || (memFlags & unifiedMemoryProperties) == unifiedMemoryProperties;
+    }
+
+    switch (m_options.memory_mode()) {
+        case lluvia::LluviaCalculatorOptions::UNIFIED:
+            if (!unifiedMemorySupported) {
+                return absl::FailedPreconditionError(absl::StrCat("device ", device.name, " has no device local and host visible memory"));
+            }
+            m_unifiedMemory = true;
+            break;
+        case lluvia::LluviaCalculatorOptions::STAGING:
+            m_unifiedMemory = false;
+            break;
+        default:
+            // discrete GPUs also expose a small device local, host visible
+            // heap, which is slow to read from the host
+            m_unifiedMemory = unifiedMemorySupported
+                && (device.deviceType == ll::DeviceType::IntegratedGPU || device.deviceType == ll::DeviceType::CPU);
+    }
+
+    LOG(INFO) << "unified memory: " << m_unifiedMemory;
+    
+    auto deviceMemoryProperties = ll::MemoryPropertyFlagBits::DeviceLocal;
+    m_deviceMemory = m_session->createMemory(deviceMemoryProperties, 32 * 1024 * 1024, false);
+
+    if (m_unifiedMemory) {
+        m_hostMemory = m_session->createMemory(unifiedMemoryProperties, 0, true);
+    } else {
+        m_hostMemory = m_session->getHostMemory();
+    }
+
+
+    
+
+    // load all supplied libraries to the session
+    auto librariesScope = absl::make_unique<LluviaTraceScope>(m_trace.get(), m_nodeName, "Open/load_libraries");
+    for (auto i = 0; i < m_options.library_path_size(); ++i) {
+        
+        auto libraryPath = std::string {};
+
+        #ifdef __ANDROID__
+            ASSIGN_OR_RETURN(libraryPath, mediapipe::PathToResourceAsFile(m_options.library_path(i)));
+        #else
+            libraryPath = m_options.library_path(i);
+        #endif
+
+        LOG(INFO) << "library path: " << libraryPath;
+        m_session->loadLibrary(libraryPath);
+    }
+    librariesScope.reset();
+
+    // scripts are not needed if the container node is instantiated from a snapshot
+    if (!m_options.snapshot_path().empty() && m_options.snapshot_mode() == lluvia::LluviaCalculatorOptions::LOAD) {
+
+        auto snapshotPath = m_options.snapshot_path();
+
+        // a snapshot missing from the assets is captured after init as on other platforms
+        #ifdef __ANDROID__
+            auto resourcePath = mediapipe::PathToResourceAsFile(snapshotPath);
+            if (resourcePath.ok()) {
+                snapshotPath = std::move(resourcePath).value();
+            }
+        #endif
+
+        auto snapshot = ReadContainerSnapshot(snapshotPath);
+
+        if (snapshot.ok() && snapshot.value().container_node() == m_options.container_node()) {
+            LOG(INFO) << "snapshot path: " << snapshotPath;
+            m_snapshot = absl::make_unique<lluvia::ContainerSnapshot>(std::move(snapshot).value());
+        } else {
+            LOG(INFO) << "snapshot not available, it will be captured after init: " << m_options.snapshot_path();
+        }
+    }
+
+    if (!m_snapshot) {
+        MP_RETURN_IF_ERROR(LoadScripts());
+    }
+
+    // LOG(INFO) << "libraries and scripts loaded, enumerating available nodes";
+    // for (const auto& desc : m_session->getNodeBuilderDescriptors()) {
+    //     LOG(INFO) << "" << desc.name;
+    // }
+
+    LOG(INFO) << "Open(): finish";
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::LoadScripts() {
+
+    if (m_scriptsLoaded) {
+        return ::mediapipe::OkStatus();
+    }
+
+    auto scope = LluviaTraceScope {m_trace.get(), m_nodeName, "LoadScripts"};
+
+    // execute all the scripts in the session
+    for (auto i = 0; i < m_options.script_path_size(); ++i) {
+        
+        auto scriptPath = std::string {};
+        
+        #ifdef __ANDROID__
+            ASSIGN_OR_RETURN(scriptPath, mediapipe::PathToResourceAsFile(m_options.script_path(i)));
+        #else
+            scriptPath = m_options.script_path(i);
+        #endif
+        
+        LOG(INFO) << "script path: " << scriptPath;
+        m_session->scriptFile(scriptPath);
+    }
+
+    m_scriptsLoaded = true;
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitNode(LluviaFrame& frame) {
+
+    LOG(INFO) << "InitNode(): start";
+    auto initScope = LluviaTraceScope {m_trace.get(), m_nodeName, "InitNode"};
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Input bindings
+    LOG(INFO) << "InitNode(): creating input port bindings";
+    auto phaseScope = absl::make_unique<LluviaTraceScope>(m_trace.get(), m_nodeName, "InitNode/inputs");
+    for (auto i = 0; i < m_options.input_port_binding_size(); ++i) {
+        
+        const auto& portBinding = m_options.input_port_binding(i);
+
+        if (portBinding.packet_type() == lluvia::IMAGE_FRAME) {
+            MP_RETURN_IF_ERROR(InitInputPortAsImageFrame(portBinding, frame));
+        }
+        else if (portBinding.packet_type() == lluvia::GPU_BUFFER) {
+            MP_RETURN_IF_ERROR(InitInputPortAsGpuBuffer(portBinding, frame));
+        }
+        else if (portBinding.packet_type() == lluvia::LLUVIA_IMAGE) {
+            MP_RETURN_IF_ERROR(InitInputPortAsLluviaImage(portBinding, frame));
+        }
+        else if (isVectorPacketType(portBinding.packet_type())) {
+            MP_RETURN_IF_ERROR(InitInputPortAsBuffer(portBinding, frame));
+        }
+        else {
+            return absl::UnknownError("Unknown port type");
+        } 
+
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Parameters
+    // TODO
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Node init
+    LOG(INFO) << "InitNode(): init container node";
+    phaseScope = absl::make_unique<LluviaTraceScope>(m_trace.get(), m_nodeName, "InitNode/container_node");
+    MP_RETURN_IF_ERROR(InitContainerNode());
+    MP_RETURN_IF_ERROR(InitAdditionalContainerNodes());
+
+    if (m_options.workgroup_tuning().enabled()) {
+        // candidates run on the frame content
+        LOG(INFO) << "InitNode(): tuning workgroup shapes";
+        phaseScope = absl::make_unique<LluviaTraceScope>(m_trace.get(), m_nodeName, "InitNode/workgroup_tuning");
+        MP_RETURN_IF_ERROR(UploadInputImages(frame));
+        MP_RETURN_IF_ERROR(TuneContainerNode());
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Outputs
+    LOG(INFO) << "InitNode(): creating output port bindings";
+    phaseScope = absl::make_unique<LluviaTraceScope>(m_trace.get(), m_nodeName, "InitNode/outputs");
+    if (getOutputPortBindings(m_options).size() > 64) {
+        return absl::InvalidArgumentError("at most 64 output ports are supported");
+    }
+
+    for (auto i = 0; i < m_options.output_port_binding_size(); ++i) {
+
+        MP_RETURN_IF_ERROR(InitOutputPort(m_options.output_port_binding(i), 0, frame));
+    }
+
+    for (auto container = 0; container < m_options.additional_container_size(); ++container) {
+        for (const auto& portBinding : m_options.additional_container(container).output_port_binding()) {
+            MP_RETURN_IF_ERROR(InitOutputPort(portBinding, container + 1, frame));
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Duration
+    m_duration = m_session->createDuration();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Command buffers
+    LOG(INFO) << "InitNode(): creating command buffers";
+    phaseScope = absl::make_unique<LluviaTraceScope>(m_trace.get(), m_nodeName, "InitNode/command_buffers");
+    m_allOutputsMask = m_outputHandlers.size() == 64 ? ~uint64_t {0} : (uint64_t {1} << m_outputHandlers.size()) - 1;
+
+    // IMAGE_FRAME ports with a roi_tag copy only their region, packed outputs
+    // read back their packed buffer and other formats their whole image
+    for (auto* handlers : {&m_inputHandlers, &m_outputHandlers}) {
+        for (auto& handler : *handlers) {
+            if (handler.mediapipePacketType == lluvia::IMAGE_FRAME && !handler.roiTag.empty()
+                && !handler.packNode && getRegionChannelBytes(*handler.image) > 0) {
+                handler.regionIndex = static_cast<int>(m_regions.size());
+                m_regions.emplace_back();
+            }
+        }
+    }
+
+    const auto hasPooledOutputs = std::any_of(m_outputHandlers.begin(), m_outputHandlers.end(), [](const PortHandler& handler) {
+        return handler.mediapipePacketType == lluvia::LLUVIA_IMAGE || handler.stagingPooled;
+    });
+
+    if (hasPooledOutputs) {
+        for (auto i = 0; i < std::max(1, m_options.image_pool_size()); ++i) {
+            MP_RETURN_IF_ERROR(GrowImagePool());
+        }
+    } else {
+        m_cmdBuffers.emplace_back();
+        m_regionCmdBuffers.emplace_back();
+        getCommandBuffer(0, m_allOutputsMask);
+    }
+
+    LOG(INFO) << "InitNode() finish";
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitContainerNode() {
+
+    if (m_snapshot) {
+
+        auto instance = [this]() {
+            auto guard = std::lock_guard {*m_runMutex};
+            return LluviaContainerInstance::Create(m_session, m_deviceMemory, m_hostMemory, *m_snapshot, m_boundPorts);
+        }();
+
+        if (instance.ok()) {
+            LOG(INFO) << "InitContainerNode(): container node instantiated from snapshot";
+            m_containerInstance = std::move(instance).value();
+            return ::mediapipe::OkStatus();
+        }
+
+        // for instance, the input shapes differ from the ones of the snapshot
+        LOG(WARNING) << "InitContainerNode(): cannot use snapshot, initializing through Lua: " << instance.status().message();
+        m_snapshot.reset();
+        MP_RETURN_IF_ERROR(LoadScripts());
+    }
+
+    try {
+        m_containerNode = m_session->createContainerNode(m_options.container_node());
+
+        for (const auto& parameter : m_options.parameter()) {
+            m_containerNode->setParameter(parameter.name(), ll::Parameter {parameter.value()});
+        }
+
+        for (const auto& [portName, object] : m_boundPorts) {
+            m_containerNode->bind(portName, object);
+        }
+
+        m_containerNode->init();
+    } catch (std::exception& e) {
+        return absl::InternalError(absl::StrCat("error initializing container node ", m_options.container_node(), ": ", e.what()));
+    }
+
+    if (m_options.snapshot_path().empty()) {
+        return ::mediapipe::OkStatus();
+    }
+
+    auto portNames = std::vector<std::string> {};
+    for (const auto& portBinding : m_options.input_port_binding()) portNames.push_back(portBinding.lluvia_port());
+    for (const auto& portBinding : m_options.output_port_binding()) portNames.push_back(portBinding.lluvia_port());
+
+    // a snapshot that cannot be captured only disables the fast startup path
+    auto snapshot = CaptureContainerSnapshot(m_session, *m_containerNode, portNames);
+    if (!snapshot.ok()) {
+        LOG(WARNING) << "InitContainerNode(): cannot capture snapshot: " << snapshot.status().message();
+        return ::mediapipe::OkStatus();
+    }
+
+    auto status = WriteContainerSnapshot(m_options.snapshot_path(), snapshot.value());
+    if (!status.ok()) {
+        LOG(WARNING) << "InitContainerNode(): cannot write snapshot: " << status.message();
+    } else {
+        LOG(INFO) << "InitContainerNode(): snapshot written to " << m_options.snapshot_path();
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitAdditionalContainerNodes() {
+
+    if (m_options.additional_container_size() == 0) {
+        return ::mediapipe::OkStatus();
+    }
+
+    // not loaded in Open() if container_node was instantiated from a snapshot
+    MP_RETURN_IF_ERROR(LoadScripts());
+
+    for (const auto& container : m_options.additional_container()) {
+
+        try {
+            auto containerNode = m_session->createContainerNode(container.container_node());
+
+            // the input ports share the objects uploaded for container_node
+            for (const auto& inputHandler : m_inputHandlers) {
+                const auto alias = container.input_port().find(inputHandler.mediapipeTag);
+                const auto& portName = alias != container.input_port().end() ? alias->second : inputHandler.lluviaPortName;
+                containerNode->bind(portName, m_boundPorts.at(inputHandler.lluviaPortName));
+            }
+
+            containerNode->init();
+            m_additionalContainerNodes.push_back(std::move(containerNode));
+
+        } catch (std::exception& e) {
+            return absl::InternalError(absl::StrCat("error initializing container node ", container.container_node(), ": ", e.what()));
+        }
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::TuneContainerNode() {
+
+    auto portNames = std::vector<std::string> {};
+    for (const auto& portBinding : m_options.input_port_binding()) portNames.push_back(portBinding.lluvia_port());
+
+    auto outputPorts = std::vector<std::string> {};
+    for (const auto& portBinding : m_options.output_port_binding()) outputPorts.push_back(portBinding.lluvia_port());
+    portNames.insert(portNames.end(), outputPorts.begin(), outputPorts.end());
+
+    auto snapshot = lluvia::ContainerSnapshot {};
+    if (m_containerInstance) {
+        snapshot = m_containerInstance->getSnapshot();
+    } else {
+        auto captured = CaptureContainerSnapshot(m_session, *m_containerNode, portNames);
+        if (!captured.ok()) {
+            LOG(WARNING) << "TuneContainerNode(): cannot capture snapshot, keeping builder shapes: " << captured.status().message();
+            return ::mediapipe::OkStatus();
+        }
+
+        snapshot = std::move(captured).value();
+    }
+
+    auto guard = std::lock_guard {*m_runMutex};
+
+    auto tuned = TuneContainerSnapshot(m_session, m_deviceMemory, m_hostMemory, m_device, snapshot, m_boundPorts, outputPorts, m_options.workgroup_tuning());
+    if (!tuned.ok()) {
+        LOG(WARNING) << "TuneContainerNode(): keeping builder shapes: " << tuned.status().message();
+        return ::mediapipe::OkStatus();
+    }
+
+    ASSIGN_OR_RETURN(m_containerInstance, LluviaContainerInstance::Create(m_session, m_deviceMemory, m_hostMemory, tuned.value(), m_boundPorts));
+
+    // the objects of the Lua container node are no longer used
+    m_containerNode.reset();
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::UploadInputImages(const LluviaFrame& frame) {
+
+    auto cmdBuffer = m_session->createCommandBuffer();
+    cmdBuffer->begin();
+
+    for (auto& inputHandler : m_inputHandlers) {
+
+        if (inputHandler.mediapipePacketType != lluvia::IMAGE_FRAME) {
+            continue;
+        }
+
+        const auto& inputImage = frame.input(inputHandler.mediapipeTag).Get<ImageFrame>();
+        const auto rowBytes = static_cast<size_t>(inputImage.Width() * inputImage.NumberOfChannels() * inputImage.ByteDepth());
+        m_hostCopy->copy(inputImage.PixelData(), inputImage.WidthStep(), inputHandler.stagingBufferMappedPtr.get(), rowBytes, rowBytes, inputImage.Height(), true);
+
+        cmdBuffer->changeImageLayout(*inputHandler.image, ll::ImageLayout::TransferDstOptimal);
+        cmdBuffer->memoryBarrier();
+        cmdBuffer->copyBufferToImage(*inputHandler.stagingBuffer, *inputHandler.image);
+        cmdBuffer->memoryBarrier();
+        cmdBuffer->changeImageLayout(*inputHandler.image, ll::ImageLayout::General);
+    }
+
+    cmdBuffer->end();
+
+    return RunCommandBuffer(*cmdBuffer);
+}
+
+::mediapipe::Status LluviaExecutionContext::RunCommandBuffer(ll::CommandBuffer& cmdBuffer) {
+
+    if (m_submissionQueue) {
+        return m_submissionQueue->run(cmdBuffer);
+    }
+
+    auto guard = std::lock_guard {*m_runMutex};
+    m_session->run(cmdBuffer);
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::ChangeImageLayout(ll::Image& image, const ll::ImageLayout newLayout) {
+
+    auto cmdBuffer = m_session->createCommandBuffer();
+    cmdBuffer->begin();
+    cmdBuffer->changeImageLayout(image, newLayout);
+    cmdBuffer->end();
+
+    return RunCommandBuffer(*cmdBuffer);
+}
+
+std::shared_ptr<ll::Object> LluviaExecutionContext::getContainerPort(const int container, const std::string& name) {
+
+    if (container > 0) {
+        return m_additionalContainerNodes[container - 1]->getPort(name);
+    }
+
+    if (m_containerInstance) {
+        return m_containerInstance->getPort(name);
+    }
+
+    return m_containerNode->getPort(name);
+}
+
+void LluviaExecutionContext::RecordCommandBuffer(const size_t poolSlot, RecordedCommand& command) {
+
+    const auto readbackMask = command.readbackMask;
+    command.transferBytes = 0;
+
+    auto cmdBuffer = m_session->createCommandBuffer();
+    cmdBuffer->begin();
+    cmdBuffer->durationStart(*m_duration);
+
+    // Copy all staging buffers to their corresponding port handler image.
+    for (auto& inputHandler : m_inputHandlers) {
+
+        // LLUVIA_IMAGE inputs are copied from the upstream image of this variant.
+        // Copies are valid in General layout, so the layout of the upstream
+        // image, which its producer records commands against, is left as is.
+        if (inputHandler.mediapipePacketType == lluvia::LLUVIA_IMAGE) {
+            cmdBuffer->copyImageToImage(*command.sourceImages[inputHandler.sourceIndex], *inputHandler.image);
+            cmdBuffer->memoryBarrier();
+            continue;
+        }
+
+        if (inputHandler.buffer) {
+            cmdBuffer->copyBuffer(*inputHandler.stagingBuffer, *inputHandler.buffer);
+            cmdBuffer->memoryBarrier();
+            continue;
+        }
+
+        const auto* region = getRecordedRegion(command, inputHandler);
+        command.transferBytes += getRegionBytes(inputHandler, region);
+
+        if (region) {
+            // the region node reads the staging buffer and writes the image in General layout
+            if (const auto& regionNode = command.regionNodes[inputHandler.regionIndex]) {
+                cmdBuffer->run(*regionNode);
+                cmdBuffer->memoryBarrier();
+            }
+            continue;
+        }
+
+        cmdBuffer->changeImageLayout(*inputHandler.image, ll::ImageLayout::TransferDstOptimal);
+        cmdBuffer->memoryBarrier();
+        cmdBuffer->copyBufferToImage(*inputHandler.stagingBuffer, *inputHandler.image);
+        cmdBuffer->memoryBarrier(); // TODO: needed?
+        cmdBuffer->changeImageLayout(*inputHandler.image, ll::ImageLayout::General);
+        cmdBuffer->memoryBarrier();
+    }
+    
+    // Compute. The container nodes only read the inputs, so they are recorded
+    // without barriers between them and the device can overlap them.
+    if (m_containerInstance) {
+        m_containerInstance->record(*cmdBuffer);
+    } else {
+        cmdBuffer->run(*m_containerNode);
+    }
+
+    for (const auto& containerNode : m_additionalContainerNodes) {
+        cmdBuffer->run(*containerNode);
+    }
+    cmdBuffer->memoryBarrier();
+
+    // Copy the output images read back in this variant to their corresponding staging buffers
+    for (auto i = size_t {0}; i < m_outputHandlers.size(); ++i) {
+
+        auto& outputHandler = m_outputHandlers[i];
+        if ((readbackMask & (uint64_t {1} << i)) == 0) {
+            continue;
+        }
+
+        if (outputHandler.mediapipePacketType == lluvia::LLUVIA_IMAGE) {
+            // the image stays in device memory, copy it to the pool image of this slot
+            auto& poolImage = *outputHandler.imagePool[poolSlot]->getImage();
+
+            cmdBuffer->changeImageLayout(*outputHandler.image, ll::ImageLayout::TransferSrcOptimal);
+            cmdBuffer->changeImageLayout(poolImage, ll::ImageLayout::TransferDstOptimal);
+            cmdBuffer->memoryBarrier();
+            cmdBuffer->copyImageToImage(*outputHandler.image, poolImage);
+            cmdBuffer->memoryBarrier();
+            cmdBuffer->changeImageLayout(*outputHandler.image, ll::ImageLayout::General);
+            cmdBuffer->changeImageLayout(poolImage, ll::ImageLayout::General);
+            cmdBuffer->memoryBarrier();
+            continue;
+        }
+
+        if (isVectorPacketType(outputHandler.mediapipePacketType)) {
+            // buffer ports are read back as is, images only through their reduction
+            for (const auto& node : outputHandler.reductionNodes) {
+                cmdBuffer->run(*node);
+                cmdBuffer->memoryBarrier();
+            }
+
+            cmdBuffer->copyBuffer(*outputHandler.packedBuffer, *outputHandler.stagingBuffer);
+            cmdBuffer->memoryBarrier();
+            continue;
+        }
+
+        if (outputHandler.packNode) {
+            // the pack node samples the image in General layout, only the packed buffer is read back
+            cmdBuffer->run(*outputHandler.packNode);
+            cmdBuffer->memoryBarrier();
+            cmdBuffer->copyBuffer(*outputHandler.packedBuffer, *outputHandler.stagingBuffer);
+            cmdBuffer->memoryBarrier();
+            command.transferBytes += outputHandler.stagingBuffer->getSize();
+            continue;
+        }
+
+        const auto* region = getRecordedRegion(command, outputHandler);
+        command.transferBytes += getRegionBytes(outputHandler, region);
+
+        if (region) {
+            // the region node samples the image in General layout and writes the staging buffer
+            if (const auto& regionNode = command.regionNodes[outputHandler.regionIndex]) {
+                cmdBuffer->run(*regionNode);
+                cmdBuffer->memoryBarrier();
+            }
+            continue;
+        }
+
+        auto& stagingBuffer = outputHandler.stagingPooled ? *outputHandler.stagingPool[poolSlot]->buffer : *outputHandler.stagingBuffer;
+
+        cmdBuffer->changeImageLayout(*outputHandler.image, ll::ImageLayout::TransferSrcOptimal);
+        cmdBuffer->memoryBarrier();
+        cmdBuffer->copyImageToBuffer(*outputHandler.image, stagingBuffer);
+        cmdBuffer->memoryBarrier();
+        cmdBuffer->changeImageLayout(*outputHandler.image, ll::ImageLayout::General);
+        cmdBuffer->memoryBarrier();
+    }
+
+    cmdBuffer->durationEnd(*m_duration);
+    cmdBuffer->end();
+
+    command.cmdBuffer = std::move(cmdBuffer);
+}
+
+::mediapipe::Status LluviaExecutionContext::GrowImagePool() {
+
+    const auto poolSlot = m_cmdBuffers.size();
+
+    for (auto& outputHandler : m_outputHandlers) {
+
+        if (outputHandler.stagingPooled) {
+            auto stagingSlot = PixelSlotPtr {new PixelSlot {}};
+            stagingSlot->buffer = m_hostMemory->createBuffer(outputHandler.image->getMinimumSize());
+            stagingSlot->mappedPtr = stagingSlot->buffer->map<uint8_t []>();
+
+            // the ImageFrame adopts the staging buffer of this slot, its rows are not padded
+            const auto width = static_cast<int>(outputHandler.image->getWidth());
+            const auto height = static_cast<int>(outputHandler.image->getHeight());
+            auto outputImage = absl::make_unique<ImageFrame>(outputHandler.imageFormat, width, height, width * outputHandler.pixelBytes,
+                                                             stagingSlot->pixels(), stagingSlot->acquireDeleter());
+
+            outputHandler.stagingPool.push_back(std::move(stagingSlot));
+            outputHandler.packetPool.push_back(Adopt(outputImage.release()));
+            continue;
+        }
+
+        if (outputHandler.mediapipePacketType != lluvia::LLUVIA_IMAGE) {
+            continue;
+        }
+
+        auto image = m_deviceMemory->createImage(outputHandler.image->getDescriptor());
+        MP_RETURN_IF_ERROR(ChangeImageLayout(*image, ll::ImageLayout::General));
+
+        outputHandler.imagePool.push_back(image->createImageView(outputHandler.imageView->getDescriptor()));
+
+        auto lluviaImage = absl::make_unique<LluviaImage>();
+        lluviaImage->session = m_session;
+        lluviaImage->imageView = outputHandler.imagePool.back();
+        outputHandler.packetPool.push_back(Adopt(lluviaImage.release()));
+    }
+
+    m_cmdBuffers.emplace_back();
+    m_regionCmdBuffers.emplace_back();
+    getCommandBuffer(poolSlot, m_allOutputsMask);
+
+    return ::mediapipe::OkStatus();
+}
+
+RecordedCommand& LluviaExecutionContext::getCommandBuffer(const size_t poolSlot, const uint64_t readbackMask) {
+
+    auto& variants = m_cmdBuffers[poolSlot];
+
+    const auto range = variants.equal_range(readbackMask);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.sourceImages == m_sourceImages) {
+            return it->second;
+        }
+    }
+
+    auto it = variants.emplace(readbackMask, RecordedCommand {});
+    it->second.readbackMask = readbackMask;
+    it->second.sourceImages = m_sourceImages;
+    RecordCommandBuffer(poolSlot, it->second);
+
+    return it->second;
+}
+
+::mediapipe::StatusOr<RecordedCommand*> LluviaExecutionContext::getRegionCommandBuffer(const size_t poolSlot, const uint64_t readbackMask) {
+
+    auto& variants = m_regionCmdBuffers[poolSlot];
+
+    for (auto& variant : variants) {
+        if (variant.readbackMask == readbackMask && variant.regions == m_regions && variant.sourceImages == m_sourceImages) {
+            variant.lastFrame = m_frameIndex;
+            return &variant;
+        }
+    }
+
+    if (variants.size() >= maxRegionCommands) {
+        // session->run() waits for the queue, so no variant is in flight
+        variants.erase(std::min_element(variants.begin(), variants.end(), [](const RecordedCommand& a, const RecordedCommand& b) {
+            return a.lastFrame < b.lastFrame;
+        }));
+    }
+
+    auto command = RecordedCommand {};
+    command.readbackMask = readbackMask;
+    command.sourceImages = m_sourceImages;
+    command.regions = m_regions;
+    command.regionNodes.resize(m_regions.size());
+    command.lastFrame = m_frameIndex;
+
+    // empty regions are not copied
+    const auto createRegionNodes = [this, &command](const std::vector<PortHandler>& handlers, const bool toImage) -> ::mediapipe::Status {
+        for (const auto& handler : handlers) {
+            const auto* region = getRecordedRegion(command, handler);
+            if (region && region->width > 0 && region->height > 0) {
+                ASSIGN_OR_RETURN(command.regionNodes[handler.regionIndex], CreateRegionNode(handler, *region, toImage));
+            }
+        }
+        return ::mediapipe::OkStatus();
+    };
+
+    MP_RETURN_IF_ERROR(createRegionNodes(m_inputHandlers, true));
+    MP_RETURN_IF_ERROR(createRegionNodes(m_outputHandlers, false));
+
+    RecordCommandBuffer(poolSlot, command);
+
+    variants.push_back(std::move(command));
+    return &variants.back();
+}
+
+::mediapipe::StatusOr<std::shared_ptr<ll::ComputeNode>> LluviaExecutionContext::CreateRegionNode(const PortHandler& handler, const PixelRect& region, const bool toImage) {
+
+    const auto channelBytes = getRegionChannelBytes(*handler.image);
+    const auto nodeName = absl::StrCat("lluvia/mediapipe/", toImage ? "RegionToImage" : "RegionToBuffer", channelBytes == 4 ? "Float" : "Uint");
+
+    try {
+        auto node = m_session->createComputeNode(nodeName);
+
+        node->setParameter("x", ll::Parameter {region.x});
+        node->setParameter("y", ll::Parameter {region.y});
+        node->setParameter("width", ll::Parameter {region.width});
+        node->setParameter("height", ll::Parameter {region.height});
+        node->setParameter("channels", ll::Parameter {static_cast<int>(handler.image->getChannelCount())});
+
+        if (channelBytes != 4) {
+            node->setParameter("channel_bytes", ll::Parameter {channelBytes});
+        }
+
+        if (toImage) {
+            node->bind("in_buffer", handler.stagingBuffer);
+            node->bind("out_image", handler.imageView);
+        } else {
+            node->bind("in_image", handler.imageView);
+            node->bind("out_buffer", handler.stagingBuffer);
+        }
+
+        node->init();
+        return node;
+
+    } catch (std::exception& e) {
+        return absl::NotFoundError(absl::StrCat("region node ", nodeName, " failed, is lluvia_mediapipe_library in library_path? ", e.what()));
+    }
+}
+
+uint64_t LluviaExecutionContext::getReadbackMask(const LluviaFrame& frame) const {
+
+    auto readbackMask = uint64_t {0};
+
+    for (auto i = size_t {0}; i < m_outputHandlers.size(); ++i) {
+
+        const auto& outputHandler = m_outputHandlers[i];
+
+        auto readback = m_frameIndex % outputHandler.readbackInterval == 0;
+        if (readback && !outputHandler.readbackTriggerTag.empty()) {
+            const auto& trigger = frame.input(outputHandler.readbackTriggerTag);
+            readback = !trigger.IsEmpty() && trigger.Get<bool>();
+        }
+
+        if (readback) {
+            readbackMask |= uint64_t {1} << i;
+        }
+    }
+
+    return readbackMask;
+}
+
+::mediapipe::StatusOr<size_t> LluviaExecutionContext::AcquirePoolSlot() {
+
+    // a slot is free once downstream released the packets of its images and staging buffers
+    for (auto poolSlot = size_t {0}; poolSlot < m_cmdBuffers.size(); ++poolSlot) {
+
+        const auto isFree = std::all_of(m_outputHandlers.begin(), m_outputHandlers.end(), [poolSlot](const PortHandler& handler) {
+            return (handler.mediapipePacketType != lluvia::LLUVIA_IMAGE && !handler.stagingPooled)
+                || isReleased(handler.packetPool[poolSlot]);
+        });
+
+        if (isFree) {
+            return poolSlot;
+        }
+    }
+
+    MP_RETURN_IF_ERROR(GrowImagePool());
+    LOG(WARNING) << "LluviaCalculator: all pool images in use downstream, pool size increased to " << m_cmdBuffers.size();
+
+    return m_cmdBuffers.size() - 1;
+}
+
+size_t LluviaExecutionContext::AcquireOutputPacket(PortHandler& handler) {
+
+    for (auto i = size_t {0}; i < handler.packetPool.size(); ++i) {
+        if (isReleased(handler.packetPool[i])) {
+            return i;
+        }
+    }
+
+    if (handler.mediapipePacketType == lluvia::IMAGE_FRAME) {
+
+        // pixels sized for the whole image, regions of interest use a part of them
+        const auto width = static_cast<int>(handler.image->getWidth());
+        const auto height = static_cast<int>(handler.image->getHeight());
+        const auto widthStep = getAlignedWidthStep(width, handler.pixelBytes);
+
+        auto frameSlot = PixelSlotPtr {new PixelSlot {}};
+        frameSlot->hostPixels = absl::make_unique<uint8_t []>(static_cast<size_t>(widthStep) * height);
+
+        auto outputImage = absl::make_unique<ImageFrame>(handler.imageFormat, width, height, widthStep,
+                                                         frameSlot->pixels(), frameSlot->acquireDeleter());
+
+        handler.framePool.push_back(std::move(frameSlot));
+        handler.packetPool.push_back(Adopt(outputImage.release()));
+        return handler.packetPool.size() - 1;
+    }
+
+    const auto valueCount = handler.resultIndices.empty() ? static_cast<size_t>(handler.stagingBuffer->getSize() / sizeof(float))
+                                                          : handler.resultIndices.size();
+
+    if (handler.mediapipePacketType == lluvia::FLOAT_VECTOR) {
+        handler.packetPool.push_back(MakePacket<std::vector<float>>(valueCount));
+    } else {
+        handler.packetPool.push_back(Adopt(new Matrix(handler.matrixRows, static_cast<int>(valueCount) / handler.matrixRows)));
+    }
+
+    return handler.packetPool.size() - 1;
+}
+
+::mediapipe::Status LluviaExecutionContext::InitNodeOnce(LluviaFrame& frame) {
+
+    std::call_once(m_configureNode, [this, &frame]() {
+        m_initStatus = InitNode(frame);
+    });
+
+    return m_initStatus;
+}
+
+::mediapipe::Status LluviaExecutionContext::Warmup(LluviaFrame& frame, const int runs) {
+
+    MP_RETURN_IF_ERROR(InitNodeOnce(frame));
+
+    for (auto i = 0; i < runs; ++i) {
+        MP_RETURN_IF_ERROR(ProcessFrame(frame));
+        frame.outputs.clear();
+    }
+
+    // readback policies count frames from the first input frame
+    m_frameIndex = 0;
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::ProcessFrame(LluviaFrame& frame) {
+
+    ///////////////////////////////////////////////////////////////////////////
+    // init the internals on the first call to Process
+    MP_RETURN_IF_ERROR(InitNodeOnce(frame));
+
+    ///////////////////////////////////////////////////////////////////////////
+    // copy input packets to input handlers
+    // in place, so that tracing does not allocate per frame
+    auto phaseScope = std::optional<LluviaTraceScope> {};
+    phaseScope.emplace(m_trace.get(), m_nodeName, "Process/inputs");
+    for (auto& inputHandler : m_inputHandlers) {
+
+        if (inputHandler.mediapipePacketType == lluvia::IMAGE_FRAME) {
+            auto& inputImage = frame.input(inputHandler.mediapipeTag).Get<ImageFrame>();
+
+            // the port images have the size of the first frame, or the declared one
+            RET_CHECK(inputImage.Width() == static_cast<int>(inputHandler.image->getWidth())
+                      && inputImage.Height() == static_cast<int>(inputHandler.image->getHeight()))
+                << "input image size changed, port: " << inputHandler.mediapipeTag
+                << ", expected: " << inputHandler.image->getWidth() << "x" << inputHandler.image->getHeight()
+                << ", got: " << inputImage.Width() << "x" << inputImage.Height();
+
+            // Only the rows and columns inside the ROI are written. Pixels outside
+            // keep the content of previous frames.
+            const auto roi = getRegionOfInterest(frame, inputHandler, inputImage.Width(), inputImage.Height());
+
+            // ImageFrame::CopyToBuffer(uint8*) only accepts 1 byte channels, copy the rows directly
+            // to support every format returned by getLluviaImageFormat()
+            const auto pixelBytes = static_cast<size_t>(inputImage.NumberOfChannels() * inputImage.ByteDepth());
+            const auto rowBytes = inputImage.Width() * pixelBytes;
+            // the row padding of the ImageFrame is dropped while copying, with
+            // non-temporal stores as the staging buffer is only read by the device
+            m_hostCopy->copy(inputImage.PixelData() + roi.y * inputImage.WidthStep() + roi.x * pixelBytes, inputImage.WidthStep(),
+                             &inputHandler.stagingBufferMappedPtr[roi.y * rowBytes + roi.x * pixelBytes], rowBytes,
+                             roi.width * pixelBytes, roi.height, true);
+        }
+        else if (inputHandler.mediapipePacketType == lluvia::LLUVIA_IMAGE) {
+            // copied by the command buffer of the frame, recorded once per upstream pool image
+            const auto& lluviaImage = frame.input(inputHandler.mediapipeTag).Get<LluviaImage>();
+            auto& sourceImage = m_sourceImages[inputHandler.sourceIndex];
+            sourceImage = lluviaImage.imageView->getImage();
+
+            RET_CHECK(sourceImage->getWidth() == inputHandler.image->getWidth()
+                      && sourceImage->getHeight() == inputHandler.image->getHeight())
+                << "input image size changed, port: " << inputHandler.mediapipeTag;
+        }
+        else if (isVectorPacketType(inputHandler.mediapipePacketType)) {
+            auto* values = reinterpret_cast<float*>(inputHandler.stagingBufferMappedPtr.get());
+            const auto valueCount = inputHandler.stagingBuffer->getSize() / sizeof(float);
+
+            if (inputHandler.mediapipePacketType == lluvia::FLOAT_VECTOR) {
+                const auto& vector = frame.input(inputHandler.mediapipeTag).Get<std::vector<float>>();
+                RET_CHECK_EQ(vector.size(), valueCount) << "the size of " << inputHandler.mediapipeTag << " cannot change between packets";
+
+                std::copy(vector.begin(), vector.end(), values);
+            } else {
+                const auto& matrix = frame.input(inputHandler.mediapipeTag).Get<Matrix>();
+                RET_CHECK_EQ(static_cast<size_t>(matrix.size()), valueCount) << "the size of " << inputHandler.mediapipeTag << " cannot change between packets";
+
+                // Matrix is column major, buffers are row major
+                for (auto row = 0; row < matrix.rows(); ++row) {
+                    for (auto col = 0; col < matrix.cols(); ++col) {
+                        values[row * matrix.cols() + col] = matrix(row, col);
+                    }
+                }
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // run the container node
+    phaseScope.emplace(m_trace.get(), m_nodeName, "Process/run");
+
+    ASSIGN_OR_RETURN(const auto poolSlot, AcquirePoolSlot());
+    const auto readbackMask = getReadbackMask(frame);
+
+    auto* command = static_cast<RecordedCommand*>(nullptr);
+    if (UpdateRegions(frame)) {
+        command = &getCommandBuffer(poolSlot, readbackMask);
+    } else {
+        ASSIGN_OR_RETURN(command, getRegionCommandBuffer(poolSlot, readbackMask));
+    }
+
+    MP_RETURN_IF_ERROR(RunCommandBuffer(*command->cmdBuffer));
+    m_transferBytes = command->transferBytes;
+    ++m_frameIndex;
+
+    auto ns = m_duration->getDuration();
+    m_gpuDuration = ns;
+    VLOG(1) << "elapsed time: " << static_cast<float>(ns.count()) / 1e6 << " ms";
+
+    if (m_trace) {
+        // session->run() returns once the queue is idle, so the GPU work ended
+        // at the latest now. Its start is placed the measured duration before,
+        // which ignores the time between the GPU finishing and run() returning.
+        const auto gpuEnd = LluviaTraceRecorder::now();
+        const auto gpuDuration = std::chrono::duration_cast<std::chrono::microseconds>(ns).count();
+        m_trace->addTrackEvent(m_gpuTrack, m_nodeName, "command buffer", gpuEnd - gpuDuration, gpuDuration);
+    }
+
+    phaseScope.emplace(m_trace.get(), m_nodeName, "Process/outputs");
+
+    ///////////////////////////////////////////////////////////////////////////
+    // produce output packets
+    for (auto i = size_t {0}; i < m_outputHandlers.size(); ++i) {
+
+        auto& outputHandler = m_outputHandlers[i];
+        if ((readbackMask & (uint64_t {1} << i)) == 0) {
+            continue;
+        }
+
+        // the packets of this slot hold its pool image or adopt its staging buffer
+        if (outputHandler.mediapipePacketType == lluvia::LLUVIA_IMAGE || outputHandler.stagingPooled) {
+            frame.addOutput(outputHandler.mediapipeTag, outputHandler.packetPool[poolSlot]);
+            continue;
+        }
+
+        if (isVectorPacketType(outputHandler.mediapipePacketType)) {
+            const auto* values = reinterpret_cast<const float*>(outputHandler.stagingBufferMappedPtr.get());
+            const auto& indices = outputHandler.resultIndices;
+
+            // released downstream, so the pool is the only owner of the packet data
+            const auto& packet = outputHandler.packetPool[AcquireOutputPacket(outputHandler)];
+
+            if (outputHandler.mediapipePacketType == lluvia::FLOAT_VECTOR) {
+                auto& result = const_cast<std::vector<float>&>(packet.Get<std::vector<float>>());
+                for (auto k = size_t {0}; k < result.size(); ++k) {
+                    result[k] = values[indices.empty() ? k : indices[k]];
+                }
+
+                frame.addOutput(outputHandler.mediapipeTag, packet);
+                continue;
+            }
+
+            auto& matrix = const_cast<Matrix&>(packet.Get<Matrix>());
+            const auto cols = static_cast<int>(matrix.cols());
+
+            for (auto row = 0; row < matrix.rows(); ++row) {
+                for (auto col = 0; col < cols; ++col) {
+                    const auto k = static_cast<size_t>(row * cols + col);
+                    matrix(row, col) = values[indices.empty() ? k : indices[k]];
+                }
+            }
+
+            frame.addOutput(outputHandler.mediapipeTag, packet);
+            continue;
+        }
+
+        const auto width = static_cast<int>(outputHandler.image->getWidth());
+        const auto height = static_cast<int>(outputHandler.image->getHeight());
+
+        const auto roi = getRegionOfInterest(frame, outputHandler, width, height);
+        if (roi.width == 0 || roi.height == 0) {
+            // nothing to emit for an empty region
+            continue;
+        }
+
+        // the staging buffer holds the whole image without row padding
+        const auto stagingRowBytes = static_cast<size_t>(width * outputHandler.pixelBytes);
+        const auto regionRowBytes = static_cast<size_t>(roi.width * outputHandler.pixelBytes);
+        const uint8_t* stagingRegion = &outputHandler.stagingBufferMappedPtr[roi.y * stagingRowBytes + roi.x * outputHandler.pixelBytes];
+
+        if (outputHandler.mediapipePacketType == lluvia::TENSOR) {
+
+            const auto elementType = outputHandler.tensorElementType == lluvia::TensorOptions::FLOAT16 ? Tensor::ElementType::kFloat16 : Tensor::ElementType::kFloat32;
+
+            auto tensors = absl::make_unique<std::vector<Tensor>>();
+            tensors->emplace_back(elementType, Tensor::Shape {1, height, width, outputHandler.tensorChannels});
+
+            {
+                auto view = tensors->back().GetCpuWriteView();
+                m_hostCopy->copy(stagingRegion, regionRowBytes, view.buffer<uint8_t>(), regionRowBytes, regionRowBytes, roi.height, false);
+            }
+
+            frame.addOutput(outputHandler.mediapipeTag, Adopt(tensors.release()));
+            continue;
+        }
+
+        if (outputHandler.packing.encoding() != lluvia::OutputPacking::NONE) {
+
+            auto packedImage = absl::make_unique<LluviaPackedImage>();
+            packedImage->width = roi.width;
+            packedImage->height = roi.height;
+            packedImage->encoding = outputHandler.packing.encoding();
+            packedImage->scale = outputHandler.packing.scale();
+            packedImage->channels = outputHandler.pixelBytes / packedImage->BytesPerElement();
+            packedImage->data.resize(regionRowBytes * roi.height);
+
+            m_hostCopy->copy(stagingRegion, stagingRowBytes, packedImage->data.data(), regionRowBytes, regionRowBytes, roi.height, false);
+
+            frame.addOutput(outputHandler.mediapipeTag, Adopt(packedImage.release()));
+            continue;
+        }
+
+        if (outputHandler.mediapipePacketType == lluvia::IMAGE_FRAME) {
+
+            // pooled ImageFrame and pixels, sized for the whole image
+            const auto index = AcquireOutputPacket(outputHandler);
+            auto& frameSlot = *outputHandler.framePool[index];
+            const auto& packet = outputHandler.packetPool[index];
+            const auto widthStep = getAlignedWidthStep(roi.width, outputHandler.pixelBytes);
+
+            // released downstream, so the pool is the only owner of the ImageFrame
+            auto& outputImage = const_cast<ImageFrame&>(packet.Get<ImageFrame>());
+            if (outputImage.Width() != roi.width || outputImage.Height() != roi.height) {
+                // the region of interest changed, the ImageFrame keeps its pixels
+                outputImage.AdoptPixelData(outputHandler.imageFormat, roi.width, roi.height, widthStep,
+                                           frameSlot.pixels(), frameSlot.acquireDeleter());
+            }
+
+            // copy staging buffer to output ImageFrame, whose rows might be padded
+            m_hostCopy->copy(stagingRegion, stagingRowBytes, frameSlot.pixels(), widthStep, regionRowBytes, roi.height, false);
+
+            // TODO: timestamps
+            frame.addOutput(outputHandler.mediapipeTag, packet);
+        }
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+bool LluviaExecutionContext::UpdateRegions(const LluviaFrame& frame) {
+
+    auto wholeImages = true;
+
+    for (const auto* handlers : {&m_inputHandlers, &m_outputHandlers}) {
+        for (const auto& handler : *handlers) {
+
+            if (handler.regionIndex < 0) {
+                continue;
+            }
+
+            const auto width = static_cast<int>(handler.image->getWidth());
+            const auto height = static_cast<int>(handler.image->getHeight());
+
+            auto& region = m_regions[handler.regionIndex];
+            region = alignRegion(getRegionOfInterest(frame, handler, width, height), width, height);
+            wholeImages = wholeImages && isWholeImage(region, *handler.image);
+        }
+    }
+
+    return wholeImages;
+}
+
+PixelRect LluviaExecutionContext::getRegionOfInterest(const LluviaFrame& frame, const PortHandler& handler, const int width, const int height) {
+
+    auto rect = PixelRect {0, 0, width, height};
+
+    if (handler.roiTag.empty() || frame.input(handler.roiTag).IsEmpty()) {
+        return rect;
+    }
+
+    const auto& roiPacket = frame.input(handler.roiTag);
+
+    auto xCenter = 0.0f;
+    auto yCenter = 0.0f;
+    auto roiWidth = 0.0f;
+    auto roiHeight = 0.0f;
+
+    // rotation is ignored, the transferred region is the axis aligned rectangle
+    if (roiPacket.ValidateAsType<NormalizedRect>().ok()) {
+        const auto& normRect = roiPacket.Get<NormalizedRect>();
+        xCenter = normRect.x_center() * width;
+        yCenter = normRect.y_center() * height;
+        roiWidth = normRect.width() * width;
+        roiHeight = normRect.height() * height;
+    } else {
+        const auto& pixelRect = roiPacket.Get<Rect>();
+        xCenter = static_cast<float>(pixelRect.x_center());
+        yCenter = static_cast<float>(pixelRect.y_center());
+        roiWidth = static_cast<float>(pixelRect.width());
+        roiHeight = static_cast<float>(pixelRect.height());
+    }
+
+    const auto x0 = std::clamp(static_cast<int>(std::floor(xCenter - 0.5f * roiWidth)), 0, width);
+    const auto y0 = std::clamp(static_cast<int>(std::floor(yCenter - 0.5f * roiHeight)), 0, height);
+    const auto x1 = std::clamp(static_cast<int>(std::ceil(xCenter + 0.5f * roiWidth)), 0, width);
+    const auto y1 = std::clamp(static_cast<int>(std::ceil(yCenter + 0.5f * roiHeight)), 0, height);
+
+    rect.x = x0;
+    rect.y = y0;
+    rect.width = std::max(0, x1 - x0);
+    rect.height = std::max(0, y1 - y0);
+
+    return rect;
+}
+
+::mediapipe::Status LluviaExecutionContext::InitOutputPort(const lluvia::PortBinding& portBinding, const int container, LluviaFrame& frame) {
+
+    // initialize the port handler for with the protobuffer attributes
+    auto portHandler = PortHandler {};
+    portHandler.mediapipePacketType = portBinding.packet_type();
+    portHandler.mediapipeTag = portBinding.mediapipe_tag();
+    portHandler.lluviaPortName = portBinding.lluvia_port();
+    portHandler.roiTag = portBinding.roi_tag();
+    portHandler.packing = portBinding.packing();
+    portHandler.readbackInterval = portBinding.readback().every_n_frames();
+    portHandler.readbackTriggerTag = portBinding.readback().trigger_tag();
+
+    if (portHandler.readbackInterval <= 0) {
+        return absl::InvalidArgumentError("readback every_n_frames must be positive");
+    }
+
+    // initialize lluvia objects
+    auto port = std::shared_ptr<ll::Object> {};
+    try {
+        // getting unexisting port name throws exception
+        port = getContainerPort(container, portHandler.lluviaPortName);
+    } catch(std::system_error& e) {
+        return absl::UnknownError(e.what());
+    }
+
+    if (isVectorPacketType(portHandler.mediapipePacketType)) {
+        return InitVectorOutputPort(std::move(portHandler), portBinding, port);
+    }
+
+    if (port->getType() != ll::ObjectType::ImageView) {
+        return absl::InvalidArgumentError(absl::StrCat("port ", portHandler.lluviaPortName, " is not an image, bind it as FLOAT_VECTOR or MATRIX"));
+    }
+
+    portHandler.imageView = std::static_pointer_cast<ll::ImageView>(port);
+    portHandler.image = portHandler.imageView->getImage();
+
+    if (portHandler.mediapipePacketType == lluvia::LLUVIA_IMAGE) {
+
+        if (!portHandler.roiTag.empty() || portBinding.has_packing()) {
+            return absl::InvalidArgumentError("roi_tag and packing are not supported for LLUVIA_IMAGE outputs");
+        }
+
+        // pool images are allocated by GrowImagePool() once all output ports are known
+        m_outputHandlers.push_back(std::move(portHandler));
+        return ::mediapipe::OkStatus();
+    }
+
+    if (portHandler.mediapipePacketType == lluvia::TENSOR) {
+        return InitTensorOutputPort(std::move(portHandler), portBinding);
+    }
+
+    const auto channelCount = static_cast<size_t>(portHandler.image->getChannelCount());
+    const auto channelType = portHandler.image->getChannelType();
+    const auto pixelCount = static_cast<uint64_t>(portHandler.image->getWidth()) * portHandler.image->getHeight();
+    const auto& packing = portHandler.packing;
+
+    if (packing.swizzle().empty() && packing.encoding() == lluvia::OutputPacking::NONE) {
+
+        // the image is read back as is
+        auto imageFormatFound = false;
+        std::tie(imageFormatFound, portHandler.imageFormat) = getMediapipeImageFormat(portHandler.image->getChannelCount(), channelType);
+
+        if (!imageFormatFound) {
+            return ::mediapipe::UnknownError("unable to find compatible output image format");
+        }
+
+        portHandler.pixelBytes = static_cast<int>(portHandler.image->getMinimumSize() / pixelCount);
+
+        // staging buffers in device memory are handed downstream, allocated by GrowImagePool()
+        portHandler.stagingPooled = m_unifiedMemory && portHandler.mediapipePacketType == lluvia::IMAGE_FRAME && portHandler.roiTag.empty();
+        if (!portHandler.stagingPooled) {
+            portHandler.stagingBuffer = m_hostMemory->createBuffer(portHandler.image->getMinimumSize());
+            portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+        }
+
+        m_outputHandlers.push_back(std::move(portHandler));
+        return ::mediapipe::OkStatus();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Packing
+    const auto swizzle = packing.swizzle().empty() ? std::string {"rgba"}.substr(0, channelCount) : packing.swizzle();
+    ASSIGN_OR_RETURN(const auto swizzleBits, getSwizzleBits(swizzle, channelCount));
+
+    auto packNodeName = std::string {};
+
+    if (packing.encoding() == lluvia::OutputPacking::NONE) {
+
+        if (channelType != ll::ChannelType::Uint8) {
+            return absl::InvalidArgumentError("packing without encoding is only supported for Uint8 images");
+        }
+
+        switch (swizzle.size()) {
+            case 1:
+                portHandler.imageFormat = ::mediapipe::ImageFormat_Format_GRAY8;
+                break;
+            case 3:
+                portHandler.imageFormat = ::mediapipe::ImageFormat_Format_SRGB;
+                break;
+            case 4:
+                portHandler.imageFormat = swizzle == "bgra" ? ::mediapipe::ImageFormat_Format_SBGRA : ::mediapipe::ImageFormat_Format_SRGBA;
+                break;
+            default:
+                return absl::InvalidArgumentError(absl::StrCat("no ImageFrame format for packed swizzle ", swizzle));
+        }
+
+        packNodeName = "lluvia/mediapipe/PackUint";
+        portHandler.pixelBytes = static_cast<int>(swizzle.size());
+
+    } else {
+
+        if (channelType != ll::ChannelType::Float32 && channelType != ll::ChannelType::Float16) {
+            return absl::InvalidArgumentError("packing encoding is only supported for floating point images");
+        }
+
+        packNodeName = "lluvia/mediapipe/PackFloat";
+        portHandler.pixelBytes = static_cast<int>(swizzle.size()) * (packing.encoding() == lluvia::OutputPacking::INT8 ? 1 : 2);
+    }
+
+    try {
+        portHandler.packNode = m_session->createComputeNode(packNodeName);
+    } catch (std::exception& e) {
+        return absl::NotFoundError(absl::StrCat("packing node ", packNodeName, " not found, is lluvia_mediapipe_library in library_path? ", e.what()));
+    }
+
+    portHandler.packNode->setParameter("swizzle", ll::Parameter {static_cast<int>(swizzleBits)});
+    portHandler.packNode->setParameter("channels", ll::Parameter {static_cast<int>(swizzle.size())});
+
+    if (packing.encoding() != lluvia::OutputPacking::NONE) {
+        portHandler.packNode->setParameter("encoding", ll::Parameter {static_cast<int>(packing.encoding())});
+        portHandler.packNode->setParameter("scale", ll::Parameter {packing.scale()});
+    }
+
+    portHandler.packNode->bind("in_image", portHandler.imageView);
+    portHandler.packNode->init();
+
+    portHandler.packedBuffer = std::static_pointer_cast<ll::Buffer>(portHandler.packNode->getPort("out_buffer"));
+    portHandler.stagingBuffer = m_hostMemory->createBuffer(portHandler.packedBuffer->getSize());
+    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+
+    LOG(INFO) << "InitOutputPort(): " << portHandler.mediapipeTag << " packed with " << packNodeName
+              << ", readback bytes: " << portHandler.stagingBuffer->getSize() << " (unpacked: " << portHandler.image->getMinimumSize() << ")";
+
+    m_outputHandlers.push_back(std::move(portHandler));
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitTensorOutputPort(PortHandler portHandler, const lluvia::PortBinding& portBinding) {
+
+    if (!portHandler.roiTag.empty() || portBinding.has_packing()) {
+        return absl::InvalidArgumentError("roi_tag and packing are not supported for TENSOR outputs");
+    }
+
+    const auto& tensorOptions = portBinding.tensor();
+    const auto channelCount = static_cast<size_t>(portHandler.image->getChannelCount());
+    const auto channelType = portHandler.image->getChannelType();
+
+    const auto swizzle = tensorOptions.swizzle().empty() ? std::string {"rgba"}.substr(0, channelCount) : tensorOptions.swizzle();
+    ASSIGN_OR_RETURN(const auto swizzleBits, getSwizzleBits(swizzle, channelCount));
+
+    const auto channels = static_cast<int>(swizzle.size());
+
+    // one value broadcast to all channels or one value per channel
+    const auto getNormalization = [](const google::protobuf::RepeatedField<float>& values, const float defaultValue, const int c) {
+        return values.empty() ? defaultValue : values.size() == 1 ? values.Get(0) : values.Get(c);
+    };
+
+    for (const auto* values : {&tensorOptions.mean(), &tensorOptions.std()}) {
+        if (values->size() > 1 && values->size() != channels) {
+            return absl::InvalidArgumentError(absl::StrCat("mean and std must have 0, 1 or ", channels, " values"));
+        }
+    }
+
+    auto packNodeName = std::string {};
+    switch (channelType) {
+        case ll::ChannelType::Uint8:
+        case ll::ChannelType::Uint16:
+            packNodeName = "lluvia/mediapipe/PackTensorUint";
+            break;
+        case ll::ChannelType::Float16:
+        case ll::ChannelType::Float32:
+            packNodeName = "lluvia/mediapipe/PackTensorFloat";
+            break;
+        default:
+            return absl::InvalidArgumentError("TENSOR outputs support Uint8, Uint16, Float16 and Float32 images");
+    }
+
+    try {
+        portHandler.packNode = m_session->createComputeNode(packNodeName);
+    } catch (std::exception& e) {
+        return absl::NotFoundError(absl::StrCat("tensor node ", packNodeName, " not found, is lluvia_mediapipe_library in library_path? ", e.what()));
+    }
+
+    portHandler.packNode->setParameter("swizzle", ll::Parameter {static_cast<int>(swizzleBits)});
+    portHandler.packNode->setParameter("channels", ll::Parameter {channels});
+    portHandler.packNode->setParameter("encoding", ll::Parameter {static_cast<int>(tensorOptions.element_type())});
+
+    for (auto c = 0; c < channels; ++c) {
+
+        const auto stdValue = getNormalization(tensorOptions.std(), 1.0f, c);
+        if (stdValue == 0.0f) {
+            return absl::InvalidArgumentError("std values must be different from zero");
+        }
+
+        portHandler.packNode->setParameter(absl::StrCat("mean_", c), ll::Parameter {getNormalization(tensorOptions.mean(), 0.0f, c)});
+        portHandler.packNode->setParameter(absl::StrCat("std_", c), ll::Parameter {stdValue});
+    }
+
+    portHandler.packNode->bind("in_image", portHandler.imageView);
+    portHandler.packNode->init();
+
+    portHandler.tensorElementType = tensorOptions.element_type();
+    portHandler.tensorChannels = channels;
+    portHandler.pixelBytes = channels * (tensorOptions.element_type() == lluvia::TensorOptions::FLOAT16 ? 2 : 4);
+
+    portHandler.packedBuffer = std::static_pointer_cast<ll::Buffer>(portHandler.packNode->getPort("out_buffer"));
+    portHandler.stagingBuffer = m_hostMemory->createBuffer(portHandler.packedBuffer->getSize());
+    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+
+    LOG(INFO) << "InitTensorOutputPort(): " << portHandler.mediapipeTag << " written to tensor with " << packNodeName
+              << ", channels: " << channels << ", readback bytes: " << portHandler.stagingBuffer->getSize();
+
+    m_outputHandlers.push_back(std::move(portHandler));
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitVectorOutputPort(PortHandler portHandler, const lluvia::PortBinding& portBinding, const std::shared_ptr<ll::Object>& port) {
+
+    if (!portHandler.roiTag.empty() || portBinding.has_packing() || portBinding.has_tensor()) {
+        return absl::InvalidArgumentError("roi_tag, packing and tensor are not supported for FLOAT_VECTOR and MATRIX outputs");
+    }
+
+    const auto& reduction = portBinding.reduction();
+
+    if (port->getType() == ll::ObjectType::Buffer) {
+
+        if (reduction.type() != lluvia::Reduction::NONE) {
+            return absl::InvalidArgumentError(absl::StrCat("reductions are computed over images, port ", portHandler.lluviaPortName, " is a buffer"));
+        }
+
+        portHandler.buffer = std::static_pointer_cast<ll::Buffer>(port);
+        portHandler.packedBuffer = portHandler.buffer;
+
+        const auto valueCount = static_cast<int>(portHandler.buffer->getSize() / sizeof(float));
+        portHandler.matrixRows = portBinding.matrix_rows();
+
+        if (portHandler.matrixRows <= 0 || valueCount % portHandler.matrixRows != 0) {
+            return absl::InvalidArgumentError(absl::StrCat("matrix_rows must divide the ", valueCount, " values of port ", portHandler.lluviaPortName));
+        }
+
+    } else {
+
+        if (reduction.type() == lluvia::Reduction::NONE) {
+            return absl::InvalidArgumentError(absl::StrCat("FLOAT_VECTOR and MATRIX outputs bound to image port ", portHandler.lluviaPortName, " need a reduction"));
+        }
+
+        portHandler.imageView = std::static_pointer_cast<ll::ImageView>(port);
+        portHandler.image = portHandler.imageView->getImage();
+
+        const auto channelCount = static_cast<int>(portHandler.image->getChannelCount());
+        const auto pixelCount = static_cast<int>(portHandler.image->getWidth() * portHandler.image->getHeight());
+
+        auto tileNodeName = std::string {};
+        switch (portHandler.image->getChannelType()) {
+            case ll::ChannelType::Uint8:
+            case ll::ChannelType::Uint16:
+            case ll::ChannelType::Uint32:
+                tileNodeName = "lluvia/mediapipe/ReduceTileUint";
+                break;
+            case ll::ChannelType::Float16:
+            case ll::ChannelType::Float32:
+                tileNodeName = "lluvia/mediapipe/ReduceTileFloat";
+                break;
+            default:
+                return absl::InvalidArgumentError("reductions support unsigned integer and floating point images");
+        }
+
+        const auto isHistogram = reduction.type() == lluvia::Reduction::HISTOGRAM;
+        if (isHistogram) {
+            if (reduction.channel() < 0 || reduction.channel() >= channelCount) {
+                return absl::InvalidArgumentError(absl::StrCat("histogram channel must be less than ", channelCount));
+            }
+
+            if (reduction.bins() <= 0 || reduction.max_value() <= reduction.min_value()) {
+                return absl::InvalidArgumentError("histogram bins must be positive and max_value greater than min_value");
+            }
+        }
+
+        // values of the mode parameter of the reduction nodes
+        const auto mode = isHistogram ? 1 : 0;
+
+        auto tileNode = std::shared_ptr<ll::ComputeNode> {};
+        auto finalNode = std::shared_ptr<ll::ComputeNode> {};
+        try {
+            tileNode = m_session->createComputeNode(tileNodeName);
+            finalNode = m_session->createComputeNode("lluvia/mediapipe/ReduceFinal");
+        } catch (std::exception& e) {
+            return absl::NotFoundError(absl::StrCat("reduction nodes not found, is lluvia_mediapipe_library in library_path? ", e.what()));
+        }
+
+        tileNode->setParameter("mode", ll::Parameter {mode});
+        tileNode->setParameter("pixels_per_invocation", ll::Parameter {reducePixelsPerInvocation});
+        tileNode->setParameter("channel", ll::Parameter {reduction.channel()});
+        tileNode->setParameter("bins", ll::Parameter {reduction.bins()});
+        tileNode->setParameter("min_value", ll::Parameter {reduction.min_value()});
+        tileNode->setParameter("max_value", ll::Parameter {reduction.max_value()});
+        tileNode->bind("in_image", portHandler.imageView);
+        tileNode->init();
+
+        finalNode->setParameter("mode", ll::Parameter {mode});
+        finalNode->setParameter("partial_count", ll::Parameter {(pixelCount + reducePixelsPerInvocation - 1) / reducePixelsPerInvocation});
+        finalNode->setParameter("bins", ll::Parameter {reduction.bins()});
+        finalNode->bind("in_partials", tileNode->getPort("out_partials"));
+        finalNode->init();
+
+        if (isHistogram) {
+            // ReduceFinal clears the histogram counts, which must be zero before the first frame
+            auto guard = std::lock_guard {*m_runMutex};
+            m_session->run(*finalNode);
+        }
+
+        portHandler.packedBuffer = std::static_pointer_cast<ll::Buffer>(finalNode->getPort("out_result"));
+        portHandler.reductionNodes = {tileNode, finalNode};
+
+        // ReduceFinal writes the sum, minimum and maximum of 4 channels, keep the ones of the image
+        switch (reduction.type()) {
+            case lluvia::Reduction::SUM:
+                for (auto c = 0; c < channelCount; ++c) portHandler.resultIndices.push_back(c);
+                break;
+            case lluvia::Reduction::MIN_MAX:
+                for (auto c = 0; c < channelCount; ++c) portHandler.resultIndices.push_back(4 + c);
+                for (auto c = 0; c < channelCount; ++c) portHandler.resultIndices.push_back(8 + c);
+                portHandler.matrixRows = 2;
+                break;
+            default:
+                break;
+        }
+    }
+
+    portHandler.stagingBuffer = m_hostMemory->createBuffer(portHandler.packedBuffer->getSize());
+    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+
+    LOG(INFO) << "InitVectorOutputPort(): " << portHandler.mediapipeTag << " reduction: " << lluvia::Reduction::Type_Name(reduction.type())
+              << ", readback bytes: " << portHandler.stagingBuffer->getSize();
+
+    m_outputHandlers.push_back(std::move(portHandler));
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitInputPortAsImageFrame(const lluvia::PortBinding& portBinding, LluviaFrame& frame) {
+
+    // initialize the port handler for with the protobuffer attributes
+    auto portHandler = PortHandler {};
+    portHandler.mediapipePacketType = portBinding.packet_type();
+    portHandler.mediapipeTag = portBinding.mediapipe_tag();
+    portHandler.lluviaPortName = portBinding.lluvia_port();
+    portHandler.roiTag = portBinding.roi_tag();
+
+    auto& inputImage = frame.input(portBinding.mediapipe_tag()).Get<ImageFrame>();
+    const auto width = inputImage.Width();
+    const auto height = inputImage.Height();
+    portHandler.pixelBytes = inputImage.NumberOfChannels() * inputImage.ByteDepth();
+
+    // TODO: usage flags
+    portHandler.stagingBuffer = m_hostMemory->createBuffer(static_cast<uint64_t>(inputImage.PixelDataSizeStoredContiguously()));
+    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+
+    const ll::ImageUsageFlags imgUsageFlags = { ll::ImageUsageFlagBits::Storage
+                                                | ll::ImageUsageFlagBits::Sampled
+                                                | ll::ImageUsageFlagBits::TransferDst
+                                                | ll::ImageUsageFlagBits::TransferSrc};
+
+    auto imageFormatSupported = false;
+    auto channelCount = ll::ChannelCount::C1;
+    auto channelType = ll::ChannelType::Uint8;
+
+    std::tie(imageFormatSupported, channelCount, channelType) = getLluviaImageFormat(inputImage.Format());
+
+    if (!imageFormatSupported) {
+        return ::mediapipe::UnknownError("image format not supported");
+    }
+
+    const auto imgDesc = ll::ImageDescriptor{1, static_cast<uint32_t >(height), static_cast<uint32_t>(width),
+                                                channelCount, channelType}
+                .setUsageFlags(imgUsageFlags);
+
+    portHandler.image = m_deviceMemory->createImage(imgDesc);
+    portHandler.imageView = portHandler.image->createImageView(ll::ImageViewDescriptor{ll::ImageAddressMode::ClampToBorder,
+                                                                                ll::ImageFilterMode::Nearest,
+                                                                                false,
+                                                                                false});
+
+    MP_RETURN_IF_ERROR(ChangeImageLayout(*portHandler.image, ll::ImageLayout::General));
+
+    // bound to the container node once all inputs are known
+    m_boundPorts[portHandler.lluviaPortName] = portHandler.imageView;
+
+    // finally, add the handler to the list of input handlers
+    m_inputHandlers.push_back(std::move(portHandler));
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitInputPortAsLluviaImage(const lluvia::PortBinding& portBinding, LluviaFrame& frame) {
+
+    // initialize the port handler for with the protobuffer attributes
+    auto portHandler = PortHandler {};
+    portHandler.mediapipePacketType = portBinding.packet_type();
+    portHandler.mediapipeTag = portBinding.mediapipe_tag();
+    portHandler.lluviaPortName = portBinding.lluvia_port();
+
+    if (!portBinding.roi_tag().empty()) {
+        return absl::InvalidArgumentError("roi_tag is not supported for LLUVIA_IMAGE inputs");
+    }
+
+    const auto& lluviaImage = frame.input(portBinding.mediapipe_tag()).Get<LluviaImage>();
+
+    if (lluviaImage.session != m_session) {
+        return absl::FailedPreconditionError("LLUVIA_IMAGE inputs must come from a calculator with the same session_name");
+    }
+
+    // the upstream image is recycled by its producer, the container node binds its own copy
+    const auto sourceImage = lluviaImage.imageView->getImage();
+
+    portHandler.image = m_deviceMemory->createImage(sourceImage->getDescriptor());
+    portHandler.imageView = portHandler.image->createImageView(lluviaImage.imageView->getDescriptor());
+
+    MP_RETURN_IF_ERROR(ChangeImageLayout(*portHandler.image, ll::ImageLayout::General));
+
+    portHandler.sourceIndex = static_cast<int>(m_sourceImages.size());
+    m_sourceImages.push_back(sourceImage);
+
+    // bound to the container node once all inputs are known
+    m_boundPorts[portHandler.lluviaPortName] = portHandler.imageView;
+
+    // finally, add the handler to the list of input handlers
+    m_inputHandlers.push_back(std::move(portHandler));
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitInputPortAsBuffer(const lluvia::PortBinding& portBinding, LluviaFrame& frame) {
+
+    // initialize the port handler for with the protobuffer attributes
+    auto portHandler = PortHandler {};
+    portHandler.mediapipePacketType = portBinding.packet_type();
+    portHandler.mediapipeTag = portBinding.mediapipe_tag();
+    portHandler.lluviaPortName = portBinding.lluvia_port();
+
+    if (!portBinding.roi_tag().empty()) {
+        return absl::InvalidArgumentError("roi_tag is not supported for FLOAT_VECTOR and MATRIX inputs");
+    }
+
+    // the buffer size is set by the first packet
+    const auto& packet = frame.input(portBinding.mediapipe_tag());
+    const auto valueCount = portHandler.mediapipePacketType == lluvia::MATRIX ? static_cast<size_t>(packet.Get<Matrix>().size())
+                                                                               : packet.Get<std::vector<float>>().size();
+
+    if (valueCount == 0) {
+        return absl::InvalidArgumentError(absl::StrCat("input ", portBinding.mediapipe_tag(), " cannot be empty"));
+    }
+
+    const auto size = static_cast<uint64_t>(valueCount * sizeof(float));
+
+    portHandler.stagingBuffer = m_hostMemory->createBuffer(size);
+    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+    portHandler.buffer = m_deviceMemory->createBuffer(size);
+
+    // bound to the container node once all inputs are known
+    m_boundPorts[portHandler.lluviaPortName] = portHandler.buffer;
+
+    // finally, add the handler to the list of input handlers
+    m_inputHandlers.push_back(std::move(portHandler));
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaExecutionContext::InitInputPortAsGpuBuffer(const lluvia::PortBinding& portBinding, LluviaFrame& frame) {
+
+    // initialize the port handler for with the protobuffer attributes
+    auto portHandler = PortHandler {};
+    portHandler.mediapipePacketType = portBinding.packet_type();
+    portHandler.mediapipeTag = portBinding.mediapipe_tag();
+    portHandler.lluviaPortName = portBinding.lluvia_port();
+    portHandler.roiTag = portBinding.roi_tag();
+
+    auto& gpuBuffer = frame.input(portBinding.mediapipe_tag()).Get<GpuBuffer>();
+
+    // Create a read view to get all attributes of the gpu buffer through an ImageFrame.
+    // TODO: Need to check whether nputImage->PixelDataSize() is equal to this other method
+    //       std::unique_ptr<ImageFrame> inputFrame = absl::make_unique<ImageFrame>(
+    //                 ImageFormatForGpuBufferFormat(inputImage->format()), width,
+    //                 height, ImageFrame::kGlDefaultAlignmentBoundary);
+    auto inputImage = gpuBuffer.GetReadView<ImageFrame>();
+    const auto width = inputImage->Width();
+    const auto height = inputImage->Height();
+    portHandler.pixelBytes = inputImage->NumberOfChannels() * inputImage->ByteDepth();
+
+    // TODO: usage flags
+    portHandler.stagingBuffer = m_hostMemory->createBuffer(static_cast<uint64_t>(inputImage->PixelDataSizeStoredContiguously()));
+    portHandler.stagingBufferMappedPtr = portHandler.stagingBuffer->map<uint8_t []>();
+
+    const ll::ImageUsageFlags imgUsageFlags = { ll::ImageUsageFlagBits::Storage
+                                                | ll::ImageUsageFlagBits::Sampled
+                                                | ll::ImageUsageFlagBits::TransferDst
+                                                | ll::ImageUsageFlagBits::TransferSrc};
+
+    auto imageFormatSupported = false;
+    auto channelCount = ll::ChannelCount::C1;
+    auto channelType = ll::ChannelType::Uint8;
+
+    std::tie(imageFormatSupported, channelCount, channelType) = getLluviaImageFormat(inputImage->Format());
+
+    if (!imageFormatSupported) {
+        return ::mediapipe::UnknownError("image format not supported");
+    }
+
+    const auto imgDesc = ll::ImageDescriptor{1, static_cast<uint32_t >(height), static_cast<uint32_t>(width),
+                                                channelCount, channelType}
+                .setUsageFlags(imgUsageFlags);
+
+    portHandler.image = m_deviceMemory->createImage(imgDesc);
+    portHandler.imageView = portHandler.image->createImageView(ll::ImageViewDescriptor{ll::ImageAddressMode::ClampToBorder,
+                                                                                ll::ImageFilterMode::Nearest,
+                                                                                false,
+                                                                                false});
+
+    MP_RETURN_IF_ERROR(ChangeImageLayout(*portHandler.image, ll::ImageLayout::General));
+
+    // bound to the container node once all inputs are known
+    m_boundPorts[portHandler.lluviaPortName] = portHandler.imageView;
+
+    // finally, add the handler to the list of input handlers
+    m_inputHandlers.push_back(std::move(portHandler));
+
+    return ::mediapipe::OkStatus();
+}
+
+} // namespace mediapipe
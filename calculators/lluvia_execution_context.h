@@ -0,0 +1,453 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_EXECUTION_CONTEXT_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_EXECUTION_CONTEXT_H_
+
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/timestamp.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_container_snapshot.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_host_copy.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_image.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_submission_queue.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_trace_recorder.h"
+
+#include <lluvia/core.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mediapipe {
+
+// Pixels adopted by a pooled output ImageFrame. The pool and the ImageFrame
+// hold a reference, the last one deletes it, so ImageFrames can outlive the
+// calculator. Deleters capture the raw pointer, which std::function stores
+// without allocating.
+struct PixelSlot {
+    // staging buffer in unified memory mode, null for host pixels
+    std::shared_ptr<ll::Buffer> buffer;
+    std::unique_ptr<uint8_t [], ll::Buffer::BufferMapDeleter> mappedPtr;
+
+    std::unique_ptr<uint8_t []> hostPixels;
+
+    std::atomic<int> references {1};
+
+    uint8_t* pixels() const noexcept { return buffer ? mappedPtr.get() : hostPixels.get(); }
+
+    // the deleter releases the reference taken here
+    std::function<void(uint8_t*)> acquireDeleter() {
+        references.fetch_add(1, std::memory_order_relaxed);
+        return [this](uint8_t*) { release(); };
+    }
+
+    void release() {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    struct Release {
+        void operator()(PixelSlot* slot) const { slot->release(); }
+    };
+};
+
+using PixelSlotPtr = std::unique_ptr<PixelSlot, PixelSlot::Release>;
+
+struct PortHandler {
+    // the staging buffer used to transfer data from ImageFrame or GPUBuffer to Lluvia/Vulkan memory space
+    std::shared_ptr<ll::Buffer> stagingBuffer;
+    
+    // the pointer to the staging buffer mapped to the host memory space.
+    std::unique_ptr<uint8_t [], ll::Buffer::BufferMapDeleter> stagingBufferMappedPtr;
+
+    // the image in device memory
+    std::shared_ptr<ll::Image> image;
+
+    // the image vide to feed to the container node
+    std::shared_ptr<ll::ImageView> imageView;
+
+    // port name in the Lluvia's container node
+    std::string lluviaPortName;
+
+    // mediapipe tag used to bind port
+    std::string mediapipeTag;
+
+    // type of mediapipe packet expected to be received in this port.
+    lluvia::MediapipePacketType mediapipePacketType;
+
+    // mediapipe tag of the optional region of interest stream. Empty if not used.
+    std::string roiTag;
+
+    // output ports only: packing applied to the image before the readback.
+    lluvia::OutputPacking packing;
+
+    // TENSOR output ports only: element type and channels of the tensor.
+    lluvia::TensorOptions::ElementType tensorElementType {lluvia::TensorOptions::FLOAT32};
+    int tensorChannels {0};
+
+    // output ports only: node packing the image into packedBuffer. Null if the
+    // image is copied to the staging buffer as is.
+    std::shared_ptr<ll::ComputeNode> packNode;
+    std::shared_ptr<ll::Buffer> packedBuffer;
+
+    // FLOAT_VECTOR and MATRIX ports bound to a buffer port of the container node.
+    std::shared_ptr<ll::Buffer> buffer;
+
+    // FLOAT_VECTOR and MATRIX outputs bound to an image: nodes reducing the
+    // image into packedBuffer, and the indices of the reduction values emitted.
+    std::vector<std::shared_ptr<ll::ComputeNode>> reductionNodes;
+    std::vector<int> resultIndices;
+
+    // MATRIX ports only: rows of the matrix, values are in row major order.
+    int matrixRows {1};
+
+    // output ports only: readback policy, see lluvia.ReadbackPolicy.
+    int readbackInterval {1};
+    std::string readbackTriggerTag;
+
+    // output ports only: format of the emitted ImageFrame.
+    ::mediapipe::ImageFormat_Format imageFormat {::mediapipe::ImageFormat_Format_UNKNOWN};
+
+    // IMAGE_FRAME and GPU_BUFFER inputs and output ports: bytes per pixel in the staging buffer.
+    int pixelBytes {0};
+
+    // ports whose region of interest is copied by region nodes instead of the
+    // whole image: index of their region in LluviaExecutionContext, -1 otherwise
+    int regionIndex {-1};
+
+    // LLUVIA_IMAGE input ports: index of their upstream image in
+    // LluviaExecutionContext::m_sourceImages, -1 otherwise
+    int sourceIndex {-1};
+
+    // LLUVIA_IMAGE output ports: images handed to downstream calculators, one per image pool slot.
+    std::vector<std::shared_ptr<ll::ImageView>> imagePool;
+
+    // IMAGE_FRAME output ports emitted without copy: staging buffers adopted by
+    // the emitted ImageFrames, one per image pool slot, instead of stagingBuffer.
+    bool stagingPooled {false};
+    std::vector<PixelSlotPtr> stagingPool;
+
+    // IMAGE_FRAME output ports copied from stagingBuffer: pixels of the
+    // ImageFrames of packetPool, by packet.
+    std::vector<PixelSlotPtr> framePool;
+
+    // IMAGE_FRAME, LLUVIA_IMAGE, FLOAT_VECTOR and MATRIX output ports: packets
+    // emitted by the port, reused with their objects once every copy is
+    // released downstream. One per image pool slot for LLUVIA_IMAGE and
+    // stagingPooled ports.
+    std::vector<Packet> packetPool;
+};
+
+// Region of interest in pixel coordinates, clamped to the image extent.
+struct PixelRect {
+    int x {0};
+    int y {0};
+    int width {0};
+    int height {0};
+
+    bool operator==(const PixelRect& other) const noexcept {
+        return x == other.x && y == other.y && width == other.width && height == other.height;
+    }
+};
+
+// Command buffer of an image pool slot, recorded for the output ports read
+// back, the upstream images of the LLUVIA_IMAGE inputs and the regions of
+// interest of the ports with a regionIndex.
+struct RecordedCommand {
+    uint64_t readbackMask {0};
+
+    // upstream images copied to the LLUVIA_IMAGE inputs by sourceIndex, also
+    // kept alive while the command buffer references them
+    std::vector<std::shared_ptr<ll::Image>> sourceImages;
+
+    // rounded region of each port by regionIndex, empty if every port copies its whole image
+    std::vector<PixelRect> regions;
+
+    // nodes copying the regions by regionIndex, null for whole and empty regions
+    std::vector<std::shared_ptr<ll::ComputeNode>> regionNodes;
+
+    std::unique_ptr<ll::CommandBuffer> cmdBuffer;
+
+    // bytes copied between staging buffers and port images by each run
+    uint64_t transferBytes {0};
+
+    // frame index of the last run, the least recently used region variant is evicted first
+    uint64_t lastFrame {0};
+};
+
+// Packets of one frame. Read from the CalculatorContext by LluviaCalculator or
+// built by LluviaEngine, processed by an execution context, possibly on a
+// worker thread, and emitted by the calculator or returned by the engine.
+struct LluviaFrame {
+    Timestamp timestamp;
+
+    // input packets by tag, empty if the stream has no packet at timestamp
+    std::map<std::string, Packet> inputs;
+
+    // output packets at timestamp and their tag, owned by the port handlers
+    // of the execution context
+    std::vector<std::pair<const std::string*, Packet>> outputs;
+
+    // empty packet if the tag has no packet in this frame
+    const Packet& input(const std::string& tag) const {
+        static const auto emptyPacket = Packet {};
+
+        const auto it = inputs.find(tag);
+        return it == inputs.end() ? emptyPacket : it->second;
+    }
+
+    void addOutput(const std::string& tag, Packet packet) {
+        outputs.emplace_back(&tag, std::move(packet).At(timestamp));
+    }
+};
+
+bool isVectorPacketType(const lluvia::MediapipePacketType packetType);
+
+// Output bindings of container_node followed by the ones of each additional container node.
+google::protobuf::RepeatedPtrField<lluvia::PortBinding> getOutputPortBindings(const lluvia::LluviaCalculatorOptions& options);
+
+// Frame of input images with the sizes and formats declared by the input
+// ports, filled with a deterministic pattern, null if none is declared. Positive width and height replace
+// the declared sizes, as for tiles.
+::mediapipe::StatusOr<std::shared_ptr<LluviaFrame>> makeDeclaredFrame(const lluvia::LluviaCalculatorOptions& options, const int width, const int height);
+
+// The last discrete GPU of devices, or the first device if there is none.
+ll::DeviceDescriptor selectDefaultDevice(const std::vector<ll::DeviceDescriptor>& devices);
+
+// Channel count and type of the Lluvia images holding IMAGE_FRAME inputs of
+// format, false if the format is not supported.
+std::tuple<bool, ll::ChannelCount, ll::ChannelType> getLluviaImageFormat(const mediapipe::ImageFormat_Format format);
+
+// Format of the IMAGE_FRAME outputs of Lluvia images, false if there is none.
+std::tuple<bool, mediapipe::ImageFormat_Format> getMediapipeImageFormat(const ll::ChannelCount channelCount, const ll::ChannelType channelType);
+
+// Session, objects and command buffers running the container node on one device.
+class LluviaExecutionContext {
+public:
+    LluviaExecutionContext(const lluvia::LluviaCalculatorOptions& options, const std::string& nodeName, const std::shared_ptr<LluviaTraceRecorder>& trace);
+
+    /**
+     * Creates the session on the device and loads the libraries and scripts.
+     * sessionName is passed to LluviaSessionRegistry, gpuTrack names the
+     * trace track of the GPU spans.
+     */
+    ::mediapipe::Status Open(const ll::DeviceDescriptor& device, const std::string& sessionName, const std::string& gpuTrack);
+
+    /**
+     * Runs the container node on the inputs of the frame and adds its
+     * outputs. The first call initializes the ports and the container node.
+     */
+    ::mediapipe::Status ProcessFrame(LluviaFrame& frame);
+
+    /**
+     * Initializes the ports and the container node from the inputs of the
+     * frame, then processes it runs times, discarding the outputs.
+     */
+    ::mediapipe::Status Warmup(LluviaFrame& frame, const int runs);
+
+    // GPU time of the last processed frame, read on the thread processing frames
+    std::chrono::nanoseconds getGpuDuration() const noexcept { return m_gpuDuration; }
+
+    // bytes copied between the staging buffers and the images of IMAGE_FRAME,
+    // GPU_BUFFER and TENSOR ports by the last processed frame, read on the
+    // thread processing frames
+    uint64_t getTransferBytes() const noexcept { return m_transferBytes; }
+
+private:
+    ::mediapipe::Status LoadScripts();
+
+    // calls InitNode() on the first frame only, returning its status on every call
+    ::mediapipe::Status InitNodeOnce(LluviaFrame& frame);
+    ::mediapipe::Status InitNode(LluviaFrame& frame);
+    ::mediapipe::Status InitContainerNode();
+    ::mediapipe::Status InitAdditionalContainerNodes();
+
+    // replaces the container node by a snapshot instance with tuned local
+    // shapes, keeping the builder shapes if it cannot be tuned
+    ::mediapipe::Status TuneContainerNode();
+
+    // copies the IMAGE_FRAME inputs of the frame to the port images
+    ::mediapipe::Status UploadInputImages(const LluviaFrame& frame);
+
+    // runs cmdBuffer on the submission thread of a named session if
+    // submission_thread is set, holding m_runMutex otherwise
+    ::mediapipe::Status RunCommandBuffer(ll::CommandBuffer& cmdBuffer);
+
+    // records the transition of image to newLayout and runs it through
+    // RunCommandBuffer, as ll::Image::changeImageLayout submits to the
+    // queue without the session lock
+    ::mediapipe::Status ChangeImageLayout(ll::Image& image, const ll::ImageLayout newLayout);
+
+    // port of container_node if container is 0, of additional_container(container - 1) otherwise
+    std::shared_ptr<ll::Object> getContainerPort(const int container, const std::string& name);
+
+    ::mediapipe::Status InitInputPortAsImageFrame(const lluvia::PortBinding& portBinding, LluviaFrame& frame);
+    ::mediapipe::Status InitInputPortAsGpuBuffer(const lluvia::PortBinding& portBinding, LluviaFrame& frame);
+    ::mediapipe::Status InitInputPortAsLluviaImage(const lluvia::PortBinding& portBinding, LluviaFrame& frame);
+    ::mediapipe::Status InitInputPortAsBuffer(const lluvia::PortBinding& portBinding, LluviaFrame& frame);
+    ::mediapipe::Status InitOutputPort(const lluvia::PortBinding& portBinding, const int container, LluviaFrame& frame);
+    ::mediapipe::Status InitTensorOutputPort(PortHandler portHandler, const lluvia::PortBinding& portBinding);
+    ::mediapipe::Status InitVectorOutputPort(PortHandler portHandler, const lluvia::PortBinding& portBinding, const std::shared_ptr<ll::Object>& port);
+
+    PixelRect getRegionOfInterest(const LluviaFrame& frame, const PortHandler& handler, const int width, const int height);
+
+    // sets m_regions to the rounded regions of interest of the frame, returns
+    // whether they all cover their whole image
+    bool UpdateRegions(const LluviaFrame& frame);
+
+    // node copying region from the staging buffer to the image of handler if
+    // toImage is set, from the image to the staging buffer otherwise
+    ::mediapipe::StatusOr<std::shared_ptr<ll::ComputeNode>> CreateRegionNode(const PortHandler& handler, const PixelRect& region, const bool toImage);
+
+    // records command.cmdBuffer and sets command.transferBytes
+    void RecordCommandBuffer(const size_t poolSlot, RecordedCommand& command);
+    RecordedCommand& getCommandBuffer(const size_t poolSlot, const uint64_t readbackMask);
+
+    // variant of slot poolSlot for m_regions, recorded on the first use
+    ::mediapipe::StatusOr<RecordedCommand*> getRegionCommandBuffer(const size_t poolSlot, const uint64_t readbackMask);
+    uint64_t getReadbackMask(const LluviaFrame& frame) const;
+    ::mediapipe::Status GrowImagePool();
+    ::mediapipe::StatusOr<size_t> AcquirePoolSlot();
+
+    // index in packetPool of a released packet of an IMAGE_FRAME, FLOAT_VECTOR
+    // or MATRIX output copied from its staging buffer, allocated only while
+    // all the previous ones are referenced downstream
+    size_t AcquireOutputPacket(PortHandler& handler);
+
+    const lluvia::LluviaCalculatorOptions m_options;
+
+    ll::DeviceDescriptor m_device {};
+    std::shared_ptr<ll::Session> m_session {};
+    std::shared_ptr<ll::Memory> m_hostMemory {};
+    std::shared_ptr<ll::Memory> m_deviceMemory {};
+
+    // whether m_hostMemory is device local, see lluvia.LluviaCalculatorOptions.MemoryMode
+    bool m_unifiedMemory {false};
+
+    // serializes session->run() between calculators sharing the session
+    std::shared_ptr<std::mutex> m_runMutex {};
+
+    // null if submission_thread is not set or the session is unnamed
+    std::shared_ptr<LluviaSubmissionQueue> m_submissionQueue {};
+
+    // copies between ImageFrames and staging buffers, shared with the
+    // calculators using the same host_copy_threads
+    std::shared_ptr<LluviaHostCopyEngine> m_hostCopy {};
+
+    // command buffers of each image pool slot, differing only in the
+    // LLUVIA_IMAGE output images they copy to. Each slot holds one variant
+    // per mask of output ports read back, bit i for m_outputHandlers[i], and
+    // upstream images of the LLUVIA_IMAGE inputs, recorded the first time
+    // they are used.
+    std::vector<std::multimap<uint64_t, RecordedCommand>> m_cmdBuffers {};
+    uint64_t m_allOutputsMask {0};
+
+    // variants of each image pool slot for frames where a region of interest
+    // does not cover its whole image, at most kMaxRegionCommands per slot
+    std::vector<std::vector<RecordedCommand>> m_regionCmdBuffers {};
+
+    // rounded regions of interest of the current frame, by PortHandler::regionIndex
+    std::vector<PixelRect> m_regions {};
+
+    // upstream images of the LLUVIA_IMAGE inputs of the current frame, by PortHandler::sourceIndex
+    std::vector<std::shared_ptr<ll::Image>> m_sourceImages {};
+
+    // number of frames processed, for readback policies
+    uint64_t m_frameIndex {0};
+
+    // null if trace_path is not set
+    std::shared_ptr<LluviaTraceRecorder> m_trace {};
+    const std::string m_nodeName;
+    std::string m_gpuTrack {};
+    std::unique_ptr<ll::Duration> m_duration {};
+    std::chrono::nanoseconds m_gpuDuration {0};
+    uint64_t m_transferBytes {0};
+
+    // the container node, either initialized through Lua or instantiated from a snapshot
+    std::shared_ptr<ll::ContainerNode> m_containerNode {};
+    std::unique_ptr<LluviaContainerInstance> m_containerInstance {};
+
+    // one per additional_container, always initialized through Lua
+    std::vector<std::shared_ptr<ll::ContainerNode>> m_additionalContainerNodes {};
+
+    // objects bound to the container node input ports
+    std::map<std::string, std::shared_ptr<ll::Object>> m_boundPorts {};
+
+    // snapshot read in Open(), null if not used
+    std::unique_ptr<lluvia::ContainerSnapshot> m_snapshot {};
+    bool m_scriptsLoaded {false};
+
+    std::vector<mediapipe::PortHandler> m_inputHandlers;
+    std::vector<mediapipe::PortHandler> m_outputHandlers;
+
+    std::once_flag m_configureNode {};
+    ::mediapipe::Status m_initStatus {};
+};
+
+// Thread running the frames routed to one execution context, in submission order.
+class LluviaDeviceWorker {
+public:
+    // called on the worker thread with the status of a finished or cancelled frame
+    using DoneCallback = std::function<void(::mediapipe::Status)>;
+
+    // maxQueuedFrames bounds the frames submitted and not finished, 0 does not bound them
+    LluviaDeviceWorker(std::unique_ptr<LluviaExecutionContext> context, const int maxQueuedFrames);
+
+    // finishes the frames queued before stopping
+    ~LluviaDeviceWorker();
+
+    // both block while maxQueuedFrames frames are queued
+    std::shared_future<::mediapipe::Status> submit(const std::shared_ptr<LluviaFrame>& frame);
+    void submit(const std::shared_ptr<LluviaFrame>& frame, DoneCallback done);
+
+    // completes the frames queued and not started with a Cancelled error,
+    // on the calling thread. The running frame finishes.
+    void cancel();
+
+    // frames submitted and not finished yet
+    int getQueuedFrames() const noexcept { return m_queuedFrames.load(); }
+
+    // only used by the caller while no frame is queued
+    LluviaExecutionContext& getContext() noexcept { return *m_context; }
+
+private:
+    struct Task {
+        std::shared_ptr<LluviaFrame> frame;
+        DoneCallback done;
+    };
+
+    void run();
+
+    std::unique_ptr<LluviaExecutionContext> m_context;
+    const int m_maxQueuedFrames;
+
+    std::mutex m_mutex {};
+    std::condition_variable m_taskCondition {};
+    std::condition_variable m_slotCondition {};
+    std::deque<Task> m_tasks {};
+    bool m_stop {false};
+
+    // changed holding m_mutex, read without it
+    std::atomic<int> m_queuedFrames {0};
+
+    std::thread m_thread;
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_EXECUTION_CONTEXT_H_
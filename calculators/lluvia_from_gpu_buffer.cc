@@ -12,14 +12,20 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "absl/strings/str_cat.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/util/resource_util.h"
 
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_from_gpu_buffer.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_session_registry.h"
+
 #include <lluvia/core.h>
 
+#include <cstring>
+#include <deque>
 #include <memory>
 #include <mutex>
 
@@ -33,16 +39,20 @@
 namespace mediapipe {
 
 /**
- * A Deleter that does nothing :)
+ * Pixel buffer object a frame is read back into, together with the fence
+ * signaled once glReadPixels has completed.
  */
-struct NopDeleter{
-
-    template<typename T>
-    void operator ()(T* ptr) const {
-    }
+struct PixelPackBuffer {
+    GLuint pbo {0};
+    GLsync fence {nullptr};
 };
 
-// Convert an input image (GpuBuffer or ImageFrame) to ImageFrame.
+// Runs a Lluvia compute node on GpuBuffer frames.
+//
+// Frames are read back from GL into a ring of pixel buffer objects without
+// waiting for the transfer. Each Process() call starts the readback of frame N
+// and then runs the compute node on frame N-1, whose readback has had a whole
+// frame to complete. Outputs keep the timestamp of their input frame.
 class LluviaFromGPUBufferCalculator : public CalculatorBase {
 
     public:
@@ -52,12 +62,17 @@ class LluviaFromGPUBufferCalculator : public CalculatorBase {
 
         ::mediapipe::Status Open(CalculatorContext* cc) override;
         ::mediapipe::Status Process(CalculatorContext* cc) override;
+        ::mediapipe::Status Close(CalculatorContext* cc) override;
 
     private:
-        void InitNode(const mediapipe::GpuBuffer*);
+        ::mediapipe::Status InitNode(const mediapipe::GpuBuffer& inputImage);
+        ::mediapipe::Status ProcessPendingFrame(CalculatorContext* cc);
 
     private:
+        lluvia::LluviaFromGpuBufferCalculatorOptions m_options;
+
         std::shared_ptr<ll::Session> m_session {};
+        std::shared_ptr<std::mutex> m_runMutex {};
         std::shared_ptr<ll::Memory> m_deviceLocalMemory {};
         std::shared_ptr<ll::Memory> m_stagingMemory {};
 
@@ -70,13 +85,18 @@ class LluviaFromGPUBufferCalculator : public CalculatorBase {
         std::shared_ptr<ll::Image> m_inputImage {};
         std::shared_ptr<ll::ImageView> m_inputImageView {};
 
-        std::mutex m_outputStagingBufferLock {};
         std::shared_ptr<ll::Buffer> m_outputStagingBuffer {};
         std::unique_ptr<uint8_t[], ll::Buffer::BufferMapDeleter> m_outputStagingBufferMapped {};
         std::shared_ptr<ll::Image> m_outputImage {};
         std::shared_ptr<ll::ImageView> m_outputImageView {};
+        GpuBufferFormat m_outputFormat {GpuBufferFormat::kUnknown};
 
-        std::once_flag m_configureNode {};
+        // readback ring and the timestamps of the frames in flight, oldest first
+        std::vector<PixelPackBuffer> m_pixelPackBuffers {};
+        size_t m_nextPixelPackBuffer {0};
+        std::deque<std::pair<size_t, Timestamp>> m_pendingFrames {};
+
+        bool m_nodeInitialized {false};
 
 #if !MEDIAPIPE_GPU_BUFFER_USE_CV_PIXEL_BUFFER
         GlCalculatorHelper helper_;
@@ -98,17 +118,23 @@ class LluviaFromGPUBufferCalculator : public CalculatorBase {
 
     ::mediapipe::Status LluviaFromGPUBufferCalculator::Open(CalculatorContext* cc) {
 
-        // Inform the framework that we always output at the same timestamp
-        // as we receive a packet at.
-        cc->SetOffset(TimestampDiff(0));
+        // No SetOffset(): outputs are emitted one Process() call after their input.
 #if !MEDIAPIPE_GPU_BUFFER_USE_CV_PIXEL_BUFFER
         MP_RETURN_IF_ERROR(helper_.Open(cc));
 #endif  // MEDIAPIPE_GPU_BUFFER_USE_CV_PIXEL_BUFFER
 
+        m_options = cc->Options<lluvia::LluviaFromGpuBufferCalculatorOptions>();
+        RET_CHECK_GE(m_options.pbo_ring_size(), 2) << "pbo_ring_size must be at least 2 to overlap readback and compute";
+
         auto sessionDesc = ll::SessionDescriptor{}
-                               .enableDebug(true);
+                               .enableDebug(m_options.enable_debug());
+
+        auto sessionHandle = LluviaSessionRegistry::getOrCreate(m_options.session_name(), false, [&sessionDesc]() {
+            return ll::Session::create(sessionDesc);
+        });
 
-        m_session = ll::Session::create(sessionDesc);
+        m_session = sessionHandle.session;
+        m_runMutex = sessionHandle.runMutex;
 
         auto memoryProperties = ll::MemoryPropertyFlagBits::HostVisible | ll::MemoryPropertyFlagBits::HostCoherent;
         m_stagingMemory = m_session->createMemory(memoryProperties, 0, false);
@@ -118,93 +144,171 @@ class LluviaFromGPUBufferCalculator : public CalculatorBase {
         LOG(INFO) << "LluviaCalculator: memories created: stagingMemory: " << m_stagingMemory->getPageSize() << " deviceLocalMemory: " << m_deviceLocalMemory->getPageSize();
 
         // path to the .zip containing all the nodes
-        auto string_path = std::string {};
-        ASSIGN_OR_RETURN(string_path, mediapipe::PathToResourceAsFile("lluvia_node_library.zip"));
+        auto libraryPaths = std::vector<std::string> {m_options.library_path().begin(), m_options.library_path().end()};
+        if (libraryPaths.empty()) {
+            libraryPaths.push_back("lluvia_node_library.zip");
+        }
+
+        for (const auto& libraryPath : libraryPaths) {
 
-        m_session->loadLibrary(string_path);
+            auto string_path = std::string {};
+            ASSIGN_OR_RETURN(string_path, mediapipe::PathToResourceAsFile(libraryPath));
+
+            m_session->loadLibrary(string_path);
+        }
 
         return ::mediapipe::OkStatus();
     }
 
     ::mediapipe::Status LluviaFromGPUBufferCalculator::Process(CalculatorContext* cc) {
 
-        auto guard = std::lock_guard {m_outputStagingBufferLock};
-
 #ifdef HAVE_GPU_BUFFER
-        if (cc->Inputs().Index(0).Value().ValidateAsType<GpuBuffer>().ok()) {
+        const auto& input = cc->Inputs().Index(0).Get<GpuBuffer>();
+
+        // init the internals given a concrete GPUBuffer
+        if (!m_nodeInitialized) {
+            MP_RETURN_IF_ERROR(InitNode(input));
+            m_nodeInitialized = true;
+        }
+
+        // all pixel buffer objects hold frames not yet processed
+        if (m_pendingFrames.size() == m_pixelPackBuffers.size()) {
+            MP_RETURN_IF_ERROR(ProcessPendingFrame(cc));
+        }
+
+        // start the readback of this frame into the next pixel buffer object, glReadPixels
+        // returns once the transfer is queued
+        const auto slot = m_nextPixelPackBuffer;
+        m_nextPixelPackBuffer = (m_nextPixelPackBuffer + 1) % m_pixelPackBuffers.size();
 
-            const auto& input = cc->Inputs().Index(0).Get<GpuBuffer>();
+        MP_RETURN_IF_ERROR(helper_.RunInGlContext([this, &input, slot]() -> ::mediapipe::Status {
 
-            // init the internals given a concrete GPUBuffer
-            std::call_once(m_configureNode, &LluviaFromGPUBufferCalculator::InitNode, this, &input);
+            auto src = helper_.CreateSourceTexture(input);
 
-            // transfer the GPUBuffer pixel content to the input stagging buffer (already mapped)
-            helper_.RunInGlContext([this, &input, &cc]() {
+            helper_.BindFramebuffer(src);
+            const auto info = GlTextureInfoForGpuBufferFormat(input.format(), 0);
 
-                auto src = helper_.CreateSourceTexture(input);
+            auto& pixelPackBuffer = m_pixelPackBuffers[slot];
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelPackBuffer.pbo);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, src.width(), src.height(), info.gl_format, info.gl_type, nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-                helper_.BindFramebuffer(src);
-                const auto info = GlTextureInfoForGpuBufferFormat(input.format(), 0);
-                glReadPixels(0, 0, src.width(), src.height(), info.gl_format,
-                             info.gl_type, &this->m_inputStagingBufferMapped[0]);
+            pixelPackBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+
+            src.Release();
+            return ::mediapipe::OkStatus();
+        }));
 
-                glFlush();
-                src.Release();
-            });
+        m_pendingFrames.emplace_back(slot, cc->InputTimestamp());
+
+        // run the compute node on the previous frame while this one is read back
+        if (m_pendingFrames.size() > 1) {
+            MP_RETURN_IF_ERROR(ProcessPendingFrame(cc));
         }
 #endif  // defined(HAVE_GPU_BUFFER)
 
+        return ::mediapipe::OkStatus();
+    }
+
+    ::mediapipe::Status LluviaFromGPUBufferCalculator::Close(CalculatorContext* cc) {
+
+        // flush the frames still being read back
+        while (!m_pendingFrames.empty()) {
+            MP_RETURN_IF_ERROR(ProcessPendingFrame(cc));
+        }
+
+        if (!m_pixelPackBuffers.empty()) {
+            MP_RETURN_IF_ERROR(helper_.RunInGlContext([this]() -> ::mediapipe::Status {
+                for (auto& pixelPackBuffer : m_pixelPackBuffers) {
+                    glDeleteBuffers(1, &pixelPackBuffer.pbo);
+                }
+                m_pixelPackBuffers.clear();
+                return ::mediapipe::OkStatus();
+            }));
+        }
+
+        return ::mediapipe::OkStatus();
+    }
+
+    ::mediapipe::Status LluviaFromGPUBufferCalculator::ProcessPendingFrame(CalculatorContext* cc) {
+
+        const auto slot = m_pendingFrames.front().first;
+        const auto timestamp = m_pendingFrames.front().second;
+        m_pendingFrames.pop_front();
+
+        const auto inputSize = static_cast<GLsizeiptr>(m_inputStagingBuffer->getSize());
+
+        // wait for the readback and copy the pixels to the Lluvia staging buffer
+        MP_RETURN_IF_ERROR(helper_.RunInGlContext([this, slot, inputSize]() -> ::mediapipe::Status {
+
+            auto& pixelPackBuffer = m_pixelPackBuffers[slot];
+
+            glClientWaitSync(pixelPackBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(pixelPackBuffer.fence);
+            pixelPackBuffer.fence = nullptr;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelPackBuffer.pbo);
+            const auto* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, inputSize, GL_MAP_READ_BIT);
+            RET_CHECK(pixels != nullptr) << "glMapBufferRange failed: " << glGetError();
+
+            std::memcpy(&m_inputStagingBufferMapped[0], pixels, inputSize);
+
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            return ::mediapipe::OkStatus();
+        }));
+
         // Run the Lluvia graph
-        m_session->run(*m_cmdBuffer);
+        {
+            auto guard = std::lock_guard {*m_runMutex};
+            m_session->run(*m_cmdBuffer);
+        }
 
+        // transfer the pixels from outputImage to a GpuBuffer
+        return helper_.RunInGlContext([this, &cc, timestamp]() -> ::mediapipe::Status {
 
-        // transfer the pixels from outputImage to GPUBuffer
-        helper_.RunInGlContext([this, &cc]() {
+            const auto width = static_cast<int>(m_outputImage->getWidth());
+            const auto height = static_cast<int>(m_outputImage->getHeight());
 
-            std::unique_ptr<ImageFrame> outputImage = absl::make_unique<ImageFrame>(
-                    ImageFormat::GRAY8,
-                    this->m_outputImage->getWidth(),
-                    this->m_outputImage->getHeight(),
-                    this->m_outputImage->getSize() / this->m_outputImage->getHeight(),
-                    &(this->m_outputStagingBufferMapped[0]),
-                    NopDeleter{}
-                    );
+            auto dst = helper_.CreateDestinationTexture(width, height, m_outputFormat);
+            const auto info = GlTextureInfoForGpuBufferFormat(m_outputFormat, 0);
 
-            auto src = this->helper_.CreateSourceTexture(*outputImage);
-            auto output = src.GetFrame<GpuBuffer>();
+            glBindTexture(dst.target(), dst.name());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(dst.target(), 0, 0, 0, width, height, info.gl_format, info.gl_type, &m_outputStagingBufferMapped[0]);
+            glBindTexture(dst.target(), 0);
             glFlush();
 
-            // FIXME timestamp
-            cc->Outputs().Index(0).Add(output.release(), cc->InputTimestamp());
-            src.Release();
+            auto output = dst.GetFrame<GpuBuffer>();
+            cc->Outputs().Index(0).Add(output.release(), timestamp);
+            dst.Release();
 
-            LOG_EVERY_N(INFO, 300) << "LluviaCalculator: shape [h:"
-                                   << std::to_string(outputImage->Height()) << ", w:" << std::to_string(outputImage->Width()) << "], format: "
-                                   << std::to_string(static_cast<int>(outputImage->Format())) << ", channel size: "
-                                   << std::to_string(outputImage->ChannelSize());
-        });
+            LOG_EVERY_N(INFO, 300) << "LluviaCalculator: shape [h:" << height << ", w:" << width << "]";
 
-        return ::mediapipe::OkStatus();
+            return ::mediapipe::OkStatus();
+        });
     }
 
-    void LluviaFromGPUBufferCalculator::InitNode(const mediapipe::GpuBuffer* inputImage) {
+    ::mediapipe::Status LluviaFromGPUBufferCalculator::InitNode(const mediapipe::GpuBuffer& inputImage) {
 
-        const auto width = inputImage->width();
-        const auto height = inputImage->height();
+        const auto width = inputImage.width();
+        const auto height = inputImage.height();
 
         LOG(INFO) << "LluviaCalculator: InitNode() width: " << width << " height: " << height;
 
+        RET_CHECK(inputImage.format() == GpuBufferFormat::kBGRA32) << "only kBGRA32 GpuBuffer inputs are supported";
+
         ///////////////////////////////////////////////////
         // Input image
         ///////////////////////////////////////////////////
 
-        // Create an ImageFrame in order to know the raw byte size I need to
-        // allocate in the staging buffer
-        std::unique_ptr<ImageFrame> inputFrame = absl::make_unique<ImageFrame>(
-                ImageFormatForGpuBufferFormat(inputImage->format()), width,
-                height, ImageFrame::kGlDefaultAlignmentBoundary);
+        // glReadPixels writes rows without padding
+        const auto inputBytes = static_cast<uint64_t>(width) * height * 4;
 
-        m_inputStagingBuffer = m_stagingMemory->createBuffer(inputFrame->PixelDataSizeStoredContiguously());
+        m_inputStagingBuffer = m_stagingMemory->createBuffer(inputBytes);
 
         // permanently map the staging buffers
         m_inputStagingBufferMapped = m_inputStagingBuffer->map<uint8[]>();
@@ -214,10 +318,11 @@ class LluviaFromGPUBufferCalculator : public CalculatorBase {
         ///////////////////////////////////////////////////
         // Compute node
         ///////////////////////////////////////////////////
-
-        // FIXME: the name of the node should be passed as parameter
-        m_computeNode =  m_session->createComputeNode("lluvia/RGBA2Gray");
-
+        try {
+            m_computeNode = m_session->createComputeNode(m_options.compute_node());
+        } catch (std::exception& e) {
+            return absl::NotFoundError(absl::StrCat("compute node ", m_options.compute_node(), " not found: ", e.what()));
+        }
 
         const ll::ImageUsageFlags imgUsageFlags = { ll::ImageUsageFlagBits::Storage
                                                     | ll::ImageUsageFlagBits::Sampled
@@ -234,32 +339,69 @@ class LluviaFromGPUBufferCalculator : public CalculatorBase {
                                                                                  false,
                                                                                  false});
 
+        // ll::Image::changeImageLayout() submits to the queue without the session lock
+        auto layoutCmdBuffer = m_session->createCommandBuffer();
+        layoutCmdBuffer->begin();
+        layoutCmdBuffer->changeImageLayout(*m_inputImage, ll::ImageLayout::General);
+        layoutCmdBuffer->end();
 
-        m_inputImage->changeImageLayout(ll::ImageLayout::General);
-
-        // FIXME: input name should be passed as parameter
-        m_computeNode->bind("in_rgba", m_inputImageView);
-        m_computeNode->init();
+        {
+            auto guard = std::lock_guard {*m_runMutex};
+            m_session->run(*layoutCmdBuffer);
+        }
 
+        try {
+            m_computeNode->bind(m_options.input_port(), m_inputImageView);
+            m_computeNode->init();
 
-        ///////////////////////////////////////////////////
-        // Output image
-        ///////////////////////////////////////////////////
+            ///////////////////////////////////////////////////
+            // Output image
+            ///////////////////////////////////////////////////
+            m_outputImageView = std::static_pointer_cast<ll::ImageView>(m_computeNode->getPort(m_options.output_port()));
+        } catch (std::exception& e) {
+            return absl::InvalidArgumentError(absl::StrCat("error initializing compute node ", m_options.compute_node(), ": ", e.what()));
+        }
 
-        // FIXME: output name should be passed as parameter
-        m_outputImageView = std::static_pointer_cast<ll::ImageView>(m_computeNode->getPort("out_gray"));
         m_outputImage = m_outputImageView->getImage();
 
-        std::unique_ptr<ImageFrame> outputFrame = absl::make_unique<ImageFrame>(
-                ImageFormat_Format_GRAY8, width,
-                height, ImageFrame::kGlDefaultAlignmentBoundary);
+        if (m_outputImage->getChannelType() != ll::ChannelType::Uint8) {
+            return absl::InvalidArgumentError("output image must have Uint8 channels");
+        }
 
-        m_outputStagingBuffer = m_stagingMemory->createBuffer(outputFrame->PixelDataSizeStoredContiguously());
+        switch (m_outputImage->getChannelCount()) {
+            case ll::ChannelCount::C1:
+                m_outputFormat = GpuBufferFormat::kOneComponent8;
+                break;
+            case ll::ChannelCount::C4:
+                m_outputFormat = GpuBufferFormat::kBGRA32;
+                break;
+            default:
+                return absl::InvalidArgumentError("output image must have 1 or 4 channels");
+        }
+
+        m_outputStagingBuffer = m_stagingMemory->createBuffer(m_outputImage->getMinimumSize());
         m_outputStagingBufferMapped = m_outputStagingBuffer->map<uint8_t[]>();
 
         LOG(INFO) << "LluviaCalculator: InitNode() outputStagingBuffer : " << m_outputStagingBuffer->getAllocationInfo().page << " size: " << m_outputStagingBuffer->getSize();
 
 
+        ///////////////////////////////////////////////////
+        // Pixel buffer objects
+        ///////////////////////////////////////////////////
+        MP_RETURN_IF_ERROR(helper_.RunInGlContext([this, inputBytes]() -> ::mediapipe::Status {
+
+            m_pixelPackBuffers.resize(m_options.pbo_ring_size());
+
+            for (auto& pixelPackBuffer : m_pixelPackBuffers) {
+                glGenBuffers(1, &pixelPackBuffer.pbo);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelPackBuffer.pbo);
+                glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(inputBytes), nullptr, GL_STREAM_READ);
+            }
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            return ::mediapipe::OkStatus();
+        }));
+
         ///////////////////////////////////////////////////
         // Command buffer
         ///////////////////////////////////////////////////
@@ -290,6 +432,7 @@ class LluviaFromGPUBufferCalculator : public CalculatorBase {
         m_cmdBuffer->end();
 
         LOG(INFO) << "LluviaCalculator: InitNode() finish";
+        return ::mediapipe::OkStatus();
     }
 
 }  // namespace mediapipe
@@ -0,0 +1,111 @@
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/sink.h"
+
+#include "tools/cpp/runfiles/runfiles.h"
+using bazel::tools::cpp::runfiles::Runfiles;
+
+#include <memory>
+
+namespace mediapipe {
+
+namespace {
+
+TEST(LluviaFromGpuBufferCalculatorTest, TestGrayOutput) {
+
+    auto runfiles = Runfiles::CreateForTest(nullptr);
+    ASSERT_NE(nullptr, runfiles);
+
+    auto libraryPath = runfiles->Rlocation("lluvia/lluvia/nodes/lluvia_node_library.zip");
+
+    auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(
+        absl::Substitute(
+            R"pb(
+                input_stream: "input_image"
+
+                node {
+                    calculator: "ImageFrameToGpuBufferCalculator"
+                    input_stream: "input_image"
+                    output_stream: "input_gpu"
+                }
+
+                node {
+                    calculator: "LluviaFromGPUBufferCalculator"
+                    input_stream: "input_gpu"
+                    output_stream: "output_gpu"
+                    node_options {
+                        [type.googleapis.com/lluvia.LluviaFromGpuBufferCalculatorOptions]: {
+                            library_path: "$0"
+                            compute_node: "lluvia/color/RGBA2Gray"
+                            input_port: "in_rgba"
+                            output_port: "out_gray"
+                            pbo_ring_size: 3
+                        }
+                    }
+                }
+
+                node {
+                    calculator: "GpuBufferToImageFrameCalculator"
+                    input_stream: "output_gpu"
+                    output_stream: "output_image"
+                }
+            )pb",
+            libraryPath
+        )
+    );
+
+    auto outputPackets = std::vector<Packet> {};
+    tool::AddVectorSink("output_image", &graphConfig, &outputPackets);
+
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(graphConfig));
+    MP_ASSERT_OK(graph.StartRun({}));
+
+    // uniform gray frames, the RGBA2Gray output equals the input channels
+    constexpr auto frameCount = 6;
+    for (auto t = 0; t < frameCount; ++t) {
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 320, 240);
+        const auto value = static_cast<uint8>(20 + 30 * t);
+
+        for (auto y = 0; y < inputImage->Height(); ++y) {
+            auto* row = inputImage->MutablePixelData() + y * inputImage->WidthStep();
+            for (auto x = 0; x < inputImage->Width(); ++x) {
+                row[4 * x + 0] = value;
+                row[4 * x + 1] = value;
+                row[4 * x + 2] = value;
+                row[4 * x + 3] = 255;
+            }
+        }
+
+        MP_ASSERT_OK(graph.AddPacketToInputStream("input_image", Adopt(inputImage.release()).At(Timestamp(t))));
+    }
+
+    MP_ASSERT_OK(graph.CloseAllInputStreams());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+
+    // outputs lag one frame, the last one is emitted on Close()
+    ASSERT_EQ(outputPackets.size(), frameCount);
+
+    for (auto t = 0; t < frameCount; ++t) {
+
+        EXPECT_EQ(outputPackets[t].Timestamp(), Timestamp(t));
+
+        auto& outImage = outputPackets[t].Get<ImageFrame>();
+        ASSERT_EQ(outImage.Width(), 320);
+        ASSERT_EQ(outImage.Height(), 240);
+        ASSERT_EQ(outImage.NumberOfChannels(), 1);
+
+        const auto expected = 20 + 30 * t;
+        for (auto y = 0; y < outImage.Height(); y += 17) {
+            EXPECT_NEAR(outImage.PixelData()[y * outImage.WidthStep() + y], expected, 1);
+        }
+    }
+}
+
+} // namespace
+} // namespace mediapipe
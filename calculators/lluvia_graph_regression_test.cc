@@ -0,0 +1,588 @@
+// Golden output and performance regression suite for the shipped graphs.
+//
+// The LluviaCalculator node of each graph is run with its own options and
+// Lua script on deterministic synthetic motion sequences. The GPU buffer
+// conversions and flow limiter around it in the mobile graphs are dropped,
+// the node is fed ImageFrames directly.
+//
+// Each run is checked three ways:
+//
+// * properties that hold by construction, such as the grayscale values of
+//   BGRA2Gray or the determinism of the optical flow graphs.
+// * against test_data/goldens/<graph>_<sequence>.golden, with a per graph
+//   tolerance.
+// * the median GPU and wall time per frame against the baselines in
+//   test_data/graph_baselines.txt. Times more than regressionThreshold
+//   above their baseline fail the test. Baselines are timings of lavapipe
+//   and only checked when the calculators run on it.
+//
+// A test with a missing golden or baseline is skipped once its other checks
+// ran, listing what is missing.
+//
+// The outputs and timings of every run are written to the test outputs
+// directory as <graph>_<sequence>.golden and graph_performance.txt. Goldens
+// and baselines are updated by copying those files into test_data after a
+// run on lavapipe, the only Vulkan device visible with
+//
+//     bazel test --test_env=VK_ICD_FILENAMES=<lvp_icd.x86_64.json> \
+//         //mediapipe/lluvia-mediapipe/calculators:lluvia_graph_regression_test
+//
+// The test outputs are in bazel-testlogs/<test path>/test.outputs/outputs.zip.
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/sink.h"
+
+#include "tools/cpp/runfiles/runfiles.h"
+using bazel::tools::cpp::runfiles::Runfiles;
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_execution_context.h"
+
+#include <lluvia/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mediapipe {
+
+namespace {
+
+constexpr auto frameWidth = 160;
+constexpr auto frameHeight = 120;
+constexpr auto frameCount = 8;
+
+// frames left out of the timings, the first one includes the node initialization
+constexpr auto warmupFrames = 2;
+
+// relative increase of a median frame time over its baseline reported as a regression
+constexpr auto regressionThreshold = 0.25;
+
+constexpr auto runfilesPrefix = "mediapipe/mediapipe/lluvia-mediapipe/";
+
+// lavapipe reports the name of its LLVM rasterizer
+constexpr auto referenceDeviceName = "llvmpipe";
+
+// A textured pattern translating by (vx, vy) pixels per frame.
+struct MotionSequence {
+    const char* name;
+    double vx;
+    double vy;
+};
+
+constexpr auto staticSequence = MotionSequence {"static", 0.0, 0.0};
+constexpr auto translationSequence = MotionSequence {"translation", 1.0, 0.5};
+
+struct GraphCase {
+    const char* name;
+
+    // relative to runfilesPrefix
+    const char* graphPath;
+    const char* scriptPath;
+
+    // maximum absolute difference of each value to the golden, and fraction
+    // of the values allowed above it
+    int tolerance;
+    double outlierFraction;
+};
+
+constexpr auto bgra2GrayGraph = GraphCase {"BGRA2Gray", "examples/desktop/graphs/BGRA2Gray/graph.pbtxt", "examples/desktop/graphs/BGRA2Gray/script.lua", 1, 0.0};
+constexpr auto colorMappingGraph = GraphCase {"ColorMapping", "graphs/mobile/ColorMapping/color_mapping.pbtxt", "graphs/mobile/ColorMapping/color_mapping.lua", 1, 0.0};
+constexpr auto hornSchunckGraph = GraphCase {"HornSchunck", "graphs/mobile/HornSchunck/horn_schunck.pbtxt", "graphs/mobile/HornSchunck/horn_schunck.lua", 2, 0.001};
+constexpr auto flowFilterGraph = GraphCase {"FlowFilter", "graphs/mobile/FlowFilter/flowfilter.pbtxt", "graphs/mobile/FlowFilter/flowfilter.lua", 2, 0.001};
+
+// Output frames without row padding, and per frame times in microseconds.
+struct GraphRun {
+    int width {0};
+    int height {0};
+    int channels {0};
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<double> wallTimes;
+    std::vector<double> gpuTimes;
+};
+
+std::string getOutputsDirectory() {
+
+    const auto* outputs = std::getenv("TEST_UNDECLARED_OUTPUTS_DIR");
+    return outputs != nullptr ? outputs : std::getenv("TEST_TMPDIR");
+}
+
+uint8_t toUint8(const double value) {
+    return static_cast<uint8_t>(std::clamp(std::round(value), 0.0, 255.0));
+}
+
+std::unique_ptr<ImageFrame> MakeMotionFrame(const MotionSequence& sequence, const int t) {
+
+    auto frame = absl::make_unique<ImageFrame>(ImageFormat::SBGRA, frameWidth, frameHeight);
+
+    constexpr auto twoPi = 6.283185307179586;
+
+    for (auto y = 0; y < frameHeight; ++y) {
+
+        auto* row = frame->MutablePixelData() + y * frame->WidthStep();
+
+        for (auto x = 0; x < frameWidth; ++x) {
+
+            const auto u = x - sequence.vx * t;
+            const auto v = y - sequence.vy * t;
+
+            const auto value = 128.0 + 60.0 * std::sin(twoPi * u / 23.0) * std::sin(twoPi * v / 17.0)
+                             + 40.0 * std::cos(twoPi * (u + 2.0 * v) / 41.0);
+
+            row[4 * x + 0] = toUint8(value);
+            row[4 * x + 1] = toUint8(0.8 * value + 20.0);
+            row[4 * x + 2] = toUint8(255.0 - value);
+            row[4 * x + 3] = 255;
+        }
+    }
+
+    return frame;
+}
+
+std::vector<uint8_t> CopyPixels(const ImageFrame& frame) {
+
+    const auto rowBytes = frame.Width() * frame.NumberOfChannels() * frame.ByteDepth();
+
+    auto pixels = std::vector<uint8_t>(rowBytes * frame.Height());
+    for (auto y = 0; y < frame.Height(); ++y) {
+        std::copy_n(frame.PixelData() + y * frame.WidthStep(), rowBytes, pixels.data() + y * rowBytes);
+    }
+
+    return pixels;
+}
+
+// Graph running the LluviaCalculator node of the shipped graph, with runfiles paths and a trace.
+::mediapipe::StatusOr<CalculatorGraphConfig> LoadGraphConfig(const Runfiles& runfiles, const GraphCase& graphCase, const std::string& tracePath) {
+
+    auto file = std::ifstream {runfiles.Rlocation(absl::StrCat(runfilesPrefix, graphCase.graphPath))};
+    RET_CHECK(file.good()) << "cannot open graph " << graphCase.graphPath;
+
+    auto stream = std::stringstream {};
+    stream << file.rdbuf();
+
+    const auto libraryPath = runfiles.Rlocation("lluvia/lluvia/nodes/lluvia_node_library.zip");
+    const auto scriptPath = runfiles.Rlocation(absl::StrCat(runfilesPrefix, graphCase.scriptPath));
+
+    // the desktop graphs take the library and script paths as $0 and $1
+    auto shippedConfig = CalculatorGraphConfig {};
+    RET_CHECK(ParseTextProto(absl::Substitute(stream.str(), libraryPath, scriptPath), &shippedConfig)) << "cannot parse graph " << graphCase.graphPath;
+
+    const auto shippedNode = std::find_if(shippedConfig.node().begin(), shippedConfig.node().end(),
+                                          [](const auto& node) { return node.calculator() == "LluviaCalculator"; });
+    RET_CHECK(shippedNode != shippedConfig.node().end()) << "no LluviaCalculator node in " << graphCase.graphPath;
+    RET_CHECK(shippedNode->node_options_size() == 1);
+
+    auto options = lluvia::LluviaCalculatorOptions {};
+    RET_CHECK(shippedNode->node_options(0).UnpackTo(&options));
+
+    options.clear_library_path();
+    options.add_library_path(libraryPath);
+    options.clear_script_path();
+    options.add_script_path(scriptPath);
+    options.set_trace_path(tracePath);
+
+    auto config = CalculatorGraphConfig {};
+    config.add_input_stream("input_image");
+    config.add_output_stream("output_image");
+
+    auto& node = *config.add_node();
+    node.set_calculator("LluviaCalculator");
+    node.add_input_stream("IN_0:input_image");
+    node.add_output_stream("OUT_0:output_image");
+    node.add_node_options()->PackFrom(options);
+
+    return config;
+}
+
+// GPU time of each frame, from the "command buffer" events of the trace.
+std::vector<double> ReadGpuTimes(const std::string& tracePath) {
+
+    auto file = std::ifstream {tracePath};
+    auto stream = std::stringstream {};
+    stream << file.rdbuf();
+    const auto trace = stream.str();
+
+    auto times = std::vector<double> {};
+
+    for (auto position = trace.find("\"name\":\"command buffer\""); position != std::string::npos;
+         position = trace.find("\"name\":\"command buffer\"", position + 1)) {
+
+        const auto duration = trace.find("\"dur\":", position);
+        if (duration != std::string::npos) {
+            times.push_back(std::atof(trace.c_str() + duration + 6));
+        }
+    }
+
+    return times;
+}
+
+::mediapipe::StatusOr<GraphRun> RunGraph(const CalculatorGraphConfig& config, const MotionSequence& sequence, const std::string& tracePath) {
+
+    auto graphConfig = config;
+    auto outputPackets = std::vector<Packet> {};
+    tool::AddVectorSink("output_image", &graphConfig, &outputPackets);
+
+    auto run = GraphRun {};
+
+    CalculatorGraph graph;
+    MP_RETURN_IF_ERROR(graph.Initialize(graphConfig));
+    MP_RETURN_IF_ERROR(graph.StartRun({}));
+
+    for (auto t = 0; t < frameCount; ++t) {
+
+        auto inputImage = MakeMotionFrame(sequence, t);
+
+        const auto start = std::chrono::steady_clock::now();
+        MP_RETURN_IF_ERROR(graph.AddPacketToInputStream("input_image", Adopt(inputImage.release()).At(Timestamp(t))));
+        MP_RETURN_IF_ERROR(graph.WaitUntilIdle());
+
+        run.wallTimes.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    MP_RETURN_IF_ERROR(graph.CloseAllInputStreams());
+    MP_RETURN_IF_ERROR(graph.WaitUntilDone());
+
+    RET_CHECK_EQ(outputPackets.size(), static_cast<size_t>(frameCount));
+
+    for (const auto& packet : outputPackets) {
+
+        const auto& frame = packet.Get<ImageFrame>();
+        run.width = frame.Width();
+        run.height = frame.Height();
+        run.channels = frame.NumberOfChannels() * frame.ByteDepth();
+        run.frames.push_back(CopyPixels(frame));
+    }
+
+    // the trace is written on Close()
+    run.gpuTimes = ReadGpuTimes(tracePath);
+
+    return run;
+}
+
+::mediapipe::StatusOr<GraphRun> RunGraphCase(const GraphCase& graphCase, const MotionSequence& sequence) {
+
+    auto runfiles = std::unique_ptr<Runfiles> {Runfiles::CreateForTest(nullptr)};
+    RET_CHECK(runfiles != nullptr);
+
+    // one trace per run, recorders keep the events of their path in memory
+    static auto runIndex = 0;
+    const auto tracePath = absl::StrCat(std::getenv("TEST_TMPDIR"), "/", graphCase.name, "_", sequence.name, "_", runIndex++, ".trace.json");
+
+    auto config = CalculatorGraphConfig {};
+    ASSIGN_OR_RETURN(config, LoadGraphConfig(*runfiles, graphCase, tracePath));
+
+    return RunGraph(config, sequence, tracePath);
+}
+
+std::string getGoldenName(const GraphCase& graphCase, const MotionSequence& sequence) {
+    return absl::StrCat(graphCase.name, "_", sequence.name, ".golden");
+}
+
+// Goldens are a text header followed by the frames without row padding:
+//
+//     LLUVIA_GOLDEN <width> <height> <bytes per pixel> <frames>\n
+void WriteGolden(const std::string& path, const GraphRun& run) {
+
+    auto file = std::ofstream {path, std::ios::binary};
+    file << "LLUVIA_GOLDEN " << run.width << " " << run.height << " " << run.channels << " " << run.frames.size() << "\n";
+
+    for (const auto& frame : run.frames) {
+        file.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+    }
+
+    EXPECT_TRUE(file.good()) << "cannot write golden " << path;
+}
+
+bool ReadGolden(const std::string& path, GraphRun& golden) {
+
+    auto file = std::ifstream {path, std::ios::binary};
+
+    auto magic = std::string {};
+    auto frames = size_t {0};
+    file >> magic >> golden.width >> golden.height >> golden.channels >> frames;
+    file.get();
+
+    if (!file.good() || magic != "LLUVIA_GOLDEN") {
+        return false;
+    }
+
+    golden.frames.assign(frames, std::vector<uint8_t>(golden.width * golden.height * golden.channels));
+    for (auto& frame : golden.frames) {
+        file.read(reinterpret_cast<char*>(frame.data()), frame.size());
+    }
+
+    return file.good();
+}
+
+// the golden name is added to missing if there is no golden
+void ExpectMatchesGolden(const GraphCase& graphCase, const MotionSequence& sequence, const GraphRun& run, std::vector<std::string>& missing) {
+
+    const auto name = getGoldenName(graphCase, sequence);
+    WriteGolden(absl::StrCat(getOutputsDirectory(), "/", name), run);
+
+    auto runfiles = std::unique_ptr<Runfiles> {Runfiles::CreateForTest(nullptr)};
+    ASSERT_NE(nullptr, runfiles);
+
+    auto golden = GraphRun {};
+    if (!ReadGolden(runfiles->Rlocation(absl::StrCat(runfilesPrefix, "calculators/test_data/goldens/", name)), golden)) {
+        missing.push_back(absl::StrCat("golden ", name));
+        return;
+    }
+
+    ASSERT_EQ(golden.width, run.width) << name;
+    ASSERT_EQ(golden.height, run.height) << name;
+    ASSERT_EQ(golden.channels, run.channels) << name;
+    ASSERT_EQ(golden.frames.size(), run.frames.size()) << name;
+
+    for (auto t = size_t {0}; t < run.frames.size(); ++t) {
+
+        auto outliers = size_t {0};
+        auto maxDifference = 0;
+
+        for (auto i = size_t {0}; i < run.frames[t].size(); ++i) {
+
+            const auto difference = std::abs(run.frames[t][i] - golden.frames[t][i]);
+            maxDifference = std::max(maxDifference, difference);
+            outliers += difference > graphCase.tolerance ? 1 : 0;
+        }
+
+        EXPECT_LE(outliers, graphCase.outlierFraction * run.frames[t].size())
+            << name << " frame " << t << ": " << outliers << " values differ by more than " << graphCase.tolerance
+            << ", maximum difference " << maxDifference;
+    }
+}
+
+double getMedianTime(std::vector<double> times) {
+
+    times.erase(times.begin(), times.begin() + std::min<size_t>(warmupFrames, times.size()));
+    if (times.empty()) {
+        return 0.0;
+    }
+
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+// Baselines by "<graph>\t<sequence>", lines starting with # are comments.
+std::map<std::string, std::pair<double, double>> ReadBaselines() {
+
+    auto baselines = std::map<std::string, std::pair<double, double>> {};
+
+    auto runfiles = std::unique_ptr<Runfiles> {Runfiles::CreateForTest(nullptr)};
+    if (runfiles == nullptr) {
+        return baselines;
+    }
+
+    auto file = std::ifstream {runfiles->Rlocation(absl::StrCat(runfilesPrefix, "calculators/test_data/graph_baselines.txt"))};
+    auto line = std::string {};
+
+    while (std::getline(file, line)) {
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        auto graph = std::string {};
+        auto sequence = std::string {};
+        auto gpuTime = 0.0;
+        auto wallTime = 0.0;
+
+        auto lineStream = std::istringstream {line};
+        if (lineStream >> graph >> sequence >> gpuTime >> wallTime) {
+            baselines[absl::StrCat(graph, "\t", sequence)] = std::make_pair(gpuTime, wallTime);
+        }
+    }
+
+    return baselines;
+}
+
+// Name of the device the calculators run on.
+std::string getDeviceName() {
+
+    const auto devices = ll::Session::getAvailableDevices();
+    return devices.empty() ? "" : selectDefaultDevice(devices).name;
+}
+
+// the baseline key is added to missing if there is no baseline
+void ExpectWithinBaseline(const GraphCase& graphCase, const MotionSequence& sequence, const GraphRun& run, std::vector<std::string>& missing) {
+
+    const auto gpuTime = getMedianTime(run.gpuTimes);
+    const auto wallTime = getMedianTime(run.wallTimes);
+    const auto key = absl::StrCat(graphCase.name, "\t", sequence.name);
+
+    LOG(INFO) << graphCase.name << " " << sequence.name << ": median GPU time " << gpuTime << " us, wall time " << wallTime << " us";
+
+    // in the format of graph_baselines.txt
+    auto report = std::ofstream {absl::StrCat(getOutputsDirectory(), "/graph_performance.txt"), std::ios::app};
+    report << key << "\t" << gpuTime << "\t" << wallTime << "\n";
+
+    EXPECT_FALSE(run.gpuTimes.empty()) << key << ": no GPU times in the trace";
+
+    // timings of other devices are not comparable to the baselines
+    static const auto deviceName = getDeviceName();
+    if (deviceName.find(referenceDeviceName) == std::string::npos) {
+        LOG(INFO) << key << ": baselines not checked on " << deviceName;
+        return;
+    }
+
+    static const auto baselines = ReadBaselines();
+
+    const auto baseline = baselines.find(key);
+    if (baseline == baselines.end()) {
+        missing.push_back(absl::StrCat("baseline ", graphCase.name, " ", sequence.name));
+        return;
+    }
+
+    EXPECT_LE(gpuTime, baseline->second.first * (1.0 + regressionThreshold))
+        << key << ": GPU time regression, baseline " << baseline->second.first << " us";
+    EXPECT_LE(wallTime, baseline->second.second * (1.0 + regressionThreshold))
+        << key << ": wall time regression, baseline " << baseline->second.second << " us";
+}
+
+// Goldens and baselines are copied from the test outputs of a run on lavapipe.
+void SkipIfMissing(const std::vector<std::string>& missing) {
+
+    if (!missing.empty()) {
+        GTEST_SKIP() << "missing in calculators/test_data, copy them from the test outputs of a run on lavapipe: "
+                     << absl::StrJoin(missing, ", ");
+    }
+}
+
+void ExpectOutputShape(const GraphRun& run, const int channels) {
+    EXPECT_EQ(run.width, frameWidth);
+    EXPECT_EQ(run.height, frameHeight);
+    EXPECT_EQ(run.channels, channels);
+}
+
+TEST(LluviaGraphRegressionTest, TestBGRA2Gray) {
+
+    auto missing = std::vector<std::string> {};
+
+    for (const auto& sequence : {staticSequence, translationSequence}) {
+
+        auto runOrStatus = RunGraphCase(bgra2GrayGraph, sequence);
+        MP_ASSERT_OK(runOrStatus.status());
+        const auto& run = runOrStatus.value();
+        ExpectOutputShape(run, 1);
+
+        // BT.601 luma, within the rounding of the shader
+        for (auto t = 0; t < frameCount; ++t) {
+
+            const auto input = CopyPixels(*MakeMotionFrame(sequence, t));
+            auto mismatches = 0;
+
+            for (auto i = 0; i < frameWidth * frameHeight; ++i) {
+                const auto* bgra = &input[4 * i];
+                const auto expected = toUint8(0.299 * bgra[2] + 0.587 * bgra[1] + 0.114 * bgra[0]);
+                mismatches += std::abs(run.frames[t][i] - expected) > 1 ? 1 : 0;
+            }
+
+            EXPECT_EQ(mismatches, 0) << sequence.name << " frame " << t;
+        }
+
+        ExpectMatchesGolden(bgra2GrayGraph, sequence, run, missing);
+        ExpectWithinBaseline(bgra2GrayGraph, sequence, run, missing);
+    }
+
+    SkipIfMissing(missing);
+}
+
+TEST(LluviaGraphRegressionTest, TestColorMapping) {
+
+    auto missing = std::vector<std::string> {};
+
+    for (const auto& sequence : {staticSequence, translationSequence}) {
+
+        auto runOrStatus = RunGraphCase(colorMappingGraph, sequence);
+        MP_ASSERT_OK(runOrStatus.status());
+        const auto& run = runOrStatus.value();
+        ExpectOutputShape(run, 4);
+
+        // the color map is pointwise: equal input pixels map to equal colors
+        for (auto t = 0; t < frameCount; ++t) {
+
+            const auto input = CopyPixels(*MakeMotionFrame(sequence, t));
+            auto colors = std::map<uint32_t, uint32_t> {};
+            auto mismatches = 0;
+
+            for (auto i = 0; i < frameWidth * frameHeight; ++i) {
+
+                auto inputPixel = uint32_t {0};
+                auto outputPixel = uint32_t {0};
+                std::memcpy(&inputPixel, &input[4 * i], 4);
+                std::memcpy(&outputPixel, &run.frames[t][4 * i], 4);
+
+                const auto color = colors.emplace(inputPixel, outputPixel).first;
+                mismatches += color->second != outputPixel ? 1 : 0;
+            }
+
+            EXPECT_EQ(mismatches, 0) << sequence.name << " frame " << t;
+        }
+
+        ExpectMatchesGolden(colorMappingGraph, sequence, run, missing);
+        ExpectWithinBaseline(colorMappingGraph, sequence, run, missing);
+    }
+
+    SkipIfMissing(missing);
+}
+
+// Optical flow graphs have no closed form output: runs must be
+// deterministic and the flow must respond to the motion.
+void ExpectOpticalFlowGraph(const GraphCase& graphCase) {
+
+    auto staticRunOrStatus = RunGraphCase(graphCase, staticSequence);
+    MP_ASSERT_OK(staticRunOrStatus.status());
+    const auto& staticRun = staticRunOrStatus.value();
+    ExpectOutputShape(staticRun, 4);
+
+    auto translationRunOrStatus = RunGraphCase(graphCase, translationSequence);
+    MP_ASSERT_OK(translationRunOrStatus.status());
+    const auto& translationRun = translationRunOrStatus.value();
+    ExpectOutputShape(translationRun, 4);
+
+    auto repeatedRunOrStatus = RunGraphCase(graphCase, translationSequence);
+    MP_ASSERT_OK(repeatedRunOrStatus.status());
+    const auto& repeatedRun = repeatedRunOrStatus.value();
+
+    for (auto t = 0; t < frameCount; ++t) {
+        EXPECT_EQ(translationRun.frames[t], repeatedRun.frames[t]) << graphCase.name << " frame " << t << " is not deterministic";
+    }
+
+    EXPECT_NE(translationRun.frames.back(), staticRun.frames.back()) << graphCase.name << " flow does not follow the motion";
+
+    auto missing = std::vector<std::string> {};
+
+    ExpectMatchesGolden(graphCase, staticSequence, staticRun, missing);
+    ExpectMatchesGolden(graphCase, translationSequence, translationRun, missing);
+
+    ExpectWithinBaseline(graphCase, staticSequence, staticRun, missing);
+    ExpectWithinBaseline(graphCase, translationSequence, translationRun, missing);
+
+    SkipIfMissing(missing);
+}
+
+TEST(LluviaGraphRegressionTest, TestHornSchunck) {
+    ExpectOpticalFlowGraph(hornSchunckGraph);
+}
+
+TEST(LluviaGraphRegressionTest, TestFlowFilter) {
+    ExpectOpticalFlowGraph(flowFilterGraph);
+}
+
+} // namespace
+} // namespace mediapipe
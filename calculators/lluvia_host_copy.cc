@@ -0,0 +1,228 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_host_copy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// Copies bytes with non-temporal stores. The caller fences once the copy is done.
+void streamBytes(const uint8_t* src, uint8_t* dst, size_t bytes) {
+
+#if defined(__SSE2__)
+    // stores must be aligned to 16 bytes, copy the head up to the first aligned address
+    const auto head = std::min(bytes, static_cast<size_t>((16 - reinterpret_cast<uintptr_t>(dst) % 16) % 16));
+    std::memcpy(dst, src, head);
+    src += head;
+    dst += head;
+    bytes -= head;
+
+    // one cache line per iteration
+    for (; bytes >= 64; src += 64, dst += 64, bytes -= 64) {
+        const auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        const auto v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+        const auto v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), v0);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), v1);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), v2);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), v3);
+    }
+
+    for (; bytes >= 16; src += 16, dst += 16, bytes -= 16) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+    }
+#endif
+
+    std::memcpy(dst, src, bytes);
+}
+
+} // namespace
+
+void copyRows(const uint8_t* src, const size_t srcStride, uint8_t* dst, const size_t dstStride,
+              const size_t rowBytes, const int rows, const bool streaming) {
+
+    const auto contiguous = srcStride == rowBytes && dstStride == rowBytes;
+
+    if (!streaming) {
+        if (contiguous) {
+            std::memcpy(dst, src, rowBytes * rows);
+            return;
+        }
+
+        for (auto y = 0; y < rows; ++y) {
+            std::memcpy(dst + y * dstStride, src + y * srcStride, rowBytes);
+        }
+        return;
+    }
+
+    if (contiguous) {
+        streamBytes(src, dst, rowBytes * rows);
+    } else {
+        for (auto y = 0; y < rows; ++y) {
+            streamBytes(src + y * srcStride, dst + y * dstStride, rowBytes);
+        }
+    }
+
+#if defined(__SSE2__)
+    // non-temporal stores are weakly ordered, make them visible before the
+    // copy is reported done
+    _mm_sfence();
+#endif
+}
+
+struct LluviaHostCopyEngine::Job {
+    const uint8_t* src {nullptr};
+    size_t srcStride {0};
+    uint8_t* dst {nullptr};
+    size_t dstStride {0};
+    size_t rowBytes {0};
+    int rows {0};
+    bool streaming {false};
+
+    int bandRows {0};
+    int bandCount {0};
+
+    std::atomic<int> nextBand {0};
+
+    // pool threads copying bands of the job, guarded by the engine mutex
+    int workers {0};
+};
+
+LluviaHostCopyEngine::LluviaHostCopyEngine(const int threadCount) {
+
+    for (auto i = 1; i < threadCount; ++i) {
+        m_threads.emplace_back(&LluviaHostCopyEngine::workerLoop, this);
+    }
+}
+
+LluviaHostCopyEngine::~LluviaHostCopyEngine() {
+
+    {
+        auto lock = std::lock_guard {m_mutex};
+        m_stop = true;
+    }
+
+    m_jobCondition.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+std::shared_ptr<LluviaHostCopyEngine> LluviaHostCopyEngine::getShared(const int threadCount) {
+
+    static auto mutex = std::mutex {};
+    static auto engines = std::map<int, std::weak_ptr<LluviaHostCopyEngine>> {};
+
+    auto lock = std::lock_guard {mutex};
+
+    auto engine = engines[threadCount].lock();
+    if (!engine) {
+        engine = std::make_shared<LluviaHostCopyEngine>(threadCount);
+        engines[threadCount] = engine;
+    }
+
+    return engine;
+}
+
+void LluviaHostCopyEngine::copy(const uint8_t* src, const size_t srcStride, uint8_t* dst, const size_t dstStride,
+                                const size_t rowBytes, const int rows, const bool streaming) {
+
+    if (m_threads.empty() || rows < 2 || rowBytes * rows < kMinParallelBytes) {
+        copyRows(src, srcStride, dst, dstStride, rowBytes, rows, streaming);
+        return;
+    }
+
+    auto job = Job {};
+    job.src = src;
+    job.srcStride = srcStride;
+    job.dst = dst;
+    job.dstStride = dstStride;
+    job.rowBytes = rowBytes;
+    job.rows = rows;
+    job.streaming = streaming;
+    job.bandRows = static_cast<int>(std::max(size_t {1}, (kBandBytes + rowBytes - 1) / rowBytes));
+    job.bandCount = (rows + job.bandRows - 1) / job.bandRows;
+
+    {
+        auto lock = std::lock_guard {m_mutex};
+        m_jobs.push_back(&job);
+    }
+
+    m_jobCondition.notify_all();
+
+    // the calling thread copies bands too, and the whole job if the pool is busy
+    copyBands(job);
+
+    auto lock = std::unique_lock {m_mutex};
+
+    // every band is taken, no other thread can pick up the job once removed
+    const auto it = std::find(m_jobs.begin(), m_jobs.end(), &job);
+    if (it != m_jobs.end()) {
+        m_jobs.erase(it);
+    }
+
+    m_doneCondition.wait(lock, [&job]() { return job.workers == 0; });
+}
+
+void LluviaHostCopyEngine::copyBands(Job& job) {
+
+    for (;;) {
+        const auto band = job.nextBand.fetch_add(1, std::memory_order_relaxed);
+        if (band >= job.bandCount) {
+            return;
+        }
+
+        const auto y = band * job.bandRows;
+        const auto rows = std::min(job.bandRows, job.rows - y);
+
+        copyRows(job.src + y * job.srcStride, job.srcStride, job.dst + y * job.dstStride, job.dstStride,
+                 job.rowBytes, rows, job.streaming);
+    }
+}
+
+void LluviaHostCopyEngine::workerLoop() {
+
+    for (;;) {
+
+        auto* job = static_cast<Job*>(nullptr);
+
+        {
+            auto lock = std::unique_lock {m_mutex};
+            m_jobCondition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+
+            if (m_stop) {
+                return;
+            }
+
+            job = m_jobs.front();
+            ++job->workers;
+        }
+
+        copyBands(*job);
+
+        {
+            auto lock = std::lock_guard {m_mutex};
+
+            // all bands are taken, stop offering the job to other threads
+            const auto it = std::find(m_jobs.begin(), m_jobs.end(), job);
+            if (it != m_jobs.end()) {
+                m_jobs.erase(it);
+            }
+
+            --job->workers;
+        }
+
+        m_doneCondition.notify_all();
+    }
+}
+
+} // namespace mediapipe
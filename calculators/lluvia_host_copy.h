@@ -0,0 +1,90 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_HOST_COPY_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_HOST_COPY_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mediapipe {
+
+/**
+ * Thread pool copying pixel regions between host buffers of different row
+ * strides, used for the staging transfers of LluviaCalculator.
+ *
+ * Copies of at least kMinParallelBytes are split in bands of rows run by the
+ * pool threads and the calling thread, smaller ones run on the calling
+ * thread. Row padding of either side is skipped while copying, so a padded
+ * ImageFrame is packed into a staging buffer in a single pass.
+ *
+ * Staging buffers are usually mapped as write-combined memory, where
+ * streaming copies use non-temporal stores that bypass the cache instead of
+ * reading each destination line first. They fall back to std::memcpy on
+ * targets without SSE2.
+ */
+class LluviaHostCopyEngine {
+public:
+    static constexpr size_t kMinParallelBytes = 1024 * 1024;
+
+    // rows of a band are at least this many bytes
+    static constexpr size_t kBandBytes = 256 * 1024;
+
+    /**
+     * Engine with threadCount - 1 pool threads, the calling thread being the
+     * last one. 1 copies on the calling thread only.
+     */
+    explicit LluviaHostCopyEngine(const int threadCount);
+
+    ~LluviaHostCopyEngine();
+
+    LluviaHostCopyEngine(const LluviaHostCopyEngine&) = delete;
+    LluviaHostCopyEngine& operator=(const LluviaHostCopyEngine&) = delete;
+
+    /**
+     * Engine shared by every calculator of the process asking for
+     * threadCount threads, alive while referenced.
+     */
+    static std::shared_ptr<LluviaHostCopyEngine> getShared(const int threadCount);
+
+    /**
+     * Copies rowBytes of each of the rows, returning once every band is
+     * written. Safe to call from several threads, their copies share the pool.
+     *
+     * streaming uses non-temporal stores, meant for destinations that are not
+     * read back by the host soon, such as upload staging buffers.
+     */
+    void copy(const uint8_t* src, const size_t srcStride, uint8_t* dst, const size_t dstStride,
+              const size_t rowBytes, const int rows, const bool streaming);
+
+    int getThreadCount() const noexcept { return static_cast<int>(m_threads.size()) + 1; }
+
+private:
+    struct Job;
+
+    void workerLoop();
+
+    static void copyBands(Job& job);
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobCondition;
+    std::condition_variable m_doneCondition;
+    std::deque<Job*> m_jobs;
+    bool m_stop {false};
+};
+
+/**
+ * Copies rowBytes of each of the rows on the calling thread, see
+ * LluviaHostCopyEngine::copy().
+ */
+void copyRows(const uint8_t* src, const size_t srcStride, uint8_t* dst, const size_t dstStride,
+              const size_t rowBytes, const int rows, const bool streaming);
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_HOST_COPY_H_
@@ -0,0 +1,29 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_IMAGE_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_IMAGE_H_
+
+#include <lluvia/core.h>
+
+#include <memory>
+
+namespace mediapipe {
+
+/**
+ * Packet type carrying an image that stays in Lluvia device memory.
+ *
+ * Producers emit the packet once the command buffer writing the image has
+ * completed, so consumers can record reads from it without further
+ * synchronization. Consumers must record their commands in the same session
+ * and hold the session run mutex while submitting them. The image is in
+ * General layout, consumers read it in that layout without changing it.
+ *
+ * The producer recycles the image only once every packet referencing it has
+ * been released, that is, when imageView is no longer shared.
+ */
+struct LluviaImage {
+    std::shared_ptr<ll::Session> session;
+    std::shared_ptr<ll::ImageView> imageView;
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_IMAGE_H_
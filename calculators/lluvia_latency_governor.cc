@@ -0,0 +1,65 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_latency_governor.h"
+
+#include <algorithm>
+
+namespace mediapipe {
+
+LluviaLatencyGovernor::LluviaLatencyGovernor(const lluvia::LatencyGovernor& options) :
+    m_options {options} {
+}
+
+const lluvia::DegradationLevel& LluviaLatencyGovernor::getDegradationLevel() const noexcept {
+    return m_level == 0 ? m_defaultLevel : m_options.level(m_level - 1);
+}
+
+bool LluviaLatencyGovernor::shouldProcess() noexcept {
+
+    const auto interval = static_cast<uint64_t>(std::max(1, getDegradationLevel().frame_interval()));
+    return m_frameIndex++ % interval == 0;
+}
+
+bool LluviaLatencyGovernor::update(const std::chrono::nanoseconds gpuTime, const std::chrono::nanoseconds wallTime) noexcept {
+
+    if (!isEnabled()) {
+        return false;
+    }
+
+    // skipped frames give their time to the processed ones
+    const auto interval = std::max(1, getDegradationLevel().frame_interval());
+    const auto frameTime = std::chrono::duration<double, std::milli>(std::max(gpuTime, wallTime)).count() / interval;
+
+    const auto deadline = static_cast<double>(m_options.deadline_ms());
+
+    if (frameTime > deadline) {
+        ++m_framesOverBudget;
+        m_framesUnderHeadroom = 0;
+    } else if (frameTime < m_options.headroom() * deadline) {
+        ++m_framesUnderHeadroom;
+        m_framesOverBudget = 0;
+    } else {
+        m_framesOverBudget = 0;
+        m_framesUnderHeadroom = 0;
+    }
+
+    if (m_framesOverBudget >= std::max(1, m_options.step_down_frames()) && m_level < m_options.level_size()) {
+        setLevel(m_level + 1);
+        return true;
+    }
+
+    if (m_framesUnderHeadroom >= std::max(1, m_options.step_up_frames()) && m_level > 0) {
+        setLevel(m_level - 1);
+        return true;
+    }
+
+    return false;
+}
+
+void LluviaLatencyGovernor::setLevel(const int level) noexcept {
+
+    m_level = level;
+    m_framesOverBudget = 0;
+    m_framesUnderHeadroom = 0;
+    m_frameIndex = 0;
+}
+
+} // namespace mediapipe
@@ -0,0 +1,59 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_LATENCY_GOVERNOR_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_LATENCY_GOVERNOR_H_
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace mediapipe {
+
+/**
+ * Degradation level selection of lluvia.LatencyGovernor.
+ *
+ * The governor only decides: the calculator asks shouldProcess() for every
+ * frame, runs the frames it accepts at getLevel() and reports their times
+ * to update().
+ */
+class LluviaLatencyGovernor {
+public:
+    explicit LluviaLatencyGovernor(const lluvia::LatencyGovernor& options);
+
+    bool isEnabled() const noexcept { return m_options.deadline_ms() > 0; }
+
+    // 0 for the configured calculator, i for m_options.level(i - 1)
+    int getLevel() const noexcept { return m_level; }
+
+    // options of the current level, the defaults at level 0
+    const lluvia::DegradationLevel& getDegradationLevel() const noexcept;
+
+    /**
+     * Whether the next frame runs, according to the frame_interval of the
+     * current level. The first frame after a level change always runs.
+     */
+    bool shouldProcess() noexcept;
+
+    /**
+     * Records the times of a processed frame. Returns true if the level changed.
+     */
+    bool update(const std::chrono::nanoseconds gpuTime, const std::chrono::nanoseconds wallTime) noexcept;
+
+private:
+    void setLevel(const int level) noexcept;
+
+    const lluvia::LatencyGovernor m_options;
+    const lluvia::DegradationLevel m_defaultLevel {};
+
+    int m_level {0};
+
+    // consecutive processed frames above the deadline and below the headroom
+    int m_framesOverBudget {0};
+    int m_framesUnderHeadroom {0};
+
+    // frames seen since the last level change
+    uint64_t m_frameIndex {0};
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_LATENCY_GOVERNOR_H_
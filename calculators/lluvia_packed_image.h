@@ -0,0 +1,39 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_PACKED_IMAGE_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_PACKED_IMAGE_H_
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace mediapipe {
+
+/**
+ * Image read back from Lluvia with a reduced precision encoding.
+ *
+ * Pixels are stored row major, channels interleaved, without row padding.
+ * INT8 and INT16 values are signed and must be divided by scale to
+ * recover the original value.
+ */
+struct LluviaPackedImage {
+    int width {0};
+    int height {0};
+    int channels {0};
+
+    lluvia::OutputPacking::Encoding encoding {lluvia::OutputPacking::FLOAT16};
+    float scale {1.0f};
+
+    std::vector<uint8_t> data;
+
+    int BytesPerElement() const {
+        return encoding == lluvia::OutputPacking::INT8 ? 1 : 2;
+    }
+
+    int RowBytes() const {
+        return width * channels * BytesPerElement();
+    }
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_PACKED_IMAGE_H_
@@ -0,0 +1,394 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_recorder.pb.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kRecordMagic[] = "LLREC001";
+constexpr char kIndexMagic[] = "LLIDX001";
+
+template<typename T>
+void AppendValue(std::string& bytes, const T value) {
+    bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// writes the whole iovecs, resuming after partial writes
+::mediapipe::Status WriteAll(const int fd, std::vector<iovec>& iovecs) {
+
+    auto* iov = iovecs.data();
+    auto remaining = iovecs.size();
+
+    while (remaining > 0) {
+
+        const auto count = static_cast<int>(std::min<size_t>(remaining, IOV_MAX));
+        auto written = ::writev(fd, iov, count);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return absl::InternalError(absl::StrCat("writev failed: ", std::strerror(errno)));
+        }
+
+        // skip the fully written iovecs and advance into the partial one
+        while (remaining > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --remaining;
+        }
+
+        if (remaining > 0) {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+} // namespace
+
+// Sink calculator recording ImageFrame packets to a file.
+//
+// Process() only queues the packet. A dedicated I/O thread takes every
+// queued frame on each wake-up and writes them with one writev() call,
+// reading the pixels in place from the packets. Outputs of LluviaCalculator
+// in UNIFIED memory mode adopt their readback buffer, so those frames are
+// written straight from the mapped memory.
+class LluviaRecorderCalculator : public CalculatorBase {
+public:
+    static ::mediapipe::Status GetContract(CalculatorContract* cc);
+
+    ::mediapipe::Status Open(CalculatorContext* cc) override;
+    ::mediapipe::Status Process(CalculatorContext* cc) override;
+    ::mediapipe::Status Close(CalculatorContext* cc) override;
+
+    ~LluviaRecorderCalculator() override;
+
+private:
+    void RunIO();
+    ::mediapipe::Status WriteBatch(const std::deque<Packet>& batch);
+    ::mediapipe::Status WriteIndex();
+    void StopIO();
+
+    lluvia::LluviaRecorderCalculatorOptions m_options;
+    std::string m_nodeName {};
+
+    int m_fd {-1};
+
+    // first frame, frames of a Y4M stream cannot change size
+    int m_width {0};
+    int m_height {0};
+
+    std::mutex m_mutex {};
+    std::condition_variable m_condition {};
+    std::deque<Packet> m_queue {};
+    bool m_stop {false};
+
+    // first error of the I/O thread, returned by the next Process() or Close()
+    ::mediapipe::Status m_ioStatus {};
+
+    std::thread m_ioThread {};
+
+    // owned by the I/O thread until it is joined
+    uint64_t m_offset {0};
+    std::vector<std::pair<int64_t, uint64_t>> m_index {};
+    std::vector<iovec> m_iovecs {};
+    std::vector<std::string> m_headers {};
+};
+REGISTER_CALCULATOR(LluviaRecorderCalculator);
+
+::mediapipe::Status LluviaRecorderCalculator::GetContract(CalculatorContract* cc) {
+
+    cc->Inputs().Index(0).Set<ImageFrame>();
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaRecorderCalculator::Open(CalculatorContext* cc) {
+
+    m_options = cc->Options<lluvia::LluviaRecorderCalculatorOptions>();
+    m_nodeName = cc->NodeName();
+
+    RET_CHECK(!m_options.path().empty()) << "path cannot be empty";
+    RET_CHECK_GT(m_options.max_queued_frames(), 0) << "max_queued_frames must be positive";
+    RET_CHECK_GT(m_options.frame_rate(), 0) << "frame_rate must be positive";
+
+    m_fd = ::open(m_options.path().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+        return absl::InternalError(absl::StrCat("cannot open ", m_options.path(), ": ", std::strerror(errno)));
+    }
+
+    m_ioThread = std::thread {&LluviaRecorderCalculator::RunIO, this};
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaRecorderCalculator::Process(CalculatorContext* cc) {
+
+    const auto& packet = cc->Inputs().Index(0).Value();
+    const auto& frame = packet.Get<ImageFrame>();
+
+    if (m_width == 0) {
+        m_width = frame.Width();
+        m_height = frame.Height();
+    }
+
+    if (m_options.format() == lluvia::LluviaRecorderCalculatorOptions::Y4M) {
+        RET_CHECK(frame.Format() == ImageFormat::GRAY8) << "Y4M recording only supports GRAY8 frames";
+        RET_CHECK(frame.Width() == m_width && frame.Height() == m_height)
+            << "frame size changed, expected: " << m_width << "x" << m_height
+            << ", got: " << frame.Width() << "x" << frame.Height();
+    }
+
+    auto dropped = false;
+    {
+        auto lock = std::unique_lock {m_mutex};
+        MP_RETURN_IF_ERROR(m_ioStatus);
+
+        const auto maxQueued = static_cast<size_t>(m_options.max_queued_frames());
+
+        switch (m_options.drop_policy()) {
+            case lluvia::LluviaRecorderCalculatorOptions::BLOCK:
+                m_condition.wait(lock, [this, maxQueued]() { return m_queue.size() < maxQueued || !m_ioStatus.ok(); });
+                MP_RETURN_IF_ERROR(m_ioStatus);
+                break;
+
+            case lluvia::LluviaRecorderCalculatorOptions::DROP_OLDEST:
+                if (m_queue.size() >= maxQueued) {
+                    m_queue.pop_front();
+                    dropped = true;
+                }
+                break;
+
+            default:
+                dropped = m_queue.size() >= maxQueued;
+                break;
+        }
+
+        // DROP_OLDEST made room for the frame
+        if (!dropped || m_options.drop_policy() == lluvia::LluviaRecorderCalculatorOptions::DROP_OLDEST) {
+            m_queue.push_back(packet);
+        }
+    }
+
+    m_condition.notify_all();
+
+    if (dropped) {
+        cc->GetCounter(absl::StrCat(m_nodeName, ": recorder dropped frames"))->Increment();
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaRecorderCalculator::Close(CalculatorContext* cc) {
+
+    // the I/O thread writes the queued frames before exiting
+    StopIO();
+
+    auto status = m_ioStatus;
+    if (status.ok() && m_options.format() == lluvia::LluviaRecorderCalculatorOptions::INDEXED) {
+        status = WriteIndex();
+    }
+
+    if (m_fd >= 0 && ::close(m_fd) != 0 && status.ok()) {
+        status = absl::InternalError(absl::StrCat("cannot close ", m_options.path(), ": ", std::strerror(errno)));
+    }
+    m_fd = -1;
+
+    return status;
+}
+
+LluviaRecorderCalculator::~LluviaRecorderCalculator() {
+
+    StopIO();
+
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void LluviaRecorderCalculator::RunIO() {
+
+    auto batch = std::deque<Packet> {};
+
+    while (true) {
+        {
+            auto lock = std::unique_lock {m_mutex};
+            m_condition.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+            // queued frames are written before stopping
+            if (m_queue.empty()) {
+                return;
+            }
+
+            std::swap(batch, m_queue);
+        }
+
+        // Process() may be waiting for room in the queue
+        m_condition.notify_all();
+
+        auto status = WriteBatch(batch);
+        batch.clear();
+
+        if (!status.ok()) {
+            auto guard = std::lock_guard {m_mutex};
+            m_ioStatus = status;
+            m_queue.clear();
+            m_condition.notify_all();
+            return;
+        }
+    }
+}
+
+::mediapipe::Status LluviaRecorderCalculator::WriteBatch(const std::deque<Packet>& batch) {
+
+    m_iovecs.clear();
+
+    // headers are referenced by m_iovecs, so they cannot move while it is filled
+    m_headers.resize(batch.size() + 1);
+    auto headerCount = size_t {0};
+
+    const auto addBytes = [this](const void* data, const size_t size) {
+        m_iovecs.push_back(iovec {const_cast<void*>(data), size});
+        m_offset += size;
+    };
+
+    const auto addHeader = [&](std::string header) -> const std::string& {
+        m_headers[headerCount] = std::move(header);
+        return m_headers[headerCount++];
+    };
+
+    if (m_offset == 0) {
+        switch (m_options.format()) {
+            case lluvia::LluviaRecorderCalculatorOptions::Y4M: {
+                const auto& header = addHeader(absl::StrCat("YUV4MPEG2 W", m_width, " H", m_height,
+                                                            " F", m_options.frame_rate(), ":1 Ip A1:1 Cmono\n"));
+                addBytes(header.data(), header.size());
+                break;
+            }
+            case lluvia::LluviaRecorderCalculatorOptions::INDEXED:
+                addBytes(kRecordMagic, 8);
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (const auto& packet : batch) {
+
+        const auto& frame = packet.Get<ImageFrame>();
+        const auto rowBytes = static_cast<size_t>(frame.Width()) * frame.NumberOfChannels() * frame.ByteDepth();
+
+        switch (m_options.format()) {
+            case lluvia::LluviaRecorderCalculatorOptions::Y4M: {
+                const auto& header = addHeader("FRAME\n");
+                addBytes(header.data(), header.size());
+                break;
+            }
+            case lluvia::LluviaRecorderCalculatorOptions::INDEXED: {
+                m_index.emplace_back(packet.Timestamp().Value(), m_offset);
+
+                auto header = std::string {};
+                AppendValue<int64_t>(header, packet.Timestamp().Value());
+                AppendValue<int32_t>(header, frame.Width());
+                AppendValue<int32_t>(header, frame.Height());
+                AppendValue<int32_t>(header, static_cast<int32_t>(frame.Format()));
+                AppendValue<int32_t>(header, frame.NumberOfChannels());
+                AppendValue<int32_t>(header, frame.ByteDepth());
+                AppendValue<int32_t>(header, 0);
+
+                const auto& storedHeader = addHeader(std::move(header));
+                addBytes(storedHeader.data(), storedHeader.size());
+                break;
+            }
+            default:
+                break;
+        }
+
+        // one iovec for the whole image unless rows are padded
+        if (frame.WidthStep() == static_cast<int>(rowBytes)) {
+            addBytes(frame.PixelData(), rowBytes * frame.Height());
+        } else {
+            for (auto y = 0; y < frame.Height(); ++y) {
+                addBytes(frame.PixelData() + y * frame.WidthStep(), rowBytes);
+            }
+        }
+    }
+
+    return WriteAll(m_fd, m_iovecs);
+}
+
+::mediapipe::Status LluviaRecorderCalculator::WriteIndex() {
+
+    auto index = std::string {};
+    if (m_offset == 0) {
+        index.append(kRecordMagic, 8);
+        m_offset = 8;
+    }
+
+    for (const auto& entry : m_index) {
+        AppendValue<int64_t>(index, entry.first);
+        AppendValue<uint64_t>(index, entry.second);
+    }
+
+    AppendValue<uint64_t>(index, m_index.size());
+    AppendValue<uint64_t>(index, m_offset);
+    index.append(kIndexMagic, 8);
+
+    auto iovecs = std::vector<iovec> {iovec {index.data(), index.size()}};
+    return WriteAll(m_fd, iovecs);
+}
+
+void LluviaRecorderCalculator::StopIO() {
+
+    if (!m_ioThread.joinable()) {
+        return;
+    }
+
+    {
+        auto guard = std::lock_guard {m_mutex};
+        m_stop = true;
+    }
+
+    m_condition.notify_all();
+    m_ioThread.join();
+}
+
+} // namespace mediapipe
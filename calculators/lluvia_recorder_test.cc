@@ -0,0 +1,150 @@
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+namespace mediapipe {
+
+namespace {
+
+constexpr auto kFrameCount = 5;
+
+std::string ReadFile(const std::string& path) {
+    auto file = std::ifstream {path, std::ios::binary};
+    return std::string {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+}
+
+template<typename T>
+T ReadValue(const std::string& bytes, const size_t offset) {
+    auto value = T {};
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+// records kFrameCount frames of the given format, row padded to 64 bytes
+std::string Record(const std::string& name, const std::string& format, const ImageFormat::Format imageFormat) {
+
+    const auto path = absl::StrCat(std::getenv("TEST_TMPDIR"), "/", name);
+
+    CalculatorRunner runner(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(
+        absl::Substitute(R"pb(
+            calculator: "LluviaRecorderCalculator"
+            input_stream: "input_image"
+            node_options {
+                [type.googleapis.com/lluvia.LluviaRecorderCalculatorOptions]: {
+                    path: "$0"
+                    format: $1
+                    drop_policy: BLOCK
+                    max_queued_frames: 2
+                }
+            }
+        )pb", path, format)));
+
+    for (auto t = 0; t < kFrameCount; ++t) {
+        auto frame = absl::make_unique<ImageFrame>(imageFormat, 10, 4, 64);
+        std::memset(frame->MutablePixelData(), t + 1, frame->PixelDataSize());
+
+        runner.MutableInputs()->Index(0).packets.push_back(Adopt(frame.release()).At(Timestamp(t * 100)));
+    }
+
+    MP_EXPECT_OK(runner.Run());
+    return ReadFile(path);
+}
+
+TEST(LluviaRecorderCalculatorTest, TestRawOutput) {
+
+    const auto bytes = Record("recorder.raw", "RAW", ImageFormat::GRAY8);
+
+    // padding is not written
+    ASSERT_EQ(bytes.size(), kFrameCount * 10 * 4);
+    for (auto t = 0; t < kFrameCount; ++t) {
+        EXPECT_EQ(bytes[t * 40], t + 1);
+        EXPECT_EQ(bytes[t * 40 + 39], t + 1);
+    }
+}
+
+TEST(LluviaRecorderCalculatorTest, TestY4MOutput) {
+
+    const auto bytes = Record("recorder.y4m", "Y4M", ImageFormat::GRAY8);
+
+    const auto header = std::string {"YUV4MPEG2 W10 H4 F30:1 Ip A1:1 Cmono\n"};
+    ASSERT_EQ(bytes.substr(0, header.size()), header);
+
+    const auto frameBytes = std::string {"FRAME\n"}.size() + 40;
+    ASSERT_EQ(bytes.size(), header.size() + kFrameCount * frameBytes);
+
+    for (auto t = 0; t < kFrameCount; ++t) {
+        const auto offset = header.size() + t * frameBytes;
+        EXPECT_EQ(bytes.substr(offset, 6), "FRAME\n");
+        EXPECT_EQ(bytes[offset + 6], t + 1);
+    }
+}
+
+TEST(LluviaRecorderCalculatorTest, TestIndexedOutput) {
+
+    // flow fields, 2 float channels
+    const auto bytes = Record("recorder.llrec", "INDEXED", ImageFormat::VEC32F2);
+    constexpr auto pixelBytes = 10 * 4 * 2 * 4;
+
+    ASSERT_GE(bytes.size(), 8 + 32);
+    EXPECT_EQ(bytes.substr(0, 8), "LLREC001");
+    EXPECT_EQ(bytes.substr(bytes.size() - 8), "LLIDX001");
+
+    const auto frameCount = ReadValue<uint64_t>(bytes, bytes.size() - 24);
+    const auto indexOffset = ReadValue<uint64_t>(bytes, bytes.size() - 16);
+
+    ASSERT_EQ(frameCount, kFrameCount);
+    ASSERT_EQ(indexOffset, 8 + kFrameCount * (32 + pixelBytes));
+
+    for (auto t = 0; t < kFrameCount; ++t) {
+
+        const auto timestamp = ReadValue<int64_t>(bytes, indexOffset + t * 16);
+        const auto offset = ReadValue<uint64_t>(bytes, indexOffset + t * 16 + 8);
+
+        EXPECT_EQ(timestamp, t * 100);
+        EXPECT_EQ(ReadValue<int64_t>(bytes, offset), t * 100);
+        EXPECT_EQ(ReadValue<int32_t>(bytes, offset + 8), 10);
+        EXPECT_EQ(ReadValue<int32_t>(bytes, offset + 12), 4);
+        EXPECT_EQ(ReadValue<int32_t>(bytes, offset + 16), static_cast<int32_t>(ImageFormat::VEC32F2));
+        EXPECT_EQ(ReadValue<int32_t>(bytes, offset + 20), 2);
+        EXPECT_EQ(ReadValue<int32_t>(bytes, offset + 24), 4);
+        EXPECT_EQ(bytes[offset + 32], t + 1);
+    }
+}
+
+TEST(LluviaRecorderCalculatorTest, TestY4MRejectsColorFrames) {
+
+    const auto path = absl::StrCat(std::getenv("TEST_TMPDIR"), "/recorder_color.y4m");
+
+    CalculatorRunner runner(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(
+        absl::Substitute(R"pb(
+            calculator: "LluviaRecorderCalculator"
+            input_stream: "input_image"
+            node_options {
+                [type.googleapis.com/lluvia.LluviaRecorderCalculatorOptions]: {
+                    path: "$0"
+                    format: Y4M
+                }
+            }
+        )pb", path)));
+
+    auto frame = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 10, 4);
+    runner.MutableInputs()->Index(0).packets.push_back(Adopt(frame.release()).At(Timestamp(0)));
+
+    EXPECT_FALSE(runner.Run().ok());
+}
+
+} // namespace
+
+} // namespace mediapipe
@@ -0,0 +1,43 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_session_registry.h"
+
+#include <map>
+
+namespace mediapipe {
+
+LluviaSessionHandle LluviaSessionRegistry::getOrCreate(const std::string& name,
+                                                       const bool withSubmissionQueue,
+                                                       const std::function<std::shared_ptr<ll::Session>()>& factory) {
+
+    if (name.empty()) {
+        return LluviaSessionHandle {factory(), std::make_shared<std::mutex>(), nullptr};
+    }
+
+    static std::mutex registryMutex;
+    static std::map<std::string, Entry> registry;
+
+    auto guard = std::lock_guard {registryMutex};
+
+    auto& entry = registry[name];
+
+    auto handle = LluviaSessionHandle {entry.session.lock(), entry.runMutex.lock(), entry.submissionQueue.lock()};
+    if (handle.session == nullptr || handle.runMutex == nullptr) {
+
+        handle.session = factory();
+        handle.runMutex = std::make_shared<std::mutex>();
+        handle.submissionQueue = nullptr;
+
+        entry.session = handle.session;
+        entry.runMutex = handle.runMutex;
+    }
+
+    // the queue lives as long as some calculator runs through it, and is
+    // created again for the session if a later one asks for it
+    if (withSubmissionQueue && handle.submissionQueue == nullptr) {
+        handle.submissionQueue = std::make_shared<LluviaSubmissionQueue>(handle.session, handle.runMutex);
+        entry.submissionQueue = handle.submissionQueue;
+    }
+
+    return handle;
+}
+
+} // namespace mediapipe
@@ -0,0 +1,58 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_SESSION_REGISTRY_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_SESSION_REGISTRY_H_
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_submission_queue.h"
+
+#include <lluvia/core.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace mediapipe {
+
+/**
+ * A Lluvia session together with the mutex serializing its queue submissions.
+ *
+ * vkQueueSubmit requires external synchronization, so every calculator
+ * sharing a session must hold runMutex while calling session->run(), or
+ * run its command buffers through submissionQueue, which holds it.
+ *
+ * submissionQueue is null unless requested for a named session.
+ */
+struct LluviaSessionHandle {
+    std::shared_ptr<ll::Session> session;
+    std::shared_ptr<std::mutex> runMutex;
+    std::shared_ptr<LluviaSubmissionQueue> submissionQueue;
+};
+
+/**
+ * Process wide registry of sessions shared by name.
+ *
+ * The first caller for a given name creates the session through the factory,
+ * later callers receive the same session as long as some handle is alive.
+ * An empty name always creates a new, unshared session.
+ *
+ * withSubmissionQueue returns the submission queue of a named session,
+ * creating it if needed. Unnamed sessions have no queue: their only
+ * submitter does not contend with anyone on the run mutex, so a thread
+ * would only add a hand-off to each submission.
+ */
+class LluviaSessionRegistry {
+public:
+    static LluviaSessionHandle getOrCreate(const std::string& name,
+                                           const bool withSubmissionQueue,
+                                           const std::function<std::shared_ptr<ll::Session>()>& factory);
+
+private:
+    struct Entry {
+        std::weak_ptr<ll::Session> session;
+        std::weak_ptr<std::mutex> runMutex;
+        std::weak_ptr<LluviaSubmissionQueue> submissionQueue;
+    };
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_SESSION_REGISTRY_H_
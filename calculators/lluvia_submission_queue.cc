@@ -0,0 +1,155 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_submission_queue.h"
+
+#include "absl/strings/str_cat.h"
+
+#include <vector>
+
+namespace mediapipe {
+
+LluviaSubmissionQueue::LluviaSubmissionQueue(const std::shared_ptr<ll::Session>& session, const std::shared_ptr<std::mutex>& runMutex) :
+    m_session {session},
+    m_runMutex {runMutex} {
+}
+
+LluviaSubmissionQueue::~LluviaSubmissionQueue() {
+
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        auto guard = std::lock_guard {m_mutex};
+        m_stop = true;
+    }
+
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+void LluviaSubmissionQueue::submit(LluviaSubmission& submission) {
+
+    std::call_once(m_started, [this]() {
+        m_thread = std::thread {&LluviaSubmissionQueue::runThread, this};
+    });
+
+    submission.done.store(false, std::memory_order_relaxed);
+    push(submission);
+}
+
+::mediapipe::Status LluviaSubmissionQueue::wait(LluviaSubmission& submission) {
+
+    if (!submission.done.load(std::memory_order_acquire)) {
+        auto lock = std::unique_lock {m_doneMutex};
+        m_doneCondition.wait(lock, [&submission]() { return submission.done.load(std::memory_order_acquire); });
+    }
+
+    return submission.status;
+}
+
+::mediapipe::Status LluviaSubmissionQueue::run(ll::CommandBuffer& cmdBuffer) {
+
+    auto submission = LluviaSubmission {};
+    submission.cmdBuffer = &cmdBuffer;
+
+    submit(submission);
+    return wait(submission);
+}
+
+std::future<::mediapipe::Status> LluviaSubmissionQueue::submitAsync(ll::CommandBuffer& cmdBuffer) {
+
+    auto* submission = new LluviaSubmission {};
+    submission->cmdBuffer = &cmdBuffer;
+    submission->promise = std::make_unique<std::promise<::mediapipe::Status>>();
+    submission->owned = true;
+
+    auto status = submission->promise->get_future();
+    submit(*submission);
+
+    return status;
+}
+
+void LluviaSubmissionQueue::push(LluviaSubmission& submission) {
+
+    auto* head = m_head.load(std::memory_order_relaxed);
+    do {
+        submission.next = head;
+    } while (!m_head.compare_exchange_weak(head, &submission, std::memory_order_release, std::memory_order_relaxed));
+
+    // the thread only sleeps on an empty list, later pushes of the same
+    // wake-up find it non empty
+    if (head == nullptr) {
+        {
+            auto guard = std::lock_guard {m_mutex};
+        }
+        m_condition.notify_one();
+    }
+}
+
+void LluviaSubmissionQueue::runThread() {
+
+    while (true) {
+
+        {
+            auto lock = std::unique_lock {m_mutex};
+            m_condition.wait(lock, [this]() { return m_stop || m_head.load(std::memory_order_acquire) != nullptr; });
+        }
+
+        // pending submissions run before stopping
+        auto* head = m_head.exchange(nullptr, std::memory_order_acquire);
+        if (head == nullptr) {
+            return;
+        }
+
+        ++m_wakeupCount;
+        runBatch(head);
+    }
+}
+
+void LluviaSubmissionQueue::runBatch(LluviaSubmission* head) {
+
+    // the list is in reverse submission order. The batch is bounded by the
+    // number of submitters waiting, so the vector stops growing once warm.
+    thread_local auto batch = std::vector<LluviaSubmission*> {};
+    batch.clear();
+
+    for (auto* submission = head; submission != nullptr; submission = submission->next) {
+        batch.push_back(submission);
+    }
+
+    {
+        auto guard = std::lock_guard {*m_runMutex};
+
+        for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+
+            auto* submission = *it;
+            try {
+                m_session->run(*submission->cmdBuffer);
+                submission->status = ::mediapipe::OkStatus();
+            } catch (std::exception& e) {
+                submission->status = absl::InternalError(absl::StrCat("error running command buffer: ", e.what()));
+            }
+        }
+    }
+
+    m_submissionCount += batch.size();
+
+    {
+        auto guard = std::lock_guard {m_doneMutex};
+
+        for (auto* submission : batch) {
+
+            if (submission->owned) {
+                submission->promise->set_value(submission->status);
+                delete submission;
+                continue;
+            }
+
+            // the submitter may release the submission as soon as done is set
+            submission->done.store(true, std::memory_order_release);
+        }
+    }
+
+    m_doneCondition.notify_all();
+}
+
+} // namespace mediapipe
@@ -0,0 +1,115 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_SUBMISSION_QUEUE_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_SUBMISSION_QUEUE_H_
+
+#include "mediapipe/framework/port/status.h"
+
+#include <lluvia/core.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mediapipe {
+
+/**
+ * Command buffer submitted to a LluviaSubmissionQueue.
+ *
+ * The submitter owns the submission and the command buffer, and keeps both
+ * alive until the queue marks the submission done.
+ */
+struct LluviaSubmission {
+    ll::CommandBuffer* cmdBuffer {nullptr};
+
+    // set by the queue, valid once done is true
+    ::mediapipe::Status status {};
+    std::atomic<bool> done {false};
+
+    // fulfilled with status if not null, see LluviaSubmissionQueue::submitAsync()
+    std::unique_ptr<std::promise<::mediapipe::Status>> promise {};
+
+    // deleted by the queue once done
+    bool owned {false};
+
+    LluviaSubmission* next {nullptr};
+};
+
+/**
+ * Thread running the command buffers submitted to one session.
+ *
+ * Submitters push to a lock-free list and the thread takes all pending
+ * submissions on each wake-up, running them in submission order while
+ * holding the run mutex of the session once. Calculators sharing a session
+ * then wait on their own submission instead of contending on the mutex.
+ *
+ * ll::Session::run() submits one command buffer and waits for the queue to
+ * be idle, so the submissions of a wake-up still reach the device one after
+ * the other.
+ */
+class LluviaSubmissionQueue {
+public:
+    LluviaSubmissionQueue(const std::shared_ptr<ll::Session>& session, const std::shared_ptr<std::mutex>& runMutex);
+
+    // runs the pending submissions before returning
+    ~LluviaSubmissionQueue();
+
+    LluviaSubmissionQueue(const LluviaSubmissionQueue&) = delete;
+    LluviaSubmissionQueue& operator=(const LluviaSubmissionQueue&) = delete;
+
+    /**
+     * Pushes the submission, resetting its done flag. The thread starts on
+     * the first submission.
+     */
+    void submit(LluviaSubmission& submission);
+
+    // blocks until the submission is done and returns its status
+    ::mediapipe::Status wait(LluviaSubmission& submission);
+
+    // submit() and wait() on a submission of the calling thread, without allocating
+    ::mediapipe::Status run(ll::CommandBuffer& cmdBuffer);
+
+    /**
+     * Submits cmdBuffer, which must stay alive until the returned future is
+     * ready.
+     */
+    std::future<::mediapipe::Status> submitAsync(ll::CommandBuffer& cmdBuffer);
+
+    // command buffers run and wake-ups of the thread so far
+    uint64_t getSubmissionCount() const noexcept { return m_submissionCount.load(); }
+    uint64_t getWakeupCount() const noexcept { return m_wakeupCount.load(); }
+
+private:
+    void push(LluviaSubmission& submission);
+    void runThread();
+
+    // runs the submissions of a list taken from m_head, oldest last
+    void runBatch(LluviaSubmission* head);
+
+    const std::shared_ptr<ll::Session> m_session;
+    const std::shared_ptr<std::mutex> m_runMutex;
+
+    std::atomic<LluviaSubmission*> m_head {nullptr};
+
+    // the thread sleeps on m_condition while m_head is null. Only the
+    // submitter pushing to an empty list takes m_mutex to wake it up.
+    std::mutex m_mutex {};
+    std::condition_variable m_condition {};
+    bool m_stop {false};
+
+    // submitters waiting in wait() sleep on m_doneCondition
+    std::mutex m_doneMutex {};
+    std::condition_variable m_doneCondition {};
+
+    std::atomic<uint64_t> m_submissionCount {0};
+    std::atomic<uint64_t> m_wakeupCount {0};
+
+    std::once_flag m_started {};
+    std::thread m_thread {};
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_SUBMISSION_QUEUE_H_
@@ -0,0 +1,184 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_trace_recorder.h"
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/port/logging.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <utility>
+
+namespace mediapipe {
+
+namespace {
+
+// ids of named tracks start above the hashed ids of host threads
+constexpr int64_t firstNamedTrack = int64_t {1} << 32;
+
+std::string escapeJson(const std::string& text) {
+
+    auto escaped = std::string {};
+    escaped.reserve(text.size());
+
+    for (const auto c : text) {
+        switch (c) {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    escaped += ' ';
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+
+    return escaped;
+}
+
+} // namespace
+
+std::shared_ptr<LluviaTraceRecorder> LluviaTraceRecorder::getOrCreate(const std::string& path, const int maxEvents) {
+
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<LluviaTraceRecorder>> registry;
+
+    auto guard = std::lock_guard {registryMutex};
+
+    auto recorder = registry[path].lock();
+    if (recorder == nullptr) {
+        recorder = std::shared_ptr<LluviaTraceRecorder>(new LluviaTraceRecorder(path, maxEvents));
+        registry[path] = recorder;
+    }
+
+    return recorder;
+}
+
+LluviaTraceRecorder::LluviaTraceRecorder(const std::string& path, const int maxEvents) :
+    m_path {path},
+    m_maxEvents {static_cast<size_t>(std::max(1, maxEvents))} {
+}
+
+LluviaTraceRecorder::~LluviaTraceRecorder() {
+
+    auto status = write();
+    if (!status.ok()) {
+        LOG(WARNING) << "LluviaTraceRecorder: " << status.message();
+    }
+}
+
+int64_t LluviaTraceRecorder::now() {
+
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+}
+
+void LluviaTraceRecorder::addEvent(const std::string& node, const std::string& name, const int64_t start, const int64_t duration) {
+
+    // 31 bits keep thread ids below the named tracks and readable in the viewers
+    const auto track = static_cast<int64_t>(std::hash<std::thread::id> {}(std::this_thread::get_id()) & 0x7FFFFFFF);
+
+    auto guard = std::lock_guard {m_mutex};
+    pushBounded(m_events, Event {node, name, track, start, duration});
+}
+
+void LluviaTraceRecorder::addTrackEvent(const std::string& track, const std::string& node, const std::string& name, const int64_t start, const int64_t duration) {
+
+    auto guard = std::lock_guard {m_mutex};
+
+    auto it = m_tracks.find(track);
+    if (it == m_tracks.end()) {
+        it = m_tracks.emplace(track, firstNamedTrack + static_cast<int64_t>(m_tracks.size())).first;
+    }
+
+    pushBounded(m_events, Event {node, name, it->second, start, duration});
+}
+
+void LluviaTraceRecorder::addCounterEvent(const std::string& node, const std::string& name, const int64_t time, const double value) {
+
+    auto guard = std::lock_guard {m_mutex};
+    pushBounded(m_counterEvents, CounterEvent {node, name, time, value});
+}
+
+template<typename T>
+void LluviaTraceRecorder::pushBounded(std::deque<T>& events, T event) {
+
+    if (events.size() == m_maxEvents) {
+        if (m_droppedEvents++ == 0) {
+            LOG(WARNING) << "LluviaTraceRecorder: more than " << m_maxEvents << " events, dropping the oldest ones of " << m_path;
+        }
+
+        events.pop_front();
+    }
+
+    events.push_back(std::move(event));
+}
+
+::mediapipe::Status LluviaTraceRecorder::write() {
+
+    auto guard = std::lock_guard {m_mutex};
+
+    auto file = std::ofstream {m_path, std::ios::out | std::ios::trunc};
+    if (!file) {
+        return absl::UnavailableError(absl::StrCat("cannot open trace file: ", m_path));
+    }
+
+    const auto pid = static_cast<int64_t>(getpid());
+    auto separator = "";
+
+    file << "{\"traceEvents\":[";
+
+    for (const auto& [track, id] : m_tracks) {
+        file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << id
+             << ",\"args\":{\"name\":\"" << escapeJson(track) << "\"}}";
+        separator = ",\n";
+    }
+
+    for (const auto& event : m_events) {
+        file << separator << "{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"lluvia\",\"ph\":\"X\""
+             << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+             << ",\"pid\":" << pid << ",\"tid\":" << event.track
+             << ",\"args\":{\"node\":\"" << escapeJson(event.node) << "\"}}";
+        separator = ",\n";
+    }
+
+    for (const auto& counter : m_counterEvents) {
+        file << separator << "{\"name\":\"" << escapeJson(counter.name) << "\",\"cat\":\"lluvia\",\"ph\":\"C\""
+             << ",\"ts\":" << counter.time << ",\"pid\":" << pid
+             << ",\"args\":{\"" << escapeJson(counter.node) << "\":" << counter.value << "}}";
+        separator = ",\n";
+    }
+
+    file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+    if (!file) {
+        return absl::DataLossError(absl::StrCat("error writing trace file: ", m_path));
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+LluviaTraceScope::LluviaTraceScope(LluviaTraceRecorder* recorder, const std::string& node, const char* name) :
+    m_recorder {recorder},
+    m_node {node},
+    m_name {name} {
+
+    if (m_recorder != nullptr) {
+        m_start = LluviaTraceRecorder::now();
+    }
+}
+
+LluviaTraceScope::~LluviaTraceScope() {
+
+    if (m_recorder != nullptr) {
+        m_recorder->addEvent(m_node, m_name, m_start, LluviaTraceRecorder::now() - m_start);
+    }
+}
+
+} // namespace mediapipe
@@ -0,0 +1,113 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_TRACE_RECORDER_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_TRACE_RECORDER_H_
+
+#include "mediapipe/framework/port/status.h"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mediapipe {
+
+/**
+ * Recorder of trace events written as a Chrome JSON trace, which both
+ * chrome://tracing and ui.perfetto.dev open.
+ *
+ * Recorders are shared by path, so the calculators writing to the same
+ * path produce one timeline. The most recent events are kept in memory and
+ * the trace is written by write() and when the last handle is released.
+ */
+class LluviaTraceRecorder {
+public:
+    /**
+     * maxEvents bounds the events and the counter events kept, it is only
+     * used by the call creating the recorder of path.
+     */
+    static std::shared_ptr<LluviaTraceRecorder> getOrCreate(const std::string& path, const int maxEvents);
+
+    ~LluviaTraceRecorder();
+
+    /**
+     * Host clock of all events, in microseconds.
+     */
+    static int64_t now();
+
+    /**
+     * Adds an event spanning [start, start + duration) to the track of the
+     * calling thread.
+     */
+    void addEvent(const std::string& node, const std::string& name, const int64_t start, const int64_t duration);
+
+    /**
+     * Adds an event to a named track not bound to a host thread, such as the
+     * GPU queue of a session.
+     */
+    void addTrackEvent(const std::string& track, const std::string& node, const std::string& name, const int64_t start, const int64_t duration);
+
+    /**
+     * Adds a sample of a counter, drawn as a chart with one series per node.
+     */
+    void addCounterEvent(const std::string& node, const std::string& name, const int64_t time, const double value);
+
+    ::mediapipe::Status write();
+
+private:
+    LluviaTraceRecorder(const std::string& path, const int maxEvents);
+
+    // drops the oldest events of full queues, called with m_mutex held
+    template<typename T>
+    void pushBounded(std::deque<T>& events, T event);
+
+    struct Event {
+        std::string node;
+        std::string name;
+        int64_t track;
+        int64_t start;
+        int64_t duration;
+    };
+
+    const std::string m_path;
+    const size_t m_maxEvents;
+
+    struct CounterEvent {
+        std::string node;
+        std::string name;
+        int64_t time;
+        double value;
+    };
+
+    std::mutex m_mutex {};
+    std::deque<Event> m_events {};
+    std::deque<CounterEvent> m_counterEvents {};
+    int64_t m_droppedEvents {0};
+
+    // ids of the named tracks, after the ones of host threads
+    std::map<std::string, int64_t> m_tracks {};
+};
+
+/**
+ * Records an event on the calling thread from construction to destruction.
+ * Does nothing if the recorder is null.
+ */
+class LluviaTraceScope {
+public:
+    LluviaTraceScope(LluviaTraceRecorder* recorder, const std::string& node, const char* name);
+    ~LluviaTraceScope();
+
+    LluviaTraceScope(const LluviaTraceScope&) = delete;
+    LluviaTraceScope& operator=(const LluviaTraceScope&) = delete;
+
+private:
+    LluviaTraceRecorder* m_recorder;
+    const std::string& m_node;
+    const char* m_name;
+    int64_t m_start {0};
+};
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_TRACE_RECORDER_H_
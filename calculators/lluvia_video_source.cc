@@ -0,0 +1,688 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/opencv_imgcodecs_inc.h"
+#include "mediapipe/framework/port/opencv_imgproc_inc.h"
+#include "mediapipe/framework/port/opencv_video_inc.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/tool/status_util.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_image.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_session_registry.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_video_source.pb.h"
+
+#include <lluvia/core.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mediapipe {
+
+namespace {
+
+// Read only mapping of a whole file, with the kernel advised to read it ahead.
+class MappedFile {
+public:
+    static ::mediapipe::StatusOr<std::unique_ptr<MappedFile>> Open(const std::string& path) {
+
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return absl::NotFoundError(absl::StrCat("cannot open ", path));
+        }
+
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+            ::close(fd);
+            return absl::InvalidArgumentError(absl::StrCat("cannot read ", path));
+        }
+
+        const auto size = static_cast<size_t>(info.st_size);
+        auto* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        // the mapping keeps the file referenced
+        ::close(fd);
+
+        if (data == MAP_FAILED) {
+            return absl::InternalError(absl::StrCat("cannot map ", path));
+        }
+
+        ::madvise(data, size, MADV_WILLNEED);
+
+        return std::unique_ptr<MappedFile> {new MappedFile {data, size}};
+    }
+
+    ~MappedFile() {
+        ::munmap(m_data, m_size);
+    }
+
+    // header over the bytes of the file, for cv::imdecode
+    cv::Mat bytes() const {
+        return cv::Mat {1, static_cast<int>(m_size), CV_8UC1, m_data};
+    }
+
+private:
+    MappedFile(void* data, const size_t size) :
+        m_data {data},
+        m_size {size} {
+    }
+
+    void* m_data;
+    size_t m_size;
+};
+
+// Source of decoded BGR, BGRA or gray frames.
+class FrameReader {
+public:
+    virtual ~FrameReader() = default;
+
+    // decodes the next frame into frame, returns false at the end of the source
+    virtual ::mediapipe::StatusOr<bool> Read(cv::Mat& frame) = 0;
+
+    virtual double getFrameRate() const = 0;
+};
+
+class VideoReader : public FrameReader {
+public:
+    ::mediapipe::Status Open(const std::string& path) {
+
+        if (!m_capture.open(path)) {
+            return absl::NotFoundError(absl::StrCat("cannot open video ", path));
+        }
+
+        return ::mediapipe::OkStatus();
+    }
+
+    ::mediapipe::StatusOr<bool> Read(cv::Mat& frame) override {
+        return m_capture.read(frame) && !frame.empty();
+    }
+
+    double getFrameRate() const override {
+        return m_capture.get(cv::CAP_PROP_FPS);
+    }
+
+private:
+    // get() is not const
+    mutable cv::VideoCapture m_capture {};
+};
+
+class ImageSequenceReader : public FrameReader {
+public:
+    ::mediapipe::Status Open(const std::string& directory, const std::string& extension, const int readAhead) {
+
+        MP_RETURN_IF_ERROR(file::MatchFileTypeInDirectory(directory, extension, &m_paths));
+        if (m_paths.empty()) {
+            return absl::NotFoundError(absl::StrCat("no ", extension, " files in ", directory));
+        }
+
+        std::sort(m_paths.begin(), m_paths.end());
+        m_readAhead = std::max(1, readAhead);
+
+        return ::mediapipe::OkStatus();
+    }
+
+    ::mediapipe::StatusOr<bool> Read(cv::Mat& frame) override {
+
+        // map the files of the next frames so the kernel reads them while
+        // this one is decoded
+        while (m_mappedFiles.size() < static_cast<size_t>(m_readAhead) && m_nextMapped < m_paths.size()) {
+            auto mappedFile = std::unique_ptr<MappedFile> {};
+            ASSIGN_OR_RETURN(mappedFile, MappedFile::Open(m_paths[m_nextMapped]));
+
+            m_mappedFiles.push_back(std::move(mappedFile));
+            ++m_nextMapped;
+        }
+
+        if (m_mappedFiles.empty()) {
+            return false;
+        }
+
+        const auto path = m_paths[m_nextMapped - m_mappedFiles.size()];
+
+        cv::imdecode(m_mappedFiles.front()->bytes(), cv::IMREAD_COLOR, &frame);
+        m_mappedFiles.pop_front();
+
+        if (frame.empty()) {
+            return absl::InvalidArgumentError(absl::StrCat("cannot decode ", path));
+        }
+
+        return true;
+    }
+
+    double getFrameRate() const override {
+        return 0.0;
+    }
+
+private:
+    std::vector<std::string> m_paths {};
+    size_t m_nextMapped {0};
+
+    int m_readAhead {1};
+    std::deque<std::unique_ptr<MappedFile>> m_mappedFiles {};
+};
+
+/**
+ * Staging buffers frames are decoded into, shared between the prefetch
+ * thread, the calculator and the ImageFrame packets adopting them.
+ *
+ * A slot is free, being written by the prefetch thread, ready to be emitted,
+ * or referenced by the calculator or a packet until released.
+ */
+class StagingRing {
+public:
+    struct Slot {
+        std::shared_ptr<ll::Buffer> buffer;
+        std::unique_ptr<uint8_t[], ll::Buffer::BufferMapDeleter> mapped;
+
+        // SBGRA header over mapped
+        cv::Mat mat;
+    };
+
+    enum class PopResult {
+        Ready,
+        Finished,
+
+        // the prefetch thread waits for a slot while every other one is
+        // referenced downstream, see AddSlot()
+        Starved,
+    };
+
+    // slots are added by the calculator thread, which owns the Lluvia memory
+    void AddSlot(std::unique_ptr<Slot> slot) {
+        {
+            auto guard = std::lock_guard {m_mutex};
+            m_free.push_back(m_slots.size());
+            m_slots.push_back(std::move(slot));
+        }
+        m_condition.notify_all();
+    }
+
+    Slot& getSlot(const size_t slot) {
+        auto guard = std::lock_guard {m_mutex};
+        return *m_slots[slot];
+    }
+
+    // blocks until a slot is free, returns false if the ring stopped
+    bool AcquireFree(size_t& slot) {
+
+        auto lock = std::unique_lock {m_mutex};
+
+        m_waitingForFree = true;
+        m_condition.notify_all();
+        m_condition.wait(lock, [this]() { return m_stop || !m_free.empty(); });
+        m_waitingForFree = false;
+
+        if (m_stop) {
+            return false;
+        }
+
+        slot = m_free.front();
+        m_free.pop_front();
+        return true;
+    }
+
+    void PushReady(const size_t slot) {
+        {
+            auto guard = std::lock_guard {m_mutex};
+            m_ready.push_back(slot);
+        }
+        m_condition.notify_all();
+    }
+
+    // blocks until a slot is ready, the source finished or the prefetch thread starves
+    PopResult PopReady(size_t& slot) {
+
+        auto lock = std::unique_lock {m_mutex};
+        m_condition.wait(lock, [this]() { return m_finished || !m_ready.empty() || isStarved(); });
+
+        // frames decoded before the end are emitted first
+        if (!m_ready.empty()) {
+            slot = m_ready.front();
+            m_ready.pop_front();
+            return PopResult::Ready;
+        }
+
+        return m_finished ? PopResult::Finished : PopResult::Starved;
+    }
+
+    void Release(const size_t slot) {
+        {
+            auto guard = std::lock_guard {m_mutex};
+            m_free.push_back(slot);
+        }
+        m_condition.notify_all();
+    }
+
+    // called by the prefetch thread at the end of the source or on error
+    void Finish(const ::mediapipe::Status& status) {
+        {
+            auto guard = std::lock_guard {m_mutex};
+            m_finished = true;
+            m_status = status;
+        }
+        m_condition.notify_all();
+    }
+
+    // wakes up the prefetch thread to exit
+    void Stop() {
+        {
+            auto guard = std::lock_guard {m_mutex};
+            m_stop = true;
+        }
+        m_condition.notify_all();
+    }
+
+    ::mediapipe::Status getStatus() {
+        auto guard = std::lock_guard {m_mutex};
+        return m_status;
+    }
+
+private:
+    bool isStarved() const noexcept { return m_waitingForFree && m_free.empty(); }
+
+    // pointers stay valid as slots are added
+    std::vector<std::unique_ptr<Slot>> m_slots {};
+
+    std::mutex m_mutex {};
+    std::condition_variable m_condition {};
+    std::deque<size_t> m_free {};
+    std::deque<size_t> m_ready {};
+    bool m_waitingForFree {false};
+    bool m_finished {false};
+    bool m_stop {false};
+    ::mediapipe::Status m_status {};
+};
+
+// converts a decoded frame into the SBGRA pixels of a staging slot
+::mediapipe::Status ConvertToStaging(const cv::Mat& frame, cv::Mat& staging) {
+
+    RET_CHECK(frame.cols == staging.cols && frame.rows == staging.rows)
+        << "frame size changed, expected: " << staging.cols << "x" << staging.rows
+        << ", got: " << frame.cols << "x" << frame.rows;
+
+    switch (frame.channels()) {
+        case 1:
+            cv::cvtColor(frame, staging, cv::COLOR_GRAY2BGRA);
+            break;
+        case 3:
+            cv::cvtColor(frame, staging, cv::COLOR_BGR2BGRA);
+            break;
+        case 4:
+            frame.copyTo(staging);
+            break;
+        default:
+            return absl::InvalidArgumentError(absl::StrCat("unsupported channel count: ", frame.channels()));
+    }
+
+    // cvtColor and copyTo reallocate instead of writing to a header of the wrong size or type
+    RET_CHECK(staging.isContinuous() && staging.type() == CV_8UC4);
+    return ::mediapipe::OkStatus();
+}
+
+} // namespace
+
+// Source calculator reading a video file or an image sequence.
+//
+// A prefetch thread decodes the frames ahead of the graph and converts them
+// straight into mapped Lluvia staging buffers, so each frame is written
+// once between the decoder and the device. Frames are emitted as LLUVIA_IMAGE
+// packets copied to device images, or as ImageFrame packets over the
+// staging buffer.
+class LluviaVideoSourceCalculator : public CalculatorBase {
+public:
+    static ::mediapipe::Status GetContract(CalculatorContract* cc);
+
+    ::mediapipe::Status Open(CalculatorContext* cc) override;
+    ::mediapipe::Status Process(CalculatorContext* cc) override;
+    ::mediapipe::Status Close(CalculatorContext* cc) override;
+
+    ~LluviaVideoSourceCalculator() override;
+
+private:
+    ::mediapipe::Status OpenReader();
+    std::unique_ptr<StagingRing::Slot> CreateStagingSlot();
+    void RunPrefetch(std::unique_ptr<FrameReader> reader, cv::Mat frame);
+    void StopPrefetch();
+
+    ::mediapipe::Status EmitLluviaImage(CalculatorContext* cc, const size_t slot, const Timestamp timestamp);
+    ::mediapipe::Status EmitImageFrame(CalculatorContext* cc, const size_t slot, const Timestamp timestamp);
+
+    // free device image, allocated only while all the previous ones are referenced downstream
+    size_t AcquireImage();
+
+    // adds an image in general layout to the pool, the transition runs holding m_runMutex
+    void AllocateImage();
+    ll::CommandBuffer& getCopyCommandBuffer(const size_t slot, const size_t image);
+
+    lluvia::LluviaVideoSourceCalculatorOptions m_options;
+
+    std::shared_ptr<ll::Session> m_session {};
+    std::shared_ptr<std::mutex> m_runMutex {};
+    std::shared_ptr<ll::Memory> m_stagingMemory {};
+    std::shared_ptr<ll::Memory> m_deviceMemory {};
+
+    int m_width {0};
+    int m_height {0};
+    double m_frameRate {0.0};
+    int64_t m_frameIndex {0};
+
+    std::unique_ptr<FrameReader> m_reader {};
+    std::shared_ptr<StagingRing> m_ring {};
+    std::thread m_prefetchThread {};
+
+    std::vector<std::shared_ptr<ll::ImageView>> m_imagePool {};
+
+    // copy of each staging slot to each pool image, recorded on first use
+    std::map<std::pair<size_t, size_t>, std::unique_ptr<ll::CommandBuffer>> m_cmdBuffers {};
+};
+REGISTER_CALCULATOR(LluviaVideoSourceCalculator);
+
+::mediapipe::Status LluviaVideoSourceCalculator::GetContract(CalculatorContract* cc) {
+
+    const auto& options = cc->Options<lluvia::LluviaVideoSourceCalculatorOptions>();
+
+    switch (options.packet_type()) {
+        case lluvia::LLUVIA_IMAGE:
+            cc->Outputs().Index(0).Set<LluviaImage>();
+            break;
+        case lluvia::IMAGE_FRAME:
+            cc->Outputs().Index(0).Set<ImageFrame>();
+            break;
+        default:
+            return absl::InvalidArgumentError("packet_type must be LLUVIA_IMAGE or IMAGE_FRAME");
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaVideoSourceCalculator::Open(CalculatorContext* cc) {
+
+    m_options = cc->Options<lluvia::LluviaVideoSourceCalculatorOptions>();
+
+    RET_CHECK(m_options.video_path().empty() != m_options.image_directory().empty())
+        << "exactly one of video_path and image_directory must be set";
+    RET_CHECK_GT(m_options.prefetch_frames(), 0) << "prefetch_frames must be positive";
+
+    MP_RETURN_IF_ERROR(OpenReader());
+
+    m_frameRate = m_options.frame_rate() > 0 ? m_options.frame_rate() : m_reader->getFrameRate();
+    if (m_frameRate <= 0) {
+        m_frameRate = 30.0;
+    }
+
+    // the first frame gives the size of the staging buffers
+    auto firstFrame = cv::Mat {};
+    auto hasFrame = false;
+    ASSIGN_OR_RETURN(hasFrame, m_reader->Read(firstFrame));
+    RET_CHECK(hasFrame) << "the source has no frames";
+
+    m_width = firstFrame.cols;
+    m_height = firstFrame.rows;
+
+    auto sessionDesc = ll::SessionDescriptor {}.enableDebug(m_options.enable_debug());
+
+    auto sessionHandle = LluviaSessionRegistry::getOrCreate(m_options.session_name(), false, [&sessionDesc]() {
+        return ll::Session::create(sessionDesc);
+    });
+
+    m_session = sessionHandle.session;
+    m_runMutex = sessionHandle.runMutex;
+
+    m_stagingMemory = m_session->createMemory(ll::MemoryPropertyFlagBits::HostVisible | ll::MemoryPropertyFlagBits::HostCoherent, 0, false);
+    if (m_options.packet_type() == lluvia::LLUVIA_IMAGE) {
+        m_deviceMemory = m_session->createMemory(ll::MemoryPropertyFlagBits::DeviceLocal, 32 * 1024 * 1024, false);
+
+        while (m_imagePool.size() < static_cast<size_t>(std::max(1, m_options.image_pool_size()))) {
+            AllocateImage();
+        }
+    }
+
+    m_ring = std::make_shared<StagingRing>();
+    for (auto i = 0; i < m_options.prefetch_frames(); ++i) {
+        m_ring->AddSlot(CreateStagingSlot());
+    }
+
+    m_prefetchThread = std::thread {&LluviaVideoSourceCalculator::RunPrefetch, this, std::move(m_reader), std::move(firstFrame)};
+
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaVideoSourceCalculator::Process(CalculatorContext* cc) {
+
+    auto slot = size_t {0};
+    auto result = m_ring->PopReady(slot);
+
+    // IMAGE_FRAME packets keep their slot until released downstream
+    while (result == StagingRing::PopResult::Starved) {
+        m_ring->AddSlot(CreateStagingSlot());
+        result = m_ring->PopReady(slot);
+    }
+
+    if (result == StagingRing::PopResult::Finished) {
+        MP_RETURN_IF_ERROR(m_ring->getStatus());
+        return tool::StatusStop();
+    }
+
+    const auto timestamp = Timestamp(static_cast<int64_t>(m_frameIndex * 1e6 / m_frameRate));
+    ++m_frameIndex;
+
+    if (m_options.packet_type() == lluvia::LLUVIA_IMAGE) {
+        return EmitLluviaImage(cc, slot, timestamp);
+    }
+
+    return EmitImageFrame(cc, slot, timestamp);
+}
+
+::mediapipe::Status LluviaVideoSourceCalculator::Close(CalculatorContext* cc) {
+
+    StopPrefetch();
+    return ::mediapipe::OkStatus();
+}
+
+LluviaVideoSourceCalculator::~LluviaVideoSourceCalculator() {
+    StopPrefetch();
+}
+
+::mediapipe::Status LluviaVideoSourceCalculator::OpenReader() {
+
+    if (!m_options.video_path().empty()) {
+        auto reader = absl::make_unique<VideoReader>();
+        MP_RETURN_IF_ERROR(reader->Open(m_options.video_path()));
+        m_reader = std::move(reader);
+        return ::mediapipe::OkStatus();
+    }
+
+    auto reader = absl::make_unique<ImageSequenceReader>();
+    MP_RETURN_IF_ERROR(reader->Open(m_options.image_directory(), m_options.image_extension(), m_options.prefetch_frames()));
+    m_reader = std::move(reader);
+    return ::mediapipe::OkStatus();
+}
+
+std::unique_ptr<StagingRing::Slot> LluviaVideoSourceCalculator::CreateStagingSlot() {
+
+    const auto rowBytes = static_cast<size_t>(m_width) * 4;
+
+    auto slot = absl::make_unique<StagingRing::Slot>();
+    slot->buffer = m_stagingMemory->createBuffer(rowBytes * m_height);
+    slot->mapped = slot->buffer->map<uint8_t[]>();
+    slot->mat = cv::Mat {m_height, m_width, CV_8UC4, slot->mapped.get(), rowBytes};
+
+    return slot;
+}
+
+void LluviaVideoSourceCalculator::RunPrefetch(std::unique_ptr<FrameReader> reader, cv::Mat frame) {
+
+    // frame holds the first frame, decoded in Open()
+    for (auto frameIndex = int64_t {0}; m_options.max_frames() <= 0 || frameIndex < m_options.max_frames(); ++frameIndex) {
+
+        if (frameIndex > 0) {
+            auto hasFrame = reader->Read(frame);
+            if (!hasFrame.ok()) {
+                m_ring->Finish(hasFrame.status());
+                return;
+            }
+
+            if (!hasFrame.value()) {
+                break;
+            }
+        }
+
+        auto slot = size_t {0};
+        if (!m_ring->AcquireFree(slot)) {
+            return;
+        }
+
+        auto status = ConvertToStaging(frame, m_ring->getSlot(slot).mat);
+        if (!status.ok()) {
+            m_ring->Finish(status);
+            return;
+        }
+
+        m_ring->PushReady(slot);
+    }
+
+    m_ring->Finish(::mediapipe::OkStatus());
+}
+
+void LluviaVideoSourceCalculator::StopPrefetch() {
+
+    if (!m_prefetchThread.joinable()) {
+        return;
+    }
+
+    m_ring->Stop();
+    m_prefetchThread.join();
+}
+
+::mediapipe::Status LluviaVideoSourceCalculator::EmitLluviaImage(CalculatorContext* cc, const size_t slot, const Timestamp timestamp) {
+
+    auto image = size_t {0};
+
+    try {
+        image = AcquireImage();
+        auto& cmdBuffer = getCopyCommandBuffer(slot, image);
+
+        auto guard = std::lock_guard {*m_runMutex};
+        m_session->run(cmdBuffer);
+    } catch (std::exception& e) {
+        m_ring->Release(slot);
+        return absl::InternalError(absl::StrCat("error copying frame to device: ", e.what()));
+    }
+
+    // run() returned, so the staging buffer can take the next frame
+    m_ring->Release(slot);
+
+    auto lluviaImage = absl::make_unique<LluviaImage>();
+    lluviaImage->session = m_session;
+    lluviaImage->imageView = m_imagePool[image];
+
+    cc->Outputs().Index(0).Add(lluviaImage.release(), timestamp);
+    return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status LluviaVideoSourceCalculator::EmitImageFrame(CalculatorContext* cc, const size_t slot, const Timestamp timestamp) {
+
+    auto& stagingSlot = m_ring->getSlot(slot);
+
+    // the slot returns to the prefetch ring once downstream releases the frame
+    auto imageFrame = absl::make_unique<ImageFrame>();
+    imageFrame->AdoptPixelData(ImageFormat::SBGRA, m_width, m_height, m_width * 4, stagingSlot.mapped.get(),
+                               [ring = m_ring, slot](uint8*) { ring->Release(slot); });
+
+    cc->Outputs().Index(0).Add(imageFrame.release(), timestamp);
+    return ::mediapipe::OkStatus();
+}
+
+size_t LluviaVideoSourceCalculator::AcquireImage() {
+
+    for (auto i = size_t {0}; i < m_imagePool.size(); ++i) {
+        if (m_imagePool[i].use_count() == 1) {
+            return i;
+        }
+    }
+
+    AllocateImage();
+    return m_imagePool.size() - 1;
+}
+
+void LluviaVideoSourceCalculator::AllocateImage() {
+
+    const auto usageFlags = ll::ImageUsageFlags {ll::ImageUsageFlagBits::Storage
+                                                 | ll::ImageUsageFlagBits::Sampled
+                                                 | ll::ImageUsageFlagBits::TransferDst
+                                                 | ll::ImageUsageFlagBits::TransferSrc};
+
+    const auto imageDesc = ll::ImageDescriptor {1, static_cast<uint32_t>(m_height), static_cast<uint32_t>(m_width),
+                                                ll::ChannelCount::C4, ll::ChannelType::Uint8}
+                               .setUsageFlags(usageFlags);
+
+    auto image = m_deviceMemory->createImage(imageDesc);
+
+    // ll::Image::changeImageLayout() submits to the queue without the session lock
+    auto cmdBuffer = m_session->createCommandBuffer();
+    cmdBuffer->begin();
+    cmdBuffer->changeImageLayout(*image, ll::ImageLayout::General);
+    cmdBuffer->end();
+
+    {
+        auto guard = std::lock_guard {*m_runMutex};
+        m_session->run(*cmdBuffer);
+    }
+
+    m_imagePool.push_back(image->createImageView(ll::ImageViewDescriptor {ll::ImageAddressMode::ClampToBorder,
+                                                                          ll::ImageFilterMode::Nearest,
+                                                                          false,
+                                                                          false}));
+}
+
+ll::CommandBuffer& LluviaVideoSourceCalculator::getCopyCommandBuffer(const size_t slot, const size_t image) {
+
+    auto& cmdBuffer = m_cmdBuffers[{slot, image}];
+    if (cmdBuffer) {
+        return *cmdBuffer;
+    }
+
+    auto& deviceImage = *m_imagePool[image]->getImage();
+
+    cmdBuffer = m_session->createCommandBuffer();
+    cmdBuffer->begin();
+    cmdBuffer->changeImageLayout(deviceImage, ll::ImageLayout::TransferDstOptimal);
+    cmdBuffer->memoryBarrier();
+    cmdBuffer->copyBufferToImage(*m_ring->getSlot(slot).buffer, deviceImage);
+    cmdBuffer->memoryBarrier();
+    cmdBuffer->changeImageLayout(deviceImage, ll::ImageLayout::General);
+    cmdBuffer->end();
+
+    return *cmdBuffer;
+}
+
+} // namespace mediapipe
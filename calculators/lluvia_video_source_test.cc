@@ -0,0 +1,207 @@
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/opencv_imgcodecs_inc.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/sink.h"
+
+#include "tools/cpp/runfiles/runfiles.h"
+using bazel::tools::cpp::runfiles::Runfiles;
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace mediapipe {
+
+namespace {
+
+constexpr auto kFrameCount = 6;
+constexpr auto kWidth = 64;
+constexpr auto kHeight = 48;
+
+// BGR color of frame t
+cv::Vec3b getFrameColor(const int t) {
+    return cv::Vec3b(10 * t, 20 * t, 30 * t);
+}
+
+// writes kFrameCount PNG frames of a solid color to a new directory of TEST_TMPDIR
+std::string WriteImageSequence(const std::string& name) {
+
+    const auto directory = absl::StrCat(std::getenv("TEST_TMPDIR"), "/", name);
+    ::mkdir(directory.c_str(), 0755);
+
+    for (auto t = 0; t < kFrameCount; ++t) {
+        auto image = cv::Mat {kHeight, kWidth, CV_8UC3, cv::Scalar(getFrameColor(t))};
+        cv::imwrite(absl::StrCat(directory, "/frame_", t, ".png"), image);
+    }
+
+    return directory;
+}
+
+TEST(LluviaVideoSourceCalculatorTest, TestImageFrameOutput) {
+
+    const auto directory = WriteImageSequence("image_frame_output");
+
+    // the sink keeps every frame, so the ring grows past prefetch_frames
+    auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(
+        absl::Substitute(
+            R"pb(
+                node {
+                    calculator: "LluviaVideoSourceCalculator"
+                    output_stream: "output_image"
+                    node_options {
+                        [type.googleapis.com/lluvia.LluviaVideoSourceCalculatorOptions]: {
+                            image_directory: "$0"
+                            frame_rate: 25
+                            prefetch_frames: 2
+                            packet_type: IMAGE_FRAME
+                        }
+                    }
+                }
+            )pb",
+            directory
+        )
+    );
+
+    auto outputPackets = std::vector<Packet> {};
+    tool::AddVectorSink("output_image", &graphConfig, &outputPackets);
+
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(graphConfig));
+    MP_ASSERT_OK(graph.Run());
+
+    ASSERT_EQ(outputPackets.size(), kFrameCount);
+
+    for (auto t = 0; t < kFrameCount; ++t) {
+
+        EXPECT_EQ(outputPackets[t].Timestamp(), Timestamp(t * 40000));
+
+        const auto& outImage = outputPackets[t].Get<ImageFrame>();
+        ASSERT_EQ(outImage.Format(), ImageFormat::SBGRA);
+        ASSERT_EQ(outImage.Width(), kWidth);
+        ASSERT_EQ(outImage.Height(), kHeight);
+
+        const auto color = getFrameColor(t);
+        for (auto y = 0; y < outImage.Height(); ++y) {
+            const auto* row = outImage.PixelData() + y * outImage.WidthStep();
+            for (auto x = 0; x < outImage.Width(); ++x) {
+                ASSERT_EQ(row[4 * x + 0], color[0]);
+                ASSERT_EQ(row[4 * x + 1], color[1]);
+                ASSERT_EQ(row[4 * x + 2], color[2]);
+                ASSERT_EQ(row[4 * x + 3], 255);
+            }
+        }
+    }
+}
+
+TEST(LluviaVideoSourceCalculatorTest, TestLluviaImageOutput) {
+
+    auto runfiles = Runfiles::CreateForTest(nullptr);
+    ASSERT_NE(nullptr, runfiles);
+
+    auto libraryPath = runfiles->Rlocation("lluvia/lluvia/nodes/lluvia_node_library.zip");
+    auto calculatorScriptPath = runfiles->Rlocation("mediapipe/mediapipe/lluvia-mediapipe/calculators/test_data/PassthroughContainerNode.lua");
+
+    const auto directory = WriteImageSequence("lluvia_image_output");
+
+    // the frames stay in device memory until the passthrough calculator reads them back
+    auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(
+        absl::Substitute(
+            R"pb(
+                node {
+                    calculator: "LluviaVideoSourceCalculator"
+                    output_stream: "device_image"
+                    node_options {
+                        [type.googleapis.com/lluvia.LluviaVideoSourceCalculatorOptions]: {
+                            image_directory: "$2"
+                            max_frames: 4
+                            session_name: "video_source"
+                        }
+                    }
+                }
+
+                node {
+                    calculator: "LluviaCalculator"
+                    input_stream: "IN_0:device_image"
+                    output_stream: "OUT_0:output_image"
+                    node_options {
+                        [type.googleapis.com/lluvia.LluviaCalculatorOptions]: {
+                            session_name: "video_source"
+                            container_node: "mediapipe/test/PassthroughContainerNode"
+                            library_path: "$0"
+                            script_path: "$1"
+
+                            input_port_binding:  {
+                                mediapipe_tag: "IN_0"
+                                lluvia_port: "in_image_0"
+                                packet_type: LLUVIA_IMAGE
+                            }
+
+                            output_port_binding:  {
+                                mediapipe_tag: "OUT_0"
+                                lluvia_port: "out_image_0"
+                                packet_type: IMAGE_FRAME
+                            }
+                        }
+                    }
+                }
+            )pb",
+            libraryPath,
+            calculatorScriptPath,
+            directory
+        )
+    );
+
+    auto outputPackets = std::vector<Packet> {};
+    tool::AddVectorSink("output_image", &graphConfig, &outputPackets);
+
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(graphConfig));
+    MP_ASSERT_OK(graph.Run());
+
+    ASSERT_EQ(outputPackets.size(), 4);
+
+    for (auto t = 0; t < 4; ++t) {
+
+        const auto& outImage = outputPackets[t].Get<ImageFrame>();
+        ASSERT_EQ(outImage.Width(), kWidth);
+        ASSERT_EQ(outImage.Height(), kHeight);
+        ASSERT_EQ(outImage.NumberOfChannels(), 4);
+
+        // the image keeps the BGRA order of the staging buffer
+        const auto color = getFrameColor(t);
+        const auto* pixel = outImage.PixelData() + (kHeight / 2) * outImage.WidthStep() + 4 * (kWidth / 2);
+        EXPECT_EQ(pixel[0], color[0]);
+        EXPECT_EQ(pixel[1], color[1]);
+        EXPECT_EQ(pixel[2], color[2]);
+    }
+}
+
+TEST(LluviaVideoSourceCalculatorTest, TestMissingSource) {
+
+    auto graphConfig = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        node {
+            calculator: "LluviaVideoSourceCalculator"
+            output_stream: "output_image"
+            node_options {
+                [type.googleapis.com/lluvia.LluviaVideoSourceCalculatorOptions]: {
+                    image_directory: "/nonexistent"
+                }
+            }
+        }
+    )pb");
+
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(graphConfig));
+    EXPECT_FALSE(graph.Run().ok());
+}
+
+} // namespace
+
+} // namespace mediapipe
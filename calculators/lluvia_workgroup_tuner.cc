@@ -0,0 +1,253 @@
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_workgroup_tuner.h"
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_container_snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <optional>
+
+namespace mediapipe {
+
+namespace {
+
+// serializes tuning within the process, so that calculators do not time
+// their candidates concurrently nor write the same cache file
+std::mutex tuningMutex;
+
+// Duration of a candidate and content of the output ports after its first run.
+struct CandidateRun {
+    std::chrono::nanoseconds duration;
+    std::vector<std::string> outputs;
+};
+
+ll::vec3ui getLocalShape(const lluvia::ComputeNodeSnapshot& node) {
+    return ll::vec3ui {node.local_x(), node.local_y(), node.local_z()};
+}
+
+ll::vec3ui getGlobalShape(const lluvia::ComputeNodeSnapshot& node) {
+    return ll::vec3ui {node.grid_x() * node.local_x(), node.grid_y() * node.local_y(), node.grid_z() * node.local_z()};
+}
+
+// Sets the local shape of the node and the grid covering globalShape with it.
+void setLocalShape(lluvia::ComputeNodeSnapshot& node, const ll::vec3ui& globalShape, const ll::vec3ui& localShape) {
+
+    node.set_local_x(localShape.x);
+    node.set_local_y(localShape.y);
+    node.set_local_z(localShape.z);
+
+    node.set_grid_x((globalShape.x + localShape.x - 1) / localShape.x);
+    node.set_grid_y((globalShape.y + localShape.y - 1) / localShape.y);
+    node.set_grid_z((globalShape.z + localShape.z - 1) / localShape.z);
+}
+
+std::string shapeToString(const ll::vec3ui& shape) {
+    return absl::StrCat(shape.x, "x", shape.y, "x", shape.z);
+}
+
+bool parseShape(const std::string& text, ll::vec3ui& shape) {
+
+    const std::vector<std::string> values = absl::StrSplit(text, 'x');
+
+    return values.size() == 3
+        && absl::SimpleAtoi(values[0], &shape.x) && shape.x > 0
+        && absl::SimpleAtoi(values[1], &shape.y) && shape.y > 0
+        && absl::SimpleAtoi(values[2], &shape.z) && shape.z > 0;
+}
+
+std::string getCacheKey(const ll::DeviceDescriptor& device, const lluvia::ComputeNodeSnapshot& node) {
+    return absl::StrCat(device.id, "\t", device.name, "\t", node.builder_name(), "\t", shapeToString(getGlobalShape(node)));
+}
+
+// Tuned local shapes by cache key. A missing file is an empty cache, malformed lines are skipped.
+std::map<std::string, ll::vec3ui> readCache(const std::string& path) {
+
+    auto cache = std::map<std::string, ll::vec3ui> {};
+
+    auto file = std::ifstream {path};
+    auto line = std::string {};
+
+    while (std::getline(file, line)) {
+
+        const auto separator = line.rfind('\t');
+        auto shape = ll::vec3ui {1, 1, 1};
+
+        if (separator != std::string::npos && parseShape(line.substr(separator + 1), shape)) {
+            cache[line.substr(0, separator)] = shape;
+        }
+    }
+
+    return cache;
+}
+
+// Local shapes tried for a node, the builder shape first. 1D nodes only try 1D shapes.
+std::vector<ll::vec3ui> getCandidateShapes(const ll::vec3ui& builderShape, const uint32_t maxInvocations) {
+
+    auto shapes = std::vector<ll::vec3ui> {builderShape};
+
+    const auto addShape = [&](const uint32_t x, const uint32_t y) {
+        if (x * y * builderShape.z <= maxInvocations && (x != builderShape.x || y != builderShape.y)) {
+            shapes.push_back(ll::vec3ui {x, y, builderShape.z});
+        }
+    };
+
+    if (builderShape.y == 1 && builderShape.z == 1) {
+        for (auto x = uint32_t {16}; x <= 1024; x *= 2) {
+            addShape(x, 1);
+        }
+
+        return shapes;
+    }
+
+    for (auto x = uint32_t {4}; x <= 64; x *= 2) {
+        for (auto y = uint32_t {2}; y <= 32; y *= 2) {
+            if (x * y >= 32) {
+                addShape(x, y);
+            }
+        }
+    }
+
+    return shapes;
+}
+
+// Instantiates the snapshot, reads its outputs after a first run and times iterations more runs.
+::mediapipe::StatusOr<CandidateRun> runCandidate(const std::shared_ptr<ll::Session>& session,
+                                                 const std::shared_ptr<ll::Memory>& deviceMemory,
+                                                 const std::shared_ptr<ll::Memory>& hostMemory,
+                                                 const lluvia::ContainerSnapshot& snapshot,
+                                                 const std::map<std::string, std::shared_ptr<ll::Object>>& boundPorts,
+                                                 const std::vector<std::string>& outputPorts,
+                                                 const int iterations) {
+
+    auto instance = std::unique_ptr<LluviaContainerInstance> {};
+    ASSIGN_OR_RETURN(instance, LluviaContainerInstance::Create(session, deviceMemory, hostMemory, snapshot, boundPorts));
+
+    auto run = CandidateRun {};
+
+    try {
+        auto duration = session->createDuration();
+
+        auto cmdBuffer = session->createCommandBuffer();
+        cmdBuffer->begin();
+        cmdBuffer->durationStart(*duration);
+        instance->record(*cmdBuffer);
+        cmdBuffer->durationEnd(*duration);
+        cmdBuffer->end();
+
+        session->run(*cmdBuffer);
+
+        for (const auto& portName : outputPorts) {
+            run.outputs.push_back(ReadObjectContent(session, instance->getPort(portName)));
+        }
+
+        auto durations = std::vector<std::chrono::nanoseconds> {};
+        for (auto i = 0; i < std::max(1, iterations); ++i) {
+            session->run(*cmdBuffer);
+            durations.push_back(duration->getDuration());
+        }
+
+        std::nth_element(durations.begin(), durations.begin() + durations.size() / 2, durations.end());
+        run.duration = durations[durations.size() / 2];
+
+    } catch (std::exception& e) {
+        return absl::InternalError(absl::StrCat("error running candidate: ", e.what()));
+    }
+
+    return run;
+}
+
+} // namespace
+
+::mediapipe::StatusOr<lluvia::ContainerSnapshot> TuneContainerSnapshot(const std::shared_ptr<ll::Session>& session,
+                                                                      const std::shared_ptr<ll::Memory>& deviceMemory,
+                                                                      const std::shared_ptr<ll::Memory>& hostMemory,
+                                                                      const ll::DeviceDescriptor& device,
+                                                                      const lluvia::ContainerSnapshot& snapshot,
+                                                                      const std::map<std::string, std::shared_ptr<ll::Object>>& boundPorts,
+                                                                      const std::vector<std::string>& outputPorts,
+                                                                      const lluvia::WorkgroupTuning& options) {
+
+    if (options.max_invocations() <= 0) {
+        return absl::InvalidArgumentError(absl::StrCat("max_invocations must be positive, got ", options.max_invocations()));
+    }
+
+    auto guard = std::lock_guard {tuningMutex};
+
+    auto tuned = snapshot;
+    auto cache = options.cache_path().empty() ? std::map<std::string, ll::vec3ui> {} : readCache(options.cache_path());
+    auto newEntries = std::vector<std::string> {};
+
+    // outputs of the builder shapes, run once a node is not cached
+    auto reference = std::optional<CandidateRun> {};
+
+    for (auto i = 0; i < tuned.compute_nodes_size(); ++i) {
+
+        auto& node = *tuned.mutable_compute_nodes(i);
+        const auto globalShape = getGlobalShape(node);
+        const auto cacheKey = getCacheKey(device, node);
+
+        const auto cached = cache.find(cacheKey);
+        if (cached != cache.end()) {
+            setLocalShape(node, globalShape, cached->second);
+            continue;
+        }
+
+        if (!reference) {
+            ASSIGN_OR_RETURN(reference, runCandidate(session, deviceMemory, hostMemory, snapshot, boundPorts, outputPorts, options.iterations()));
+        }
+
+        const auto builderShape = getLocalShape(node);
+        auto bestShape = builderShape;
+        auto bestDuration = std::chrono::nanoseconds::max();
+
+        for (const auto& shape : getCandidateShapes(builderShape, static_cast<uint32_t>(options.max_invocations()))) {
+
+            setLocalShape(node, globalShape, shape);
+
+            auto run = runCandidate(session, deviceMemory, hostMemory, tuned, boundPorts, outputPorts, options.iterations());
+            if (!run.ok()) {
+                LOG(INFO) << "TuneContainerSnapshot(): " << node.builder_name() << " " << shapeToString(shape) << " rejected: " << run.status().message();
+                continue;
+            }
+
+            if (run.value().outputs != reference->outputs) {
+                LOG(INFO) << "TuneContainerSnapshot(): " << node.builder_name() << " " << shapeToString(shape) << " rejected: outputs differ";
+                continue;
+            }
+
+            if (run.value().duration < bestDuration) {
+                bestShape = shape;
+                bestDuration = run.value().duration;
+            }
+        }
+
+        setLocalShape(node, globalShape, bestShape);
+        LOG(INFO) << "TuneContainerSnapshot(): " << node.builder_name() << " local shape " << shapeToString(bestShape)
+                  << ", builder shape " << shapeToString(builderShape);
+
+        // later nodes with the same builder and global shape reuse the result
+        cache[cacheKey] = bestShape;
+        newEntries.push_back(absl::StrCat(cacheKey, "\t", shapeToString(bestShape)));
+    }
+
+    if (!options.cache_path().empty() && !newEntries.empty()) {
+
+        auto file = std::ofstream {options.cache_path(), std::ios::app};
+        for (const auto& entry : newEntries) {
+            file << entry << "\n";
+        }
+
+        if (!file) {
+            LOG(WARNING) << "TuneContainerSnapshot(): cannot write cache " << options.cache_path();
+        }
+    }
+
+    return tuned;
+}
+
+} // namespace mediapipe
@@ -0,0 +1,45 @@
+#ifndef LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_WORKGROUP_TUNER_H_
+#define LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_WORKGROUP_TUNER_H_
+
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_snapshot.pb.h"
+
+#include <lluvia/core.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mediapipe {
+
+/**
+ * Tunes the local shape of each compute node of a container snapshot.
+ *
+ * Nodes are tuned one at a time, in snapshot order, keeping the shapes
+ * already chosen for the previous ones. Each candidate shape replaces the
+ * node's local shape, with the grid recomputed to cover the same global
+ * shape, and the snapshot is instantiated with boundPorts and timed with
+ * ll::Duration. Candidates failing to instantiate, or whose outputPorts
+ * content differs from the one of the builder shapes, are rejected.
+ *
+ * Results are cached in options.cache_path, one line per node:
+ *
+ *     <device id> TAB <device name> TAB <builder name> TAB <global shape> TAB <local shape>
+ *
+ * with shapes written as XxYxZ. Cached nodes are not benchmarked.
+ */
+::mediapipe::StatusOr<lluvia::ContainerSnapshot> TuneContainerSnapshot(const std::shared_ptr<ll::Session>& session,
+                                                                      const std::shared_ptr<ll::Memory>& deviceMemory,
+                                                                      const std::shared_ptr<ll::Memory>& hostMemory,
+                                                                      const ll::DeviceDescriptor& device,
+                                                                      const lluvia::ContainerSnapshot& snapshot,
+                                                                      const std::map<std::string, std::shared_ptr<ll::Object>>& boundPorts,
+                                                                      const std::vector<std::string>& outputPorts,
+                                                                      const lluvia::WorkgroupTuning& options);
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_CALCULATORS_LLUVIA_WORKGROUP_TUNER_H_
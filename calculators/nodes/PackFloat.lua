@@ -0,0 +1,73 @@
+local builder = ll.class(ll.ComputeNodeBuilder)
+
+builder.name = 'lluvia/mediapipe/PackFloat'
+builder.doc = [[
+Packs a floating point image into a tightly packed buffer with reduced precision.
+
+Parameters
+----------
+swizzle : int. Source channel index of each packed channel, 8 bits per channel,
+    the first packed channel in the lowest byte.
+
+channels : int. Number of packed channels, 1 to 4.
+
+encoding : int. 1: float16, 2: int8, 3: int16.
+
+scale : float. Multiplier applied to each value before quantization to int8 or int16.
+
+Outputs
+-------
+out_buffer : Buffer. Packed values, rounded up to a multiple of 4 bytes.
+]]
+
+function builder.newDescriptor()
+
+    local desc = ll.ComputeNodeDescriptor.new()
+    desc:init(builder.name, ll.ComputeDimension.D1)
+
+    local in_image = ll.PortDescriptor.new(0, 'in_image', ll.PortDirection.In, ll.PortType.SampledImageView)
+    desc:addPort(in_image)
+
+    desc:addPort(ll.PortDescriptor.new(1, 'out_buffer', ll.PortDirection.Out, ll.PortType.Buffer))
+
+    desc:setParameter('swizzle', 0x03020100)
+    desc:setParameter('channels', 2)
+    desc:setParameter('encoding', 1)
+    desc:setParameter('scale', 1.0)
+
+    return desc
+end
+
+
+function builder.onNodeInit(node)
+
+    local in_image = node:getPort('in_image')
+
+    local swizzle = math.floor(node:getParameter('swizzle'))
+    local channels = math.floor(node:getParameter('channels'))
+    local encoding = math.floor(node:getParameter('encoding'))
+    local scale = node:getParameter('scale')
+
+    local elementsPerWord = 2
+    if encoding == 2 then
+        elementsPerWord = 4
+    end
+
+    local words = math.ceil(in_image.width * in_image.height * channels / elementsPerWord)
+
+    local memory = in_image.memory
+    local out_buffer = memory:createBuffer(words * 4)
+    node:bind('out_buffer', out_buffer)
+
+    local pushConstants = ll.PushConstants.new()
+    pushConstants:pushInt32(swizzle)
+    pushConstants:pushInt32(channels)
+    pushConstants:pushInt32(encoding)
+    pushConstants:pushFloat(scale)
+    node.pushConstants = pushConstants
+
+    node:configureGridShape(ll.vec3ui.new(words, 1, 1))
+end
+
+
+ll.registerNodeBuilder(builder)
@@ -0,0 +1,83 @@
+local builder = ll.class(ll.ComputeNodeBuilder)
+
+builder.name = 'lluvia/mediapipe/PackTensorFloat'
+builder.doc = [[
+Writes the normalized channels of a floating point image to a NHWC tensor buffer.
+
+Parameters
+----------
+swizzle : int. Source channel index of each tensor channel, 8 bits per channel,
+    the first tensor channel in the lowest byte.
+
+channels : int. Number of tensor channels, 1 to 4.
+
+encoding : int. 0: float32, 1: float16.
+
+mean_0 ... mean_3 : float. Mean subtracted from each tensor channel.
+
+std_0 ... std_3 : float. Standard deviation each tensor channel is divided by.
+
+Outputs
+-------
+out_buffer : Buffer. Tensor values, rounded up to a multiple of 4 bytes.
+]]
+
+function builder.newDescriptor()
+
+    local desc = ll.ComputeNodeDescriptor.new()
+    desc:init(builder.name, ll.ComputeDimension.D1)
+
+    local in_image = ll.PortDescriptor.new(0, 'in_image', ll.PortDirection.In, ll.PortType.SampledImageView)
+    desc:addPort(in_image)
+
+    desc:addPort(ll.PortDescriptor.new(1, 'out_buffer', ll.PortDirection.Out, ll.PortType.Buffer))
+
+    desc:setParameter('swizzle', 0x03020100)
+    desc:setParameter('channels', 4)
+    desc:setParameter('encoding', 0)
+
+    for c = 0, 3 do
+        desc:setParameter(string.format('mean_%d', c), 0.0)
+        desc:setParameter(string.format('std_%d', c), 1.0)
+    end
+
+    return desc
+end
+
+
+function builder.onNodeInit(node)
+
+    local in_image = node:getPort('in_image')
+
+    local swizzle = math.floor(node:getParameter('swizzle'))
+    local channels = math.floor(node:getParameter('channels'))
+    local encoding = math.floor(node:getParameter('encoding'))
+
+    local elementsPerWord = 1
+    if encoding == 1 then
+        elementsPerWord = 2
+    end
+
+    local words = math.ceil(in_image.width * in_image.height * channels / elementsPerWord)
+
+    local memory = in_image.memory
+    local out_buffer = memory:createBuffer(words * 4)
+    node:bind('out_buffer', out_buffer)
+
+    local pushConstants = ll.PushConstants.new()
+    for c = 0, 3 do
+        pushConstants:pushFloat(node:getParameter(string.format('mean_%d', c)))
+    end
+    for c = 0, 3 do
+        pushConstants:pushFloat(1.0 / node:getParameter(string.format('std_%d', c)))
+    end
+    pushConstants:pushInt32(swizzle)
+    pushConstants:pushInt32(channels)
+    pushConstants:pushInt32(encoding)
+    node.pushConstants = pushConstants
+
+    node:configureGridShape(ll.vec3ui.new(words, 1, 1))
+end
+
+
+ll.registerNodeBuilder(builder)
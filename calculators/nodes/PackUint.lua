@@ -0,0 +1,59 @@
+local builder = ll.class(ll.ComputeNodeBuilder)
+
+builder.name = 'lluvia/mediapipe/PackUint'
+builder.doc = [[
+Packs an 8 bit unsigned image into a tightly packed byte buffer.
+
+Parameters
+----------
+swizzle : int. Source channel index of each packed channel, 8 bits per channel,
+    the first packed channel in the lowest byte.
+
+channels : int. Number of packed channels, 1 to 4.
+
+Outputs
+-------
+out_buffer : Buffer. width * height * channels bytes, rounded up to a multiple of 4.
+]]
+
+function builder.newDescriptor()
+
+    local desc = ll.ComputeNodeDescriptor.new()
+    desc:init(builder.name, ll.ComputeDimension.D1)
+
+    local in_image = ll.PortDescriptor.new(0, 'in_image', ll.PortDirection.In, ll.PortType.SampledImageView)
+    in_image:checkImageChannelTypeIs(ll.ChannelType.Uint8)
+    desc:addPort(in_image)
+
+    desc:addPort(ll.PortDescriptor.new(1, 'out_buffer', ll.PortDirection.Out, ll.PortType.Buffer))
+
+    desc:setParameter('swizzle', 0x03020100)
+    desc:setParameter('channels', 4)
+
+    return desc
+end
+
+
+function builder.onNodeInit(node)
+
+    local in_image = node:getPort('in_image')
+
+    local swizzle = math.floor(node:getParameter('swizzle'))
+    local channels = math.floor(node:getParameter('channels'))
+
+    local words = math.ceil(in_image.width * in_image.height * channels / 4)
+
+    local memory = in_image.memory
+    local out_buffer = memory:createBuffer(words * 4)
+    node:bind('out_buffer', out_buffer)
+
+    local pushConstants = ll.PushConstants.new()
+    pushConstants:pushInt32(swizzle)
+    pushConstants:pushInt32(channels)
+    node.pushConstants = pushConstants
+
+    node:configureGridShape(ll.vec3ui.new(words, 1, 1))
+end
+
+
+ll.registerNodeBuilder(builder)
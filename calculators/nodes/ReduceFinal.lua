@@ -0,0 +1,70 @@
+local builder = ll.class(ll.ComputeNodeBuilder)
+
+builder.name = 'lluvia/mediapipe/ReduceFinal'
+builder.doc = [[
+Combines the partial results of lluvia/mediapipe/ReduceTileUint or
+lluvia/mediapipe/ReduceTileFloat in a single workgroup.
+
+Parameters
+----------
+mode : int. Same as the ReduceTile node.
+
+partial_count : int. Mode 0 only. Number of partials in in_partials.
+
+bins : int. Mode 1 only. Number of histogram bins.
+
+Inputs
+------
+in_partials : Buffer. out_partials of the ReduceTile node. Histogram
+    counts are cleared after being read.
+
+Outputs
+-------
+out_result : Buffer. Mode 0: 12 floats, the sum, minimum and maximum of
+    the 4 channels. Mode 1: bins float counts.
+]]
+
+function builder.newDescriptor()
+
+    local desc = ll.ComputeNodeDescriptor.new()
+    desc:init(builder.name, ll.ComputeDimension.D1)
+
+    desc:addPort(ll.PortDescriptor.new(0, 'in_partials', ll.PortDirection.In, ll.PortType.Buffer))
+    desc:addPort(ll.PortDescriptor.new(1, 'out_result', ll.PortDirection.Out, ll.PortType.Buffer))
+
+    desc:setParameter('mode', 0)
+    desc:setParameter('partial_count', 0)
+    desc:setParameter('bins', 256)
+
+    return desc
+end
+
+
+function builder.onNodeInit(node)
+
+    local in_partials = node:getPort('in_partials')
+
+    local mode = math.floor(node:getParameter('mode'))
+    local bins = math.floor(node:getParameter('bins'))
+
+    local words = 12
+    if mode == 1 then
+        words = bins
+    end
+
+    local memory = in_partials.memory
+    local out_result = memory:createBuffer(words * 4)
+    node:bind('out_result', out_result)
+
+    local pushConstants = ll.PushConstants.new()
+    pushConstants:pushInt32(mode)
+    pushConstants:pushInt32(math.floor(node:getParameter('partial_count')))
+    pushConstants:pushInt32(bins)
+    node.pushConstants = pushConstants
+
+    -- a single workgroup
+    node:configureGridShape(ll.vec3ui.new(1, 1, 1))
+end
+
+
+ll.registerNodeBuilder(builder)
@@ -0,0 +1,81 @@
+local builder = ll.class(ll.ComputeNodeBuilder)
+
+builder.name = 'lluvia/mediapipe/ReduceTileUint'
+builder.doc = [[
+First stage of the reductions of an unsigned integer image, see lluvia/mediapipe/ReduceFinal.
+
+Parameters
+----------
+mode : int. 0: per channel sum, minimum and maximum. 1: histogram.
+
+pixels_per_invocation : int. Number of consecutive pixels reduced by each invocation.
+
+channel : int. Histogram only. Channel counted in the histogram.
+
+bins : int. Histogram only. Number of bins.
+
+min_value : float. Histogram only. Lower bound of the first bin.
+
+max_value : float. Histogram only. Upper bound of the last bin.
+
+Outputs
+-------
+out_partials : Buffer. Mode 0: 12 floats per invocation, the sum, minimum
+    and maximum of the 4 channels. Mode 1: bins uint counts, which must be
+    zero before the first run. ReduceFinal clears them after each run.
+]]
+
+function builder.newDescriptor()
+
+    local desc = ll.ComputeNodeDescriptor.new()
+    desc:init(builder.name, ll.ComputeDimension.D1)
+
+    local in_image = ll.PortDescriptor.new(0, 'in_image', ll.PortDirection.In, ll.PortType.SampledImageView)
+    desc:addPort(in_image)
+
+    desc:addPort(ll.PortDescriptor.new(1, 'out_partials', ll.PortDirection.Out, ll.PortType.Buffer))
+
+    desc:setParameter('mode', 0)
+    desc:setParameter('pixels_per_invocation', 64)
+    desc:setParameter('channel', 0)
+    desc:setParameter('bins', 256)
+    desc:setParameter('min_value', 0.0)
+    desc:setParameter('max_value', 256.0)
+
+    return desc
+end
+
+
+function builder.onNodeInit(node)
+
+    local in_image = node:getPort('in_image')
+
+    local mode = math.floor(node:getParameter('mode'))
+    local pixelsPerInvocation = math.floor(node:getParameter('pixels_per_invocation'))
+    local bins = math.floor(node:getParameter('bins'))
+
+    local invocations = math.ceil(in_image.width * in_image.height / pixelsPerInvocation)
+
+    local words = bins
+    if mode == 0 then
+        words = 12 * invocations
+    end
+
+    local memory = in_image.memory
+    local out_partials = memory:createBuffer(words * 4)
+    node:bind('out_partials', out_partials)
+
+    local pushConstants = ll.PushConstants.new()
+    pushConstants:pushInt32(mode)
+    pushConstants:pushInt32(pixelsPerInvocation)
+    pushConstants:pushInt32(math.floor(node:getParameter('channel')))
+    pushConstants:pushInt32(bins)
+    pushConstants:pushFloat(node:getParameter('min_value'))
+    pushConstants:pushFloat(node:getParameter('max_value'))
+    node.pushConstants = pushConstants
+
+    node:configureGridShape(ll.vec3ui.new(invocations, 1, 1))
+end
+
+
+ll.registerNodeBuilder(builder)
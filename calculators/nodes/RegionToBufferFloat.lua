@@ -0,0 +1,63 @@
+local builder = ll.class(ll.ComputeNodeBuilder)
+
+builder.name = 'lluvia/mediapipe/RegionToBufferFloat'
+builder.doc = [[
+Reads a region of a float32 image into a staging buffer holding the whole image without row padding.
+
+Parameters
+----------
+x : int. Left column of the region.
+
+y : int. Top row of the region.
+
+width : int. Width of the region.
+
+height : int. Height of the region.
+
+channels : int. Number of channels of the image, 1 to 4.
+
+Inputs
+------
+in_image : SampledImageView. Image whose region is read.
+
+Outputs
+-------
+out_buffer : Buffer. Staging buffer of the image, the bytes outside the region are left untouched.
+]]
+
+function builder.newDescriptor()
+
+    local desc = ll.ComputeNodeDescriptor.new()
+    desc:init(builder.name, ll.ComputeDimension.D2)
+
+    desc:addPort(ll.PortDescriptor.new(0, 'in_image', ll.PortDirection.In, ll.PortType.SampledImageView))
+    desc:addPort(ll.PortDescriptor.new(1, 'out_buffer', ll.PortDirection.Out, ll.PortType.Buffer))
+
+    desc:setParameter('x', 0)
+    desc:setParameter('y', 0)
+    desc:setParameter('width', 0)
+    desc:setParameter('height', 0)
+    desc:setParameter('channels', 1)
+
+    return desc
+end
+
+
+function builder.onNodeInit(node)
+
+    local width = math.floor(node:getParameter('width'))
+    local height = math.floor(node:getParameter('height'))
+
+    local pushConstants = ll.PushConstants.new()
+    pushConstants:pushInt32(math.floor(node:getParameter('x')))
+    pushConstants:pushInt32(math.floor(node:getParameter('y')))
+    pushConstants:pushInt32(width)
+    pushConstants:pushInt32(height)
+    pushConstants:pushInt32(math.floor(node:getParameter('channels')))
+    node.pushConstants = pushConstants
+
+    node:configureGridShape(ll.vec3ui.new(width, height, 1))
+end
+
+
+ll.registerNodeBuilder(builder)
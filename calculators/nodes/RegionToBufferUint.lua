@@ -0,0 +1,75 @@
+local builder = ll.class(ll.ComputeNodeBuilder)
+
+builder.name = 'lluvia/mediapipe/RegionToBufferUint'
+builder.doc = [[
+Reads a region of an unsigned integer image into a staging buffer holding the whole image without row padding.
+
+Parameters
+----------
+x : int. Left column of the region.
+
+y : int. Top row of the region.
+
+width : int. Width of the region.
+
+height : int. Height of the region.
+
+channels : int. Number of channels of the image, 1 to 4.
+
+channel_bytes : int. Bytes per channel, 1 or 2.
+
+Inputs
+------
+in_image : SampledImageView. Image whose region is read.
+
+Outputs
+-------
+out_buffer : Buffer. Staging buffer of the image, the bytes outside the region are left untouched.
+]]
+
+function builder.newDescriptor()
+
+    local desc = ll.ComputeNodeDescriptor.new()
+    desc:init(builder.name, ll.ComputeDimension.D2)
+
+    desc:addPort(ll.PortDescriptor.new(0, 'in_image', ll.PortDirection.In, ll.PortType.SampledImageView))
+    desc:addPort(ll.PortDescriptor.new(1, 'out_buffer', ll.PortDirection.Out, ll.PortType.Buffer))
+
+    desc:setParameter('x', 0)
+    desc:setParameter('y', 0)
+    desc:setParameter('width', 0)
+    desc:setParameter('height', 0)
+    desc:setParameter('channels', 1)
+    desc:setParameter('channel_bytes', 1)
+
+    return desc
+end
+
+
+function builder.onNodeInit(node)
+
+    local width = math.floor(node:getParameter('width'))
+    local height = math.floor(node:getParameter('height'))
+
+    local pushConstants = ll.PushConstants.new()
+    pushConstants:pushInt32(math.floor(node:getParameter('x')))
+    pushConstants:pushInt32(math.floor(node:getParameter('y')))
+    pushConstants:pushInt32(width)
+    pushConstants:pushInt32(height)
+    pushConstants:pushInt32(math.floor(node:getParameter('channels')))
+    pushConstants:pushInt32(math.floor(node:getParameter('channel_bytes')))
+    node.pushConstants = pushConstants
+
+    -- one invocation per 32 bit word of each region row, which can start
+    -- in the middle of a word
+    local words = 0
+    if width > 0 then
+        local pixelBytes = math.floor(node:getParameter('channels')) * math.floor(node:getParameter('channel_bytes'))
+        words = math.ceil(width * pixelBytes / 4) + 1
+    end
+
+    node:configureGridShape(ll.vec3ui.new(words, height, 1))
+end
+
+
+ll.registerNodeBuilder(builder)
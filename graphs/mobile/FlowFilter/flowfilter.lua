@@ -19,6 +19,11 @@ function builder.newDescriptor()
     local out_image = ll.PortDescriptor.new(1, 'out_image', ll.PortDirection.Out, ll.PortType.ImageView)
     desc:addPort(out_image)
 
+    -- overridden by LluviaCalculatorOptions.parameter, for instance to lower
+    -- the pyramid levels when the latency governor degrades the calculator
+    desc:setParameter('levels', 2)
+    desc:setParameter('smooth_iterations', 1)
+
     return desc
 end
 
@@ -41,9 +46,9 @@ function builder.onNodeInit(node)
     local FlowFilter = ll.createContainerNode('lluvia/opticalflow/flowfilter/FlowFilter')
     FlowFilter:setParameter('gamma', 0.001)
     FlowFilter:setParameter('gamma_low', 0.0001)
-    FlowFilter:setParameter('levels', 2)
+    FlowFilter:setParameter('levels', math.floor(node:getParameter('levels')))
     FlowFilter:setParameter('max_flow', 4)
-    FlowFilter:setParameter('smooth_iterations', 1)
+    FlowFilter:setParameter('smooth_iterations', math.floor(node:getParameter('smooth_iterations')))
     FlowFilter:setParameter('float_precision', ll.FloatPrecision.FP16)
     FlowFilter:bind('in_gray', out_gray)
 
@@ -19,6 +19,11 @@ function builder.newDescriptor()
     local out_image = ll.PortDescriptor.new(1, 'out_image', ll.PortDirection.Out, ll.PortType.ImageView)
     desc:addPort(out_image)
 
+    -- overridden by LluviaCalculatorOptions.parameter, for instance to lower
+    -- the iterations when the latency governor degrades the calculator
+    desc:setParameter('alpha', 0.03)
+    desc:setParameter('iterations', 20)
+
     return desc
 end
 
@@ -39,8 +44,8 @@ function builder.onNodeInit(node)
 
     -- Horn and Schunck
     local HornSchunck = ll.createContainerNode('lluvia/opticalflow/HornSchunck/HornSchunck')
-    HornSchunck:setParameter('alpha', 0.03)
-    HornSchunck:setParameter('iterations', 20)
+    HornSchunck:setParameter('alpha', node:getParameter('alpha'))
+    HornSchunck:setParameter('iterations', math.floor(node:getParameter('iterations')))
     HornSchunck:setParameter('float_precision', ll.FloatPrecision.FP32)
     HornSchunck:bind('in_gray', out_gray)
 
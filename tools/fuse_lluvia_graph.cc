@@ -0,0 +1,101 @@
+
+#include <cstdlib>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+
+#include "mediapipe/lluvia-mediapipe/tools/lluvia_graph_fusion.h"
+
+#include "google/protobuf/text_format.h"
+
+#include <iostream>
+
+ABSL_FLAG(std::string, input_graph, "", "Path to the text format CalculatorGraphConfig to fuse.");
+ABSL_FLAG(std::string, output_graph, "", "Path to write the fused CalculatorGraphConfig to.");
+ABSL_FLAG(std::string, output_script_dir, "", "Directory to write the generated Lua scripts to.");
+ABSL_FLAG(std::string, script_path_prefix, "", "Prefix of the generated scripts in the script_path option of fused nodes. Defaults to output_script_dir.");
+ABSL_FLAG(std::string, builder_name_prefix, "mediapipe/fused/", "Prefix of the generated container node builder names.");
+
+
+absl::Status fuseGraph() {
+
+    auto input_graph = absl::GetFlag(FLAGS_input_graph);
+    if (input_graph.empty()) {
+        return absl::InvalidArgumentError("input_graph cannot be empty");
+    }
+
+    auto output_graph = absl::GetFlag(FLAGS_output_graph);
+    if (output_graph.empty()) {
+        return absl::InvalidArgumentError("output_graph cannot be empty");
+    }
+
+    auto output_script_dir = absl::GetFlag(FLAGS_output_script_dir);
+    if (output_script_dir.empty()) {
+        return absl::InvalidArgumentError("output_script_dir cannot be empty");
+    }
+
+    if (output_script_dir.back() != '/') {
+        output_script_dir += '/';
+    }
+
+    auto options = mediapipe::LluviaFusionOptions {};
+    options.builderNamePrefix = absl::GetFlag(FLAGS_builder_name_prefix);
+    options.scriptPathPrefix = absl::GetFlag(FLAGS_script_path_prefix);
+    if (options.scriptPathPrefix.empty()) {
+        options.scriptPathPrefix = output_script_dir;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Graph configuration
+    auto graphConfigFileContent = std::string {};
+    MP_RETURN_IF_ERROR(mediapipe::file::GetContents(input_graph, &graphConfigFileContent));
+
+    auto graphConfig = mediapipe::CalculatorGraphConfig {};
+    if (!google::protobuf::TextFormat::ParseFromString(graphConfigFileContent, &graphConfig)) {
+        return absl::InvalidArgumentError(absl::StrCat("error parsing graph: ", input_graph));
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Fuse
+    ASSIGN_OR_RETURN(auto result, mediapipe::FuseLluviaCalculators(graphConfig, options));
+
+    auto fusedGraphContent = std::string {};
+    if (!google::protobuf::TextFormat::PrintToString(result.graph, &fusedGraphContent)) {
+        return absl::InternalError("error printing fused graph");
+    }
+
+    MP_RETURN_IF_ERROR(mediapipe::file::SetContents(output_graph, fusedGraphContent));
+
+    for (const auto& script : result.scripts) {
+        MP_RETURN_IF_ERROR(mediapipe::file::SetContents(output_script_dir + script.fileName, script.content));
+    }
+
+    std::cout << mediapipe::LluviaFusionReportToString(result.report);
+
+    return absl::OkStatus();
+}
+
+
+int main(int argc, char** argv) {
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Arg parsing
+    absl::ParseCommandLine(argc, argv);
+    std::cout << "input_graph: " << absl::GetFlag(FLAGS_input_graph) << std::endl;
+    std::cout << "output_graph: " << absl::GetFlag(FLAGS_output_graph) << std::endl;
+
+    auto status = fuseGraph();
+
+    if (!status.ok()) {
+        std::cerr << "ERROR: " << status.message() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,535 @@
+#include "mediapipe/lluvia-mediapipe/tools/lluvia_cost_report.h"
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_container_snapshot.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_execution_context.h"
+
+#include <lluvia/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace mediapipe {
+
+namespace {
+
+uint64_t getChannelTypeSize(const ll::ChannelType channelType) {
+
+    switch (channelType) {
+        case ll::ChannelType::Uint8:
+        case ll::ChannelType::Int8:
+            return 1;
+        case ll::ChannelType::Uint16:
+        case ll::ChannelType::Int16:
+        case ll::ChannelType::Float16:
+            return 2;
+        case ll::ChannelType::Uint32:
+        case ll::ChannelType::Int32:
+        case ll::ChannelType::Float32:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+std::string getChannelTypeName(const ll::ChannelType channelType) {
+
+    switch (channelType) {
+        case ll::ChannelType::Uint8: return "Uint8";
+        case ll::ChannelType::Int8: return "Int8";
+        case ll::ChannelType::Uint16: return "Uint16";
+        case ll::ChannelType::Int16: return "Int16";
+        case ll::ChannelType::Float16: return "Float16";
+        case ll::ChannelType::Uint32: return "Uint32";
+        case ll::ChannelType::Int32: return "Int32";
+        case ll::ChannelType::Float32: return "Float32";
+        case ll::ChannelType::Uint64: return "Uint64";
+        case ll::ChannelType::Int64: return "Int64";
+        case ll::ChannelType::Float64: return "Float64";
+    }
+
+    return "unknown";
+}
+
+uint64_t getImageBytes(const lluvia::ImageSnapshot& image) {
+    return uint64_t {image.width()} * image.height() * image.depth() * image.channel_count()
+        * getChannelTypeSize(static_cast<ll::ChannelType>(image.channel_type()));
+}
+
+// image or buffer index of an object, image views resolve to their image
+std::pair<lluvia::SnapshotObjectType, int> getStorage(const lluvia::ContainerSnapshot& snapshot, const lluvia::ObjectRef& ref) {
+
+    if (ref.type() == lluvia::SNAPSHOT_IMAGE_VIEW) {
+        return {lluvia::SNAPSHOT_IMAGE, snapshot.image_views(ref.index()).image()};
+    }
+
+    return {ref.type(), ref.index()};
+}
+
+// bytes read back for an output port bound to an object of objectBytes
+uint64_t getReadbackBytes(const lluvia::PortBinding& binding, const lluvia::ImageSnapshot* image, const uint64_t objectBytes) {
+
+    if (binding.packet_type() == lluvia::LLUVIA_IMAGE) {
+        return 0;
+    }
+
+    // buffer ports are read back whole
+    if (image == nullptr) {
+        return objectBytes;
+    }
+
+    const auto pixels = uint64_t {image->width()} * image->height() * image->depth();
+
+    if (binding.reduction().type() != lluvia::Reduction::NONE) {
+        switch (binding.reduction().type()) {
+            case lluvia::Reduction::HISTOGRAM:
+                return uint64_t {4} * binding.reduction().bins();
+            case lluvia::Reduction::MIN_MAX:
+                return uint64_t {8} * image->channel_count();
+            default:
+                return uint64_t {4} * image->channel_count();
+        }
+    }
+
+    if (binding.packet_type() == lluvia::TENSOR) {
+        const auto channels = binding.tensor().swizzle().empty() ? image->channel_count() : binding.tensor().swizzle().size();
+        return pixels * channels * (binding.tensor().element_type() == lluvia::TensorOptions::FLOAT16 ? 2 : 4);
+    }
+
+    if (binding.has_packing()) {
+        const auto channels = binding.packing().swizzle().empty() ? image->channel_count() : binding.packing().swizzle().size();
+
+        switch (binding.packing().encoding()) {
+            case lluvia::OutputPacking::INT8:
+                return pixels * channels;
+            case lluvia::OutputPacking::INT16:
+            case lluvia::OutputPacking::FLOAT16:
+                return pixels * channels * 2;
+            default:
+                return pixels * channels * getChannelTypeSize(static_cast<ll::ChannelType>(image->channel_type()));
+        }
+    }
+
+    return objectBytes;
+}
+
+// Options of an additional container node as seen by ComputeCostReport(),
+// its input bindings renamed to the ports of the container node.
+lluvia::LluviaCalculatorOptions getContainerOptions(const lluvia::LluviaCalculatorOptions& options, const lluvia::ContainerNodeConfig& container) {
+
+    auto containerOptions = lluvia::LluviaCalculatorOptions {};
+    containerOptions.set_container_node(container.container_node());
+
+    for (const auto& binding : options.input_port_binding()) {
+
+        auto& containerBinding = *containerOptions.add_input_port_binding();
+        containerBinding = binding;
+
+        const auto alias = container.input_port().find(binding.mediapipe_tag());
+        if (alias != container.input_port().end()) {
+            containerBinding.set_lluvia_port(alias->second);
+        }
+    }
+
+    *containerOptions.mutable_output_port_binding() = container.output_port_binding();
+    return containerOptions;
+}
+
+// Adds the cost of an additional container node. Its input ports are bound
+// to the images uploaded for container_node, which are already counted.
+void addContainerCost(LluviaCostReport& report, LluviaCostReport containerReport, const std::set<std::string>& inputPorts) {
+
+    for (auto& node : containerReport.nodes) {
+        report.nodes.push_back(std::move(node));
+    }
+
+    for (auto& image : containerReport.images) {
+        if (inputPorts.count(image.port) == 0) {
+            report.images.push_back(std::move(image));
+        } else {
+            containerReport.deviceMemoryBytes -= image.bytes;
+        }
+    }
+
+    for (auto& buffer : containerReport.buffers) {
+        report.buffers.push_back(std::move(buffer));
+    }
+
+    report.deviceMemoryBytes += containerReport.deviceMemoryBytes;
+    report.hostMemoryBytes += containerReport.hostMemoryBytes;
+    report.readbackBytes += containerReport.readbackBytes;
+    report.dispatches += containerReport.dispatches;
+    report.barriers += containerReport.barriers;
+    report.layoutChanges += containerReport.layoutChanges;
+    report.transferCommands += containerReport.transferCommands;
+}
+
+struct CapturedContainer {
+    lluvia::ContainerSnapshot snapshot;
+    std::map<std::string, std::shared_ptr<ll::Object>> boundPorts;
+};
+
+// Runs each compute node of instance alone and sets the median GPU time of
+// report.nodes from firstNode on.
+::mediapipe::Status timeComputeNodes(const std::shared_ptr<ll::Session>& session, LluviaContainerInstance& instance,
+                                     const int timingIterations, LluviaCostReport& report, const size_t firstNode) {
+
+    try {
+        const auto& computeNodes = instance.getComputeNodes();
+        auto duration = session->createDuration();
+
+        for (auto i = size_t {0}; i < computeNodes.size() && firstNode + i < report.nodes.size(); ++i) {
+
+            auto cmdBuffer = session->createCommandBuffer();
+            cmdBuffer->begin();
+            cmdBuffer->durationStart(*duration);
+            cmdBuffer->run(*computeNodes[i]);
+            cmdBuffer->durationEnd(*duration);
+            cmdBuffer->end();
+
+            auto durations = std::vector<std::chrono::nanoseconds> {};
+            for (auto n = 0; n < timingIterations; ++n) {
+                session->run(*cmdBuffer);
+                durations.push_back(duration->getDuration());
+            }
+
+            std::nth_element(durations.begin(), durations.begin() + durations.size() / 2, durations.end());
+            report.nodes[firstNode + i].gpuTimeNs = durations[durations.size() / 2].count();
+        }
+    } catch (std::exception& e) {
+        return absl::InternalError(absl::StrCat("error timing compute nodes: ", e.what()));
+    }
+
+    return ::mediapipe::OkStatus();
+}
+
+} // namespace
+
+LluviaCostReport ComputeCostReport(const lluvia::ContainerSnapshot& snapshot, const lluvia::LluviaCalculatorOptions& options) {
+
+    auto report = LluviaCostReport {};
+    report.containerNode = snapshot.container_node();
+
+    for (const auto& node : snapshot.compute_nodes()) {
+
+        auto nodeCost = LluviaNodeCost {};
+        nodeCost.builderName = node.builder_name();
+        nodeCost.grid = {node.grid_x(), node.grid_y(), node.grid_z()};
+        nodeCost.local = {node.local_x(), node.local_y(), node.local_z()};
+        nodeCost.invocations = uint64_t {node.grid_x()} * node.grid_y() * node.grid_z()
+                             * node.local_x() * node.local_y() * node.local_z();
+
+        report.nodes.push_back(std::move(nodeCost));
+    }
+
+    // container ports of each image and buffer
+    auto ports = std::map<std::pair<lluvia::SnapshotObjectType, int>, std::string> {};
+    for (const auto& port : snapshot.ports()) {
+        ports[getStorage(snapshot, port.object())] = port.name();
+    }
+
+    const auto getPort = [&ports](const lluvia::SnapshotObjectType type, const int index) {
+        const auto it = ports.find({type, index});
+        return it == ports.end() ? std::string {} : it->second;
+    };
+
+    for (auto i = 0; i < snapshot.images_size(); ++i) {
+
+        const auto& image = snapshot.images(i);
+        const auto channelType = static_cast<ll::ChannelType>(image.channel_type());
+
+        auto imageCost = LluviaObjectCost {};
+        imageCost.description = absl::StrCat(image.width(), "x", image.height(), "x", image.depth(),
+                                             " C", image.channel_count(), " ", getChannelTypeName(channelType));
+        imageCost.bytes = getImageBytes(image);
+        imageCost.port = getPort(lluvia::SNAPSHOT_IMAGE, i);
+
+        report.deviceMemoryBytes += imageCost.bytes;
+        report.images.push_back(std::move(imageCost));
+    }
+
+    for (auto i = 0; i < snapshot.buffers_size(); ++i) {
+
+        const auto& buffer = snapshot.buffers(i);
+
+        auto bufferCost = LluviaObjectCost {};
+        bufferCost.description = buffer.host_visible() ? "host visible" : "device local";
+        bufferCost.bytes = buffer.size();
+        bufferCost.port = getPort(lluvia::SNAPSHOT_BUFFER, i);
+
+        (buffer.host_visible() ? report.hostMemoryBytes : report.deviceMemoryBytes) += bufferCost.bytes;
+        report.buffers.push_back(std::move(bufferCost));
+    }
+
+    // bytes of the object bound to a container port, and its image if any
+    const auto findPort = [&snapshot](const std::string& name) -> std::pair<const lluvia::ImageSnapshot*, uint64_t> {
+
+        for (const auto& port : snapshot.ports()) {
+            if (port.name() != name) {
+                continue;
+            }
+
+            const auto storage = getStorage(snapshot, port.object());
+            if (storage.first == lluvia::SNAPSHOT_IMAGE) {
+                const auto& image = snapshot.images(storage.second);
+                return {&image, getImageBytes(image)};
+            }
+
+            return {nullptr, snapshot.buffers(storage.second).size()};
+        }
+
+        return {nullptr, 0};
+    };
+
+    for (const auto& binding : options.input_port_binding()) {
+        if (binding.packet_type() != lluvia::LLUVIA_IMAGE) {
+            report.uploadBytes += findPort(binding.lluvia_port()).second;
+        }
+    }
+
+    for (const auto& binding : options.output_port_binding()) {
+        const auto port = findPort(binding.lluvia_port());
+        report.readbackBytes += getReadbackBytes(binding, port.first, port.second);
+    }
+
+    for (const auto& op : snapshot.record_ops()) {
+        switch (op.type()) {
+            case lluvia::RecordOp::RUN:
+                ++report.dispatches;
+                break;
+            case lluvia::RecordOp::MEMORY_BARRIER:
+                ++report.barriers;
+                break;
+            case lluvia::RecordOp::CHANGE_IMAGE_LAYOUT:
+                ++report.layoutChanges;
+                break;
+            default:
+                ++report.transferCommands;
+                break;
+        }
+    }
+
+    return report;
+}
+
+::mediapipe::StatusOr<LluviaCostReport> CaptureCostReport(const lluvia::LluviaCalculatorOptions& options, const int timingIterations) {
+
+    auto session = std::shared_ptr<ll::Session> {};
+    auto containerNode = std::shared_ptr<ll::ContainerNode> {};
+    auto deviceMemory = std::shared_ptr<ll::Memory> {};
+    auto boundPorts = std::map<std::string, std::shared_ptr<ll::Object>> {};
+
+    try {
+        const auto availableDevices = ll::Session::getAvailableDevices();
+        if (availableDevices.empty()) {
+            return absl::UnavailableError("no Vulkan device available");
+        }
+
+        session = ll::Session::create(ll::SessionDescriptor()
+                                          .setDeviceDescriptor(selectDefaultDevice(availableDevices))
+                                          .enableDebug(options.enable_debug()));
+        deviceMemory = session->createMemory(ll::MemoryPropertyFlagBits::DeviceLocal, 32 * 1024 * 1024, false);
+
+        for (const auto& libraryPath : options.library_path()) {
+            session->loadLibrary(libraryPath);
+        }
+
+        for (const auto& scriptPath : options.script_path()) {
+            session->scriptFile(scriptPath);
+        }
+
+        containerNode = session->createContainerNode(options.container_node());
+    } catch (std::exception& e) {
+        return absl::InvalidArgumentError(absl::StrCat("error creating container node ", options.container_node(), ": ", e.what()));
+    }
+
+    for (const auto& parameter : options.parameter()) {
+        containerNode->setParameter(parameter.name(), ll::Parameter {parameter.value()});
+    }
+
+    const ll::ImageUsageFlags usageFlags = {ll::ImageUsageFlagBits::Storage
+                                            | ll::ImageUsageFlagBits::Sampled
+                                            | ll::ImageUsageFlagBits::TransferDst
+                                            | ll::ImageUsageFlagBits::TransferSrc};
+
+    auto portNames = std::vector<std::string> {};
+
+    for (const auto& binding : options.input_port_binding()) {
+
+        if (binding.packet_type() != lluvia::IMAGE_FRAME && binding.packet_type() != lluvia::LLUVIA_IMAGE) {
+            return absl::UnimplementedError(absl::StrCat("input ", binding.mediapipe_tag(), ": only image inputs are supported"));
+        }
+
+        if (binding.width() <= 0 || binding.height() <= 0) {
+            return absl::InvalidArgumentError(absl::StrCat("input ", binding.mediapipe_tag(), " must declare its width and height"));
+        }
+
+        auto supported = false;
+        auto channelCount = ll::ChannelCount::C1;
+        auto channelType = ll::ChannelType::Uint8;
+        std::tie(supported, channelCount, channelType) = getLluviaImageFormat(binding.format());
+
+        if (!supported) {
+            return absl::InvalidArgumentError(absl::StrCat("input ", binding.mediapipe_tag(), ": image format not supported"));
+        }
+
+        const auto imageDesc = ll::ImageDescriptor {1, static_cast<uint32_t>(binding.height()), static_cast<uint32_t>(binding.width()),
+                                                    channelCount, channelType}
+                                   .setUsageFlags(usageFlags);
+
+        auto image = deviceMemory->createImage(imageDesc);
+        image->changeImageLayout(ll::ImageLayout::General);
+
+        auto imageView = image->createImageView(ll::ImageViewDescriptor {ll::ImageAddressMode::ClampToBorder,
+                                                                         ll::ImageFilterMode::Nearest,
+                                                                         false,
+                                                                         false});
+
+        boundPorts[binding.lluvia_port()] = imageView;
+        portNames.push_back(binding.lluvia_port());
+    }
+
+    try {
+        for (const auto& [name, object] : boundPorts) {
+            containerNode->bind(name, object);
+        }
+
+        containerNode->init();
+    } catch (std::exception& e) {
+        return absl::InvalidArgumentError(absl::StrCat("error initializing container node ", options.container_node(), ": ", e.what()));
+    }
+
+    for (const auto& binding : options.output_port_binding()) {
+        portNames.push_back(binding.lluvia_port());
+    }
+
+    auto snapshot = lluvia::ContainerSnapshot {};
+    ASSIGN_OR_RETURN(snapshot, CaptureContainerSnapshot(session, *containerNode, portNames));
+
+    auto report = ComputeCostReport(snapshot, options);
+
+    // snapshots and bound objects of the container nodes, in record order
+    auto containers = std::vector<CapturedContainer> {};
+    containers.push_back(CapturedContainer {std::move(snapshot), boundPorts});
+
+    for (const auto& container : options.additional_container()) {
+
+        const auto containerOptions = getContainerOptions(options, container);
+
+        auto captured = CapturedContainer {};
+        auto containerPortNames = std::vector<std::string> {};
+        auto inputPorts = std::set<std::string> {};
+
+        for (auto i = 0; i < options.input_port_binding_size(); ++i) {
+
+            const auto& name = containerOptions.input_port_binding(i).lluvia_port();
+            captured.boundPorts[name] = boundPorts.at(options.input_port_binding(i).lluvia_port());
+
+            containerPortNames.push_back(name);
+            inputPorts.insert(name);
+        }
+
+        auto additionalNode = std::shared_ptr<ll::ContainerNode> {};
+
+        try {
+            additionalNode = session->createContainerNode(container.container_node());
+
+            for (const auto& [name, object] : captured.boundPorts) {
+                additionalNode->bind(name, object);
+            }
+
+            additionalNode->init();
+        } catch (std::exception& e) {
+            return absl::InvalidArgumentError(absl::StrCat("error initializing container node ", container.container_node(), ": ", e.what()));
+        }
+
+        for (const auto& binding : container.output_port_binding()) {
+            containerPortNames.push_back(binding.lluvia_port());
+        }
+
+        ASSIGN_OR_RETURN(captured.snapshot, CaptureContainerSnapshot(session, *additionalNode, containerPortNames));
+
+        addContainerCost(report, ComputeCostReport(captured.snapshot, containerOptions), inputPorts);
+        report.additionalContainerNodes.push_back(container.container_node());
+
+        containers.push_back(std::move(captured));
+    }
+
+    if (timingIterations <= 0) {
+        return report;
+    }
+
+    // index in report.nodes of the first compute node of each container
+    auto firstNode = size_t {0};
+
+    for (const auto& container : containers) {
+
+        auto instance = std::unique_ptr<LluviaContainerInstance> {};
+        ASSIGN_OR_RETURN(instance, LluviaContainerInstance::Create(session, deviceMemory, session->getHostMemory(), container.snapshot, container.boundPorts));
+
+        MP_RETURN_IF_ERROR(timeComputeNodes(session, *instance, timingIterations, report, firstNode));
+        firstNode += container.snapshot.compute_nodes_size();
+    }
+
+    return report;
+}
+
+std::string LluviaCostReportToString(const LluviaCostReport& report) {
+
+    auto text = absl::StrCat("container node: ", report.containerNode, "\n");
+
+    for (const auto& containerNode : report.additionalContainerNodes) {
+        absl::StrAppend(&text, "additional container node: ", containerNode, "\n");
+    }
+
+    absl::StrAppend(&text, "\n", "compute nodes: ", report.nodes.size(), "\n");
+
+    for (const auto& node : report.nodes) {
+        absl::StrAppend(&text, "  ", node.builderName,
+                        "  grid: ", node.grid[0], "x", node.grid[1], "x", node.grid[2],
+                        "  local: ", node.local[0], "x", node.local[1], "x", node.local[2],
+                        "  invocations: ", node.invocations);
+
+        if (node.gpuTimeNs >= 0) {
+            absl::StrAppend(&text, "  gpu time: ", static_cast<double>(node.gpuTimeNs) / 1e6, " ms");
+        }
+
+        absl::StrAppend(&text, "\n");
+    }
+
+    const auto appendObjects = [&text](const std::string& title, const std::vector<LluviaObjectCost>& objects) {
+
+        absl::StrAppend(&text, "\n", title, ": ", objects.size(), "\n");
+
+        for (const auto& object : objects) {
+            absl::StrAppend(&text, "  ", object.description, "  bytes: ", object.bytes);
+            if (!object.port.empty()) {
+                absl::StrAppend(&text, "  port: ", object.port);
+            }
+            absl::StrAppend(&text, "\n");
+        }
+    };
+
+    appendObjects("images", report.images);
+    appendObjects("buffers", report.buffers);
+
+    absl::StrAppend(&text, "\n",
+        "device memory bytes:         ", report.deviceMemoryBytes, "\n",
+        "host memory bytes:           ", report.hostMemoryBytes, "\n",
+        "upload bytes per frame:      ", report.uploadBytes, "\n",
+        "readback bytes per frame:    ", report.readbackBytes, "\n",
+        "dispatches per frame:        ", report.dispatches, "\n",
+        "barriers per frame:          ", report.barriers, "\n",
+        "layout changes per frame:    ", report.layoutChanges, "\n",
+        "transfer commands per frame: ", report.transferCommands, "\n");
+
+    return text;
+}
+
+} // namespace mediapipe
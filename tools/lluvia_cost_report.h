@@ -0,0 +1,88 @@
+#ifndef LLUVIA_MEDIAPIPE_TOOLS_LLUVIA_COST_REPORT_H_
+#define LLUVIA_MEDIAPIPE_TOOLS_LLUVIA_COST_REPORT_H_
+
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_snapshot.pb.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mediapipe {
+
+struct LluviaNodeCost {
+    std::string builderName;
+
+    std::array<uint32_t, 3> grid {};
+    std::array<uint32_t, 3> local {};
+
+    // grid times local shape
+    uint64_t invocations {0};
+
+    // median GPU time of the node run alone, -1 if not timed.
+    int64_t gpuTimeNs {-1};
+};
+
+// Image or buffer allocated by the container node or bound to its ports.
+struct LluviaObjectCost {
+    std::string description;
+    uint64_t bytes {0};
+
+    // container port the object is bound to, empty for internal objects.
+    std::string port;
+};
+
+// Per frame cost of the container nodes of a LluviaCalculator.
+struct LluviaCostReport {
+    std::string containerNode;
+    std::vector<std::string> additionalContainerNodes;
+
+    // compute nodes in record order, each one listed once. The nodes of the
+    // additional container nodes follow the ones of containerNode.
+    std::vector<LluviaNodeCost> nodes;
+
+    std::vector<LluviaObjectCost> images;
+    std::vector<LluviaObjectCost> buffers;
+
+    // images and buffers in device local memory, and buffers in host visible memory.
+    uint64_t deviceMemoryBytes {0};
+    uint64_t hostMemoryBytes {0};
+
+    // bytes copied between host and device per frame by the input and
+    // output port bindings. LLUVIA_IMAGE ports stay in device memory.
+    uint64_t uploadBytes {0};
+    uint64_t readbackBytes {0};
+
+    // commands recorded by the container nodes per frame, not including the
+    // ones the calculator records around them.
+    int dispatches {0};
+    int barriers {0};
+    int layoutChanges {0};
+    int transferCommands {0};
+};
+
+/**
+ * Computes the report of a container node captured with
+ * CaptureContainerSnapshot(), with the ports of options' bindings among the
+ * captured ports. Nodes are not timed.
+ */
+LluviaCostReport ComputeCostReport(const lluvia::ContainerSnapshot& snapshot, const lluvia::LluviaCalculatorOptions& options);
+
+/**
+ * Instantiates options.container_node on the default device, loading
+ * library_path and script_path and setting the parameters of options, then
+ * each additional_container bound to the same input images.
+ *
+ * Input ports must be images declaring their width, height and format.
+ * If timingIterations is positive, each compute node is then run alone that
+ * many times and its median GPU time reported.
+ */
+::mediapipe::StatusOr<LluviaCostReport> CaptureCostReport(const lluvia::LluviaCalculatorOptions& options, const int timingIterations);
+
+std::string LluviaCostReportToString(const LluviaCostReport& report);
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_TOOLS_LLUVIA_COST_REPORT_H_
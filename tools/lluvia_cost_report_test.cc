@@ -0,0 +1,112 @@
+#include "absl/strings/substitute.h"
+
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+#include "tools/cpp/runfiles/runfiles.h"
+using bazel::tools::cpp::runfiles::Runfiles;
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/tools/lluvia_cost_report.h"
+
+#include <memory>
+
+namespace mediapipe {
+
+namespace {
+
+lluvia::LluviaCalculatorOptions GetRGBA2GrayOptions() {
+
+    auto runfiles = std::unique_ptr<Runfiles> {Runfiles::CreateForTest(nullptr)};
+
+    auto libraryPath = runfiles->Rlocation("lluvia/lluvia/nodes/lluvia_node_library.zip");
+    auto lluviaMediapipeLibraryPath = runfiles->Rlocation("mediapipe/mediapipe/lluvia-mediapipe/calculators/lluvia_mediapipe_library.zip");
+
+    return ParseTextProtoOrDie<lluvia::LluviaCalculatorOptions>(absl::Substitute(R"pb(
+        container_node: "lluvia/mediapipe/LluviaCalculator"
+        library_path: "$0"
+        library_path: "$1"
+
+        input_port_binding:  {
+            mediapipe_tag: "IN_0"
+            lluvia_port: "in_image"
+            packet_type: IMAGE_FRAME
+            width: 64
+            height: 32
+            format: SRGBA
+        }
+
+        output_port_binding:  {
+            mediapipe_tag: "OUT_0"
+            lluvia_port: "out_image"
+            packet_type: IMAGE_FRAME
+        }
+    )pb", libraryPath, lluviaMediapipeLibraryPath));
+}
+
+TEST(LluviaCostReportTest, TestRGBA2Gray) {
+
+    ASSERT_OK_AND_ASSIGN(auto report, CaptureCostReport(GetRGBA2GrayOptions(), 0));
+
+    EXPECT_EQ(report.containerNode, "lluvia/mediapipe/LluviaCalculator");
+    ASSERT_GE(report.nodes.size(), 1);
+    EXPECT_GT(report.nodes[0].invocations, 0);
+    EXPECT_EQ(report.nodes[0].gpuTimeNs, -1);
+
+    EXPECT_EQ(report.uploadBytes, 64 * 32 * 4);
+    EXPECT_GT(report.readbackBytes, 0);
+    EXPECT_GE(report.dispatches, 1);
+    EXPECT_GE(report.deviceMemoryBytes, report.uploadBytes + report.readbackBytes);
+}
+
+TEST(LluviaCostReportTest, TestTiming) {
+
+    ASSERT_OK_AND_ASSIGN(auto report, CaptureCostReport(GetRGBA2GrayOptions(), 3));
+
+    for (const auto& node : report.nodes) {
+        EXPECT_GE(node.gpuTimeNs, 0);
+    }
+}
+
+TEST(LluviaCostReportTest, TestAdditionalContainer) {
+
+    const auto options = GetRGBA2GrayOptions();
+
+    auto withAdditional = options;
+    withAdditional.MergeFrom(ParseTextProtoOrDie<lluvia::LluviaCalculatorOptions>(R"pb(
+        additional_container {
+            container_node: "lluvia/mediapipe/LluviaCalculator"
+            output_port_binding {
+                mediapipe_tag: "OUT_1"
+                lluvia_port: "out_image"
+                packet_type: IMAGE_FRAME
+            }
+        }
+    )pb"));
+
+    ASSERT_OK_AND_ASSIGN(auto report, CaptureCostReport(options, 0));
+    ASSERT_OK_AND_ASSIGN(auto additionalReport, CaptureCostReport(withAdditional, 0));
+
+    ASSERT_EQ(additionalReport.additionalContainerNodes.size(), 1);
+    EXPECT_EQ(additionalReport.nodes.size(), 2 * report.nodes.size());
+    EXPECT_EQ(additionalReport.dispatches, 2 * report.dispatches);
+
+    // the input image is uploaded and counted once
+    EXPECT_EQ(additionalReport.uploadBytes, report.uploadBytes);
+    EXPECT_EQ(additionalReport.readbackBytes, 2 * report.readbackBytes);
+    EXPECT_EQ(additionalReport.deviceMemoryBytes, 2 * report.deviceMemoryBytes - report.uploadBytes);
+}
+
+TEST(LluviaCostReportTest, TestMissingInputShape) {
+
+    auto options = GetRGBA2GrayOptions();
+    options.mutable_input_port_binding(0)->clear_width();
+
+    EXPECT_FALSE(CaptureCostReport(options, 0).ok());
+}
+
+} // namespace
+
+} // namespace mediapipe
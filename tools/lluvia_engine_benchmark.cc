@@ -0,0 +1,124 @@
+#include <cstdlib>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/substitute.h"
+
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_engine.h"
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <vector>
+
+ABSL_FLAG(std::string, lluvia_library, "", "Path to lluvia_node_library.zip.");
+ABSL_FLAG(std::string, mediapipe_library, "", "Path to lluvia_mediapipe_library.zip.");
+ABSL_FLAG(int, width, 1920, "Width of the input frames.");
+ABSL_FLAG(int, height, 1080, "Height of the input frames.");
+ABSL_FLAG(int, frames, 300, "Number of frames measured for each in-flight depth.");
+ABSL_FLAG(int, warmup_frames, 10, "Number of frames run before measuring.");
+
+// Runs the RGBA2Gray container node of lluvia_mediapipe_library through a
+// LluviaEngine keeping depth frames in flight, and returns the frames per
+// second once warmed up.
+::mediapipe::StatusOr<double> runDepth(const int depth) {
+
+    const auto width = absl::GetFlag(FLAGS_width);
+    const auto height = absl::GetFlag(FLAGS_height);
+
+    const auto options = mediapipe::ParseTextProtoOrDie<lluvia::LluviaCalculatorOptions>(
+        absl::Substitute(
+            R"pb(
+                container_node: "lluvia/mediapipe/LluviaCalculator"
+
+                library_path: "$0"
+                library_path: "$1"
+
+                input_port_binding:  {
+                    mediapipe_tag: "IN_0"
+                    lluvia_port: "in_image"
+                    packet_type: IMAGE_FRAME
+                    width: $2
+                    height: $3
+                    format: SRGBA
+                }
+
+                output_port_binding:  {
+                    mediapipe_tag: "OUT_0"
+                    lluvia_port: "out_image"
+                    packet_type: IMAGE_FRAME
+                }
+            )pb",
+            absl::GetFlag(FLAGS_lluvia_library),
+            absl::GetFlag(FLAGS_mediapipe_library),
+            width,
+            height
+        )
+    );
+
+    ASSIGN_OR_RETURN(auto engine, mediapipe::LluviaEngine::Create(options, depth));
+
+    // one input buffer per frame in flight, reused once its frame finished
+    auto pixels = std::vector<std::vector<uint8_t>>(depth, std::vector<uint8_t>(static_cast<size_t>(width) * height * 4, 1));
+    auto pending = std::deque<std::future<::mediapipe::StatusOr<mediapipe::LluviaEngineOutputs>>> {};
+
+    const auto warmupFrames = absl::GetFlag(FLAGS_warmup_frames);
+    const auto frames = absl::GetFlag(FLAGS_frames);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto t = 0; t < warmupFrames + frames; ++t) {
+
+        if (t == warmupFrames) {
+            start = std::chrono::steady_clock::now();
+        }
+
+        if (static_cast<int>(pending.size()) == depth) {
+            MP_RETURN_IF_ERROR(pending.front().get().status());
+            pending.pop_front();
+        }
+
+        auto& framePixels = pixels[t % depth];
+        pending.push_back(engine->submit(std::map<std::string, mediapipe::LluviaImageView> {
+            {"IN_0", mediapipe::LluviaImageView {framePixels.data(), width, height, 0, mediapipe::ImageFormat::SRGBA}}}));
+    }
+
+    while (!pending.empty()) {
+        MP_RETURN_IF_ERROR(pending.front().get().status());
+        pending.pop_front();
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    return frames / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Arg parsing
+    absl::ParseCommandLine(argc, argv);
+    std::cout << "resolution: " << absl::GetFlag(FLAGS_width) << "x" << absl::GetFlag(FLAGS_height) << std::endl;
+
+    if (absl::GetFlag(FLAGS_frames) <= 0) {
+        std::cerr << "ERROR: frames must be positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (const auto depth : {1, 2, 4}) {
+
+        auto framesPerSecond = runDepth(depth);
+
+        if (!framesPerSecond.ok()) {
+            std::cerr << "depth " << depth << ": " << framesPerSecond.status().message() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "in-flight depth " << depth << ": " << framesPerSecond.value() << " frames/s" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
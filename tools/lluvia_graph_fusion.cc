@@ -0,0 +1,528 @@
+#include "mediapipe/lluvia-mediapipe/tools/lluvia_graph_fusion.h"
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <set>
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kLluviaCalculator[] = "LluviaCalculator";
+
+struct StreamEndpoint {
+    int node {-1};
+    std::string tag;
+};
+
+struct Stream {
+    StreamEndpoint producer;
+    std::vector<StreamEndpoint> consumers;
+
+    // consumed by a back edge, ignored for cycle detection
+    std::vector<bool> backEdge;
+
+    bool isGraphOutput {false};
+};
+
+// Tag and stream name of "TAG:name", "TAG:index:name" or "name".
+std::pair<std::string, std::string> splitStream(const std::string& tagIndexName) {
+
+    const std::vector<std::string> parts = absl::StrSplit(tagIndexName, ':');
+
+    if (parts.size() == 1) {
+        return {"", parts[0]};
+    }
+
+    return {parts[0], parts.back()};
+}
+
+bool getLluviaOptions(const CalculatorGraphConfig::Node& node, lluvia::LluviaCalculatorOptions* options) {
+
+    if (node.calculator() != kLluviaCalculator) {
+        return false;
+    }
+
+    for (const auto& any : node.node_options()) {
+        if (any.Is<lluvia::LluviaCalculatorOptions>()) {
+            return any.UnpackTo(options);
+        }
+    }
+
+    if (node.has_options() && node.options().HasExtension(lluvia::LluviaCalculatorOptions::ext)) {
+        *options = node.options().GetExtension(lluvia::LluviaCalculatorOptions::ext);
+        return true;
+    }
+
+    // a LluviaCalculator without options has nothing to fuse
+    return false;
+}
+
+const lluvia::PortBinding* findBinding(const google::protobuf::RepeatedPtrField<lluvia::PortBinding>& bindings, const std::string& tag) {
+
+    for (const auto& binding : bindings) {
+        if (binding.mediapipe_tag() == tag) {
+            return &binding;
+        }
+    }
+
+    return nullptr;
+}
+
+bool isFusableBinding(const lluvia::PortBinding* binding) {
+
+    return binding != nullptr
+        && (binding->packet_type() == lluvia::IMAGE_FRAME || binding->packet_type() == lluvia::LLUVIA_IMAGE)
+        && binding->roi_tag().empty()
+        && !binding->has_packing();
+}
+
+// Options applying to the whole calculator, which the fused calculator
+// can only carry over when its nodes agree on them.
+bool haveSameCalculatorOptions(const lluvia::LluviaCalculatorOptions& a, const lluvia::LluviaCalculatorOptions& b) {
+
+    return a.memory_mode() == b.memory_mode()
+        && a.trace_path() == b.trace_path()
+        && a.trace_max_events() == b.trace_max_events()
+        && a.warmup_runs() == b.warmup_runs()
+        && a.workgroup_tuning().SerializeAsString() == b.workgroup_tuning().SerializeAsString()
+        && a.submission_thread() == b.submission_thread()
+        && a.host_copy_threads() == b.host_copy_threads();
+}
+
+void copyCalculatorOptions(const lluvia::LluviaCalculatorOptions& options, lluvia::LluviaCalculatorOptions& fusedOptions) {
+
+    if (options.has_memory_mode()) fusedOptions.set_memory_mode(options.memory_mode());
+    if (options.has_trace_path()) fusedOptions.set_trace_path(options.trace_path());
+    if (options.has_trace_max_events()) fusedOptions.set_trace_max_events(options.trace_max_events());
+    if (options.has_warmup_runs()) fusedOptions.set_warmup_runs(options.warmup_runs());
+    if (options.has_workgroup_tuning()) *fusedOptions.mutable_workgroup_tuning() = options.workgroup_tuning();
+    if (options.has_submission_thread()) fusedOptions.set_submission_thread(options.submission_thread());
+    if (options.has_host_copy_threads()) fusedOptions.set_host_copy_threads(options.host_copy_threads());
+}
+
+bool hasBackEdge(const CalculatorGraphConfig::Node& node, const std::string& tag, const int inputIndex) {
+
+    for (const auto& info : node.input_stream_info()) {
+        if (!info.back_edge()) continue;
+
+        // tag_index is either "TAG", "TAG:index" or the plain input index
+        const std::vector<std::string> parts = absl::StrSplit(info.tag_index(), ':');
+        if (parts[0] == tag || parts[0] == std::to_string(inputIndex)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+class UnionFind {
+public:
+    explicit UnionFind(const int size) : m_parent(size) {
+        std::iota(m_parent.begin(), m_parent.end(), 0);
+    }
+
+    int find(int i) {
+        while (m_parent[i] != i) {
+            m_parent[i] = m_parent[m_parent[i]];
+            i = m_parent[i];
+        }
+        return i;
+    }
+
+    void merge(const int a, const int b) {
+        m_parent[find(b)] = find(a);
+    }
+
+    std::vector<int> m_parent;
+};
+
+// True if the graph contracted by groups has a cycle, back edges excluded.
+bool hasCycle(const std::map<std::string, Stream>& streams, UnionFind groups, const int nodeCount) {
+
+    auto edges = std::vector<std::set<int>>(nodeCount);
+    for (const auto& [name, stream] : streams) {
+        if (stream.producer.node < 0) continue;
+
+        const auto from = groups.find(stream.producer.node);
+        for (auto i = size_t {0}; i < stream.consumers.size(); ++i) {
+            const auto to = groups.find(stream.consumers[i].node);
+            if (!stream.backEdge[i] && from != to) {
+                edges[from].insert(to);
+            }
+        }
+    }
+
+    // 0: not visited, 1: in the current path, 2: done
+    auto state = std::vector<int>(nodeCount, 0);
+
+    std::function<bool(int)> visit = [&](const int n) {
+        state[n] = 1;
+        for (const auto next : edges[n]) {
+            if (state[next] == 1) return true;
+            if (state[next] == 0 && visit(next)) return true;
+        }
+        state[n] = 2;
+        return false;
+    };
+
+    for (auto n = 0; n < nodeCount; ++n) {
+        if (state[n] == 0 && visit(n)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace
+
+::mediapipe::StatusOr<LluviaFusionResult> FuseLluviaCalculators(const CalculatorGraphConfig& config,
+                                                                const LluviaFusionOptions& fusionOptions) {
+
+    const auto nodeCount = config.node_size();
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Parse options and streams
+    auto lluviaOptions = std::vector<lluvia::LluviaCalculatorOptions>(nodeCount);
+    auto isLluvia = std::vector<bool>(nodeCount, false);
+
+    auto streams = std::map<std::string, Stream> {};
+
+    for (auto n = 0; n < nodeCount; ++n) {
+        const auto& node = config.node(n);
+
+        // a fused container node replaces container_node only, and degradation
+        // levels of the latency governor apply to the whole calculator. Tiles
+        // and devices are split per calculator, and a snapshot holds the
+        // original container node.
+        const auto& options = lluviaOptions[n];
+        isLluvia[n] = getLluviaOptions(node, &lluviaOptions[n])
+            && options.additional_container_size() == 0
+            && options.latency_governor().deadline_ms() <= 0
+            && (options.tiling().tile_width() <= 0 || options.tiling().tile_height() <= 0)
+            && options.multi_device().device_index_size() == 0
+            && options.snapshot_path().empty();
+
+        for (const auto& outputStream : node.output_stream()) {
+            const auto [tag, name] = splitStream(outputStream);
+            streams[name].producer = StreamEndpoint {n, tag};
+        }
+
+        for (auto i = 0; i < node.input_stream_size(); ++i) {
+            const auto [tag, name] = splitStream(node.input_stream(i));
+            streams[name].consumers.push_back(StreamEndpoint {n, tag});
+            streams[name].backEdge.push_back(hasBackEdge(node, tag, i));
+        }
+    }
+
+    for (const auto& outputStream : config.output_stream()) {
+        streams[splitStream(outputStream).second].isGraphOutput = true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Group nodes along fusable edges
+    auto groups = UnionFind {nodeCount};
+    auto fusedStreams = std::set<std::string> {};
+
+    for (const auto& [name, stream] : streams) {
+
+        const auto producer = stream.producer.node;
+        if (producer < 0 || stream.isGraphOutput || stream.consumers.size() != 1 || stream.backEdge[0]) {
+            continue;
+        }
+
+        const auto consumer = stream.consumers[0].node;
+        if (!isLluvia[producer] || !isLluvia[consumer] || producer == consumer) {
+            continue;
+        }
+
+        const auto& producerNode = config.node(producer);
+        const auto& consumerNode = config.node(consumer);
+
+        if (producerNode.executor() != consumerNode.executor()
+            || producerNode.input_side_packet_size() > 0 || consumerNode.input_side_packet_size() > 0
+            || consumerNode.has_input_stream_handler()) {
+            continue;
+        }
+
+        // every member of a group agrees on them, as its edges do
+        if (!haveSameCalculatorOptions(lluviaOptions[producer], lluviaOptions[consumer])) {
+            continue;
+        }
+
+        if (!isFusableBinding(findBinding(lluviaOptions[producer].output_port_binding(), stream.producer.tag))
+            || !isFusableBinding(findBinding(lluviaOptions[consumer].input_port_binding(), stream.consumers[0].tag))) {
+            continue;
+        }
+
+        auto candidate = groups;
+        candidate.merge(producer, consumer);
+
+        if (hasCycle(streams, candidate, nodeCount)) {
+            continue;
+        }
+
+        groups = candidate;
+        fusedStreams.insert(name);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Members of each group in topological order
+    auto members = std::map<int, std::vector<int>> {};
+    for (auto n = 0; n < nodeCount; ++n) {
+        members[groups.find(n)].push_back(n);
+    }
+
+    for (auto& [root, group] : members) {
+
+        if (group.size() < 2) continue;
+
+        // Kahn's algorithm over the fused edges, ties broken by node order
+        auto inDegree = std::map<int, int> {};
+        for (const auto n : group) inDegree[n] = 0;
+
+        for (const auto& name : fusedStreams) {
+            const auto& stream = streams.at(name);
+            if (groups.find(stream.producer.node) == root) {
+                ++inDegree[stream.consumers[0].node];
+            }
+        }
+
+        auto sorted = std::vector<int> {};
+        auto ready = std::set<int> {};
+        for (const auto n : group) {
+            if (inDegree[n] == 0) ready.insert(n);
+        }
+
+        while (!ready.empty()) {
+            const auto n = *ready.begin();
+            ready.erase(ready.begin());
+            sorted.push_back(n);
+
+            for (const auto& name : fusedStreams) {
+                const auto& stream = streams.at(name);
+                if (stream.producer.node == n && --inDegree[stream.consumers[0].node] == 0) {
+                    ready.insert(stream.consumers[0].node);
+                }
+            }
+        }
+
+        group = sorted;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Output graph
+    auto result = LluviaFusionResult {};
+    result.graph = config;
+    result.graph.clear_node();
+
+    for (auto n = 0; n < nodeCount; ++n) {
+
+        const auto root = groups.find(n);
+        const auto& group = members.at(root);
+
+        if (group.size() < 2) {
+            *result.graph.add_node() = config.node(n);
+            continue;
+        }
+
+        // the fused node takes the position of the first member in the original graph
+        if (n != *std::min_element(group.begin(), group.end())) {
+            continue;
+        }
+
+        const auto fusedIndex = result.report.fusedCalculators++;
+        result.report.mergedNodes += static_cast<int>(group.size());
+        result.report.submissionsSaved += static_cast<int>(group.size()) - 1;
+
+        auto script = LluviaFusedScript {};
+        script.fileName = absl::StrCat("fused_", fusedIndex, ".lua");
+        script.builderName = absl::StrCat(fusionOptions.builderNamePrefix, "fused_", fusedIndex);
+
+        auto fusedOptions = lluvia::LluviaCalculatorOptions {};
+        fusedOptions.set_container_node(script.builderName);
+
+        auto fusedNode = CalculatorGraphConfig::Node {};
+        fusedNode.set_calculator(kLluviaCalculator);
+        fusedNode.set_executor(config.node(n).executor());
+
+        auto memberIndex = std::map<int, int> {};
+        for (auto i = 0; i < static_cast<int>(group.size()); ++i) {
+            memberIndex[group[i]] = i;
+        }
+
+        auto onNodeInit = std::vector<std::string> {};
+        auto onNodeRecord = std::vector<std::string> {};
+
+        for (auto i = 0; i < static_cast<int>(group.size()); ++i) {
+
+            const auto& node = config.node(group[i]);
+            const auto& options = lluviaOptions[group[i]];
+
+            const auto child = absl::StrCat("n", i);
+            const auto prefixTag = [i](const std::string& tag) { return absl::StrCat("N", i, "_", tag); };
+
+            // session-wide options
+            if (i == 0) {
+                copyCalculatorOptions(options, fusedOptions);
+            }
+
+            fusedOptions.set_enable_debug(fusedOptions.enable_debug() || options.enable_debug());
+            fusedOptions.set_image_pool_size(std::max(fusedOptions.image_pool_size(), options.image_pool_size()));
+            if (fusedOptions.session_name().empty()) {
+                fusedOptions.set_session_name(options.session_name());
+            }
+
+            for (const auto& path : options.library_path()) {
+                if (std::find(fusedOptions.library_path().begin(), fusedOptions.library_path().end(), path) == fusedOptions.library_path().end()) {
+                    fusedOptions.add_library_path(path);
+                }
+            }
+
+            for (const auto& path : options.script_path()) {
+                if (std::find(fusedOptions.script_path().begin(), fusedOptions.script_path().end(), path) == fusedOptions.script_path().end()) {
+                    fusedOptions.add_script_path(path);
+                }
+            }
+
+            onNodeInit.push_back(absl::StrCat("    local ", child, " = ll.createContainerNode('", options.container_node(), "')"));
+
+            for (const auto& parameter : options.parameter()) {
+                onNodeInit.push_back(absl::StrCat("    ", child, ":setParameter('", parameter.name(), "', ", parameter.value(), ")"));
+            }
+
+            // inputs
+            for (const auto& inputStream : node.input_stream()) {
+
+                const auto [tag, name] = splitStream(inputStream);
+                const auto* binding = findBinding(options.input_port_binding(), tag);
+
+                if (fusedStreams.count(name) > 0) {
+
+                    // internal edge, bind the upstream output image directly
+                    const auto& stream = streams.at(name);
+                    const auto& producerOptions = lluviaOptions[stream.producer.node];
+                    const auto* producerBinding = findBinding(producerOptions.output_port_binding(), stream.producer.tag);
+
+                    onNodeInit.push_back(absl::StrCat("    ", child, ":bind('", binding->lluvia_port(), "', n",
+                                                      memberIndex.at(stream.producer.node), ":getPort('", producerBinding->lluvia_port(), "'))"));
+
+                    result.report.transferCommandsSaved += 2;
+                    if (binding->packet_type() == lluvia::IMAGE_FRAME || producerBinding->packet_type() == lluvia::IMAGE_FRAME) {
+                        result.report.hostCopiesSaved += 2;
+                    }
+                    if (binding->packet_type() == lluvia::LLUVIA_IMAGE) {
+                        // the ingest command buffer is a submission of its own
+                        result.report.submissionsSaved += 1;
+                    }
+                    continue;
+                }
+
+                fusedNode.add_input_stream(absl::StrCat(prefixTag(tag), ":", name));
+
+                if (binding == nullptr) {
+                    // ROI streams, renamed together with the bindings referencing them
+                    continue;
+                }
+
+                auto fusedBinding = *binding;
+                fusedBinding.set_mediapipe_tag(prefixTag(binding->mediapipe_tag()));
+                fusedBinding.set_lluvia_port(absl::StrCat(child, "_", binding->lluvia_port()));
+                if (!binding->roi_tag().empty()) {
+                    fusedBinding.set_roi_tag(prefixTag(binding->roi_tag()));
+                }
+                *fusedOptions.add_input_port_binding() = fusedBinding;
+
+                onNodeInit.push_back(absl::StrCat("    ", child, ":bind('", binding->lluvia_port(), "', node:getPort('", fusedBinding.lluvia_port(), "'))"));
+            }
+
+            onNodeInit.push_back(absl::StrCat("    ", child, ":init()"));
+            onNodeInit.push_back(absl::StrCat("    node:bindNode('", child, "', ", child, ")"));
+
+            // outputs
+            for (const auto& outputStream : node.output_stream()) {
+
+                const auto [tag, name] = splitStream(outputStream);
+                if (fusedStreams.count(name) > 0) {
+                    continue;
+                }
+
+                fusedNode.add_output_stream(absl::StrCat(prefixTag(tag), ":", name));
+
+                const auto* binding = findBinding(options.output_port_binding(), tag);
+                if (binding == nullptr) {
+                    continue;
+                }
+
+                auto fusedBinding = *binding;
+                fusedBinding.set_mediapipe_tag(prefixTag(binding->mediapipe_tag()));
+                fusedBinding.set_lluvia_port(absl::StrCat(child, "_", binding->lluvia_port()));
+                if (!binding->roi_tag().empty()) {
+                    fusedBinding.set_roi_tag(prefixTag(binding->roi_tag()));
+                }
+                *fusedOptions.add_output_port_binding() = fusedBinding;
+
+                onNodeInit.push_back(absl::StrCat("    node:bind('", fusedBinding.lluvia_port(), "', ", child, ":getPort('", binding->lluvia_port(), "'))"));
+            }
+
+            onNodeInit.push_back("");
+
+            // LluviaCalculator puts a barrier after running each container node
+            onNodeRecord.push_back(absl::StrCat("    node:getNode('", child, "'):record(cmdBuffer)"));
+            onNodeRecord.push_back("    cmdBuffer:memoryBarrier()");
+        }
+
+        fusedOptions.add_script_path(absl::StrCat(fusionOptions.scriptPathPrefix, script.fileName));
+        fusedNode.add_node_options()->PackFrom(fusedOptions);
+
+        *result.graph.add_node() = fusedNode;
+
+        auto memberNames = std::vector<std::string> {};
+        for (const auto m : group) {
+            memberNames.push_back(lluviaOptions[m].container_node());
+        }
+
+        script.content = absl::StrCat(
+            "-- Generated by fuse_lluvia_graph, do not edit.\n",
+            "local builder = ll.class(ll.ContainerNodeBuilder)\n\n",
+            "builder.name = '", script.builderName, "'\n",
+            "builder.doc = [[\nFused container node running ", absl::StrJoin(memberNames, ", "), ".\n]]\n",
+            "\n",
+            "function builder.newDescriptor()\n\n",
+            "    local desc = ll.ContainerNodeDescriptor.new()\n",
+            "    desc.builderName = builder.name\n\n",
+            "    return desc\n",
+            "end\n\n\n",
+            "function builder.onNodeInit(node)\n\n",
+            absl::StrJoin(onNodeInit, "\n"), "\n",
+            "end\n\n\n",
+            "function builder.onNodeRecord(node, cmdBuffer)\n\n",
+            absl::StrJoin(onNodeRecord, "\n"), "\n",
+            "end\n\n\n",
+            "ll.registerNodeBuilder(builder)\n");
+
+        result.scripts.push_back(std::move(script));
+    }
+
+    return result;
+}
+
+std::string LluviaFusionReportToString(const LluviaFusionReport& report) {
+
+    return absl::StrCat(
+        "fused calculators:                 ", report.fusedCalculators, "\n",
+        "merged LluviaCalculator nodes:     ", report.mergedNodes, "\n",
+        "submissions saved per frame:       ", report.submissionsSaved, "\n",
+        "transfer commands saved per frame: ", report.transferCommandsSaved, "\n",
+        "host copies saved per frame:       ", report.hostCopiesSaved, "\n");
+}
+
+} // namespace mediapipe
@@ -0,0 +1,77 @@
+#ifndef LLUVIA_MEDIAPIPE_TOOLS_LLUVIA_GRAPH_FUSION_H_
+#define LLUVIA_MEDIAPIPE_TOOLS_LLUVIA_GRAPH_FUSION_H_
+
+#include "mediapipe/framework/calculator.pb.h"
+#include "mediapipe/framework/port/statusor.h"
+
+#include <string>
+#include <vector>
+
+namespace mediapipe {
+
+struct LluviaFusionOptions {
+    // prefix prepended to the generated script file names in the script_path
+    // option of fused nodes, for instance a directory or an asset prefix.
+    std::string scriptPathPrefix;
+
+    // prefix of the generated container node builder names. It must be
+    // unique among graphs sharing a Lluvia session.
+    std::string builderNamePrefix {"mediapipe/fused/"};
+};
+
+// Lua script describing the container node of one fused calculator.
+struct LluviaFusedScript {
+    std::string fileName;
+    std::string builderName;
+    std::string content;
+};
+
+// Per frame savings of the fused graph compared to the original one.
+struct LluviaFusionReport {
+    // number of fused calculators in the output graph.
+    int fusedCalculators {0};
+
+    // number of LluviaCalculator nodes merged into fused calculators.
+    int mergedNodes {0};
+
+    // session->run() calls, each one a queue submission plus a fence wait.
+    int submissionsSaved {0};
+
+    // buffer-image and image-image copy commands removed from command buffers.
+    int transferCommandsSaved {0};
+
+    // host memcpy between ImageFrame and staging buffers.
+    int hostCopiesSaved {0};
+};
+
+struct LluviaFusionResult {
+    CalculatorGraphConfig graph;
+    std::vector<LluviaFusedScript> scripts;
+    LluviaFusionReport report;
+};
+
+/**
+ * Merges chains of LluviaCalculator nodes into single calculators.
+ *
+ * An edge between two LluviaCalculator nodes is fused when its stream is
+ * consumed only by the downstream node, both port bindings are IMAGE_FRAME
+ * or LLUVIA_IMAGE without ROI or packing, and merging does not create a
+ * cycle. Each fused calculator runs a generated container node recording
+ * the original container nodes in topological order, with the downstream
+ * input port bound to the upstream output image. Kernels and
+ * their order are unchanged, so the outputs match the original graph.
+ * The parameters of each original node are set on its container node.
+ * Nodes with additional containers, a latency governor, tiling, multiple
+ * devices or a snapshot are not fused. Calculator wide options such as
+ * memory_mode, trace_path, warmup_runs, workgroup_tuning,
+ * submission_thread and host_copy_threads are carried over to the fused
+ * calculator, edges between nodes whose values differ are not fused.
+ */
+::mediapipe::StatusOr<LluviaFusionResult> FuseLluviaCalculators(const CalculatorGraphConfig& config,
+                                                                const LluviaFusionOptions& options);
+
+std::string LluviaFusionReportToString(const LluviaFusionReport& report);
+
+} // namespace mediapipe
+
+#endif // LLUVIA_MEDIAPIPE_TOOLS_LLUVIA_GRAPH_FUSION_H_
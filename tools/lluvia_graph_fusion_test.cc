@@ -0,0 +1,350 @@
+#include "absl/strings/str_cat.h"
+#include "absl/strings/substitute.h"
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/sink.h"
+
+#include "tools/cpp/runfiles/runfiles.h"
+using bazel::tools::cpp::runfiles::Runfiles;
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/tools/lluvia_graph_fusion.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+namespace mediapipe {
+
+namespace {
+
+// Three passthrough calculators, the second one feeding both the third
+// one and the graph output.
+constexpr char kPassthroughGraph[] = R"pb(
+    input_stream: "input_image"
+    output_stream: "middle_image"
+
+    node {
+        calculator: "LluviaCalculator"
+        input_stream: "IN_0:input_image"
+        output_stream: "OUT_0:device_image"
+        node_options {
+            [type.googleapis.com/lluvia.LluviaCalculatorOptions]: {
+                session_name: "fusion"
+                container_node: "mediapipe/test/PassthroughContainerNode"
+                library_path: "$0"
+                script_path: "$1"
+
+                input_port_binding:  {
+                    mediapipe_tag: "IN_0"
+                    lluvia_port: "in_image_0"
+                    packet_type: IMAGE_FRAME
+                }
+
+                output_port_binding:  {
+                    mediapipe_tag: "OUT_0"
+                    lluvia_port: "out_image_0"
+                    packet_type: LLUVIA_IMAGE
+                }
+            }
+        }
+    }
+
+    node {
+        calculator: "LluviaCalculator"
+        input_stream: "IN_0:device_image"
+        output_stream: "OUT_0:middle_image"
+        node_options {
+            [type.googleapis.com/lluvia.LluviaCalculatorOptions]: {
+                session_name: "fusion"
+                container_node: "mediapipe/test/PassthroughContainerNode"
+                library_path: "$0"
+                script_path: "$1"
+
+                input_port_binding:  {
+                    mediapipe_tag: "IN_0"
+                    lluvia_port: "in_image_0"
+                    packet_type: LLUVIA_IMAGE
+                }
+
+                output_port_binding:  {
+                    mediapipe_tag: "OUT_0"
+                    lluvia_port: "out_image_0"
+                    packet_type: IMAGE_FRAME
+                }
+            }
+        }
+    }
+
+    node {
+        calculator: "LluviaCalculator"
+        input_stream: "IN_0:middle_image"
+        output_stream: "OUT_0:output_image"
+        node_options {
+            [type.googleapis.com/lluvia.LluviaCalculatorOptions]: {
+                session_name: "fusion"
+                container_node: "mediapipe/test/PassthroughContainerNode"
+                library_path: "$0"
+                script_path: "$1"
+
+                input_port_binding:  {
+                    mediapipe_tag: "IN_0"
+                    lluvia_port: "in_image_0"
+                    packet_type: IMAGE_FRAME
+                }
+
+                output_port_binding:  {
+                    mediapipe_tag: "OUT_0"
+                    lluvia_port: "out_image_0"
+                    packet_type: IMAGE_FRAME
+                }
+            }
+        }
+    }
+)pb";
+
+CalculatorGraphConfig getPassthroughGraph() {
+
+    auto runfiles = Runfiles::CreateForTest(nullptr);
+
+    auto libraryPath = runfiles->Rlocation("lluvia/lluvia/nodes/lluvia_node_library.zip");
+    auto calculatorScriptPath = runfiles->Rlocation("mediapipe/mediapipe/lluvia-mediapipe/calculators/test_data/PassthroughContainerNode.lua");
+
+    return ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(kPassthroughGraph, libraryPath, calculatorScriptPath));
+}
+
+// Applies update to the LluviaCalculatorOptions of the given node.
+void updateOptions(CalculatorGraphConfig& graphConfig, const int node,
+                   const std::function<void(lluvia::LluviaCalculatorOptions&)>& update) {
+
+    auto* any = graphConfig.mutable_node(node)->mutable_node_options(0);
+
+    auto options = lluvia::LluviaCalculatorOptions {};
+    ASSERT_TRUE(any->UnpackTo(&options));
+    update(options);
+    any->PackFrom(options);
+}
+
+std::vector<Packet> runGraph(CalculatorGraphConfig graphConfig, const int frameCount) {
+
+    auto outputPackets = std::vector<Packet> {};
+    tool::AddVectorSink("output_image", &graphConfig, &outputPackets);
+
+    CalculatorGraph graph;
+    MP_EXPECT_OK(graph.Initialize(graphConfig));
+    MP_EXPECT_OK(graph.StartRun({}));
+
+    for (auto t = 0; t < frameCount; ++t) {
+
+        auto inputImage = absl::make_unique<ImageFrame>(ImageFormat::SRGBA, 320, 240);
+        for (auto y = 0; y < inputImage->Height(); ++y) {
+            auto* row = inputImage->MutablePixelData() + y * inputImage->WidthStep();
+            for (auto x = 0; x < inputImage->Width() * 4; ++x) {
+                row[x] = static_cast<uint8>((x * 7 + y * 3 + t) % 256);
+            }
+        }
+
+        MP_EXPECT_OK(graph.AddPacketToInputStream("input_image", Adopt(inputImage.release()).At(Timestamp(t))));
+    }
+
+    MP_EXPECT_OK(graph.CloseAllInputStreams());
+    MP_EXPECT_OK(graph.WaitUntilDone());
+
+    return outputPackets;
+}
+
+TEST(LluviaGraphFusionTest, TestFuseChain) {
+
+    auto graphConfig = getPassthroughGraph();
+
+    ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, LluviaFusionOptions {}));
+
+    // middle_image is a graph output, only the first edge is fused
+    ASSERT_EQ(result.graph.node_size(), 2);
+    ASSERT_EQ(result.scripts.size(), 1);
+
+    EXPECT_EQ(result.report.fusedCalculators, 1);
+    EXPECT_EQ(result.report.mergedNodes, 2);
+    EXPECT_EQ(result.report.submissionsSaved, 2);
+    EXPECT_EQ(result.report.transferCommandsSaved, 2);
+    EXPECT_EQ(result.report.hostCopiesSaved, 0);
+
+    const auto& fusedNode = result.graph.node(0);
+    EXPECT_EQ(fusedNode.calculator(), "LluviaCalculator");
+    ASSERT_EQ(fusedNode.input_stream_size(), 1);
+    EXPECT_EQ(fusedNode.input_stream(0), "N0_IN_0:input_image");
+    ASSERT_EQ(fusedNode.output_stream_size(), 1);
+    EXPECT_EQ(fusedNode.output_stream(0), "N1_OUT_0:middle_image");
+
+    auto options = lluvia::LluviaCalculatorOptions {};
+    ASSERT_EQ(fusedNode.node_options_size(), 1);
+    ASSERT_TRUE(fusedNode.node_options(0).UnpackTo(&options));
+
+    EXPECT_EQ(options.container_node(), result.scripts[0].builderName);
+    EXPECT_EQ(options.session_name(), "fusion");
+    EXPECT_EQ(options.script_path_size(), 2);
+    ASSERT_EQ(options.input_port_binding_size(), 1);
+    EXPECT_EQ(options.input_port_binding(0).lluvia_port(), "n0_in_image_0");
+    ASSERT_EQ(options.output_port_binding_size(), 1);
+    EXPECT_EQ(options.output_port_binding(0).lluvia_port(), "n1_out_image_0");
+
+    // the last node is untouched
+    EXPECT_EQ(result.graph.node(1).input_stream(0), "IN_0:middle_image");
+}
+
+TEST(LluviaGraphFusionTest, TestMultipleConsumers) {
+
+    auto graphConfig = getPassthroughGraph();
+
+    // device_image now feeds two calculators
+    *graphConfig.add_node() = graphConfig.node(1);
+    graphConfig.mutable_node(3)->set_output_stream(0, "OUT_0:other_image");
+
+    ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, LluviaFusionOptions {}));
+
+    EXPECT_EQ(result.graph.node_size(), 4);
+    EXPECT_TRUE(result.scripts.empty());
+    EXPECT_EQ(result.report.fusedCalculators, 0);
+}
+
+TEST(LluviaGraphFusionTest, TestFusedOutputMatches) {
+
+    constexpr auto frameCount = 4;
+
+    auto graphConfig = getPassthroughGraph();
+
+    auto fusionOptions = LluviaFusionOptions {};
+    fusionOptions.scriptPathPrefix = absl::StrCat(std::getenv("TEST_TMPDIR"), "/");
+
+    ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, fusionOptions));
+    ASSERT_EQ(result.scripts.size(), 1);
+
+    MP_ASSERT_OK(file::SetContents(fusionOptions.scriptPathPrefix + result.scripts[0].fileName, result.scripts[0].content));
+
+    auto expectedPackets = runGraph(graphConfig, frameCount);
+    auto fusedPackets = runGraph(result.graph, frameCount);
+
+    ASSERT_EQ(expectedPackets.size(), frameCount);
+    ASSERT_EQ(fusedPackets.size(), frameCount);
+
+    for (auto t = 0; t < frameCount; ++t) {
+        auto& expected = expectedPackets[t].Get<ImageFrame>();
+        auto& fused = fusedPackets[t].Get<ImageFrame>();
+
+        ASSERT_EQ(expected.Width(), fused.Width());
+        ASSERT_EQ(expected.Height(), fused.Height());
+        ASSERT_EQ(expected.Format(), fused.Format());
+
+        for (auto y = 0; y < expected.Height(); ++y) {
+            ASSERT_EQ(std::memcmp(expected.PixelData() + y * expected.WidthStep(),
+                                  fused.PixelData() + y * fused.WidthStep(),
+                                  expected.Width() * expected.ByteDepth() * expected.NumberOfChannels()), 0);
+        }
+    }
+}
+
+TEST(LluviaGraphFusionTest, TestTilingNotFused) {
+
+    auto graphConfig = getPassthroughGraph();
+    updateOptions(graphConfig, 0, [](lluvia::LluviaCalculatorOptions& options) {
+        options.mutable_tiling()->set_tile_width(64);
+        options.mutable_tiling()->set_tile_height(64);
+    });
+
+    ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, LluviaFusionOptions {}));
+
+    EXPECT_EQ(result.graph.node_size(), 3);
+    EXPECT_EQ(result.report.fusedCalculators, 0);
+}
+
+TEST(LluviaGraphFusionTest, TestMultiDeviceNotFused) {
+
+    auto graphConfig = getPassthroughGraph();
+    updateOptions(graphConfig, 1, [](lluvia::LluviaCalculatorOptions& options) {
+        options.mutable_multi_device()->add_device_index(0);
+    });
+
+    ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, LluviaFusionOptions {}));
+
+    EXPECT_EQ(result.graph.node_size(), 3);
+    EXPECT_EQ(result.report.fusedCalculators, 0);
+}
+
+TEST(LluviaGraphFusionTest, TestSnapshotNotFused) {
+
+    auto graphConfig = getPassthroughGraph();
+    updateOptions(graphConfig, 0, [](lluvia::LluviaCalculatorOptions& options) {
+        options.set_snapshot_path("passthrough.snapshot");
+    });
+
+    ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, LluviaFusionOptions {}));
+
+    EXPECT_EQ(result.graph.node_size(), 3);
+    EXPECT_EQ(result.report.fusedCalculators, 0);
+}
+
+TEST(LluviaGraphFusionTest, TestDifferentOptionsNotFused) {
+
+    const auto updates = std::vector<std::function<void(lluvia::LluviaCalculatorOptions&)>> {
+        [](lluvia::LluviaCalculatorOptions& options) { options.set_memory_mode(lluvia::LluviaCalculatorOptions::STAGING); },
+        [](lluvia::LluviaCalculatorOptions& options) { options.set_trace_path("trace.json"); },
+        [](lluvia::LluviaCalculatorOptions& options) { options.set_trace_max_events(10); },
+        [](lluvia::LluviaCalculatorOptions& options) { options.set_warmup_runs(0); },
+        [](lluvia::LluviaCalculatorOptions& options) { options.mutable_workgroup_tuning()->set_enabled(true); },
+        [](lluvia::LluviaCalculatorOptions& options) { options.set_submission_thread(true); },
+        [](lluvia::LluviaCalculatorOptions& options) { options.set_host_copy_threads(4); },
+    };
+
+    for (auto i = size_t {0}; i < updates.size(); ++i) {
+
+        auto graphConfig = getPassthroughGraph();
+        updateOptions(graphConfig, 1, updates[i]);
+
+        ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, LluviaFusionOptions {}));
+
+        EXPECT_EQ(result.graph.node_size(), 3) << "option " << i;
+        EXPECT_EQ(result.report.fusedCalculators, 0) << "option " << i;
+    }
+}
+
+TEST(LluviaGraphFusionTest, TestSameOptionsCarriedOver) {
+
+    auto graphConfig = getPassthroughGraph();
+    for (auto node = 0; node < 2; ++node) {
+        updateOptions(graphConfig, node, [](lluvia::LluviaCalculatorOptions& options) {
+            options.set_memory_mode(lluvia::LluviaCalculatorOptions::STAGING);
+            options.set_trace_path("trace.json");
+            options.set_trace_max_events(10);
+            options.set_warmup_runs(0);
+            options.mutable_workgroup_tuning()->set_enabled(true);
+            options.mutable_workgroup_tuning()->set_cache_path("tuning.txt");
+            options.set_submission_thread(true);
+            options.set_host_copy_threads(4);
+        });
+    }
+
+    ASSERT_OK_AND_ASSIGN(auto result, FuseLluviaCalculators(graphConfig, LluviaFusionOptions {}));
+    ASSERT_EQ(result.graph.node_size(), 2);
+
+    auto options = lluvia::LluviaCalculatorOptions {};
+    ASSERT_TRUE(result.graph.node(0).node_options(0).UnpackTo(&options));
+
+    EXPECT_EQ(options.memory_mode(), lluvia::LluviaCalculatorOptions::STAGING);
+    EXPECT_EQ(options.trace_path(), "trace.json");
+    EXPECT_EQ(options.trace_max_events(), 10);
+    EXPECT_EQ(options.warmup_runs(), 0);
+    EXPECT_TRUE(options.workgroup_tuning().enabled());
+    EXPECT_EQ(options.workgroup_tuning().cache_path(), "tuning.txt");
+    EXPECT_TRUE(options.submission_thread());
+    EXPECT_EQ(options.host_copy_threads(), 4);
+}
+
+} // namespace
+} // namespace mediapipe
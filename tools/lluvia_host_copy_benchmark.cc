@@ -0,0 +1,114 @@
+#include <cstdlib>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_host_copy.h"
+
+#include <lluvia/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+ABSL_FLAG(int, threads, 4, "Threads of the copy engine, see LluviaCalculatorOptions.host_copy_threads.");
+ABSL_FLAG(int, iterations, 50, "Number of copies measured for each frame size and copy method.");
+ABSL_FLAG(bool, staging, true, "Copies to a mapped staging buffer of a Lluvia session instead of host heap memory.");
+
+struct FrameSize {
+    const char* name;
+    int width;
+    int height;
+};
+
+// Median throughput in GB/s of copy over bytes, after one untimed run.
+double measureThroughput(const size_t bytes, const std::function<void()>& copy) {
+
+    copy();
+
+    auto seconds = std::vector<double> {};
+
+    for (auto i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        copy();
+        const auto end = std::chrono::steady_clock::now();
+
+        seconds.push_back(std::chrono::duration<double>(end - start).count());
+    }
+
+    std::nth_element(seconds.begin(), seconds.begin() + seconds.size() / 2, seconds.end());
+    return bytes / seconds[seconds.size() / 2] / 1e9;
+}
+
+int main(int argc, char** argv) {
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Arg parsing
+    absl::ParseCommandLine(argc, argv);
+    std::cout << "threads: " << absl::GetFlag(FLAGS_threads) << std::endl;
+    std::cout << "staging: " << absl::GetFlag(FLAGS_staging) << std::endl;
+
+    if (absl::GetFlag(FLAGS_iterations) <= 0) {
+        std::cerr << "ERROR: iterations must be positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto engine = mediapipe::LluviaHostCopyEngine {std::max(1, absl::GetFlag(FLAGS_threads))};
+    auto session = std::shared_ptr<ll::Session> {};
+
+    if (absl::GetFlag(FLAGS_staging)) {
+        session = ll::Session::create();
+    }
+
+    // SRGB frames, whose ImageFrame rows are padded, copied to an unpadded
+    // staging buffer as LluviaCalculator uploads them
+    const auto frameSizes = std::vector<FrameSize> {{"1080p", 1920, 1080}, {"4K", 3840, 2160}, {"8K", 7680, 4320}};
+
+    for (const auto& frameSize : frameSizes) {
+
+        const auto rowBytes = static_cast<size_t>(frameSize.width) * 3;
+        const auto srcStride = (rowBytes + 15) / 16 * 16 + 16;
+        const auto bytes = rowBytes * frameSize.height;
+
+        auto src = std::vector<uint8_t>(srcStride * frameSize.height, 1);
+
+        auto hostDst = std::vector<uint8_t> {};
+        auto stagingBuffer = std::shared_ptr<ll::Buffer> {};
+        auto stagingPtr = std::unique_ptr<uint8_t [], ll::Buffer::BufferMapDeleter> {};
+        auto* dst = static_cast<uint8_t*>(nullptr);
+
+        if (session) {
+            stagingBuffer = session->getHostMemory()->createBuffer(bytes);
+            stagingPtr = stagingBuffer->map<uint8_t []>();
+            dst = stagingPtr.get();
+        } else {
+            hostDst.resize(bytes);
+            dst = hostDst.data();
+        }
+
+        const auto memcpyRows = measureThroughput(bytes, [&]() {
+            for (auto y = 0; y < frameSize.height; ++y) {
+                std::memcpy(dst + y * rowBytes, src.data() + y * srcStride, rowBytes);
+            }
+        });
+
+        const auto engineCopy = measureThroughput(bytes, [&]() {
+            engine.copy(src.data(), srcStride, dst, rowBytes, rowBytes, frameSize.height, false);
+        });
+
+        const auto engineStreaming = measureThroughput(bytes, [&]() {
+            engine.copy(src.data(), srcStride, dst, rowBytes, rowBytes, frameSize.height, true);
+        });
+
+        std::cout << frameSize.name << " (" << bytes / (1024 * 1024) << " MB)"
+                  << ": memcpy: " << memcpyRows << " GB/s"
+                  << ", engine: " << engineCopy << " GB/s"
+                  << ", engine streaming: " << engineStreaming << " GB/s" << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include <cstdlib>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/substitute.h"
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+ABSL_FLAG(std::string, lluvia_library, "", "Path to lluvia_node_library.zip.");
+ABSL_FLAG(std::string, mediapipe_library, "", "Path to lluvia_mediapipe_library.zip.");
+ABSL_FLAG(int, width, 1920, "Width of the input frames.");
+ABSL_FLAG(int, height, 1080, "Height of the input frames.");
+ABSL_FLAG(int, frames, 300, "Number of frames measured for each memory mode.");
+ABSL_FLAG(int, warmup_frames, 10, "Number of frames run before measuring.");
+
+
+// Runs the RGBA2Gray container node of lluvia_mediapipe_library one frame at
+// a time and returns the latency of each frame in milliseconds, from adding
+// the input packet to the graph being idle.
+::mediapipe::StatusOr<std::vector<double>> runMemoryMode(const std::string& memoryMode) {
+
+    auto graphConfig = mediapipe::ParseTextProtoOrDie<mediapipe::CalculatorGraphConfig>(
+        absl::Substitute(
+            R"pb(
+                input_stream: "input_image"
+                output_stream: "output_image"
+
+                node {
+                    calculator: "LluviaCalculator"
+                    input_stream: "IN_0:input_image"
+                    output_stream: "OUT_0:output_image"
+                    node_options {
+                        [type.googleapis.com/lluvia.LluviaCalculatorOptions]: {
+                            container_node: "lluvia/mediapipe/LluviaCalculator"
+
+                            library_path: "$0"
+                            library_path: "$1"
+
+                            memory_mode: $2
+
+                            input_port_binding:  {
+                                mediapipe_tag: "IN_0"
+                                lluvia_port: "in_image"
+                                packet_type: IMAGE_FRAME
+                            }
+
+                            output_port_binding:  {
+                                mediapipe_tag: "OUT_0"
+                                lluvia_port: "out_image"
+                                packet_type: IMAGE_FRAME
+                            }
+                        }
+                    }
+                }
+            )pb",
+            absl::GetFlag(FLAGS_lluvia_library),
+            absl::GetFlag(FLAGS_mediapipe_library),
+            memoryMode
+        )
+    );
+
+    mediapipe::CalculatorGraph graph;
+    MP_RETURN_IF_ERROR(graph.Initialize(graphConfig));
+
+    // reading one pixel makes the observer touch the output memory, as a consumer would
+    auto checksum = 0;
+    MP_RETURN_IF_ERROR(graph.ObserveOutputStream("output_image", [&checksum](const mediapipe::Packet& packet) {
+        checksum += packet.Get<mediapipe::ImageFrame>().PixelData()[0];
+        return ::mediapipe::OkStatus();
+    }));
+
+    MP_RETURN_IF_ERROR(graph.StartRun({}));
+
+    const auto width = absl::GetFlag(FLAGS_width);
+    const auto height = absl::GetFlag(FLAGS_height);
+    const auto warmupFrames = absl::GetFlag(FLAGS_warmup_frames);
+    const auto frames = absl::GetFlag(FLAGS_frames);
+
+    auto latencies = std::vector<double> {};
+
+    for (auto t = 0; t < warmupFrames + frames; ++t) {
+
+        auto inputImage = absl::make_unique<mediapipe::ImageFrame>(mediapipe::ImageFormat::SRGBA, width, height);
+        std::fill_n(inputImage->MutablePixelData(), inputImage->PixelDataSize(), static_cast<uint8_t>(t));
+
+        const auto start = std::chrono::steady_clock::now();
+
+        MP_RETURN_IF_ERROR(graph.AddPacketToInputStream("input_image", mediapipe::Adopt(inputImage.release()).At(mediapipe::Timestamp(t))));
+        MP_RETURN_IF_ERROR(graph.WaitUntilIdle());
+
+        const auto end = std::chrono::steady_clock::now();
+
+        if (t >= warmupFrames) {
+            latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+    }
+
+    MP_RETURN_IF_ERROR(graph.CloseAllInputStreams());
+    MP_RETURN_IF_ERROR(graph.WaitUntilDone());
+
+    std::cout << memoryMode << " checksum: " << checksum << std::endl;
+    return latencies;
+}
+
+
+void printLatencies(const std::string& memoryMode, std::vector<double> latencies) {
+
+    std::sort(latencies.begin(), latencies.end());
+
+    auto sum = 0.0;
+    for (const auto latency : latencies) sum += latency;
+
+    const auto percentile = [&latencies](const double p) {
+        return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+
+    std::cout << memoryMode << ": frames: " << latencies.size()
+              << ", mean: " << sum / latencies.size() << " ms"
+              << ", p50: " << percentile(0.5) << " ms"
+              << ", p99: " << percentile(0.99) << " ms" << std::endl;
+}
+
+
+int main(int argc, char** argv) {
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Arg parsing
+    absl::ParseCommandLine(argc, argv);
+    std::cout << "resolution: " << absl::GetFlag(FLAGS_width) << "x" << absl::GetFlag(FLAGS_height) << std::endl;
+
+    if (absl::GetFlag(FLAGS_frames) <= 0) {
+        std::cerr << "ERROR: frames must be positive" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (const auto* memoryMode : {"STAGING", "UNIFIED"}) {
+
+        auto latencies = runMemoryMode(memoryMode);
+
+        if (!latencies.ok()) {
+            // UNIFIED fails in Open() on devices without device local, host visible memory
+            std::cerr << memoryMode << ": " << latencies.status().message() << std::endl;
+            continue;
+        }
+
+        printLatencies(memoryMode, std::move(latencies).value());
+    }
+
+    return EXIT_SUCCESS;
+}
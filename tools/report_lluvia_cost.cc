@@ -0,0 +1,137 @@
+
+#include <cstdlib>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/substitute.h"
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/status.h"
+
+#include "mediapipe/lluvia-mediapipe/calculators/lluvia_calculator.pb.h"
+#include "mediapipe/lluvia-mediapipe/tools/lluvia_cost_report.h"
+
+#include "google/protobuf/text_format.h"
+
+#include <iostream>
+
+ABSL_FLAG(std::string, graph_file, "", "Path to the text format CalculatorGraphConfig containing the LluviaCalculator.");
+ABSL_FLAG(std::string, node, "", "Name of the LluviaCalculator node to report. Defaults to the first LluviaCalculator of the graph.");
+ABSL_FLAG(std::string, lluvia_library, "", "Path to the Lluvia node library, replaces $0 in the graph.");
+ABSL_FLAG(std::string, script_file, "", "Path to the LUA script describing the container node, replaces $1 in the graph.");
+ABSL_FLAG(int, width, 0, "Overrides the declared width of the input images.");
+ABSL_FLAG(int, height, 0, "Overrides the declared height of the input images.");
+ABSL_FLAG(int, timing_iterations, 0, "Runs of each compute node to measure its GPU time. 0 disables timing.");
+ABSL_FLAG(int, max_device_memory_mb, 0, "Fails if the container node allocates more device memory. 0 disables the check.");
+ABSL_FLAG(int, max_transfer_mb, 0, "Fails if more bytes are uploaded and read back per frame. 0 disables the check.");
+
+
+absl::Status reportCost() {
+
+    auto graph_file = absl::GetFlag(FLAGS_graph_file);
+    if (graph_file.empty()) {
+        return absl::InvalidArgumentError("graph_file cannot be empty");
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Graph configuration
+    auto graphConfigFileContent = std::string {};
+    MP_RETURN_IF_ERROR(mediapipe::file::GetContents(graph_file, &graphConfigFileContent));
+
+    // replace template values
+    graphConfigFileContent = absl::Substitute(graphConfigFileContent,
+                                              absl::GetFlag(FLAGS_lluvia_library),
+                                              absl::GetFlag(FLAGS_script_file));
+
+    auto graphConfig = mediapipe::CalculatorGraphConfig {};
+    if (!google::protobuf::TextFormat::ParseFromString(graphConfigFileContent, &graphConfig)) {
+        return absl::InvalidArgumentError(absl::StrCat("error parsing graph: ", graph_file));
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Calculator options
+    const auto nodeName = absl::GetFlag(FLAGS_node);
+
+    auto options = lluvia::LluviaCalculatorOptions {};
+    auto found = false;
+
+    for (const auto& node : graphConfig.node()) {
+
+        if (node.calculator() != "LluviaCalculator" || (!nodeName.empty() && node.name() != nodeName)) {
+            continue;
+        }
+
+        for (const auto& any : node.node_options()) {
+            if (any.Is<lluvia::LluviaCalculatorOptions>()) {
+                found = any.UnpackTo(&options);
+            }
+        }
+
+        if (!found && node.has_options() && node.options().HasExtension(lluvia::LluviaCalculatorOptions::ext)) {
+            options = node.options().GetExtension(lluvia::LluviaCalculatorOptions::ext);
+            found = true;
+        }
+
+        if (found) {
+            break;
+        }
+    }
+
+    if (!found) {
+        return absl::NotFoundError(nodeName.empty() ? std::string {"graph has no LluviaCalculator with options"}
+                                                    : absl::StrCat("LluviaCalculator node not found: ", nodeName));
+    }
+
+    for (auto& binding : *options.mutable_input_port_binding()) {
+        if (absl::GetFlag(FLAGS_width) > 0) {
+            binding.set_width(absl::GetFlag(FLAGS_width));
+        }
+
+        if (absl::GetFlag(FLAGS_height) > 0) {
+            binding.set_height(absl::GetFlag(FLAGS_height));
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Report
+    ASSIGN_OR_RETURN(auto report, mediapipe::CaptureCostReport(options, absl::GetFlag(FLAGS_timing_iterations)));
+
+    std::cout << mediapipe::LluviaCostReportToString(report);
+
+    constexpr auto MB = uint64_t {1024 * 1024};
+
+    const auto maxDeviceMemoryMB = absl::GetFlag(FLAGS_max_device_memory_mb);
+    if (maxDeviceMemoryMB > 0 && report.deviceMemoryBytes > maxDeviceMemoryMB * MB) {
+        return absl::ResourceExhaustedError(absl::StrCat("device memory ", report.deviceMemoryBytes,
+                                                         " bytes exceeds ", maxDeviceMemoryMB, " MB"));
+    }
+
+    const auto maxTransferMB = absl::GetFlag(FLAGS_max_transfer_mb);
+    const auto transferBytes = report.uploadBytes + report.readbackBytes;
+    if (maxTransferMB > 0 && transferBytes > maxTransferMB * MB) {
+        return absl::ResourceExhaustedError(absl::StrCat("transfer per frame ", transferBytes,
+                                                         " bytes exceeds ", maxTransferMB, " MB"));
+    }
+
+    return absl::OkStatus();
+}
+
+
+int main(int argc, char** argv) {
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Arg parsing
+    absl::ParseCommandLine(argc, argv);
+    std::cout << "graph_file: " << absl::GetFlag(FLAGS_graph_file) << std::endl;
+
+    auto status = reportCost();
+
+    if (!status.ok()) {
+        std::cerr << "ERROR: " << status.message() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}